@@ -13,6 +13,7 @@
 #include <linux/delay.h>
 #include <linux/libfdt.h>
 #include <os.h>
+#include <par_run.h>
 #include <asm/io.h>
 #include <asm/malloc.h>
 #include <asm/setjmp.h>
@@ -345,3 +346,18 @@ ulong timer_get_boot_us(void)
 
 	return (count - base_count) / 1000;
 }
+
+#if CONFIG_IS_ENABLED(PAR_RUN)
+int arch_par_run_cpus(void)
+{
+	/* Use threads even on a single-CPU host, so the parallel paths run */
+	return max(os_get_cpu_count(), 2);
+}
+
+int arch_par_run(int ncpus, void (*worker)(void *arg, int cpu), void *arg)
+{
+	os_run_threads(ncpus, worker, arg);
+
+	return 0;
+}
+#endif
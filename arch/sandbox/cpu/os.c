@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -898,3 +899,51 @@ void os_relaunch(char *argv[])
 	execv(argv[0], argv);
 	os_exit(1);
 }
+
+int os_get_cpu_count(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return count > 0 ? count : 1;
+}
+
+struct os_thread {
+	pthread_t thread;
+	void (*func)(void *arg, int idx);
+	void *arg;
+	int idx;
+	bool started;
+};
+
+static void *os_thread_start(void *data)
+{
+	struct os_thread *thr = data;
+
+	thr->func(thr->arg, thr->idx);
+
+	return NULL;
+}
+
+void os_run_threads(int count, void (*func)(void *arg, int idx), void *arg)
+{
+	struct os_thread *thr;
+	int i;
+
+	thr = calloc(count, sizeof(*thr));
+	for (i = 1; thr && i < count; i++) {
+		thr[i].func = func;
+		thr[i].arg = arg;
+		thr[i].idx = i;
+		thr[i].started = !pthread_create(&thr[i].thread, NULL,
+						 os_thread_start, &thr[i]);
+	}
+
+	func(arg, 0);
+	for (i = 1; i < count; i++) {
+		if (thr && thr[i].started)
+			pthread_join(thr[i].thread, NULL);
+		else
+			func(arg, i);
+	}
+	free(thr);
+}
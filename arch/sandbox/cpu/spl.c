@@ -52,6 +52,12 @@ static int spl_board_load_image(struct spl_image_info *spl_image,
 }
 SPL_LOAD_IMAGE_METHOD("sandbox", 9, BOOT_DEVICE_BOARD, spl_board_load_image);
 
+int board_fit_config_name_match(const char *name)
+{
+	/* no board-specific configuration, so use the default one */
+	return -EINVAL;
+}
+
 void spl_board_init(void)
 {
 	struct sandbox_state *state = state_get_current();
@@ -115,6 +115,68 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_usb_flash_max_queued() - get the deepest UAS command queue seen
+ *
+ * @dev:	USB flash stick emulation device
+ * @return largest number of UAS commands which were outstanding at once
+ */
+int sandbox_usb_flash_max_queued(struct udevice *dev);
+
+struct usb_ctrlrequest;
+
+/**
+ * sandbox_udc_host_t - emulated USB host for the sandbox device controller
+ *
+ * This is called each time the gadget polls the controller. It can use
+ * sandbox_udc_control() and sandbox_udc_bulk() to talk to the gadget.
+ *
+ * @dev:	USB device controller
+ * @priv:	Private data passed to sandbox_udc_set_host()
+ */
+typedef void (*sandbox_udc_host_t)(struct udevice *dev, void *priv);
+
+/**
+ * sandbox_udc_set_host() - plug an emulated host into the device controller
+ *
+ * @dev:	USB device controller
+ * @host:	Function to call while the gadget runs, NULL to unplug
+ * @priv:	Private data to pass to @host
+ */
+void sandbox_udc_set_host(struct udevice *dev, sandbox_udc_host_t host,
+			  void *priv);
+
+/**
+ * sandbox_udc_control() - send a control request to the gadget
+ *
+ * @dev:	USB device controller
+ * @ctrl:	Setup packet
+ * @buf:	Data stage, wLength bytes to receive or send
+ * @return number of bytes in the data stage, -EPIPE if the gadget stalled,
+ *	-ENODEV if no gadget is bound
+ */
+int sandbox_udc_control(struct udevice *dev,
+			const struct usb_ctrlrequest *ctrl, void *buf);
+
+/**
+ * sandbox_udc_bulk() - move data for the oldest request on a bulk endpoint
+ *
+ * @dev:	USB device controller
+ * @ep_addr:	Endpoint address, with USB_DIR_IN set for IN endpoints
+ * @buf:	Buffer to receive into or send from
+ * @len:	Size of @buf in bytes
+ * @return number of bytes moved, -EAGAIN if no request is queued, -EPIPE if
+ *	the endpoint is halted, other -ve on error
+ */
+int sandbox_udc_bulk(struct udevice *dev, int ep_addr, void *buf, int len);
+
+/**
+ * sandbox_udc_disconnect() - unplug the emulated cable
+ *
+ * @dev:	USB device controller
+ */
+void sandbox_udc_disconnect(struct udevice *dev);
+
 /**
  * sandbox_osd_get_mem() - get the internal memory of a sandbox OSD
  *
@@ -8,6 +8,7 @@
 #include <blk.h>
 #include <command.h>
 #include <console.h>
+#include <fs.h>
 #include <memalign.h>
 #include <mmc.h>
 #include <part.h>
@@ -141,6 +142,8 @@ static struct mmc *init_mmc_device(int dev, bool force_init)
 	struct blk_desc *bd = mmc_get_blk_desc(mmc);
 	blkcache_invalidate(bd->if_type, bd->devnum);
 #endif
+	if (force_init)
+		fs_cache_invalidate(mmc_get_blk_desc(mmc));
 
 	return mmc;
 }
@@ -406,6 +409,7 @@ static int do_mmc_sparse_write(struct cmd_tbl *cmdtp, int flag,
 	sparse.size = dev_desc->lba - blk;
 	sparse.write = mmc_sparse_write;
 	sparse.reserve = mmc_sparse_reserve;
+	sparse.discard = NULL;
 	sparse.mssg = NULL;
 	sprintf(dest, "0x" LBAF, sparse.start * sparse.blksz);
 
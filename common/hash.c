@@ -330,6 +330,17 @@ int hash_progressive_lookup_algo(const char *algo_name,
 	return -EPROTONOSUPPORT;
 }
 
+int hash_get_algo(int index, struct hash_algo **algop)
+{
+	reloc_update();
+
+	if (index < 0 || index >= ARRAY_SIZE(hash_algo))
+		return -ENOENT;
+	*algop = &hash_algo[index];
+
+	return 0;
+}
+
 #ifndef USE_HOSTCC
 int hash_parse_string(const char *algo_name, const char *str, uint8_t *result)
 {
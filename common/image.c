@@ -28,6 +28,7 @@
 #include <image.h>
 #include <lz4.h>
 #include <mapmem.h>
+#include <par_decomp.h>
 
 #if IMAGE_ENABLE_FIT || IMAGE_ENABLE_OF_LIBFDT
 #include <linux/libfdt.h>
@@ -448,6 +449,24 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 	*load_end = load;
 	print_decomp_msg(comp, type, load == image_start);
 
+#ifndef USE_HOSTCC
+#if CONFIG_IS_ENABLED(PAR_DECOMP)
+	if (comp != IH_COMP_NONE) {
+		size_t size;
+
+		/* Images made of independent frames can use several CPUs */
+		ret = par_decomp(comp, image_buf, image_len, load_buf, unc_len,
+				 &size);
+		if (ret != -EPROTONOSUPPORT) {
+			if (!ret)
+				*load_end = load + size;
+			return ret;
+		}
+		ret = 0;
+	}
+#endif /* CONFIG_PAR_DECOMP */
+#endif
+
 	/*
 	 * Load the image to the right place, decompressing if needed. After
 	 * this, image_len will be set to the number of uncompressed bytes
@@ -525,51 +544,29 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 #ifndef USE_HOSTCC
 #if CONFIG_IS_ENABLED(ZSTD)
 	case IH_COMP_ZSTD: {
-		size_t size = unc_len;
-		ZSTD_DStream *dstream;
-		ZSTD_inBuffer in_buf;
-		ZSTD_outBuffer out_buf;
-		void *workspace;
-		size_t wsize;
-
-		wsize = ZSTD_DStreamWorkspaceBound(image_len);
-		workspace = malloc(wsize);
-		if (!workspace) {
-			debug("%s: cannot allocate workspace of size %zu\n", __func__,
-			      wsize);
-			return -1;
-		}
+		ZSTD_DCtx *dctx;
+		size_t size;
 
-		dstream = ZSTD_initDStream(image_len, workspace, wsize);
-		if (!dstream) {
-			printf("%s: ZSTD_initDStream failed\n", __func__);
-			return ZSTD_getErrorCode(ret);
+		dctx = ZSTD_createDCtx();
+		if (!dctx) {
+			debug("%s: cannot allocate zstd context\n", __func__);
+			return -ENOMEM;
 		}
 
-		in_buf.src = image_buf;
-		in_buf.pos = 0;
-		in_buf.size = image_len;
-
-		out_buf.dst = load_buf;
-		out_buf.pos = 0;
-		out_buf.size = size;
-
-		while (1) {
-			size_t ret;
-
-			ret = ZSTD_decompressStream(dstream, &out_buf, &in_buf);
-			if (ZSTD_isError(ret)) {
-				printf("%s: ZSTD_decompressStream error %d\n", __func__,
-				       ZSTD_getErrorCode(ret));
-				return ZSTD_getErrorCode(ret);
-			}
-
-			if (in_buf.pos >= image_len || !ret)
-				break;
+		size = ZSTD_decompressDCtx(dctx, load_buf, unc_len, image_buf,
+					   image_len);
+		ZSTD_freeDCtx(dctx);
+		if (ZSTD_isError(size)) {
+			printf("%s: ZSTD_decompressDCtx error %d\n", __func__,
+			       ZSTD_getErrorCode(size));
+			if (ZSTD_getErrorCode(size) == ZSTD_error_dstSize_tooSmall)
+				ret = -ENOSPC;
+			else
+				ret = -EINVAL;
+			break;
 		}
 
-		image_len = out_buf.pos;
-
+		image_len = size;
 		break;
 	}
 #endif /* CONFIG_ZSTD */
@@ -5,12 +5,14 @@
  */
 
 #include <common.h>
+#include <decomp_stream.h>
 #include <errno.h>
 #include <fpga.h>
 #include <gzip.h>
 #include <image.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <spl.h>
 #include <sysinfo.h>
 #include <asm/cache.h>
@@ -27,6 +29,9 @@ DECLARE_GLOBAL_DATA_PTR;
 #define CONFIG_SYS_BOOTM_LEN	(64 << 20)
 #endif
 
+/* Size of the chunks read when decompressing an image as it is loaded */
+#define SPL_FIT_STREAM_BUF_SZ	(64 * 1024)
+
 struct spl_fit_info {
 	const void *fit;	/* Pointer to a valid FIT blob */
 	size_t ext_data_offset;	/* Offset to FIT external data (end of FIT) */
@@ -213,6 +218,64 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return (data_size + info->bl_len - 1) / info->bl_len;
 }
 
+/**
+ * spl_load_fit_stream(): decompress external image data while reading it
+ * @info:	points to information about the device to load data from
+ * @sector:	the start sector of the FIT image on the device
+ * @offset:	offset of the image data from @sector, in bytes
+ * @length:	size of the compressed image data
+ * @comp:	compression type of the image (IH_COMP_...)
+ * @load_addr:	where to put the uncompressed image
+ * @sizep:	returns the size of the uncompressed image
+ *
+ * The compressed data is read in chunks of SPL_FIT_STREAM_BUF_SZ, each of
+ * which is decompressed before the next is read, so the compressed image is
+ * never held in memory as a whole.
+ *
+ * Return:	0 on success or a negative error number.
+ */
+static int spl_load_fit_stream(struct spl_load_info *info, ulong sector,
+			       int offset, size_t length, int comp,
+			       ulong load_addr, size_t *sizep)
+{
+	int unit = info->filename ? 1 : info->bl_len;
+	int overhead = get_aligned_image_overhead(info, offset);
+	int nr_sectors = get_aligned_image_size(info, length, offset);
+	int count = max(SPL_FIT_STREAM_BUF_SZ / unit, 1);
+	struct decomp_stream ds;
+	int i, nr, ret, err;
+	size_t len;
+	void *buf;
+
+	buf = malloc_cache_aligned(count * unit);
+	if (!buf)
+		return -ENOMEM;
+	ret = decomp_stream_start(&ds, comp, (void *)load_addr,
+				  CONFIG_SYS_BOOTM_LEN);
+	if (ret) {
+		free(buf);
+		return ret;
+	}
+
+	sector += get_aligned_image_offset(info, offset);
+	for (i = 0; !ret && i < nr_sectors; i += nr) {
+		nr = min(nr_sectors - i, count);
+		if (info->read(info, sector + i, nr, buf) != nr) {
+			ret = -EIO;
+			break;
+		}
+		len = min((size_t)nr * unit - overhead, length);
+		ret = decomp_stream_write(&ds, buf + overhead, len);
+		length -= len;
+		overhead = 0;
+	}
+	err = decomp_stream_finish(&ds);
+	free(buf);
+	*sizep = ds.out;
+
+	return ret ? ret : err;
+}
+
 /**
  * spl_load_fit_image(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -244,6 +307,7 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 	const void *data;
 	const void *fit = ctx->fit;
 	bool external_data = false;
+	int ret;
 
 	if (IS_ENABLED(CONFIG_SPL_FPGA) ||
 	    (IS_ENABLED(CONFIG_SPL_OS_BOOT) && IS_ENABLED(CONFIG_SPL_GZIP))) {
@@ -253,7 +317,7 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 			debug("%s ", genimg_get_type_name(type));
 	}
 
-	if (IS_ENABLED(CONFIG_SPL_GZIP)) {
+	if (IS_ENABLED(CONFIG_SPL_GZIP) || CONFIG_IS_ENABLED(DECOMP_STREAM)) {
 		fit_image_get_comp(fit, node, &image_comp);
 		debug("%s ", genimg_get_comp_name(image_comp));
 	}
@@ -273,6 +337,27 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		if (fit_image_get_data_size(fit, node, &len))
 			return -ENOENT;
 
+		/*
+		 * Without a hash check or post-processing step that needs the
+		 * whole compressed image, decompress it as it is read
+		 */
+		if (CONFIG_IS_ENABLED(DECOMP_STREAM) &&
+		    !CONFIG_IS_ENABLED(FIT_SIGNATURE) &&
+		    !CONFIG_IS_ENABLED(FIT_IMAGE_POST_PROCESS) &&
+		    image_comp != IH_COMP_NONE &&
+		    decomp_stream_supported(image_comp)) {
+			debug("External data: dst=%lx, offset=%x, streamed\n",
+			      load_addr, offset);
+			ret = spl_load_fit_stream(info, sector, offset, len,
+						  image_comp, load_addr,
+						  &length);
+			if (ret) {
+				puts("Uncompressing error\n");
+				return ret;
+			}
+			goto done;
+		}
+
 		load_ptr = (load_addr + align_len) & ~align_len;
 		length = len;
 
@@ -321,6 +406,7 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		memcpy((void *)load_addr, src, length);
 	}
 
+done:
 	if (image_info) {
 		ulong entry_point;
 
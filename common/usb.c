@@ -659,6 +659,7 @@ int usb_set_interface(struct usb_device *dev, int interface, int alternate)
 				USB_CNTL_TIMEOUT * 5);
 	if (ret < 0)
 		return ret;
+	if_face->act_altsetting = alternate;
 
 	return 0;
 }
@@ -46,6 +46,7 @@
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <linux/delay.h>
+#include <linux/usb/uas.h>
 
 #include <part.h>
 #include <usb.h>
@@ -101,6 +102,10 @@ struct us_data {
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
 	unsigned short	max_xfer_blk;		/* maximum transfer blocks */
+	unsigned char	ep_cmd;			/* UAS command pipe */
+	unsigned char	ep_status;		/* UAS status pipe */
+	unsigned char	uas_depth;		/* UAS commands in flight */
+	bool		uas_streams;		/* UAS pipes use streams */
 };
 
 #if !CONFIG_IS_ENABLED(BLK)
@@ -111,6 +116,9 @@ static struct us_data usb_stor[USB_MAX_STOR_DEV];
 #define USB_STOR_TRANSPORT_FAILED -1
 #define USB_STOR_TRANSPORT_ERROR  -2
 
+/* Most UAS commands kept in flight, also the number of streams asked for */
+#define USB_STOR_UAS_MAX_CMDS	8
+
 int usb_stor_get_info(struct usb_device *dev, struct us_data *us,
 		      struct blk_desc *dev_desc);
 int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
@@ -939,6 +947,310 @@ do_retry:
 	return USB_STOR_TRANSPORT_FAILED;
 }
 
+#if CONFIG_IS_ENABLED(USB_STORAGE_UAS)
+/*
+ * USB Attached SCSI: commands go out as command IUs on their own pipe and
+ * each carries a tag, so the device may be given several at once. Command
+ * IUs have no status of their own; the SCSI status comes back in a sense IU
+ * on the status pipe.
+ *
+ * On SuperSpeed with bulk streams the data and status of a command move on
+ * the stream numbered by its tag. Otherwise (USB 2.0 style) the device picks
+ * the command to serve and says so with a READ READY or WRITE READY IU on the
+ * status pipe, before the data phase and the sense IU of that command.
+ */
+static int usb_stor_UAS_reset(struct us_data *us)
+{
+	struct usb_device *dev = us->pusb_dev;
+
+	usb_clear_halt(dev, usb_sndbulkpipe(dev, us->ep_cmd));
+	usb_clear_halt(dev, usb_rcvbulkpipe(dev, us->ep_status));
+	usb_clear_halt(dev, usb_rcvbulkpipe(dev, us->ep_in));
+	usb_clear_halt(dev, usb_sndbulkpipe(dev, us->ep_out));
+
+	return 0;
+}
+
+/* Start a transfer on one of the UAS pipes, without waiting for it */
+static int usb_stor_UAS_submit(struct us_data *us, struct usb_bulk_req *req,
+			       unsigned long pipe, unsigned int stream_id,
+			       void *buf, int len)
+{
+	req->pipe = pipe;
+	req->stream_id = stream_id;
+	req->buffer = buf;
+	req->length = len;
+
+	return usb_bulk_submit(us->pusb_dev, req);
+}
+
+/* Wait for all of @reqs, so that none is left queued on the host */
+static int usb_stor_UAS_reap(struct us_data *us, struct usb_bulk_req *reqs,
+			     int count)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < count; i++) {
+		if (usb_bulk_reap(us->pusb_dev, &reqs[i]) && !ret)
+			ret = -EIO;
+	}
+
+	return ret;
+}
+
+/* Record the SCSI status and any sense data delivered by a sense IU */
+static void usb_stor_UAS_sense(struct scsi_cmd *srb, struct sense_iu *siu,
+			       int actlen)
+{
+	int len;
+
+	srb->status = siu->status;
+	memset(srb->sense_buf, '\0', sizeof(srb->sense_buf));
+	len = min_t(int, be16_to_cpu(siu->len),
+		    actlen - (int)offsetof(struct sense_iu, sense));
+	len = min_t(int, len, sizeof(srb->sense_buf));
+	if (len > 0)
+		memcpy(srb->sense_buf, siu->sense, len);
+}
+
+/*
+ * Run @count commands, with tags 1 to @count. All command IUs are queued
+ * before any data moves, so that the device can work on them together; with
+ * streams the data and status transfers of every command are queued as well.
+ * The SCSI status of each command ends up in its ->status, which stays
+ * S_ILLEGAL for commands which did not complete.
+ */
+static int usb_stor_UAS_run(struct us_data *us, struct scsi_cmd *srbs,
+			    int count)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct command_iu, iu, USB_STOR_UAS_MAX_CMDS);
+	struct usb_bulk_req reqs[3 * USB_STOR_UAS_MAX_CMDS];
+	struct usb_bulk_req *status_req[USB_STOR_UAS_MAX_CMDS];
+	struct usb_device *dev = us->pusb_dev;
+	unsigned int status_pipe, pipe;
+	int i, tag, pending, actlen;
+	int nreqs = 0, ret = 0;
+	struct sense_iu *siu;
+	struct scsi_cmd *srb;
+	size_t stride;
+	u8 *buf;
+
+	/* sense IUs are received into separate cache lines */
+	stride = ALIGN(sizeof(*siu), ARCH_DMA_MINALIGN);
+	buf = malloc_cache_aligned(stride * (us->uas_streams ? count : 1));
+	if (!buf)
+		return -ENOMEM;
+
+	status_pipe = usb_rcvbulkpipe(dev, us->ep_status);
+	for (i = 0; i < count; i++) {
+		srb = &srbs[i];
+		srb->status = S_ILLEGAL;
+		memset(&iu[i], '\0', sizeof(iu[i]));
+		iu[i].iu_id = IU_ID_COMMAND;
+		iu[i].tag = cpu_to_be16(i + 1);
+		iu[i].prio_attr = UAS_SIMPLE_TAG;
+		iu[i].lun[1] = srb->lun;
+		memcpy(iu[i].cdb, srb->cmd,
+		       min_t(int, srb->cmdlen, sizeof(iu[i].cdb)));
+		ret = usb_stor_UAS_submit(us, &reqs[nreqs],
+					  usb_sndbulkpipe(dev, us->ep_cmd), 0,
+					  &iu[i], sizeof(iu[i]));
+		if (ret)
+			goto reap;
+		nreqs++;
+	}
+
+	for (i = 0; us->uas_streams && i < count; i++) {
+		srb = &srbs[i];
+		if (srb->datalen) {
+			pipe = US_DIRECTION(srb->cmd[0]) ?
+			       usb_rcvbulkpipe(dev, us->ep_in) :
+			       usb_sndbulkpipe(dev, us->ep_out);
+			ret = usb_stor_UAS_submit(us, &reqs[nreqs], pipe, i + 1,
+						  srb->pdata, srb->datalen);
+			if (ret)
+				goto reap;
+			nreqs++;
+		}
+		status_req[i] = &reqs[nreqs];
+		ret = usb_stor_UAS_submit(us, &reqs[nreqs], status_pipe, i + 1,
+					  buf + i * stride, sizeof(*siu));
+		if (ret)
+			goto reap;
+		nreqs++;
+	}
+
+reap:
+	if (usb_stor_UAS_reap(us, reqs, nreqs) || ret) {
+		debug("UAS: transfer failed, %d of %d queued\n", nreqs,
+		      us->uas_streams ? 3 * count : count);
+		goto err;
+	}
+
+	if (us->uas_streams) {
+		for (i = 0; i < count; i++) {
+			siu = (struct sense_iu *)(buf + i * stride);
+			if (siu->iu_id != IU_ID_STATUS ||
+			    be16_to_cpu(siu->tag) != i + 1)
+				goto err;
+			usb_stor_UAS_sense(&srbs[i], siu,
+					   status_req[i]->actual_length);
+		}
+		free(buf);
+
+		return 0;
+	}
+
+	siu = (struct sense_iu *)buf;
+	for (pending = count; pending;) {
+		if (usb_bulk_msg(dev, status_pipe, siu, sizeof(*siu), &actlen,
+				 USB_CNTL_TIMEOUT * 5) ||
+		    actlen < sizeof(struct iu))
+			goto err;
+		tag = be16_to_cpu(siu->tag);
+		if (tag < 1 || tag > count)
+			goto err;
+		srb = &srbs[tag - 1];
+
+		switch (siu->iu_id) {
+		case IU_ID_READ_READY:
+		case IU_ID_WRITE_READY:
+			pipe = siu->iu_id == IU_ID_READ_READY ?
+			       usb_rcvbulkpipe(dev, us->ep_in) :
+			       usb_sndbulkpipe(dev, us->ep_out);
+			if (usb_bulk_msg(dev, pipe, srb->pdata, srb->datalen,
+					 &actlen, USB_CNTL_TIMEOUT * 5))
+				goto err;
+			break;
+		case IU_ID_STATUS:
+			usb_stor_UAS_sense(srb, siu, actlen);
+			pending--;
+			break;
+		default:
+			/* a response IU: the device refused the command */
+			debug("UAS: unexpected IU %x for tag %d\n",
+			      siu->iu_id, tag);
+			goto err;
+		}
+	}
+	free(buf);
+
+	return 0;
+err:
+	free(buf);
+	usb_stor_UAS_reset(us);
+	return -EIO;
+}
+
+static int usb_stor_UAS_transport(struct scsi_cmd *srb, struct us_data *us)
+{
+	if (usb_stor_UAS_run(us, srb, 1))
+		return USB_STOR_TRANSPORT_ERROR;
+	if (srb->status != S_GOOD) {
+		debug("UAS: cmd %02x status %02x sense %02x\n", srb->cmd[0],
+		      srb->status, srb->sense_buf[2]);
+		return USB_STOR_TRANSPORT_FAILED;
+	}
+
+	return USB_STOR_TRANSPORT_GOOD;
+}
+
+/*
+ * Look for an alternate setting of the interface which speaks UAS and
+ * switch to it. The four pipes are told apart by the pipe usage descriptor
+ * after each endpoint, which usb_parse_config() does not keep, so walk the
+ * configuration descriptor again.
+ */
+static int usb_stor_UAS_probe(struct usb_device *dev, struct us_data *us)
+{
+	struct usb_interface_descriptor *idesc;
+	struct usb_endpoint_descriptor *epdesc = NULL;
+	struct usb_pipe_usage_descriptor *pdesc;
+	struct usb_descriptor_header *head;
+	unsigned char ep[DATA_OUT_PIPE_ID + 1] = { 0 };
+	unsigned long pipes[3];
+	unsigned char *buf;
+	int len, pos, ret, alt = -1;
+	int ifnum = dev->config.if_desc[us->ifnum].desc.bInterfaceNumber;
+
+	len = usb_get_configuration_len(dev, dev->configno);
+	if (len < 0)
+		return len;
+	buf = malloc_cache_aligned(len);
+	if (!buf)
+		return -ENOMEM;
+	ret = usb_get_configuration_no(dev, dev->configno, buf, len);
+	if (ret < 0)
+		goto out;
+	len = min(len, ret);
+
+	for (pos = 0; pos + 2 <= len; pos += head->bLength) {
+		head = (struct usb_descriptor_header *)&buf[pos];
+		if (head->bLength < 2 || pos + head->bLength > len)
+			break;
+		if (head->bDescriptorType == USB_DT_INTERFACE) {
+			/* only the endpoints of the first UAS setting count */
+			if (alt >= 0)
+				break;
+			idesc = (struct usb_interface_descriptor *)head;
+			if (idesc->bInterfaceNumber == ifnum &&
+			    idesc->bInterfaceClass == USB_CLASS_MASS_STORAGE &&
+			    idesc->bInterfaceProtocol == US_PR_UAS)
+				alt = idesc->bAlternateSetting;
+		} else if (head->bDescriptorType == USB_DT_ENDPOINT) {
+			epdesc = (struct usb_endpoint_descriptor *)head;
+		} else if (head->bDescriptorType == USB_DT_PIPE_USAGE &&
+			   alt >= 0 && epdesc &&
+			   head->bLength >= sizeof(*pdesc)) {
+			pdesc = (struct usb_pipe_usage_descriptor *)head;
+			if (pdesc->bPipeID >= CMD_PIPE_ID &&
+			    pdesc->bPipeID <= DATA_OUT_PIPE_ID)
+				ep[pdesc->bPipeID] = epdesc->bEndpointAddress;
+		}
+	}
+
+	ret = -ENOENT;
+	if (alt < 0 || !ep[CMD_PIPE_ID] || !ep[STATUS_PIPE_ID] ||
+	    !ep[DATA_IN_PIPE_ID] || !ep[DATA_OUT_PIPE_ID] ||
+	    (ep[CMD_PIPE_ID] & USB_DIR_IN) || !(ep[STATUS_PIPE_ID] & USB_DIR_IN) ||
+	    !(ep[DATA_IN_PIPE_ID] & USB_DIR_IN) ||
+	    (ep[DATA_OUT_PIPE_ID] & USB_DIR_IN))
+		goto out;
+
+	ret = usb_set_interface(dev, ifnum, alt);
+	if (ret)
+		goto out;
+
+	us->protocol = US_PR_UAS;
+	us->transport = usb_stor_UAS_transport;
+	us->transport_reset = usb_stor_UAS_reset;
+	us->ep_cmd = ep[CMD_PIPE_ID] & USB_ENDPOINT_NUMBER_MASK;
+	us->ep_status = ep[STATUS_PIPE_ID] & USB_ENDPOINT_NUMBER_MASK;
+	us->ep_in = ep[DATA_IN_PIPE_ID] & USB_ENDPOINT_NUMBER_MASK;
+	us->ep_out = ep[DATA_OUT_PIPE_ID] & USB_ENDPOINT_NUMBER_MASK;
+	us->ep_int = 0;
+	us->uas_depth = USB_STOR_UAS_MAX_CMDS;
+	us->uas_streams = false;
+
+	/* Stream IDs double as tags, so they limit the commands in flight */
+	pipes[0] = usb_rcvbulkpipe(dev, us->ep_status);
+	pipes[1] = usb_rcvbulkpipe(dev, us->ep_in);
+	pipes[2] = usb_sndbulkpipe(dev, us->ep_out);
+	ret = usb_alloc_streams(dev, pipes, ARRAY_SIZE(pipes),
+				USB_STOR_UAS_MAX_CMDS);
+	if (ret > 0) {
+		us->uas_streams = true;
+		us->uas_depth = min(ret, USB_STOR_UAS_MAX_CMDS);
+	}
+	debug("UAS: alt %d, cmd %d status %d in %d out %d, streams %d\n", alt,
+	      us->ep_cmd, us->ep_status, us->ep_in, us->ep_out, ret);
+	ret = 0;
+out:
+	free(buf);
+	return ret;
+}
+#endif
+
 static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 				      struct us_data *us)
 {
@@ -961,6 +1273,13 @@ static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 	 */
 	unsigned short blk = 240;
 
+	/*
+	 * UAS devices are recent enough to cope with the larger transfers
+	 * which other systems use for USB3
+	 */
+	if (us->protocol == US_PR_UAS)
+		blk = 2048;
+
 #if CONFIG_IS_ENABLED(DM_USB)
 	size_t size;
 	int ret;
@@ -1001,6 +1320,10 @@ static int usb_request_sense(struct scsi_cmd *srb, struct us_data *ss)
 {
 	char *ptr;
 
+	/* UAS returns the sense data with the status of each command */
+	if (ss->protocol == US_PR_UAS)
+		return 0;
+
 	ptr = (char *)srb->pdata;
 	memset(&srb->cmd[0], 0, 12);
 	srb->cmd[0] = SCSI_REQ_SENSE;
@@ -1066,11 +1389,11 @@ static int usb_read_capacity(struct scsi_cmd *srb, struct us_data *ss)
 	return -1;
 }
 
-static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
-		       unsigned long start, unsigned short blocks)
+static void usb_setup_rw_10(struct scsi_cmd *srb, unsigned char opcode,
+			    unsigned long start, unsigned short blocks)
 {
 	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_READ10;
+	srb->cmd[0] = opcode;
 	srb->cmd[1] = srb->lun << 5;
 	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
 	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
@@ -1079,6 +1402,12 @@ static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
 	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
 	srb->cmd[8] = (unsigned char) blocks & 0xff;
 	srb->cmdlen = 12;
+}
+
+static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
+		       unsigned long start, unsigned short blocks)
+{
+	usb_setup_rw_10(srb, SCSI_READ10, start, blocks);
 	debug("read10: start %lx blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
@@ -1086,20 +1415,48 @@ static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
 static int usb_write_10(struct scsi_cmd *srb, struct us_data *ss,
 			unsigned long start, unsigned short blocks)
 {
-	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_WRITE10;
-	srb->cmd[1] = srb->lun << 5;
-	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
-	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
-	srb->cmd[4] = ((unsigned char) (start >> 8)) & 0xff;
-	srb->cmd[5] = ((unsigned char) (start)) & 0xff;
-	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
-	srb->cmd[8] = (unsigned char) blocks & 0xff;
-	srb->cmdlen = 12;
+	usb_setup_rw_10(srb, SCSI_WRITE10, start, blocks);
 	debug("write10: start %lx blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
 
+#if CONFIG_IS_ENABLED(USB_STORAGE_UAS)
+/*
+ * Split @blks blocks into READ(10) or WRITE(10) commands of max_xfer_blk
+ * blocks each and queue up to uas_depth of them to the device at once.
+ * Returns the number of blocks moved by the commands which completed in
+ * order, so the caller can fall back to single commands after an error.
+ */
+static lbaint_t usb_stor_UAS_rw(struct us_data *ss, struct scsi_cmd *srb,
+				unsigned char opcode, unsigned long start,
+				lbaint_t blks, uintptr_t buf_addr, ulong blksz)
+{
+	struct scsi_cmd srbs[USB_STOR_UAS_MAX_CMDS];
+	unsigned short blocks;
+	lbaint_t done = 0;
+	int i, count;
+
+	for (count = 0; count < ss->uas_depth && blks; count++) {
+		blocks = min_t(lbaint_t, blks, ss->max_xfer_blk);
+		srbs[count].lun = srb->lun;
+		srbs[count].pdata = (unsigned char *)buf_addr;
+		srbs[count].datalen = blksz * blocks;
+		usb_setup_rw_10(&srbs[count], opcode, start, blocks);
+		start += blocks;
+		blks -= blocks;
+		buf_addr += srbs[count].datalen;
+	}
+	debug("uas %s: %d commands\n", opcode == SCSI_READ10 ? "read" : "write",
+	      count);
+	if (usb_stor_UAS_run(ss, srbs, count))
+		return 0;
+	for (i = 0; i < count && srbs[i].status == S_GOOD; i++)
+		done += srbs[i].datalen / blksz;
+
+	return done;
+}
+#endif
+
 
 #ifdef CONFIG_USB_BIN_FIXUP
 /*
@@ -1171,6 +1528,21 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 	      block_dev->devnum, start, blks, buf_addr);
 
 	do {
+#if CONFIG_IS_ENABLED(USB_STORAGE_UAS)
+		if (ss->protocol == US_PR_UAS && blks > ss->max_xfer_blk) {
+			lbaint_t done;
+
+			usb_show_progress();
+			done = usb_stor_UAS_rw(ss, srb, SCSI_READ10, start, blks,
+					       buf_addr, block_dev->blksz);
+			if (done) {
+				start += done;
+				blks -= done;
+				buf_addr += done * block_dev->blksz;
+				continue;
+			}
+		}
+#endif
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1256,6 +1628,21 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 	      block_dev->devnum, start, blks, buf_addr);
 
 	do {
+#if CONFIG_IS_ENABLED(USB_STORAGE_UAS)
+		if (ss->protocol == US_PR_UAS && blks > ss->max_xfer_blk) {
+			lbaint_t done;
+
+			usb_show_progress();
+			done = usb_stor_UAS_rw(ss, srb, SCSI_WRITE10, start, blks,
+					       buf_addr, block_dev->blksz);
+			if (done) {
+				start += done;
+				blks -= done;
+				buf_addr += done * block_dev->blksz;
+				continue;
+			}
+		}
+#endif
 		/* If write fails retry for max retry count else
 		 * return with number of blocks written successfully.
 		 */
@@ -1348,6 +1735,12 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		ss->transport = usb_stor_BBB_transport;
 		ss->transport_reset = usb_stor_BBB_reset;
 		break;
+#if CONFIG_IS_ENABLED(USB_STORAGE_UAS)
+	case US_PR_UAS:
+		/* set up by usb_stor_UAS_probe() below */
+		debug("USB Attached SCSI\n");
+		break;
+#endif
 	default:
 		printf("USB Storage Transport unknown / not yet implemented\n");
 		return 0;
@@ -1411,6 +1804,17 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		dev->irq_handle = usb_stor_irq;
 	}
 
+#if CONFIG_IS_ENABLED(USB_STORAGE_UAS)
+	/*
+	 * A UAS device may offer Bulk-Only as its first setting and UAS as an
+	 * alternate one. Prefer UAS, keeping Bulk-Only if that fails.
+	 */
+	if (usb_stor_UAS_probe(dev, ss) && ss->protocol == US_PR_UAS) {
+		debug("UAS interface unusable\n");
+		return 0;
+	}
+#endif
+
 	/* Set the maximum transfer size per host controller setting */
 	usb_stor_set_max_xfer_blk(dev, ss);
 
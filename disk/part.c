@@ -14,6 +14,7 @@
 #include <malloc.h>
 #include <part.h>
 #include <ubifs_uboot.h>
+#include <linux/ctype.h>
 
 #undef	PART_DEBUG
 
@@ -54,6 +55,247 @@ static struct part_driver *part_driver_lookup_type(struct blk_desc *dev_desc)
 	return NULL;
 }
 
+/* The string of a partition that a lookup is keyed on */
+enum part_key {
+	PART_KEY_NAME,
+	PART_KEY_UUID,
+	PART_KEY_TYPE_GUID,
+
+	PART_KEY_COUNT,
+};
+
+static const char *part_key_str(const struct disk_partition *info,
+				enum part_key key)
+{
+	switch (key) {
+	case PART_KEY_NAME:
+		return (const char *)info->name;
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	case PART_KEY_UUID:
+		return info->uuid;
+#endif
+#ifdef CONFIG_PARTITION_TYPE_GUID
+	case PART_KEY_TYPE_GUID:
+		return info->type_guid;
+#endif
+	default:
+		return "";
+	}
+}
+
+/* GUIDs may be written in either case, names must match exactly */
+static bool part_key_match(enum part_key key, const char *a, const char *b)
+{
+	if (key == PART_KEY_NAME)
+		return !strcmp(a, b);
+
+	return !strcasecmp(a, b);
+}
+
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+/**
+ * struct part_cache - Partition table of a block device, as parsed
+ *
+ * @list:	Entry in part_cache_list
+ * @desc:	Block device the table was read from
+ * @hwpart:	Hardware partition of @desc the table was read from
+ * @count:	Number of partitions, numbered 1 to @count without a gap
+ * @parts:	Information about each partition, @parts[0] is partition 1
+ * @mask:	Size of each index minus one, the size is a power of two
+ * @index:	Open-addressed hash table for each key, holding the position
+ *		in @parts plus one, or 0 for a free slot
+ */
+struct part_cache {
+	struct list_head list;
+	struct blk_desc *desc;
+	int hwpart;
+	int count;
+	struct disk_partition *parts;
+	uint mask;
+	u16 *index[PART_KEY_COUNT];
+};
+
+static LIST_HEAD(part_cache_list);
+
+static uint part_key_hash(enum part_key key, const char *str)
+{
+	uint hash = 5381;
+
+	for (; *str; str++)
+		hash = hash * 33 +
+		       (key == PART_KEY_NAME ? *str : tolower(*str));
+
+	return hash;
+}
+
+static void part_cache_free(struct part_cache *pc)
+{
+	list_del(&pc->list);
+	free(pc->index[0]);
+	free(pc->parts);
+	free(pc);
+}
+
+static struct part_cache *part_cache_find(struct blk_desc *dev_desc)
+{
+	struct part_cache *pc;
+
+	list_for_each_entry(pc, &part_cache_list, list) {
+		if (pc->desc == dev_desc && pc->hwpart == dev_desc->hwpart)
+			return pc;
+	}
+
+	return NULL;
+}
+
+void part_cache_invalidate(struct blk_desc *dev_desc)
+{
+	struct part_cache *pc, *next;
+
+	list_for_each_entry_safe(pc, next, &part_cache_list, list) {
+		if (!dev_desc || pc->desc == dev_desc)
+			part_cache_free(pc);
+	}
+}
+
+void part_cache_invalidate_blocks(struct blk_desc *dev_desc, lbaint_t start,
+				  lbaint_t blkcnt)
+{
+	struct part_cache *pc = part_cache_find(dev_desc);
+	struct disk_partition *info;
+	int i;
+
+	if (!pc)
+		return;
+
+	/*
+	 * Data written inside a partition cannot change the table, unless
+	 * the partition starts at block 0 where the table itself lives
+	 */
+	for (i = 0; i < pc->count; i++) {
+		info = &pc->parts[i];
+		if (info->start && start >= info->start &&
+		    blkcnt <= info->size &&
+		    start - info->start <= info->size - blkcnt)
+			return;
+	}
+
+	part_cache_free(pc);
+}
+
+static void part_cache_index(struct part_cache *pc, int i)
+{
+	enum part_key key;
+	const char *str;
+	uint pos;
+
+	for (key = 0; key < PART_KEY_COUNT; key++) {
+		str = part_key_str(&pc->parts[i], key);
+		if (key != PART_KEY_NAME && !*str)
+			continue;
+		pos = part_key_hash(key, str) & pc->mask;
+		while (pc->index[key][pos])
+			pos = (pos + 1) & pc->mask;
+		pc->index[key][pos] = i + 1;
+	}
+}
+
+/*
+ * Read the whole table through the driver, the same way the uncached
+ * lookups walk it: from partition 1 up to the first one that is missing.
+ */
+static struct part_cache *part_cache_get(struct blk_desc *dev_desc,
+					 struct part_driver *drv)
+{
+	struct disk_partition *parts;
+	struct part_cache *pc;
+	int count, size = 0;
+	enum part_key key;
+
+	pc = part_cache_find(dev_desc);
+	if (pc)
+		return pc;
+
+	pc = calloc(1, sizeof(*pc));
+	if (!pc)
+		return NULL;
+
+	for (count = 0; count + 1 < drv->max_entries; count++) {
+		if (count == size) {
+			size = size ? size * 2 : 16;
+			parts = realloc(pc->parts, size * sizeof(*parts));
+			if (!parts)
+				goto err;
+			pc->parts = parts;
+		}
+		memset(&pc->parts[count], '\0', sizeof(*parts));
+		if (drv->get_info(dev_desc, count + 1, &pc->parts[count]))
+			break;
+	}
+
+	/* keep the indexes at most half full */
+	for (size = 4; size < 2 * count; size <<= 1)
+		;
+	pc->index[0] = calloc(PART_KEY_COUNT * size, sizeof(u16));
+	if (!pc->index[0])
+		goto err;
+	for (key = 1; key < PART_KEY_COUNT; key++)
+		pc->index[key] = pc->index[0] + key * size;
+	pc->mask = size - 1;
+	pc->count = count;
+	for (count = 0; count < pc->count; count++)
+		part_cache_index(pc, count);
+
+	pc->desc = dev_desc;
+	pc->hwpart = dev_desc->hwpart;
+	list_add(&pc->list, &part_cache_list);
+
+	return pc;
+
+err:
+	free(pc->parts);
+	free(pc);
+
+	return NULL;
+}
+
+static int part_cache_lookup(struct part_cache *pc, enum part_key key,
+			     const char *str, struct disk_partition *info)
+{
+	uint pos;
+	int i;
+
+	pos = part_key_hash(key, str) & pc->mask;
+	for (; pc->index[key][pos]; pos = (pos + 1) & pc->mask) {
+		i = pc->index[key][pos] - 1;
+		if (part_key_match(key, str, part_key_str(&pc->parts[i], key))) {
+			*info = pc->parts[i];
+			return i + 1;
+		}
+	}
+
+	return -ENOENT;
+}
+#else
+struct part_cache {
+	int count;
+	struct disk_partition *parts;
+};
+
+static inline struct part_cache *part_cache_get(struct blk_desc *dev_desc,
+						struct part_driver *drv)
+{
+	return NULL;
+}
+
+static inline int part_cache_lookup(struct part_cache *pc, enum part_key key,
+				    const char *str,
+				    struct disk_partition *info)
+{
+	return -ENOENT;
+}
+#endif
+
 #ifdef CONFIG_HAVE_BLOCK_DEVICE
 static struct blk_desc *get_dev_hwpart(const char *ifname, int dev, int hwpart)
 {
@@ -240,6 +482,7 @@ void part_init(struct blk_desc *dev_desc)
 	struct part_driver *entry;
 
 	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	part_cache_invalidate(dev_desc);
 
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
@@ -329,6 +572,7 @@ int part_get_info(struct blk_desc *dev_desc, int part,
 {
 #ifdef CONFIG_HAVE_BLOCK_DEVICE
 	struct part_driver *drv;
+	struct part_cache *pc;
 
 #if CONFIG_IS_ENABLED(PARTITION_UUIDS)
 	/* The common case is no UUID support */
@@ -349,6 +593,11 @@ int part_get_info(struct blk_desc *dev_desc, int part,
 		       drv->name);
 		return -ENOSYS;
 	}
+	pc = part_cache_get(dev_desc, drv);
+	if (pc && part > 0 && part <= pc->count) {
+		*info = pc->parts[part - 1];
+		return 0;
+	}
 	if (drv->get_info(dev_desc, part, info) == 0) {
 		PRINTF("## Valid %s partition found ##\n", drv->name);
 		return 0;
@@ -658,23 +907,31 @@ cleanup:
 	return ret;
 }
 
-int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
-			       struct disk_partition *info, int part_type)
+static int part_get_info_by_key(struct blk_desc *dev_desc, enum part_key key,
+				const char *str, struct disk_partition *info)
 {
 	struct part_driver *part_drv;
+	struct part_cache *pc;
 	int ret;
 	int i;
 
 	part_drv = part_driver_lookup_type(dev_desc);
 	if (!part_drv)
 		return -1;
+	if (key != PART_KEY_NAME && !*str)
+		return -ENOENT;
+
+	pc = part_cache_get(dev_desc, part_drv);
+	if (pc)
+		return part_cache_lookup(pc, key, str, info);
+
 	for (i = 1; i < part_drv->max_entries; i++) {
 		ret = part_drv->get_info(dev_desc, i, info);
 		if (ret != 0) {
 			/* no more entries in table */
 			break;
 		}
-		if (strcmp(name, (const char *)info->name) == 0) {
+		if (part_key_match(key, str, part_key_str(info, key))) {
 			/* matched */
 			return i;
 		}
@@ -683,12 +940,30 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 	return -ENOENT;
 }
 
+int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
+			       struct disk_partition *info, int part_type)
+{
+	return part_get_info_by_key(dev_desc, PART_KEY_NAME, name, info);
+}
+
 int part_get_info_by_name(struct blk_desc *dev_desc, const char *name,
 			  struct disk_partition *info)
 {
 	return part_get_info_by_name_type(dev_desc, name, info, PART_TYPE_ALL);
 }
 
+int part_get_info_by_uuid(struct blk_desc *dev_desc, const char *uuid,
+			  struct disk_partition *info)
+{
+	return part_get_info_by_key(dev_desc, PART_KEY_UUID, uuid, info);
+}
+
+int part_get_info_by_type_guid(struct blk_desc *dev_desc, const char *guid,
+			       struct disk_partition *info)
+{
+	return part_get_info_by_key(dev_desc, PART_KEY_TYPE_GUID, guid, info);
+}
+
 /**
  * Get partition info from device number and partition name.
  *
@@ -56,6 +56,7 @@ struct ahci_uc_priv *probe_ent = NULL;
 #define WAIT_MS_LINKUP	200
 
 #define AHCI_CAP_S64A BIT(31)
+#define AHCI_CAP_SNCQ BIT(30)
 
 __weak void __iomem *ahci_port_base(void __iomem *base, u32 port)
 {
@@ -495,14 +496,21 @@ static int ahci_init_one(struct ahci_uc_priv *uc_priv, pci_dev_t dev)
 
 #define MAX_DATA_BYTE_COUNT  (4*1024*1024)
 
-static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
+/* Command table used by command slot @tag */
+static ulong ahci_cmd_tbl(struct ahci_ioports *pp, int tag)
+{
+	return pp->cmd_tbl + tag * AHCI_CMD_TBL_SZ;
+}
+
+static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port, int tag,
 			unsigned char *buf, int buf_len)
 {
 	struct ahci_ioports *pp = &(uc_priv->port[port]);
-	struct ahci_sg *ahci_sg = pp->cmd_tbl_sg;
+	struct ahci_sg *ahci_sg;
 	u32 sg_count;
 	int i;
 
+	ahci_sg = (struct ahci_sg *)(ahci_cmd_tbl(pp, tag) + AHCI_CMD_TBL_HDR);
 	sg_count = ((buf_len - 1) / MAX_DATA_BYTE_COUNT) + 1;
 	if (sg_count > AHCI_MAX_SG) {
 		printf("Error:Too much sg!\n");
@@ -531,14 +539,16 @@ static int ahci_fill_sg(struct ahci_uc_priv *uc_priv, u8 port,
 }
 
 
-static void ahci_fill_cmd_slot(struct ahci_ioports *pp, u32 opts)
+static void ahci_fill_cmd_slot(struct ahci_ioports *pp, int tag, u32 opts)
 {
-	pp->cmd_slot->opts = cpu_to_le32(opts);
-	pp->cmd_slot->status = 0;
-	pp->cmd_slot->tbl_addr = cpu_to_le32((u32)pp->cmd_tbl & 0xffffffff);
+	struct ahci_cmd_hdr *cmd_slot = pp->cmd_slot + tag;
+	ulong cmd_tbl = ahci_cmd_tbl(pp, tag);
+
+	cmd_slot->opts = cpu_to_le32(opts);
+	cmd_slot->status = 0;
+	cmd_slot->tbl_addr = cpu_to_le32((u32)cmd_tbl & 0xffffffff);
 #ifdef CONFIG_PHYS_64BIT
-	pp->cmd_slot->tbl_addr_hi =
-	    cpu_to_le32((u32)(((pp->cmd_tbl) >> 16) >> 16));
+	cmd_slot->tbl_addr_hi = cpu_to_le32((u32)(((cmd_tbl) >> 16) >> 16));
 #endif
 }
 
@@ -588,7 +598,7 @@ static int ahci_port_start(struct ahci_uc_priv *uc_priv, u8 port)
 	pp->cmd_slot =
 		(struct ahci_cmd_hdr *)(uintptr_t)virt_to_phys((void *)mem);
 	debug("cmd_slot = %p\n", pp->cmd_slot);
-	mem += (AHCI_CMD_SLOT_SZ + 224);
+	mem += AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT;
 
 	/*
 	 * Second item: Received-FIS area
@@ -597,8 +607,8 @@ static int ahci_port_start(struct ahci_uc_priv *uc_priv, u8 port)
 	mem += AHCI_RX_FIS_SZ;
 
 	/*
-	 * Third item: data area for storing a single command
-	 * and its scatter-gather table
+	 * Third item: data area for storing the commands and their
+	 * scatter-gather tables, one per slot when NCQ is used
 	 */
 	pp->cmd_tbl = virt_to_phys((void *)mem);
 	debug("cmd_tbl_dma = %lx\n", pp->cmd_tbl);
@@ -657,9 +667,9 @@ static int ahci_device_data_io(struct ahci_uc_priv *uc_priv, u8 port, u8 *fis,
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, fis_len);
 
-	sg_count = ahci_fill_sg(uc_priv, port, buf, buf_len);
+	sg_count = ahci_fill_sg(uc_priv, port, 0, buf, buf_len);
 	opts = (fis_len >> 2) | (sg_count << 16) | (is_write << 6);
-	ahci_fill_cmd_slot(pp, opts);
+	ahci_fill_cmd_slot(pp, 0, opts);
 
 	ahci_dcache_flush_sata_cmd(pp);
 	ahci_dcache_flush_range((unsigned long)buf, (unsigned long)buf_len);
@@ -746,12 +756,164 @@ static int ata_scsiop_inquiry(struct ahci_uc_priv *uc_priv,
 	ata_id_strcpy((u16 *)&pccb->pdata[16], &idbuf[ATA_ID_PROD], 16);
 	ata_id_strcpy((u16 *)&pccb->pdata[32], &idbuf[ATA_ID_FW_REV], 4);
 
+#ifdef CONFIG_AHCI_NCQ
+	uc_priv->port[port].ncq_depth = 0;
+	if ((uc_priv->cap & AHCI_CAP_SNCQ) && ata_id_has_ncq(idbuf))
+		uc_priv->port[port].ncq_depth =
+			min(ata_id_queue_depth(idbuf),
+			    (int)((uc_priv->cap >> 8) & 0x1f) + 1);
+	debug("scsi_ahci: port %d NCQ depth %u\n", port,
+	      uc_priv->port[port].ncq_depth);
+#endif
+
 #ifdef DEBUG
 	ata_dump_id(idbuf);
 #endif
 	return 0;
 }
 
+#ifdef CONFIG_AHCI_NCQ
+/* Build a READ/WRITE FPDMA QUEUED command in slot @tag */
+static int ahci_ncq_prep(struct ahci_uc_priv *uc_priv, u8 port, int tag,
+			 u64 lba, u32 blocks, u8 *buf, u8 is_write)
+{
+	struct ahci_ioports *pp = &uc_priv->port[port];
+	u8 *fis = (u8 *)ahci_cmd_tbl(pp, tag);
+	int sg_count;
+	u32 opts;
+
+	memset(fis, 0, 20);
+	fis[0] = 0x27;		 /* Host to device FIS. */
+	fis[1] = 1 << 7;	 /* Command FIS. */
+	fis[2] = is_write ? ATA_CMD_FPDMA_WRITE : ATA_CMD_FPDMA_READ;
+	/* The sector count moves to the features registers */
+	fis[3] = (blocks >> 0) & 0xff;
+	fis[11] = (blocks >> 8) & 0xff;
+	fis[4] = (lba >> 0) & 0xff;
+	fis[5] = (lba >> 8) & 0xff;
+	fis[6] = (lba >> 16) & 0xff;
+	fis[7] = 1 << 6; /* device reg: set LBA mode */
+	fis[8] = (lba >> 24) & 0xff;
+	fis[9] = (lba >> 32) & 0xff;
+	fis[10] = (lba >> 40) & 0xff;
+	/* ...and the tag takes its place in the count register */
+	fis[12] = tag << 3;
+
+	sg_count = ahci_fill_sg(uc_priv, port, tag, buf, blocks * ATA_SECT_SIZE);
+	if (sg_count < 0)
+		return -EIO;
+
+	opts = 5 | (sg_count << 16) | (is_write ? AHCI_CMD_WRITE : 0);
+	ahci_fill_cmd_slot(pp, tag, opts);
+
+	return 0;
+}
+
+/*
+ * Bring a port back after a failed queued command. The device aborts every
+ * outstanding tag and refuses further commands until the NCQ error log is
+ * read, so stop the command engine to clear SActive and the issue register,
+ * restart it and then read the log.
+ */
+static void ahci_ncq_recover(struct ahci_uc_priv *uc_priv, u8 port)
+{
+	struct ahci_ioports *pp = &uc_priv->port[port];
+	void __iomem *port_mmio = pp->port_mmio;
+	ALLOC_CACHE_ALIGN_BUFFER(u8, log, ATA_SECT_SIZE);
+	u8 fis[20];
+	u32 tmp;
+
+	tmp = readl(port_mmio + PORT_CMD);
+	writel_with_flush(tmp & ~PORT_CMD_START, port_mmio + PORT_CMD);
+	waiting_for_cmd_completed(port_mmio + PORT_CMD, 500, PORT_CMD_LIST_ON);
+
+	writel(readl(port_mmio + PORT_SCR_ERR), port_mmio + PORT_SCR_ERR);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+	writel_with_flush(tmp | PORT_CMD_START, port_mmio + PORT_CMD);
+
+	memset(fis, 0, sizeof(fis));
+	fis[0] = 0x27;		 /* Host to device FIS. */
+	fis[1] = 1 << 7;	 /* Command FIS. */
+	fis[2] = ATA_CMD_READ_LOG_EXT;
+	fis[4] = ATA_LOG_SATA_NCQ;
+	fis[12] = 1;
+	if (ahci_device_data_io(uc_priv, port, fis, sizeof(fis), log,
+				ATA_SECT_SIZE, 0))
+		debug("scsi_ahci: cannot read NCQ error log on port %d\n",
+		      port);
+	else
+		debug("scsi_ahci: NCQ error on tag %d, status %#x error %#x\n",
+		      log[0] & 0x1f, log[2], log[3]);
+}
+
+/*
+ * Transfer @blocks sectors with queued commands. The request is split into
+ * CONFIG_AHCI_NCQ_MAX_BLOCKS pieces which are spread over all free tags;
+ * completed tags are reaped from SActive and refilled until the whole
+ * request is done.
+ */
+static int ahci_ncq_data_io(struct ahci_uc_priv *uc_priv, u8 port,
+			    u64 lba, u32 blocks, u8 *buf, u8 is_write)
+{
+	struct ahci_ioports *pp = &uc_priv->port[port];
+	void __iomem *port_mmio = pp->port_mmio;
+	const u32 all = GENMASK(pp->ncq_depth - 1, 0);
+	const ulong len = (ulong)blocks * ATA_SECT_SIZE;
+	u32 active = 0, issue, done, now;
+	u8 *data = buf;
+	ulong start;
+	int tag;
+
+	ahci_dcache_flush_range((unsigned long)buf, len);
+	writel(readl(port_mmio + PORT_IRQ_STAT) & PORT_IRQ_FATAL,
+	       port_mmio + PORT_IRQ_STAT);
+
+	start = get_timer(0);
+	while (blocks || active) {
+		issue = 0;
+		while (blocks && (active | issue) != all) {
+			now = min_t(u32, blocks, CONFIG_AHCI_NCQ_MAX_BLOCKS);
+			tag = ffs(~(active | issue)) - 1;
+			if (ahci_ncq_prep(uc_priv, port, tag, lba, now, data,
+					  is_write))
+				goto err;
+			issue |= BIT(tag);
+			lba += now;
+			data += now * ATA_SECT_SIZE;
+			blocks -= now;
+		}
+		if (issue) {
+			ahci_dcache_flush_sata_cmd(pp);
+			writel(issue, port_mmio + PORT_SCR_ACT);
+			writel_with_flush(issue, port_mmio + PORT_CMD_ISSUE);
+			active |= issue;
+		}
+
+		if (readl(port_mmio + PORT_IRQ_STAT) & PORT_IRQ_FATAL) {
+			debug("scsi_ahci: NCQ error, tfd %#x\n",
+			      readl(port_mmio + PORT_TFDATA));
+			goto err;
+		}
+		done = active & ~readl(port_mmio + PORT_SCR_ACT);
+		if (done) {
+			active &= ~done;
+			start = get_timer(0);
+		} else if (get_timer(start) > WAIT_MS_DATAIO) {
+			printf("scsi_ahci: NCQ timeout, tags %#x\n", active);
+			goto err;
+		}
+	}
+
+	ahci_dcache_invalidate_range((unsigned long)buf, len);
+
+	return 0;
+
+err:
+	ahci_ncq_recover(uc_priv, port);
+
+	return -EIO;
+}
+#endif
 
 /*
  * SCSI READ10/WRITE10 command operation.
@@ -794,6 +956,27 @@ static int ata_scsiop_read_write(struct ahci_uc_priv *uc_priv,
 	debug("scsi_ahci: %s %u blocks starting from lba 0x" LBAFU "\n",
 	      is_write ?  "write" : "read", blocks, lba);
 
+#ifdef CONFIG_AHCI_NCQ
+	if (uc_priv->port[pccb->target].ncq_depth) {
+		if (ATA_SECT_SIZE * blocks > user_buffer_size) {
+			printf("scsi_ahci: Error: buffer too small.\n");
+			return -EIO;
+		}
+		if (!ahci_ncq_data_io(uc_priv, pccb->target, lba, blocks,
+				      user_buffer, is_write)) {
+			/* one flush for the whole request */
+			if (is_write && ata_io_flush(uc_priv, pccb->target))
+				return -EIO;
+			return 0;
+		}
+
+		/* Retry the request with the non-queued commands below */
+		printf("scsi_ahci: NCQ failed on port %d, disabling it\n",
+		       pccb->target);
+		uc_priv->port[pccb->target].ncq_depth = 0;
+	}
+#endif
+
 	/* Preset the FIS */
 	memset(fis, 0, sizeof(fis));
 	fis[0] = 0x27;		 /* Host to device FIS. */
@@ -1126,7 +1309,7 @@ static int ata_io_flush(struct ahci_uc_priv *uc_priv, u8 port)
 	fis[2] = ATA_CMD_FLUSH_EXT;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, 20);
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
 	ahci_dcache_flush_sata_cmd(pp);
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
 
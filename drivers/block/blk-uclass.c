@@ -7,6 +7,7 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <fs.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
@@ -463,6 +464,8 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	fs_cache_invalidate(block_dev);
+	part_cache_invalidate_blocks(block_dev, start, blkcnt);
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -476,9 +479,181 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	fs_cache_invalidate(block_dev);
+	part_cache_invalidate_blocks(block_dev, start, blkcnt);
 	return ops->erase(dev, start, blkcnt);
 }
 
+unsigned long blk_ddiscard(struct blk_desc *block_dev, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	unsigned long ret;
+
+	if (!ops->discard)
+		return blk_derase(block_dev, start, blkcnt);
+
+	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	fs_cache_invalidate(block_dev);
+	part_cache_invalidate_blocks(block_dev, start, blkcnt);
+	ret = ops->discard(dev, start, blkcnt);
+	if (ret == (unsigned long)-ENOSYS)
+		return blk_derase(block_dev, start, blkcnt);
+
+	return ret;
+}
+
+void blk_req_complete(struct blk_req *req, lbaint_t actual, int status)
+{
+	struct blk_desc *block_dev = dev_get_uclass_plat(req->dev);
+
+	if (req->op == BLK_REQ_READ && !status && actual == req->blkcnt) {
+		blkcache_fill(block_dev->if_type, block_dev->devnum,
+			      req->start, req->blkcnt, block_dev->blksz,
+			      req->buffer);
+	} else if (req->op != BLK_REQ_READ) {
+		/*
+		 * A read queued before this request may have filled the caches
+		 * with the old contents since they were invalidated on submit
+		 */
+		blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+		fs_cache_invalidate(block_dev);
+		part_cache_invalidate_blocks(block_dev, req->start,
+					     req->blkcnt);
+	}
+
+	req->actual = actual;
+	req->status = status;
+	req->done = true;
+	if (req->complete)
+		req->complete(req);
+}
+
+int blk_submit(struct blk_desc *block_dev, struct blk_req *req)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks;
+	int ret;
+
+	req->dev = dev;
+	req->actual = 0;
+	req->status = 0;
+	req->done = false;
+
+	switch (req->op) {
+	case BLK_REQ_READ:
+		if (!ops->read)
+			return -ENOSYS;
+		if (blkcache_read(block_dev->if_type, block_dev->devnum,
+				  req->start, req->blkcnt, block_dev->blksz,
+				  req->buffer)) {
+			blk_req_complete(req, req->blkcnt, 0);
+			return 0;
+		}
+		break;
+	case BLK_REQ_WRITE:
+		if (!ops->write)
+			return -ENOSYS;
+		blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+		fs_cache_invalidate(block_dev);
+		part_cache_invalidate_blocks(block_dev, req->start,
+					     req->blkcnt);
+		break;
+	case BLK_REQ_ERASE:
+		if (!ops->erase)
+			return -ENOSYS;
+		blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+		fs_cache_invalidate(block_dev);
+		part_cache_invalidate_blocks(block_dev, req->start,
+					     req->blkcnt);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (ops->submit) {
+		/* Let the driver finish earlier requests until it has room */
+		for (;;) {
+			ret = ops->submit(dev, req);
+			if (ret != -EBUSY)
+				return ret;
+			ret = ops->poll(dev);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	/* The driver cannot queue requests, so carry this one out now */
+	switch (req->op) {
+	case BLK_REQ_READ:
+		blks = ops->read(dev, req->start, req->blkcnt, req->buffer);
+		break;
+	case BLK_REQ_WRITE:
+		blks = ops->write(dev, req->start, req->blkcnt, req->buffer);
+		break;
+	default:
+		blks = ops->erase(dev, req->start, req->blkcnt);
+		break;
+	}
+	if (IS_ERR_VALUE(blks))
+		blk_req_complete(req, 0, blks);
+	else
+		blk_req_complete(req, blks, blks == req->blkcnt ? 0 : -EIO);
+
+	return 0;
+}
+
+int blk_poll(struct blk_desc *block_dev)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+long blk_wait(struct blk_desc *block_dev, struct blk_req *req)
+{
+	int ret;
+
+	while (!req->done) {
+		ret = blk_poll(block_dev);
+		if (ret < 0)
+			return ret;
+		/* nothing left in flight, yet the request has not finished */
+		if (!ret && !req->done)
+			return -EIO;
+	}
+
+	return req->status ? req->status : req->actual;
+}
+
+int blk_dread_async(struct blk_desc *block_dev, lbaint_t start,
+		    lbaint_t blkcnt, void *buffer, struct blk_req *req)
+{
+	req->op = BLK_REQ_READ;
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buffer = buffer;
+
+	return blk_submit(block_dev, req);
+}
+
+int blk_dwrite_async(struct blk_desc *block_dev, lbaint_t start,
+		     lbaint_t blkcnt, const void *buffer, struct blk_req *req)
+{
+	req->op = BLK_REQ_WRITE;
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buffer = (void *)buffer;
+
+	return blk_submit(block_dev, req);
+}
+
 int blk_get_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -656,9 +831,20 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+	fs_cache_invalidate(desc);
+	part_cache_invalidate(desc);
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
 	.per_device_plat_auto	= sizeof(struct blk_desc),
 };
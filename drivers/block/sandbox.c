@@ -18,6 +18,9 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Blocks of zeroes written at a time by discard */
+#define HOST_DISCARD_BLKS	64
+
 #ifndef CONFIG_BLK
 static struct host_block_dev host_devices[CONFIG_HOST_MAX_DEVICES];
 
@@ -232,26 +235,114 @@ int host_get_dev_err(int devnum, struct blk_desc **blk_devp)
 
 #ifdef CONFIG_BLK
 
+static int sandbox_host_bind(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_plat(dev);
+
+	INIT_LIST_HEAD(&host_dev->queue);
+
+	return 0;
+}
+
 int sandbox_host_unbind(struct udevice *dev)
 {
 	struct host_block_dev *host_dev;
 
 	/* Data validity is checked in host_dev_bind() */
 	host_dev = dev_get_plat(dev);
+	while (!list_empty(&host_dev->queue)) {
+		struct blk_req *req = list_first_entry(&host_dev->queue,
+						       struct blk_req, list);
+
+		list_del(&req->list);
+		blk_req_complete(req, 0, -ENODEV);
+	}
 	os_close(host_dev->fd);
 
 	return 0;
 }
 
+/*
+ * Requests are only queued by submit() and carried out one at a time by
+ * poll(), so that callers see them finish later, as with real hardware
+ */
+static int host_block_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct host_block_dev *host_dev = dev_get_plat(dev);
+
+	list_add_tail(&req->list, &host_dev->queue);
+
+	return 0;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_plat(dev);
+	struct blk_req *req;
+	struct list_head *entry;
+	ulong blks;
+	int count = 0;
+
+	req = list_first_entry_or_null(&host_dev->queue, struct blk_req, list);
+	if (req) {
+		list_del(&req->list);
+		if (req->op == BLK_REQ_READ)
+			blks = host_block_read(dev, req->start, req->blkcnt,
+					       req->buffer);
+		else
+			blks = host_block_write(dev, req->start, req->blkcnt,
+						req->buffer);
+		if (IS_ERR_VALUE(blks))
+			blk_req_complete(req, 0, -EIO);
+		else
+			blk_req_complete(req, blks,
+					 blks == req->blkcnt ? 0 : -EIO);
+	}
+
+	list_for_each(entry, &host_dev->queue)
+		count++;
+
+	return count;
+}
+
+/* Discarded blocks read back as zeroes, like a device with DRAT/RZAT */
+static unsigned long host_block_discard(struct udevice *dev,
+					lbaint_t start, lbaint_t blkcnt)
+{
+	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
+	lbaint_t done = 0, count;
+	ulong blks;
+	void *zero;
+
+	zero = calloc(HOST_DISCARD_BLKS, block_dev->blksz);
+	if (!zero)
+		return -ENOMEM;
+
+	while (done < blkcnt) {
+		count = min_t(lbaint_t, blkcnt - done, HOST_DISCARD_BLKS);
+		blks = host_block_write(dev, start + done, count, zero);
+		if (IS_ERR_VALUE(blks) || blks != count)
+			break;
+		done += count;
+	}
+	free(zero);
+
+	return done;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.discard	= host_block_discard,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.bind		= sandbox_host_bind,
 	.unbind		= sandbox_host_unbind,
 	.plat_auto	= sizeof(struct host_block_dev),
 };
@@ -170,11 +170,15 @@ done:
 }
 
 static unsigned char *dfu_buf;
+/* filled while dfu_buf is written, for entities with submit_medium() */
+static unsigned char *dfu_alt_buf;
 static unsigned long dfu_buf_size;
 static enum dfu_device_type dfu_buf_device_type;
 
 unsigned char *dfu_free_buf(void)
 {
+	free(dfu_alt_buf);
+	dfu_alt_buf = NULL;
 	free(dfu_buf);
 	dfu_buf = NULL;
 	return dfu_buf;
@@ -211,6 +215,10 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 		printf("%s: Could not memalign 0x%lx bytes\n",
 		       __func__, dfu_buf_size);
 
+	/* without it, writes are simply synchronous */
+	if (dfu_buf && dfu->submit_medium)
+		dfu_alt_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+
 	dfu_buf_device_type = dfu->dev_type;
 	return dfu_buf;
 }
@@ -232,24 +240,39 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
-static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+static int dfu_write_buffer_drain(struct dfu_entity *dfu, bool async)
 {
 	long w_size;
 	int ret;
 
+	/* the previous buffer must be on the medium before this one */
+	if (dfu->wait_medium) {
+		ret = dfu->wait_medium(dfu);
+		if (ret)
+			return ret;
+	}
+
 	/* flush size? */
 	w_size = dfu->i_buf - dfu->i_buf_start;
 	if (w_size == 0)
 		return 0;
 
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
-
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
+	if (async)
+		ret = dfu->submit_medium(dfu, dfu->offset, dfu->i_buf_start,
+					 &w_size);
+	else
+		ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start,
+					&w_size);
 	if (ret)
 		debug("%s: Write error!\n", __func__);
 
+	/* receive into the other buffer while this one is written */
+	if (async) {
+		dfu->i_buf_start = dfu->i_buf_start == dfu_buf ? dfu_alt_buf :
+			dfu_buf;
+		dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
+	}
+
 	/* point back */
 	dfu->i_buf = dfu->i_buf_start;
 
@@ -263,6 +286,10 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 
 void dfu_transaction_cleanup(struct dfu_entity *dfu)
 {
+	/* an aborted download may still be writing one buffer */
+	if (dfu->wait_medium)
+		dfu->wait_medium(dfu);
+
 	/* clear everything */
 	dfu->crc = 0;
 	dfu->offset = 0;
@@ -308,7 +335,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
 	int ret = 0;
 
-	ret = dfu_write_buffer_drain(dfu);
+	ret = dfu_write_buffer_drain(dfu, false);
 	if (ret)
 		return ret;
 
@@ -328,6 +355,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
+	bool async;
 	int ret;
 
 	debug("%s: name: %s buf: 0x%p size: 0x%x p_num: 0x%x offset: 0x%llx bufoffset: 0x%lx\n",
@@ -361,9 +389,16 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* handle rollover */
 	dfu->i_blk_seq_num = (dfu->i_blk_seq_num + 1) & 0xffff;
 
+	/*
+	 * Callers such as thor receive straight into dfu_buf, which must then
+	 * not be in use by a write when this function returns.
+	 */
+	async = dfu->submit_medium && dfu_alt_buf &&
+		((u8 *)buf < dfu_buf || (u8 *)buf >= dfu_buf + dfu_buf_size);
+
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_drain(dfu, async);
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			return ret;
@@ -378,12 +413,20 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		return -1;
 	}
 
+	/*
+	 * Hash each block as it is copied in, while it is still in the cache,
+	 * instead of reading the whole buffer back from memory when it is
+	 * drained.
+	 */
 	memcpy(dfu->i_buf, buf, size);
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
+					   dfu->i_buf, size, 0);
 	dfu->i_buf += size;
 
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_drain(dfu, async);
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			return ret;
@@ -10,10 +10,12 @@
 #include <log.h>
 #include <malloc.h>
 #include <errno.h>
+#include <blk.h>
 #include <div64.h>
 #include <dfu.h>
 #include <ext4fs.h>
 #include <fat.h>
+#include <image-sparse.h>
 #include <mmc.h>
 #include <part.h>
 #include <command.h>
@@ -22,34 +24,54 @@ static unsigned char *dfu_file_buf;
 static u64 dfu_file_buf_len;
 static u64 dfu_file_buf_offset;
 
-static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
-			u64 offset, void *buf, long *len)
-{
-	struct mmc *mmc;
-	u32 blk_start, blk_count, n = 0;
-	int ret, part_num_bkp = 0;
+static struct sparse_storage dfu_sparse_info;
+static struct sparse_stream dfu_sparse;
+static bool dfu_sparse_active;
 
-	mmc = find_mmc_device(dfu->data.mmc.dev_num);
-	if (!mmc) {
-		pr_err("Device MMC %d - not found!", dfu->data.mmc.dev_num);
-		return -ENODEV;
-	}
+#if CONFIG_IS_ENABLED(DFU_MMC_ASYNC)
+static struct blk_req dfu_mmc_req;
+/* device dfu_mmc_req was submitted to, or NULL if none is in flight */
+static struct blk_desc *dfu_mmc_req_desc;
+#endif
 
+static int mmc_block_range(struct dfu_entity *dfu, u64 offset, long *len,
+			   u32 *blk_start, u32 *blk_count)
+{
 	/*
 	 * We must ensure that we work in lba_blk_size chunks, so ALIGN
 	 * this value.
 	 */
 	*len = ALIGN(*len, dfu->data.mmc.lba_blk_size);
 
-	blk_start = dfu->data.mmc.lba_start +
+	*blk_start = dfu->data.mmc.lba_start +
 			(u32)lldiv(offset, dfu->data.mmc.lba_blk_size);
-	blk_count = *len / dfu->data.mmc.lba_blk_size;
-	if (blk_start + blk_count >
+	*blk_count = *len / dfu->data.mmc.lba_blk_size;
+	if (*blk_start + *blk_count >
 			dfu->data.mmc.lba_start + dfu->data.mmc.lba_size) {
 		puts("Request would exceed designated area!\n");
 		return -EINVAL;
 	}
 
+	return 0;
+}
+
+static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
+			u64 offset, void *buf, long *len)
+{
+	struct mmc *mmc;
+	u32 blk_start, blk_count, n = 0;
+	int ret, part_num_bkp = 0;
+
+	mmc = find_mmc_device(dfu->data.mmc.dev_num);
+	if (!mmc) {
+		pr_err("Device MMC %d - not found!", dfu->data.mmc.dev_num);
+		return -ENODEV;
+	}
+
+	ret = mmc_block_range(dfu, offset, len, &blk_start, &blk_count);
+	if (ret)
+		return ret;
+
 	if (dfu->data.mmc.hw_partition >= 0) {
 		part_num_bkp = mmc_get_blk_desc(mmc)->hwpart;
 		ret = blk_select_hwpart_devnum(IF_TYPE_MMC,
@@ -194,6 +216,55 @@ static int mmc_file_buf_write_finish(struct dfu_entity *dfu)
 	return ret;
 }
 
+static lbaint_t mmc_sparse_write(struct sparse_storage *info, lbaint_t blk,
+				 lbaint_t blkcnt, const void *buffer)
+{
+	long len = blkcnt * info->blksz;
+
+	if (mmc_block_op(DFU_OP_WRITE, info->priv, (u64)blk * info->blksz,
+			 (void *)buffer, &len))
+		return 0;
+
+	return blkcnt;
+}
+
+static lbaint_t mmc_sparse_reserve(struct sparse_storage *info,
+				   lbaint_t blk, lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static int mmc_sparse_start(struct dfu_entity *dfu, void *buf)
+{
+	struct sparse_storage *info = &dfu_sparse_info;
+	int ret;
+
+	/* release what an aborted download may have left behind */
+	if (dfu_sparse_active) {
+		sparse_stream_finish(&dfu_sparse, dfu->name, NULL);
+		dfu_sparse_active = false;
+	}
+
+	if (!is_sparse_image(buf))
+		return 0;
+
+	info->blksz = dfu->data.mmc.lba_blk_size;
+	info->start = 0;
+	info->size = dfu->data.mmc.lba_size;
+	info->priv = dfu;
+	info->write = mmc_sparse_write;
+	info->reserve = mmc_sparse_reserve;
+	info->discard = NULL;
+	info->mssg = NULL;
+
+	ret = sparse_stream_start(&dfu_sparse, info);
+	if (ret)
+		return ret;
+	dfu_sparse_active = true;
+
+	return 0;
+}
+
 int dfu_write_medium_mmc(struct dfu_entity *dfu,
 		u64 offset, void *buf, long *len)
 {
@@ -201,7 +272,15 @@ int dfu_write_medium_mmc(struct dfu_entity *dfu,
 
 	switch (dfu->layout) {
 	case DFU_RAW_ADDR:
-		ret = mmc_block_op(DFU_OP_WRITE, dfu, offset, buf, len);
+		if (CONFIG_IS_ENABLED(DFU_MMC_SPARSE) && !offset) {
+			ret = mmc_sparse_start(dfu, buf);
+			if (ret)
+				break;
+		}
+		if (CONFIG_IS_ENABLED(DFU_MMC_SPARSE) && dfu_sparse_active)
+			ret = sparse_stream_write(&dfu_sparse, buf, *len, NULL);
+		else
+			ret = mmc_block_op(DFU_OP_WRITE, dfu, offset, buf, len);
 		break;
 	case DFU_FS_FAT:
 	case DFU_FS_EXT4:
@@ -221,6 +300,68 @@ int dfu_write_medium_mmc(struct dfu_entity *dfu,
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(DFU_MMC_ASYNC)
+static int dfu_submit_medium_mmc(struct dfu_entity *dfu,
+				 u64 offset, void *buf, long *len)
+{
+	u32 blk_start, blk_count;
+	struct mmc *mmc;
+	int ret;
+
+	/* files, sparse images and hardware partitions are written in place */
+	if (dfu->layout != DFU_RAW_ADDR || dfu->data.mmc.hw_partition >= 0)
+		return dfu_write_medium_mmc(dfu, offset, buf, len);
+
+	if (CONFIG_IS_ENABLED(DFU_MMC_SPARSE)) {
+		if (!offset) {
+			ret = mmc_sparse_start(dfu, buf);
+			if (ret)
+				return ret;
+		}
+		if (dfu_sparse_active)
+			return sparse_stream_write(&dfu_sparse, buf, *len,
+						   NULL);
+	}
+
+	mmc = find_mmc_device(dfu->data.mmc.dev_num);
+	if (!mmc) {
+		pr_err("Device MMC %d - not found!", dfu->data.mmc.dev_num);
+		return -ENODEV;
+	}
+
+	ret = mmc_block_range(dfu, offset, len, &blk_start, &blk_count);
+	if (ret)
+		return ret;
+
+	debug("%s: dev: %d start: %d cnt: %d buf: 0x%p\n", __func__,
+	      dfu->data.mmc.dev_num, blk_start, blk_count, buf);
+	ret = blk_dwrite_async(mmc_get_blk_desc(mmc), blk_start, blk_count,
+			       buf, &dfu_mmc_req);
+	if (ret)
+		return ret;
+	dfu_mmc_req_desc = mmc_get_blk_desc(mmc);
+
+	return 0;
+}
+
+static int dfu_wait_medium_mmc(struct dfu_entity *dfu)
+{
+	long n;
+
+	if (!dfu_mmc_req_desc)
+		return 0;
+
+	n = blk_wait(dfu_mmc_req_desc, &dfu_mmc_req);
+	dfu_mmc_req_desc = NULL;
+	if (n != dfu_mmc_req.blkcnt) {
+		pr_err("MMC operation failed");
+		return n < 0 ? n : -EIO;
+	}
+
+	return 0;
+}
+#endif
+
 int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 {
 	int ret = 0;
@@ -235,6 +376,11 @@ int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 		dfu_reinit_needed = true;
 		break;
 	case DFU_RAW_ADDR:
+		if (CONFIG_IS_ENABLED(DFU_MMC_SPARSE) && dfu_sparse_active) {
+			ret = sparse_stream_finish(&dfu_sparse, dfu->name, NULL);
+			dfu_sparse_active = false;
+		}
+		break;
 	case DFU_SKIP:
 		break;
 	default:
@@ -444,6 +590,10 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 	dfu->read_medium = dfu_read_medium_mmc;
 	dfu->write_medium = dfu_write_medium_mmc;
 	dfu->flush_medium = dfu_flush_medium_mmc;
+#if CONFIG_IS_ENABLED(DFU_MMC_ASYNC)
+	dfu->submit_medium = dfu_submit_medium_mmc;
+	dfu->wait_medium = dfu_wait_medium_mmc;
+#endif
 	dfu->inited = 0;
 	dfu->free_entity = dfu_free_entity_mmc;
 
@@ -124,12 +124,12 @@ static int part_get_info_by_name_or_alias(struct blk_desc **dev_desc,
 }
 
 /**
- * fb_mmc_blk_write() - Write/erase MMC in chunks of FASTBOOT_MAX_BLK_WRITE
+ * fb_mmc_blk_write() - Write MMC in chunks of FASTBOOT_MAX_BLK_WRITE
  *
  * @block_dev: Pointer to block device
- * @start: First block to write/erase
+ * @start: First block to write
  * @blkcnt: Count of blocks
- * @buffer: Pointer to data buffer for write or NULL for erase
+ * @buffer: Pointer to data buffer for write
  */
 static lbaint_t fb_mmc_blk_write(struct blk_desc *block_dev, lbaint_t start,
 				 lbaint_t blkcnt, const void *buffer)
@@ -142,22 +142,45 @@ static lbaint_t fb_mmc_blk_write(struct blk_desc *block_dev, lbaint_t start,
 
 	for (i = 0; i < blkcnt; i += FASTBOOT_MAX_BLK_WRITE) {
 		cur_blkcnt = min((int)blkcnt - i, FASTBOOT_MAX_BLK_WRITE);
-		if (buffer) {
-			if (fastboot_progress_callback)
-				fastboot_progress_callback("writing");
-			blks_written = blk_dwrite(block_dev, blk, cur_blkcnt,
-						  buffer + (i * block_dev->blksz));
-		} else {
-			if (fastboot_progress_callback)
-				fastboot_progress_callback("erasing");
-			blks_written = blk_derase(block_dev, blk, cur_blkcnt);
-		}
+		if (fastboot_progress_callback)
+			fastboot_progress_callback("writing");
+		blks_written = blk_dwrite(block_dev, blk, cur_blkcnt,
+					  buffer + (i * block_dev->blksz));
 		blk += blks_written;
 		blks += blks_written;
 	}
 	return blks;
 }
 
+/**
+ * fb_mmc_blk_discard() - Discard a range of MMC blocks
+ *
+ * The range is passed down in one go: the driver picks TRIM/DISCARD when the
+ * card has it and otherwise only erases the erase groups lying completely
+ * inside the range, which splitting it up here would lose at each boundary.
+ * Without driver model there is no discard, so the range is erased; it must
+ * then be aligned to erase groups.
+ *
+ * @block_dev: Pointer to block device
+ * @start: First block to discard
+ * @blkcnt: Count of blocks
+ */
+static lbaint_t fb_mmc_blk_discard(struct blk_desc *block_dev, lbaint_t start,
+				   lbaint_t blkcnt)
+{
+	ulong blks;
+
+	if (fastboot_progress_callback)
+		fastboot_progress_callback("erasing");
+	blks = blk_ddiscard(block_dev, start, blkcnt);
+	if (blks == (ulong)-ENOSYS)
+		blks = blk_derase(block_dev, start, blkcnt);
+	if (IS_ERR_VALUE(blks))
+		return 0;
+
+	return blks;
+}
+
 static lbaint_t fb_mmc_sparse_write(struct sparse_storage *info,
 		lbaint_t blk, lbaint_t blkcnt, const void *buffer)
 {
@@ -173,6 +196,20 @@ static lbaint_t fb_mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+static lbaint_t fb_mmc_sparse_discard(struct sparse_storage *info,
+		lbaint_t blk, lbaint_t blkcnt)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+	ulong blks;
+
+	blks = blk_ddiscard(sparse->dev_desc, blk, blkcnt);
+	if (IS_ERR_VALUE(blks))
+		return 0;
+
+	/* partial erase groups at either end are kept on purpose */
+	return blkcnt;
+}
+
 static void write_raw_image(struct blk_desc *dev_desc,
 			    struct disk_partition *info, const char *part_name,
 			    void *buffer, u32 download_bytes, char *response)
@@ -213,7 +250,7 @@ static int fb_mmc_erase_mmc_hwpart(struct blk_desc *dev_desc)
 
 	debug("Start Erasing mmc hwpart[%u]...\n", dev_desc->hwpart);
 
-	blks = fb_mmc_blk_write(dev_desc, 0, dev_desc->lba, NULL);
+	blks = fb_mmc_blk_discard(dev_desc, 0, dev_desc->lba);
 
 	if (blks != dev_desc->lba) {
 		pr_err("Failed to erase mmc hwpart[%u]\n", dev_desc->hwpart);
@@ -602,6 +639,11 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 	if (fastboot_mmc_get_part_info(cmd, &dev_desc, &info, response) < 0)
 		return;
 
+	/*
+	 * The partition is only named once the download has finished, so a
+	 * sparse image is expanded from the download buffer rather than
+	 * while it arrives. The host splits larger images into several.
+	 */
 	if (is_sparse_image(download_buffer)) {
 		struct fb_mmc_sparse sparse_priv;
 		struct sparse_storage sparse;
@@ -614,6 +656,10 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 		sparse.size = info.size;
 		sparse.write = fb_mmc_sparse_write;
 		sparse.reserve = fb_mmc_sparse_reserve;
+		if (IS_ENABLED(CONFIG_FASTBOOT_MMC_SPARSE_DISCARD))
+			sparse.discard = fb_mmc_sparse_discard;
+		else
+			sparse.discard = NULL;
 		sparse.mssg = fastboot_fail;
 
 		printf("Flashing sparse image at offset " LBAFU "\n",
@@ -690,7 +736,7 @@ void fastboot_mmc_erase(const char *cmd, char *response)
 	printf("Erasing blocks " LBAFU " to " LBAFU " due to alignment\n",
 	       blks_start, blks_start + blks_size);
 
-	blks = fb_mmc_blk_write(dev_desc, blks_start, blks_size, NULL);
+	blks = fb_mmc_blk_discard(dev_desc, blks_start, blks_size);
 
 	if (blks != blks_size) {
 		pr_err("failed erasing from device %d\n", dev_desc->devnum);
@@ -338,10 +338,8 @@ void mmc_do_preinit(void)
 	uclass_foreach_dev(dev, uc) {
 		struct mmc *m = mmc_get_mmc_dev(dev);
 
-		if (!m)
-			continue;
-		if (m->preinit)
-			mmc_start_init(m);
+		if (m)
+			mmc_start_preinit(m);
 	}
 }
 
@@ -485,6 +483,7 @@ static const struct blk_ops mmc_blk_ops = {
 #if CONFIG_IS_ENABLED(MMC_WRITE)
 	.write	= mmc_bwrite,
 	.erase	= mmc_berase,
+	.discard	= mmc_bdiscard,
 #endif
 	.select_hwpart	= mmc_select_hwpart,
 };
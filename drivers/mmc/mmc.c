@@ -588,50 +588,71 @@ static int mmc_switch_voltage(struct mmc *mmc, int signal_voltage)
 }
 #endif
 
-static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
+static int sd_send_op_cond_iter(struct mmc *mmc, bool uhs_en)
 {
-	int timeout = 1000;
-	int err;
 	struct mmc_cmd cmd;
+	int err;
 
-	while (1) {
-		cmd.cmdidx = MMC_CMD_APP_CMD;
-		cmd.resp_type = MMC_RSP_R1;
-		cmd.cmdarg = 0;
+	cmd.cmdidx = MMC_CMD_APP_CMD;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
 
-		err = mmc_send_cmd(mmc, &cmd, NULL);
+	err = mmc_send_cmd(mmc, &cmd, NULL);
 
-		if (err)
-			return err;
+	if (err)
+		return err;
 
-		cmd.cmdidx = SD_CMD_APP_SEND_OP_COND;
-		cmd.resp_type = MMC_RSP_R3;
+	cmd.cmdidx = SD_CMD_APP_SEND_OP_COND;
+	cmd.resp_type = MMC_RSP_R3;
 
-		/*
-		 * Most cards do not answer if some reserved bits
-		 * in the ocr are set. However, Some controller
-		 * can set bit 7 (reserved for low voltages), but
-		 * how to manage low voltages SD card is not yet
-		 * specified.
-		 */
-		cmd.cmdarg = mmc_host_is_spi(mmc) ? 0 :
-			(mmc->cfg->voltages & 0xff8000);
+	/*
+	 * Most cards do not answer if some reserved bits
+	 * in the ocr are set. However, Some controller
+	 * can set bit 7 (reserved for low voltages), but
+	 * how to manage low voltages SD card is not yet
+	 * specified.
+	 */
+	cmd.cmdarg = mmc_host_is_spi(mmc) ? 0 :
+		(mmc->cfg->voltages & 0xff8000);
 
-		if (mmc->version == SD_VERSION_2)
-			cmd.cmdarg |= OCR_HCS;
+	if (mmc->version == SD_VERSION_2)
+		cmd.cmdarg |= OCR_HCS;
 
-		if (uhs_en)
-			cmd.cmdarg |= OCR_S18R;
+	if (uhs_en)
+		cmd.cmdarg |= OCR_S18R;
 
-		err = mmc_send_cmd(mmc, &cmd, NULL);
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+
+	if (err)
+		return err;
 
+	mmc->ocr = cmd.response[0];
+	return 0;
+}
+
+static int sd_complete_op_cond(struct mmc *mmc)
+{
+	bool uhs_en = mmc->op_cond_uhs;
+	int timeout = 1000;
+	struct mmc_cmd cmd;
+	ulong start;
+	int err;
+
+	/*
+	 * Time out from here rather than from the first ACMD41, as the card
+	 * may not be used until long after mmc_start_init()
+	 */
+	start = get_timer(0);
+	mmc->op_cond_pending = 0;
+	while (!(mmc->ocr & OCR_BUSY)) {
+		err = sd_send_op_cond_iter(mmc, uhs_en);
 		if (err)
 			return err;
 
-		if (cmd.response[0] & OCR_BUSY)
+		if (mmc->ocr & OCR_BUSY)
 			break;
 
-		if (timeout-- <= 0)
+		if (get_timer(start) > timeout)
 			return -EOPNOTSUPP;
 
 		udelay(1000);
@@ -649,12 +670,12 @@ static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
 
 		if (err)
 			return err;
-	}
 
-	mmc->ocr = cmd.response[0];
+		mmc->ocr = cmd.response[0];
+	}
 
 #if CONFIG_IS_ENABLED(MMC_UHS_SUPPORT)
-	if (uhs_en && !(mmc_host_is_spi(mmc)) && (cmd.response[0] & 0x41000000)
+	if (uhs_en && !(mmc_host_is_spi(mmc)) && (mmc->ocr & 0x41000000)
 	    == 0x41000000) {
 		err = mmc_switch_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
 		if (err)
@@ -668,6 +689,28 @@ static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
 	return 0;
 }
 
+/*
+ * Send the first ACMD41. A card which is still busy powering up is left for
+ * mmc_complete_init() to wait for, so that several cards can power up at
+ * the same time.
+ */
+static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
+{
+	int err;
+
+	err = sd_send_op_cond_iter(mmc, uhs_en);
+	if (err)
+		return err;
+
+	mmc->op_cond_sd = 1;
+	mmc->op_cond_uhs = uhs_en;
+	mmc->op_cond_pending = 1;
+	if (!(mmc->ocr & OCR_BUSY))
+		return 0;
+
+	return sd_complete_op_cond(mmc);
+}
+
 static int mmc_send_op_cond_iter(struct mmc *mmc, int use_arg)
 {
 	struct mmc_cmd cmd;
@@ -689,18 +732,18 @@ static int mmc_send_op_cond_iter(struct mmc *mmc, int use_arg)
 	return 0;
 }
 
+/*
+ * Ask the card for its capabilities and start its power-up with CMD1. The
+ * wait for the card to become ready is left to mmc_complete_op_cond().
+ */
 static int mmc_send_op_cond(struct mmc *mmc)
 {
 	int err, i;
-	int timeout = 1000;
-	uint start;
 
 	/* Some cards seem to need this */
 	mmc_go_idle(mmc);
 
-	start = get_timer(0);
- 	/* Asking to the card its capabilities */
-	for (i = 0; ; i++) {
+	for (i = 0; i < 2; i++) {
 		err = mmc_send_op_cond_iter(mmc, i != 0);
 		if (err)
 			return err;
@@ -708,11 +751,8 @@ static int mmc_send_op_cond(struct mmc *mmc)
 		/* exit if not busy (flag seems to be inverted) */
 		if (mmc->ocr & OCR_BUSY)
 			break;
-
-		if (get_timer(start) > timeout)
-			return -ETIMEDOUT;
-		udelay(100);
 	}
+	mmc->op_cond_sd = 0;
 	mmc->op_cond_pending = 1;
 	return 0;
 }
@@ -720,26 +760,29 @@ static int mmc_send_op_cond(struct mmc *mmc)
 static int mmc_complete_op_cond(struct mmc *mmc)
 {
 	struct mmc_cmd cmd;
+	bool retried = false;
 	int timeout = 1000;
 	ulong start;
 	int err;
 
+	start = get_timer(0);
 	mmc->op_cond_pending = 0;
-	if (!(mmc->ocr & OCR_BUSY)) {
-		/* Some cards seem to need this */
-		mmc_go_idle(mmc);
-
-		start = get_timer(0);
-		while (1) {
-			err = mmc_send_op_cond_iter(mmc, 1);
-			if (err)
-				return err;
-			if (mmc->ocr & OCR_BUSY)
-				break;
-			if (get_timer(start) > timeout)
+	while (!(mmc->ocr & OCR_BUSY)) {
+		err = mmc_send_op_cond_iter(mmc, 1);
+		if (err)
+			return err;
+		if (mmc->ocr & OCR_BUSY)
+			break;
+		if (get_timer(start) > timeout) {
+			if (retried)
 				return -EOPNOTSUPP;
-			udelay(100);
+			/* Some cards seem to need this */
+			mmc_go_idle(mmc);
+			start = get_timer(0);
+			retried = true;
+			continue;
 		}
+		udelay(100);
 	}
 
 	if (mmc_host_is_spi(mmc)) { /* read OCR for spi */
@@ -2766,6 +2809,49 @@ static int mmc_power_cycle(struct mmc *mmc)
 	return mmc_power_on(mmc);
 }
 
+/* Reset the card and find out whether it is an SD or an MMC card */
+static int mmc_detect_card(struct mmc *mmc, bool uhs_en)
+{
+	int err;
+
+retry:
+	mmc_set_initial_state(mmc);
+
+	/* Reset the Card */
+	err = mmc_go_idle(mmc);
+
+	if (err)
+		return err;
+
+	/* The internal partition reset to user partition(0) at every CMD0 */
+	mmc_get_blk_desc(mmc)->hwpart = 0;
+
+	/* Test for SD version 2 */
+	err = mmc_send_if_cond(mmc);
+
+	/* Now try to get the SD card's operating condition */
+	err = sd_send_op_cond(mmc, uhs_en);
+	if (err && uhs_en) {
+		uhs_en = false;
+		mmc_power_cycle(mmc);
+		goto retry;
+	}
+
+	/* If the command timed out, we check for an MMC card */
+	if (err == -ETIMEDOUT) {
+		err = mmc_send_op_cond(mmc);
+
+		if (err) {
+#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
+			pr_err("Card did not respond to voltage select! : %d\n", err);
+#endif
+			return -EOPNOTSUPP;
+		}
+	}
+
+	return err;
+}
+
 int mmc_get_op_cond(struct mmc *mmc)
 {
 	bool uhs_en = supports_uhs(mmc->cfg->host_caps);
@@ -2813,42 +2899,7 @@ int mmc_get_op_cond(struct mmc *mmc)
 		return err;
 	mmc->ddr_mode = 0;
 
-retry:
-	mmc_set_initial_state(mmc);
-
-	/* Reset the Card */
-	err = mmc_go_idle(mmc);
-
-	if (err)
-		return err;
-
-	/* The internal partition reset to user partition(0) at every CMD0 */
-	mmc_get_blk_desc(mmc)->hwpart = 0;
-
-	/* Test for SD version 2 */
-	err = mmc_send_if_cond(mmc);
-
-	/* Now try to get the SD card's operating condition */
-	err = sd_send_op_cond(mmc, uhs_en);
-	if (err && uhs_en) {
-		uhs_en = false;
-		mmc_power_cycle(mmc);
-		goto retry;
-	}
-
-	/* If the command timed out, we check for an MMC card */
-	if (err == -ETIMEDOUT) {
-		err = mmc_send_op_cond(mmc);
-
-		if (err) {
-#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
-			pr_err("Card did not respond to voltage select! : %d\n", err);
-#endif
-			return -EOPNOTSUPP;
-		}
-	}
-
-	return err;
+	return mmc_detect_card(mmc, uhs_en);
 }
 
 int mmc_start_init(struct mmc *mmc)
@@ -2890,13 +2941,31 @@ int mmc_start_init(struct mmc *mmc)
 	return err;
 }
 
+static int mmc_finish_op_cond(struct mmc *mmc)
+{
+	if (mmc->op_cond_sd)
+		return sd_complete_op_cond(mmc);
+
+	return mmc_complete_op_cond(mmc);
+}
+
 static int mmc_complete_init(struct mmc *mmc)
 {
+	bool uhs_en;
 	int err = 0;
 
 	mmc->init_in_progress = 0;
-	if (mmc->op_cond_pending)
-		err = mmc_complete_op_cond(mmc);
+	if (mmc->op_cond_pending) {
+		uhs_en = mmc->op_cond_sd && mmc->op_cond_uhs;
+		err = mmc_finish_op_cond(mmc);
+		if (err && uhs_en) {
+			/* As in mmc_detect_card(), try again without UHS */
+			mmc_power_cycle(mmc);
+			err = mmc_detect_card(mmc, false);
+			if (!err && mmc->op_cond_pending)
+				err = mmc_finish_op_cond(mmc);
+		}
+	}
 
 	if (!err)
 		err = mmc_startup(mmc);
@@ -2981,6 +3050,12 @@ void mmc_set_preinit(struct mmc *mmc, int preinit)
 	mmc->preinit = preinit;
 }
 
+void mmc_start_preinit(struct mmc *mmc)
+{
+	if (mmc->preinit || CONFIG_IS_ENABLED(MMC_PREINIT))
+		mmc_start_init(mmc);
+}
+
 #if CONFIG_IS_ENABLED(DM_MMC)
 static int mmc_probe(struct bd_info *bis)
 {
@@ -3057,10 +3132,8 @@ int mmc_init_device(int num)
 		return ret;
 
 	m = mmc_get_mmc_dev(dev);
-	if (!m)
-		return 0;
-	if (m->preinit)
-		mmc_start_init(m);
+	if (m)
+		mmc_start_preinit(m);
 
 	return 0;
 }
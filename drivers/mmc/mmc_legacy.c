@@ -23,9 +23,7 @@ struct mmc *find_mmc_device(int dev_num)
 
 void mmc_do_preinit(void)
 {
-	struct mmc *m = &mmc_static;
-	if (m->preinit)
-		mmc_start_init(m);
+	mmc_start_preinit(&mmc_static);
 }
 
 struct blk_desc *mmc_get_blk_desc(struct mmc *mmc)
@@ -74,9 +72,7 @@ void mmc_do_preinit(void)
 
 	list_for_each(entry, &mmc_devices) {
 		m = list_entry(entry, struct mmc, link);
-
-		if (m->preinit)
-			mmc_start_init(m);
+		mmc_start_preinit(m);
 	}
 }
 #endif
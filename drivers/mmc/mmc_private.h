@@ -32,10 +32,13 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 ulong mmc_bwrite(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 		 const void *src);
 ulong mmc_berase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
+ulong mmc_bdiscard(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
 #else
 ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		 const void *src);
 ulong mmc_berase(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt);
+ulong mmc_bdiscard(struct blk_desc *block_dev, lbaint_t start,
+		   lbaint_t blkcnt);
 #endif
 
 #else /* CONFIG_SPL_MMC_WRITE is not defined */
@@ -101,6 +104,16 @@ int mmc_get_next_devnum(void);
  */
 void mmc_do_preinit(void);
 
+/**
+ * mmc_start_preinit() - Start init of a device if it should be set up early
+ *
+ * This starts init if the device asks for it with mmc_set_preinit(), or for
+ * every device with CONFIG_MMC_PREINIT.
+ *
+ * @mmc:	MMC device to start
+ */
+void mmc_start_preinit(struct mmc *mmc);
+
 /**
  * mmc_list_init() - Set up the list of MMC devices
  */
@@ -15,7 +15,8 @@
 #include <linux/math64.h>
 #include "mmc_private.h"
 
-static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
+static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt,
+			 u32 arg)
 {
 	struct mmc_cmd cmd;
 	ulong end;
@@ -52,7 +53,7 @@ static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
 		goto err_out;
 
 	cmd.cmdidx = MMC_CMD_ERASE;
-	cmd.cmdarg = MMC_ERASE_ARG;
+	cmd.cmdarg = arg;
 	cmd.resp_type = MMC_RSP_R1b;
 
 	err = mmc_send_cmd(mmc, &cmd, NULL);
@@ -113,7 +114,7 @@ ulong mmc_berase(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt)
 			blk_r = ((blkcnt - blk) > mmc->erase_grp_size) ?
 				mmc->erase_grp_size : (blkcnt - blk);
 		}
-		err = mmc_erase_t(mmc, start + blk, blk_r);
+		err = mmc_erase_t(mmc, start + blk, blk_r, MMC_ERASE_ARG);
 		if (err)
 			break;
 
@@ -127,6 +128,117 @@ ulong mmc_berase(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt)
 	return blk;
 }
 
+/* Largest range handed to a single discard, keeps the busy timeout sane */
+#define MMC_DISCARD_MAX_BLKS	(1 << 21)
+#define MMC_DISCARD_MAX_TIMEOUT	600000
+
+/*
+ * Pick the cheapest CMD38 argument the card offers: DISCARD and TRIM work
+ * on write blocks and leave the erase to the card's garbage collection,
+ * plain ERASE only works on whole erase groups.
+ */
+static u32 mmc_discard_arg(struct mmc *mmc)
+{
+	if (IS_SD(mmc) || !mmc->ext_csd)
+		return MMC_ERASE_ARG;
+	if (mmc->version >= MMC_VERSION_4_5)
+		return MMC_DISCARD_ARG;
+	if (mmc->ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT] & EXT_CSD_SEC_GB_CL_EN)
+		return MMC_TRIM_ARG;
+
+	return MMC_ERASE_ARG;
+}
+
+static int mmc_discard_timeout(struct mmc *mmc, u32 arg, lbaint_t blkcnt)
+{
+	ulong timeout_ms;
+	uint units, mult;
+
+	if (IS_SD(mmc)) {
+		units = DIV_ROUND_UP(blkcnt, mmc->ssr.au ? mmc->ssr.au : 1);
+		if (mmc->ssr.erase_timeout)
+			timeout_ms = units * mmc->ssr.erase_timeout +
+				     mmc->ssr.erase_offset;
+		else
+			timeout_ms = units * 250;
+	} else {
+		units = DIV_ROUND_UP(blkcnt, mmc->erase_grp_size);
+		mult = 0;
+		if (mmc->ext_csd)
+			mult = mmc->ext_csd[arg == MMC_ERASE_ARG ?
+					    EXT_CSD_ERASE_TIMEOUT_MULT :
+					    EXT_CSD_TRIM_MULT];
+		timeout_ms = units * (mult ? mult * 300 : 1000);
+	}
+
+	return clamp(timeout_ms, 1000UL, (ulong)MMC_DISCARD_MAX_TIMEOUT);
+}
+
+#if CONFIG_IS_ENABLED(BLK)
+ulong mmc_bdiscard(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+#else
+ulong mmc_bdiscard(struct blk_desc *block_dev, lbaint_t start,
+		   lbaint_t blkcnt)
+#endif
+{
+#if CONFIG_IS_ENABLED(BLK)
+	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
+#endif
+	int dev_num = block_dev->devnum;
+	struct mmc *mmc = find_mmc_device(dev_num);
+	lbaint_t blk = 0, blk_r, end;
+	u32 arg, rem;
+	int err;
+
+	if (!mmc)
+		return -ENODEV;
+
+	err = blk_select_hwpart_devnum(IF_TYPE_MMC, dev_num,
+				       block_dev->hwpart);
+	if (err < 0)
+		return err;
+
+	arg = mmc_discard_arg(mmc);
+
+	/*
+	 * An eMMC ERASE takes out whole erase groups, so only pass on the
+	 * groups that lie completely inside the range: the partial groups at
+	 * either end hold data belonging to someone else. The last group of
+	 * the device is the exception, as nothing follows it.
+	 */
+	if (!IS_SD(mmc) && arg == MMC_ERASE_ARG && mmc->erase_grp_size > 1) {
+		end = start + blkcnt;
+		div_u64_rem(start, mmc->erase_grp_size, &rem);
+		if (rem)
+			start += mmc->erase_grp_size - rem;
+		div_u64_rem(end, mmc->erase_grp_size, &rem);
+		if (end != block_dev->lba)
+			end -= rem;
+		if (end <= start)
+			return 0;
+		blkcnt = end - start;
+	}
+
+	while (blkcnt) {
+		blk_r = min_t(lbaint_t, blkcnt, MMC_DISCARD_MAX_BLKS);
+		err = mmc_erase_t(mmc, start, blk_r, arg);
+		if (err)
+			return err;
+
+		/* Waiting for the ready status */
+		err = mmc_poll_for_busy(mmc, mmc_discard_timeout(mmc, arg,
+								 blk_r));
+		if (err)
+			return err;
+
+		start += blk_r;
+		blkcnt -= blk_r;
+		blk += blk_r;
+	}
+
+	return blk;
+}
+
 static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 		lbaint_t blkcnt, const void *src)
 {
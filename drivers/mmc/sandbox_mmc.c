@@ -23,16 +23,20 @@ struct sandbox_mmc_plat {
 #define MMC_BL_LEN BIT(MMC_BL_LEN_SHIFT)
 #define MMC_CAPACITY (((MMC_CSIZE + 1) << (MMC_CMULT + 2)) \
 		      * MMC_BL_LEN) /* 1 MiB */
+/* Number of ACMD41s the card stays busy for after a reset */
+#define MMC_POWERUP_POLLS 2
 
 struct sandbox_mmc_priv {
 	u8 buf[MMC_CAPACITY];
+	int powerup;
 };
 
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
  * This emulate an SD card version 2. Single-block reads result in zero data.
- * Multiple-block reads return a test string.
+ * Multiple-block reads return a test string. Like a real card, it needs a
+ * few ACMD41s after a reset before it reports that it is ready.
  */
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
@@ -47,7 +51,9 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		break;
 	case SD_CMD_SEND_RELATIVE_ADDR:
 		cmd->response[0] = 0 << 16; /* mmc->rca */
+		break;
 	case MMC_CMD_GO_IDLE_STATE:
+		priv->powerup = MMC_POWERUP_POLLS;
 		break;
 	case SD_CMD_SEND_IF_COND:
 		cmd->response[0] = 0xaa;
@@ -97,7 +103,11 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		       (erase_end - erase_start + 1) * mmc->write_bl_len);
 		break;
 	case SD_CMD_APP_SEND_OP_COND:
-		cmd->response[0] = OCR_BUSY | OCR_HCS;
+		cmd->response[0] = OCR_HCS;
+		if (priv->powerup)
+			priv->powerup--;
+		else
+			cmd->response[0] |= OCR_BUSY;
 		cmd->response[1] = 0;
 		cmd->response[2] = 0;
 		break;
@@ -1115,6 +1115,30 @@ int nand_read_page_op(struct nand_chip *chip, unsigned int page,
 }
 EXPORT_SYMBOL_GPL(nand_read_page_op);
 
+/**
+ * nand_read_cache_op - Do a READ CACHE SEQUENTIAL or READ CACHE END operation
+ * @chip: The NAND chip
+ * @last: this is the last page of the sequence
+ *
+ * This function is issued after a READ PAGE operation (or a previous READ
+ * CACHE operation) and before reading out the page data. It moves the page
+ * loaded by the previous operation to the cache register and, unless @last
+ * is set, starts loading the next page from the array while the data is
+ * being read out, which hides tR for all but the first page.
+ * This function does not select/unselect the CS line.
+ *
+ * Returns 0 on success, a negative error code otherwise.
+ */
+static int nand_read_cache_op(struct nand_chip *chip, bool last)
+{
+	struct mtd_info *mtd = nand_to_mtd(chip);
+
+	chip->cmdfunc(mtd, last ? NAND_CMD_READCACHEEND : NAND_CMD_READCACHESEQ,
+		      -1, -1);
+
+	return 0;
+}
+
 /**
  * nand_read_param_page_op - Do a READ PARAMETER PAGE operation
  * @chip: The NAND chip
@@ -2298,6 +2322,45 @@ static int nand_setup_read_retry(struct mtd_info *mtd, int retry_mode)
 	return chip->setup_read_retry(mtd, retry_mode);
 }
 
+/**
+ * nand_cache_read_last - [INTERN] Find the end of a READ CACHE sequence
+ * @mtd: MTD device structure
+ * @realpage: first page to read
+ * @col: column of the first byte to read in @realpage
+ * @readlen: number of bytes left to read
+ * @ops: oob ops structure
+ *
+ * Returns the last page that can be read together with @realpage using READ
+ * CACHE SEQUENTIAL, or -1 if plain READ PAGE operations have to be used. A
+ * sequence never crosses an eraseblock, covers whole pages only and is only
+ * used when the core itself drives the command and address cycles.
+ */
+static int nand_cache_read_last(struct mtd_info *mtd, int realpage, int col,
+				uint32_t readlen, struct mtd_oob_ops *ops)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+	int ppb = 1 << (chip->phys_erase_shift - chip->page_shift);
+	int last;
+
+	if (!IS_ENABLED(CONFIG_SYS_NAND_CACHE_READ) ||
+	    !NAND_HAS_CACHEREAD(chip) || chip->cmdfunc != nand_command_lp ||
+	    !nand_standard_page_accessors(&chip->ecc) ||
+	    (chip->options & NAND_NEED_READRDY) || chip->read_retries ||
+	    ops->oobbuf || ops->mode == MTD_OPS_RAW || col)
+		return -1;
+
+	last = realpage + readlen / mtd->writesize - 1;
+	last = min(last, (realpage | (ppb - 1)));
+	if (last <= realpage)
+		return -1;
+
+	/* All pages of the sequence come from the chip */
+	if (chip->pagebuf >= realpage && chip->pagebuf <= last)
+		chip->pagebuf = -1;
+
+	return last;
+}
+
 /**
  * nand_do_read_ops - [INTERN] Read data with ECC
  * @mtd: MTD device structure
@@ -2321,6 +2384,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	unsigned int max_bitflips = 0;
 	int retry_mode = 0;
 	bool ecc_fail = false;
+	int cache_last = -1;
 
 	chipnr = (int)(from >> chip->chip_shift);
 	chip->select_chip(mtd, chipnr);
@@ -2358,8 +2422,20 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 						 __func__, buf);
 
 read_retry:
-			if (nand_standard_page_accessors(&chip->ecc)) {
-				ret = nand_read_page_op(chip, page, 0, NULL, 0);
+			if (realpage > cache_last) {
+				cache_last = nand_cache_read_last(mtd, realpage,
+								  col, readlen,
+								  ops);
+				if (nand_standard_page_accessors(&chip->ecc)) {
+					ret = nand_read_page_op(chip, page, 0,
+								NULL, 0);
+					if (ret)
+						break;
+				}
+			}
+			if (realpage <= cache_last) {
+				ret = nand_read_cache_op(chip,
+							 realpage == cache_last);
 				if (ret)
 					break;
 			}
@@ -2472,6 +2548,11 @@ read_retry:
 			chip->select_chip(mtd, chipnr);
 		}
 	}
+
+	/* Don't leave the chip in the middle of a READ CACHE sequence */
+	if (realpage < cache_last)
+		nand_read_cache_op(chip, true);
+
 	chip->select_chip(mtd, -1);
 
 	ops->retlen = ops->len - (size_t) readlen;
@@ -3945,6 +4026,9 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 		return 0;
 	}
 
+	if (le16_to_cpu(p->opt_cmd) & ONFI_OPT_CMD_READ_CACHE)
+		chip->options |= NAND_CACHEREAD;
+
 	sanitize_string(p->manufacturer, sizeof(p->manufacturer));
 	sanitize_string(p->model, sizeof(p->model));
 	if (!mtd->name)
@@ -21,6 +21,9 @@
 #include "sf_internal.h"
 
 #include <asm/getopt.h>
+#include <asm/unaligned.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
 #include <asm/spi.h>
 #include <asm/state.h>
 #include <dm/device-internal.h>
@@ -42,13 +45,16 @@ enum sandbox_sf_state {
 	SF_READ_STATUS, /* read the flash's status register */
 	SF_READ_STATUS1, /* read the flash's status register upper 8 bits*/
 	SF_WRITE_STATUS, /* write the flash's status register */
+	SF_READ_FSR, /* read the flash's flag status register */
+	SF_SFDP, /* read the flash's SFDP tables */
+	SF_WRITE_REG, /* write the flash's volatile configuration registers */
 };
 
 static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 {
 	static const char * const states[] = {
 		"CMD", "ID", "ADDR", "READ", "WRITE", "ERASE", "READ_STATUS",
-		"READ_STATUS1", "WRITE_STATUS",
+		"READ_STATUS1", "WRITE_STATUS", "READ_FSR", "SFDP", "WRITE_REG",
 	};
 	return states[state];
 }
@@ -59,11 +65,39 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 #define STAT_BP_SHIFT	2
 #define STAT_BP_MASK	(7 << STAT_BP_SHIFT)
 
-/* Assume all SPI flashes have 3 byte addresses since they do atm */
+/* Commands take 3 address bytes unless they are 4-byte or 8D-8D-8D ones */
 #define SF_ADDR_LEN	3
 
 #define IDCODE_LEN 3
 
+/*
+ * Volatile configuration registers of Micron octal flashes: CFR0V selects
+ * the protocol and CFR1V the number of read dummy cycles.
+ */
+#define SF_CFR_NUM		2
+#define SF_DUMMY_DEFAULT	16
+/* Dummy bytes before register data in 8D-8D-8D mode: 8 DTR cycles */
+#define SF_DTR_REG_DUMMY	16
+
+/*
+ * SFDP served by the emulator: the header, up to three parameter headers,
+ * then the Basic Flash Parameter Table (JESD216D), the 4-byte Address
+ * Instruction Table and, for octal DTR flashes, the xSPI Profile 1.0 table.
+ */
+#define SF_SFDP_SIGNATURE	0x50444653	/* "SFDP" */
+#define SF_SFDP_MAJOR		1
+#define SF_SFDP_MINOR		8
+#define SF_SFDP_BFPT_ID		0xff00
+#define SF_SFDP_4BAIT_ID	0xff84
+#define SF_SFDP_PROFILE1_ID	0xff05
+#define SF_SFDP_BFPT		0x30
+#define SF_SFDP_BFPT_LEN	20
+#define SF_SFDP_4BAIT		(SF_SFDP_BFPT + SF_SFDP_BFPT_LEN * 4)
+#define SF_SFDP_4BAIT_LEN	2
+#define SF_SFDP_PROFILE1	(SF_SFDP_4BAIT + SF_SFDP_4BAIT_LEN * 4)
+#define SF_SFDP_PROFILE1_LEN	5
+#define SF_SFDP_SIZE		(SF_SFDP_PROFILE1 + SF_SFDP_PROFILE1_LEN * 4)
+
 /* Used to quickly bulk erase backing store */
 static u8 sandbox_sf_0xff[0x1000];
 
@@ -88,8 +122,18 @@ struct sandbox_spi_flash {
 	uint off;
 	/* How many address bytes we've consumed */
 	uint addr_bytes, pad_addr_bytes;
+	/* Address bytes of the current command */
+	uint addr_len;
+	/* State to enter once the address and dummy bytes are consumed */
+	enum sandbox_sf_state next_state;
 	/* The current flash status (see STAT_XXX defines above) */
 	u16 status;
+	/* Volatile configuration registers */
+	u8 cfr[SF_CFR_NUM];
+	/* Commands are sent in 8D-8D-8D mode, with an op code extension */
+	bool octal_dtr;
+	/* SFDP tables */
+	u8 sfdp[SF_SFDP_SIZE];
 	/* Data describing the flash we're emulating */
 	const struct flash_info *data;
 	/* The file on disk to serv up data from */
@@ -116,6 +160,74 @@ void sandbox_sf_set_block_protect(struct udevice *dev, int bp_mask)
  * have come from the device tree) then this function gets the filename and
  * device type from there.
  */
+static void sandbox_sf_put_param_header(u8 *buf, u16 id, u8 len, u32 ptp)
+{
+	put_unaligned_le32((id & 0xff) | SF_SFDP_MAJOR << 16 | len << 24, buf);
+	put_unaligned_le32(ptp | (id >> 8) << 24, buf + 4);
+}
+
+/* Describe the emulated flash in SFDP, matching what the emulator supports */
+static void sandbox_sf_init_sfdp(struct sandbox_spi_flash *sbsf)
+{
+	const struct flash_info *data = sbsf->data;
+	u64 size = (u64)data->sector_size * data->n_sectors;
+	u32 bfpt[SF_SFDP_BFPT_LEN] = { 0 };
+	u32 bait[SF_SFDP_4BAIT_LEN] = { 0 };
+	u32 profile1[SF_SFDP_PROFILE1_LEN] = { 0 };
+	bool octal_dtr = data->flags & SPI_NOR_OCTAL_DTR_READ;
+	u8 *buf = sbsf->sfdp;
+	int i;
+
+	memset(buf, 0xff, sizeof(sbsf->sfdp));
+	put_unaligned_le32(SF_SFDP_SIGNATURE, buf);
+	put_unaligned_le32(SF_SFDP_MINOR | SF_SFDP_MAJOR << 8 |
+			   (octal_dtr ? 2 : 1) << 16, buf + 4);
+	sandbox_sf_put_param_header(buf + 8, SF_SFDP_BFPT_ID, SF_SFDP_BFPT_LEN,
+				    SF_SFDP_BFPT);
+	sandbox_sf_put_param_header(buf + 16, SF_SFDP_4BAIT_ID,
+				    SF_SFDP_4BAIT_LEN, SF_SFDP_4BAIT);
+	if (octal_dtr)
+		sandbox_sf_put_param_header(buf + 24, SF_SFDP_PROFILE1_ID,
+					    SF_SFDP_PROFILE1_LEN,
+					    SF_SFDP_PROFILE1);
+
+	/* 3- or 4-byte addresses, density, erase types, page size */
+	if (size > SZ_16M)
+		bfpt[0] |= BIT(17);
+	if (size <= SZ_256M)
+		bfpt[1] = size * 8 - 1;
+	else
+		bfpt[1] = BIT(31) | ilog2(size * 8);
+	if (data->flags & SECT_4K)
+		bfpt[7] = ilog2(SZ_4K) | SPINOR_OP_BE_4K << 8 |
+			  (ilog2(data->sector_size) | SPINOR_OP_SE << 8) << 16;
+	else
+		bfpt[7] = ilog2(data->sector_size) | SPINOR_OP_SE << 8;
+	bfpt[10] = ilog2(data->page_size) << 4;
+	/* No quad enable bit, op code extension repeats the op code */
+
+	/* 4-byte Read, Fast Read, 1-1-8 Read, Page Program and erases */
+	bait[0] = BIT(0) | BIT(1) | BIT(6) | BIT(9);
+	if (data->flags & SECT_4K)
+		bait[0] |= BIT(10);
+	if (data->flags & SPI_NOR_OCTAL_READ)
+		bait[0] |= BIT(20);
+
+	/*
+	 * 8D-8D-8D Fast Read op code, registers read with 8 dummy cycles and
+	 * 20 dummy cycles for reads at 200MHz
+	 */
+	profile1[0] = SPINOR_OP_MT_DTR_RD << 8 | BIT(28);
+	profile1[3] = 20 << 7;
+
+	for (i = 0; i < SF_SFDP_BFPT_LEN; i++)
+		put_unaligned_le32(bfpt[i], buf + SF_SFDP_BFPT + i * 4);
+	for (i = 0; i < SF_SFDP_4BAIT_LEN; i++)
+		put_unaligned_le32(bait[i], buf + SF_SFDP_4BAIT + i * 4);
+	for (i = 0; octal_dtr && i < SF_SFDP_PROFILE1_LEN; i++)
+		put_unaligned_le32(profile1[i], buf + SF_SFDP_PROFILE1 + i * 4);
+}
+
 static int sandbox_sf_probe(struct udevice *dev)
 {
 	/* spec = idcode:file */
@@ -181,6 +293,8 @@ static int sandbox_sf_probe(struct udevice *dev)
 
 	sbsf->data = data;
 	sbsf->cs = cs;
+	memset(sbsf->cfr, 0xff, sizeof(sbsf->cfr));
+	sandbox_sf_init_sfdp(sbsf);
 
 	return 0;
 
@@ -208,6 +322,7 @@ static void sandbox_sf_cs_activate(struct udevice *dev)
 	sbsf->off = 0;
 	sbsf->addr_bytes = 0;
 	sbsf->pad_addr_bytes = 0;
+	sbsf->addr_len = SF_ADDR_LEN;
 	sbsf->state = SF_CMD;
 	sbsf->cmd = SF_CMD;
 }
@@ -246,10 +361,45 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		sbsf->state = SF_ID;
 		sbsf->cmd = SF_ID;
 		break;
+	case SPINOR_OP_READ_FAST_4B:
+	case SPINOR_OP_READ_1_1_8_4B:
+		sbsf->addr_len = 4;
 	case SPINOR_OP_READ_FAST:
+	case SPINOR_OP_READ_1_1_8:
 		sbsf->pad_addr_bytes = 1;
+		sbsf->next_state = SF_READ;
+		sbsf->state = SF_ADDR;
+		break;
+	case SPINOR_OP_READ_4B:
+		sbsf->addr_len = 4;
 	case SPINOR_OP_READ:
+		sbsf->next_state = SF_READ;
+		sbsf->state = SF_ADDR;
+		break;
+	case SPINOR_OP_MT_DTR_RD:
+		if (!sbsf->octal_dtr) {
+			debug(" cmd %#x needs 8D-8D-8D mode\n", sbsf->cmd);
+			return -EIO;
+		}
+		/* two bytes per dummy cycle */
+		sbsf->pad_addr_bytes = 2 * (sbsf->cfr[1] == 0xff ?
+					    SF_DUMMY_DEFAULT : sbsf->cfr[1]);
+		sbsf->next_state = SF_READ;
+		sbsf->state = SF_ADDR;
+		break;
+	case SPINOR_OP_PP_4B:
+		sbsf->addr_len = 4;
 	case SPINOR_OP_PP:
+		sbsf->next_state = SF_WRITE;
+		sbsf->state = SF_ADDR;
+		break;
+	case SPINOR_OP_RDSFDP:
+		sbsf->pad_addr_bytes = 1;
+		sbsf->next_state = SF_SFDP;
+		sbsf->state = SF_ADDR;
+		break;
+	case SPINOR_OP_MT_WR_ANY_REG:
+		sbsf->next_state = SF_WRITE_REG;
 		sbsf->state = SF_ADDR;
 		break;
 	case SPINOR_OP_WRDI:
@@ -262,6 +412,9 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 	case SPINOR_OP_RDSR2:
 		sbsf->state = SF_READ_STATUS1;
 		break;
+	case SPINOR_OP_RDFSR:
+		sbsf->state = SF_READ_FSR;
+		break;
 	case SPINOR_OP_WREN:
 		debug(" write enabled\n");
 		sbsf->status |= STAT_WEL;
@@ -276,19 +429,41 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		if (sbsf->cmd == SPINOR_OP_CHIP_ERASE) {
 			sbsf->erase_size = sbsf->data->sector_size *
 				sbsf->data->n_sectors;
-		} else if (sbsf->cmd == SPINOR_OP_BE_4K && (flags & SECT_4K)) {
+		} else if ((sbsf->cmd == SPINOR_OP_BE_4K ||
+			    sbsf->cmd == SPINOR_OP_BE_4K_4B) &&
+			   (flags & SECT_4K)) {
 			sbsf->erase_size = 4 << 10;
-		} else if (sbsf->cmd == SPINOR_OP_SE && !(flags & SECT_4K)) {
-			sbsf->erase_size = 64 << 10;
+		} else if (sbsf->cmd == SPINOR_OP_SE ||
+			   sbsf->cmd == SPINOR_OP_SE_4B) {
+			sbsf->erase_size = sbsf->data->sector_size;
 		} else {
 			debug(" cmd unknown: %#x\n", sbsf->cmd);
 			return -EIO;
 		}
+		if (sbsf->cmd == SPINOR_OP_BE_4K_4B ||
+		    sbsf->cmd == SPINOR_OP_SE_4B)
+			sbsf->addr_len = 4;
+		sbsf->next_state = SF_ERASE;
 		sbsf->state = SF_ADDR;
 		break;
 	}
 	}
 
+	if (sbsf->octal_dtr) {
+		/* Every address is 4 bytes long in 8D-8D-8D mode */
+		if (sbsf->state == SF_ADDR)
+			sbsf->addr_len = 4;
+
+		/* and registers are read after some dummy cycles */
+		if (sbsf->state == SF_ID || sbsf->state == SF_READ_STATUS ||
+		    sbsf->state == SF_READ_FSR) {
+			sbsf->next_state = sbsf->state;
+			sbsf->state = SF_ADDR;
+			sbsf->addr_len = 0;
+			sbsf->pad_addr_bytes = SF_DTR_REG_DUMMY;
+		}
+	}
+
 	if (oldstate != sbsf->state)
 		log_content(" cmd: transition to %s state\n",
 			    sandbox_sf_state_name(sbsf->state));
@@ -312,6 +487,34 @@ int sandbox_erase_part(struct sandbox_spi_flash *sbsf, int size)
 	return 0;
 }
 
+/*
+ * Programming can only clear bits, which matters when DTR writes pad an odd
+ * start or length with 0xff
+ */
+static int sandbox_sf_program(struct sandbox_spi_flash *sbsf, const u8 *buf,
+			      int len)
+{
+	u8 old[256];
+	int done, todo, ret, i;
+
+	for (done = 0; done < len; done += todo) {
+		todo = min(len - done, (int)sizeof(old));
+		ret = os_read(sbsf->fd, old, todo);
+		if (ret < 0)
+			return ret;
+		memset(old + ret, 0xff, todo - ret);
+		for (i = 0; i < todo; i++)
+			old[i] &= buf[done + i];
+		if (os_lseek(sbsf->fd, -ret, OS_SEEK_CUR) < 0)
+			return -EIO;
+		ret = os_write(sbsf->fd, old, todo);
+		if (ret != todo)
+			return ret < 0 ? ret : -EIO;
+	}
+
+	return len;
+}
+
 static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			   const void *rxp, void *txp, unsigned long flags)
 {
@@ -334,6 +537,17 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 		if (ret)
 			return ret;
 		++pos;
+
+		/* In 8D-8D-8D mode the op code is repeated */
+		if (sbsf->octal_dtr) {
+			if (pos >= bytes || rx[pos] != rx[0]) {
+				debug(" bad op code extension\n");
+				return -EIO;
+			}
+			if (tx)
+				sandbox_spi_tristate(&tx[pos], 1);
+			++pos;
+		}
 	}
 
 	/* Process the remaining data */
@@ -360,7 +574,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			log_content(" addr: bytes:%u rx:%02x ",
 				    sbsf->addr_bytes, rx[pos]);
 
-			if (sbsf->addr_bytes++ < SF_ADDR_LEN)
+			if (sbsf->addr_bytes++ < sbsf->addr_len)
 				sbsf->off = (sbsf->off << 8) | rx[pos];
 			log_content("addr:%06x\n", sbsf->off);
 
@@ -370,29 +584,21 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 
 			/* See if we're done processing */
 			if (sbsf->addr_bytes <
-					SF_ADDR_LEN + sbsf->pad_addr_bytes)
+					sbsf->addr_len + sbsf->pad_addr_bytes)
 				break;
 
 			/* Next state! */
-			if (os_lseek(sbsf->fd, sbsf->off, OS_SEEK_SET) < 0) {
+			sbsf->state = sbsf->next_state;
+			if ((sbsf->state == SF_READ || sbsf->state == SF_WRITE ||
+			     sbsf->state == SF_ERASE) &&
+			    os_lseek(sbsf->fd, sbsf->off, OS_SEEK_SET) < 0) {
 				puts("sandbox_sf: os_lseek() failed");
 				return -EIO;
 			}
-			switch (sbsf->cmd) {
-			case SPINOR_OP_READ_FAST:
-			case SPINOR_OP_READ:
-				sbsf->state = SF_READ;
-				break;
-			case SPINOR_OP_PP:
-				sbsf->state = SF_WRITE;
-				break;
-			default:
-				/* assume erase state ... */
-				sbsf->state = SF_ERASE;
-				goto case_sf_erase;
-			}
 			log_content(" cmd: transition to %s state\n",
 				    sandbox_sf_state_name(sbsf->state));
+			if (sbsf->state == SF_ERASE)
+				goto case_sf_erase;
 			break;
 		case SF_READ:
 			/*
@@ -408,7 +614,9 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 				puts("sandbox_sf: os_read() failed\n");
 				return -EIO;
 			}
-			pos += ret;
+			/* the backing file may be smaller than the flash */
+			memset(tx + pos + ret, 0xff, cnt - ret);
+			pos += cnt;
 			break;
 		case SF_READ_STATUS:
 			log_content(" read status: %#x\n", sbsf->status);
@@ -422,6 +630,36 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			memset(tx + pos, sbsf->status >> 8, cnt);
 			pos += cnt;
 			break;
+		case SF_READ_FSR:
+			log_content(" read flag status: ready\n");
+			cnt = bytes - pos;
+			memset(tx + pos, FSR_READY, cnt);
+			pos += cnt;
+			break;
+		case SF_SFDP:
+			cnt = bytes - pos;
+			log_content(" tx: sfdp(%u) at %#x\n", cnt, sbsf->off);
+			for (; pos < bytes; pos++, sbsf->off++)
+				tx[pos] = sbsf->off < sizeof(sbsf->sfdp) ?
+					  sbsf->sfdp[sbsf->off] : 0xff;
+			break;
+		case SF_WRITE_REG:
+			if (!(sbsf->status & STAT_WEL)) {
+				puts("sandbox_sf: write enable not set before register write\n");
+				goto done;
+			}
+
+			cnt = bytes - pos;
+			log_content(" rx: write register %#x (%u)\n",
+				    sbsf->off, cnt);
+			if (tx)
+				sandbox_spi_tristate(&tx[pos], cnt);
+			for (; pos < bytes; pos++, sbsf->off++)
+				if (sbsf->off < SF_CFR_NUM)
+					sbsf->cfr[sbsf->off] = rx[pos];
+			sbsf->octal_dtr = sbsf->cfr[0] == SPINOR_MT_OCT_DTR;
+			sbsf->status &= ~STAT_WEL;
+			break;
 		case SF_WRITE_STATUS:
 			log_content(" write status: %#x (ignored)\n", rx[pos]);
 			pos = bytes;
@@ -442,7 +680,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			log_content(" rx: write(%u)\n", cnt);
 			if (tx)
 				sandbox_spi_tristate(&tx[pos], cnt);
-			ret = os_write(sbsf->fd, rx + pos, cnt);
+			ret = sandbox_sf_program(sbsf, rx + pos, cnt);
 			if (ret < 0) {
 				puts("sandbox_spi: os_write() failed\n");
 				return -EIO;
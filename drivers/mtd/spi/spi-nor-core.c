@@ -40,6 +40,66 @@
 
 #define DEFAULT_READY_WAIT_JIFFIES		(40UL * HZ)
 
+static u8 spi_nor_get_cmd_ext(const struct spi_nor *nor,
+			      const struct spi_mem_op *op)
+{
+	switch (nor->cmd_ext_type) {
+	case SPI_NOR_EXT_INVERT:
+		return ~op->cmd.opcode;
+
+	case SPI_NOR_EXT_REPEAT:
+		return op->cmd.opcode;
+
+	default:
+		dev_dbg(nor->dev, "Unknown command extension type\n");
+		return 0;
+	}
+}
+
+/**
+ * spi_nor_setup_op() - Set up common properties of a spi-mem op.
+ * @nor:		pointer to a 'struct spi_nor'
+ * @op:			pointer to the 'struct spi_mem_op' whose properties
+ *			need to be initialized.
+ * @proto:		the protocol from which the properties need to be set.
+ *
+ * The dummy phase must be given in bytes as for a single data rate op on
+ * the address lines; in DTR mode it is doubled here, and the opcode gets its
+ * extension byte.
+ */
+static void spi_nor_setup_op(const struct spi_nor *nor,
+			     struct spi_mem_op *op,
+			     const enum spi_nor_protocol proto)
+{
+	u8 ext;
+
+	op->cmd.buswidth = spi_nor_get_protocol_inst_nbits(proto);
+
+	if (op->addr.nbytes)
+		op->addr.buswidth = spi_nor_get_protocol_addr_nbits(proto);
+
+	if (op->dummy.nbytes)
+		op->dummy.buswidth = spi_nor_get_protocol_addr_nbits(proto);
+
+	if (op->data.dir != SPI_MEM_NO_DATA)
+		op->data.buswidth = spi_nor_get_protocol_data_nbits(proto);
+
+	if (spi_nor_protocol_is_dtr(proto)) {
+		/* Mixed DTR modes are not supported, all phases are DTR */
+		op->cmd.dtr = 1;
+		op->addr.dtr = 1;
+		op->dummy.dtr = 1;
+		op->data.dtr = 1;
+
+		/* 2 bytes per clock cycle in DTR mode. */
+		op->dummy.nbytes *= 2;
+
+		ext = spi_nor_get_cmd_ext(nor, op);
+		op->cmd.opcode = (op->cmd.opcode << 8) | ext;
+		op->cmd.nbytes = 2;
+	}
+}
+
 static int spi_nor_read_write_reg(struct spi_nor *nor, struct spi_mem_op
 		*op, void *buf)
 {
@@ -56,9 +116,29 @@ static int spi_nor_read_reg(struct spi_nor *nor, u8 code, u8 *val, int len)
 					  SPI_MEM_OP_NO_ADDR,
 					  SPI_MEM_OP_NO_DUMMY,
 					  SPI_MEM_OP_DATA_IN(len, NULL, 1));
+	u8 buf[SPI_NOR_MAX_ID_LEN];
 	int ret;
 
-	ret = spi_nor_read_write_reg(nor, &op, val);
+	if (nor->reg_proto == SNOR_PROTO_8_8_8_DTR) {
+		/*
+		 * Register reads take the address and dummy cycles the flash
+		 * asks for in 8D-8D-8D mode, and a byte takes half a cycle:
+		 * read an even number of bytes and drop the extra one.
+		 */
+		if (len > sizeof(buf))
+			return -EINVAL;
+		op.addr.nbytes = nor->rdsr_addr_nbytes;
+		op.dummy.nbytes = nor->rdsr_dummy;
+		op.data.nbytes = round_up(len, 2);
+	}
+	spi_nor_setup_op(nor, &op, nor->reg_proto);
+
+	if (op.data.nbytes != len) {
+		ret = spi_nor_read_write_reg(nor, &op, buf);
+		memcpy(val, buf, len);
+	} else {
+		ret = spi_nor_read_write_reg(nor, &op, val);
+	}
 	if (ret < 0)
 		dev_dbg(nor->dev, "error %d reading %x\n", ret, code);
 
@@ -72,6 +152,8 @@ static int spi_nor_write_reg(struct spi_nor *nor, u8 opcode, u8 *buf, int len)
 					  SPI_MEM_OP_NO_DUMMY,
 					  SPI_MEM_OP_DATA_OUT(len, NULL, 1));
 
+	spi_nor_setup_op(nor, &op, nor->reg_proto);
+
 	return spi_nor_read_write_reg(nor, &op, buf);
 }
 
@@ -86,14 +168,14 @@ static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
 	size_t remaining = len;
 	int ret;
 
-	/* get transfer protocols. */
-	op.cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->read_proto);
-	op.addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->read_proto);
-	op.dummy.buswidth = op.addr.buswidth;
-	op.data.buswidth = spi_nor_get_protocol_data_nbits(nor->read_proto);
+	/* the controller may return less than asked, spi_nor_read() loops */
+	if (nor->dirmap.rdesc)
+		return spi_mem_dirmap_read(nor->dirmap.rdesc, from, len, buf);
 
 	/* convert the dummy cycles to the number of bytes */
-	op.dummy.nbytes = (nor->read_dummy * op.dummy.buswidth) / 8;
+	op.dummy.nbytes = (nor->read_dummy *
+			   spi_nor_get_protocol_addr_nbits(nor->read_proto)) / 8;
+	spi_nor_setup_op(nor, &op, nor->read_proto);
 
 	while (remaining) {
 		op.data.nbytes = remaining < UINT_MAX ? remaining : UINT_MAX;
@@ -121,20 +203,43 @@ static ssize_t spi_nor_write_data(struct spi_nor *nor, loff_t to, size_t len,
 				   SPI_MEM_OP_ADDR(nor->addr_width, to, 1),
 				   SPI_MEM_OP_NO_DUMMY,
 				   SPI_MEM_OP_DATA_OUT(len, buf, 1));
+	u8 pad[2];
 	int ret;
 
-	/* get transfer protocols. */
-	op.cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->write_proto);
-	op.addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->write_proto);
-	op.data.buswidth = spi_nor_get_protocol_data_nbits(nor->write_proto);
-
 	if (nor->program_opcode == SPINOR_OP_AAI_WP && nor->sst_write_second)
 		op.addr.nbytes = 0;
 
+	if (spi_nor_protocol_is_dtr(nor->write_proto)) {
+		/*
+		 * Only whole 2-byte words can be programmed in DTR mode. An
+		 * odd head or tail byte is padded with 0xff, which leaves the
+		 * neighbouring byte untouched, and written on its own.
+		 */
+		if ((to & 1) || len == 1) {
+			pad[0] = (to & 1) ? 0xff : buf[0];
+			pad[1] = (to & 1) ? buf[0] : 0xff;
+			op.addr.val = to & ~1;
+			op.data.buf.out = pad;
+			op.data.nbytes = 2;
+		} else {
+			op.data.nbytes = len & ~1;
+		}
+	}
+	spi_nor_setup_op(nor, &op, nor->write_proto);
+
 	ret = spi_mem_adjust_op_size(nor->spi, &op);
 	if (ret)
 		return ret;
+
+	if (op.data.buf.out == pad) {
+		ret = spi_mem_exec_op(nor->spi, &op);
+
+		return ret ? ret : 1;
+	}
+
 	op.data.nbytes = len < op.data.nbytes ? len : op.data.nbytes;
+	if (op.data.dtr)
+		op.data.nbytes &= ~1;
 
 	ret = spi_mem_exec_op(nor->spi, &op);
 	if (ret)
@@ -536,6 +641,8 @@ static int spi_nor_erase_sector(struct spi_nor *nor, u32 addr)
 	if (nor->erase)
 		return nor->erase(nor, addr);
 
+	spi_nor_setup_op(nor, &op, nor->reg_proto);
+
 	/*
 	 * Default implementation, if driver doesn't have a specialized HW
 	 * control
@@ -1485,6 +1592,7 @@ enum spi_nor_read_command_index {
 	SNOR_CMD_READ_1_8_8,
 	SNOR_CMD_READ_8_8_8,
 	SNOR_CMD_READ_1_8_8_DTR,
+	SNOR_CMD_READ_8_8_8_DTR,
 
 	SNOR_CMD_READ_MAX
 };
@@ -1501,6 +1609,7 @@ enum spi_nor_pp_command_index {
 	SNOR_CMD_PP_1_1_8,
 	SNOR_CMD_PP_1_8_8,
 	SNOR_CMD_PP_8_8_8,
+	SNOR_CMD_PP_8_8_8_DTR,
 
 	SNOR_CMD_PP_MAX
 };
@@ -1514,6 +1623,12 @@ struct spi_nor_flash_parameter {
 	struct spi_nor_pp_command	page_programs[SNOR_CMD_PP_MAX];
 
 	int (*quad_enable)(struct spi_nor *nor);
+	int (*octal_dtr_enable)(struct spi_nor *nor, bool enable);
+
+	/* Command extension and register read timings in 8D-8D-8D mode */
+	enum spi_nor_cmd_ext		cmd_ext_type;
+	u8				rdsr_dummy;
+	u8				rdsr_addr_nbytes;
 };
 
 static void
@@ -1609,7 +1724,9 @@ struct sfdp_parameter_header {
 	 ((p)->parameter_table_pointer[0] <<  0))
 
 #define SFDP_BFPT_ID		0xff00	/* Basic Flash Parameter Table */
+#define SFDP_PROFILE1_ID	0xff05	/* xSPI Profile 1.0 Table */
 #define SFDP_SECTOR_MAP_ID	0xff81	/* Sector Map Table */
+#define SFDP_4BAIT_ID		0xff84	/* 4-byte Address Instruction Table */
 #define SFDP_SST_ID		0x01bf	/* Manufacturer specific Table */
 
 #define SFDP_SIGNATURE		0x50444653U
@@ -1632,11 +1749,14 @@ struct sfdp_header {
 /* Basic Flash Parameter Table */
 
 /*
- * JESD216 rev B defines a Basic Flash Parameter Table of 16 DWORDs.
+ * JESD216 rev D defines a Basic Flash Parameter Table of 20 DWORDs.
  * They are indexed from 1 but C arrays are indexed from 0.
  */
 #define BFPT_DWORD(i)		((i) - 1)
-#define BFPT_DWORD_MAX		16
+#define BFPT_DWORD_MAX		20
+
+/* JESD216 rev A and B defined 16 DWORDs. */
+#define BFPT_DWORD_MAX_JESD216B			16
 
 /* The first version of JESB216 defined only 9 DWORDs. */
 #define BFPT_DWORD_MAX_JESD216			9
@@ -1701,6 +1821,13 @@ struct sfdp_header {
 #define BFPT_DWORD15_QER_SR2_BIT1_NO_RD		(0x4UL << 20)
 #define BFPT_DWORD15_QER_SR2_BIT1		(0x5UL << 20) /* Spansion */
 
+/* 18th DWORD: opcode extension used by 8D-8D-8D commands. */
+#define BFPT_DWORD18_CMD_EXT_MASK		GENMASK(30, 29)
+#define BFPT_DWORD18_CMD_EXT_REP		(0x0UL << 29) /* Repeat */
+#define BFPT_DWORD18_CMD_EXT_INV		(0x1UL << 29) /* Invert */
+#define BFPT_DWORD18_CMD_EXT_RES		(0x2UL << 29) /* Reserved */
+#define BFPT_DWORD18_CMD_EXT_16B		(0x3UL << 29) /* 16-bit opcode */
+
 struct sfdp_bfpt {
 	u32	dwords[BFPT_DWORD_MAX];
 };
@@ -1953,7 +2080,7 @@ static int spi_nor_parse_bfpt(struct spi_nor *nor,
 	}
 
 	/* Stop here if not JESD216 rev A or later. */
-	if (bfpt_header->length < BFPT_DWORD_MAX)
+	if (bfpt_header->length < BFPT_DWORD_MAX_JESD216B)
 		return 0;
 
 	/* Page size: this field specifies 'N' so the page size = 2^N bytes. */
@@ -1987,6 +2114,247 @@ static int spi_nor_parse_bfpt(struct spi_nor *nor,
 		return -EINVAL;
 	}
 
+	/* Stop here if not JESD216 rev C or later. */
+	if (bfpt_header->length < BFPT_DWORD_MAX)
+		return 0;
+
+	/* 8D-8D-8D command extension. */
+	switch (bfpt.dwords[BFPT_DWORD(18)] & BFPT_DWORD18_CMD_EXT_MASK) {
+	case BFPT_DWORD18_CMD_EXT_REP:
+		params->cmd_ext_type = SPI_NOR_EXT_REPEAT;
+		break;
+
+	case BFPT_DWORD18_CMD_EXT_INV:
+		params->cmd_ext_type = SPI_NOR_EXT_INVERT;
+		break;
+
+	case BFPT_DWORD18_CMD_EXT_RES:
+		return -EINVAL;
+
+	case BFPT_DWORD18_CMD_EXT_16B:
+		dev_dbg(nor->dev, "16-bit opcodes not supported\n");
+		return -ENOTSUPP;
+	}
+
+	return 0;
+}
+
+#ifndef CONFIG_SPI_FLASH_BAR
+/* 4-byte Address Instruction Table */
+
+#define SFDP_4BAIT_DWORD_MAX	2
+
+struct sfdp_4bait {
+	/* The hardware capability. */
+	u32		hwcaps;
+
+	/*
+	 * The <supported_bit> bit in DWORD1 of the 4BAIT tells us whether
+	 * the associated 4-byte address op code is supported.
+	 */
+	u32		supported_bit;
+};
+
+/**
+ * spi_nor_parse_4bait() - parse the 4-Byte Address Instruction Table
+ * @nor:		pointer to a 'struct spi_nor'.
+ * @param_header:	pointer to the 'struct sfdp_parameter_header' describing
+ *			the 4-Byte Address Instruction Table length and version.
+ * @params:		pointer to the 'struct spi_nor_flash_parameter' to be
+ *			filled.
+ *
+ * Switches to the dedicated 4-byte address op codes when the table says each
+ * of the read, page program and erase operations has one, so that no global
+ * 4-byte address mode needs to be entered (and left again before a reset).
+ *
+ * Return: 0 on success, -errno otherwise.
+ */
+static int spi_nor_parse_4bait(struct spi_nor *nor,
+			       const struct sfdp_parameter_header *param_header,
+			       struct spi_nor_flash_parameter *params)
+{
+	static const struct sfdp_4bait reads[] = {
+		{ SNOR_HWCAPS_READ,		BIT(0) },
+		{ SNOR_HWCAPS_READ_FAST,	BIT(1) },
+		{ SNOR_HWCAPS_READ_1_1_2,	BIT(2) },
+		{ SNOR_HWCAPS_READ_1_2_2,	BIT(3) },
+		{ SNOR_HWCAPS_READ_1_1_4,	BIT(4) },
+		{ SNOR_HWCAPS_READ_1_4_4,	BIT(5) },
+		{ SNOR_HWCAPS_READ_1_1_1_DTR,	BIT(13) },
+		{ SNOR_HWCAPS_READ_1_2_2_DTR,	BIT(14) },
+		{ SNOR_HWCAPS_READ_1_4_4_DTR,	BIT(15) },
+		{ SNOR_HWCAPS_READ_1_1_8,	BIT(20) },
+		{ SNOR_HWCAPS_READ_1_8_8,	BIT(21) },
+	};
+	static const struct sfdp_4bait programs[] = {
+		{ SNOR_HWCAPS_PP,		BIT(6) },
+		{ SNOR_HWCAPS_PP_1_1_4,		BIT(7) },
+		{ SNOR_HWCAPS_PP_1_4_4,		BIT(8) },
+		{ SNOR_HWCAPS_PP_1_1_8,		BIT(22) },
+		{ SNOR_HWCAPS_PP_1_8_8,		BIT(23) },
+	};
+	/* Erase types 1 to 4 */
+	const u32 erase_mask = GENMASK(12, 9);
+	u32 dwords[SFDP_4BAIT_DWORD_MAX];
+	u32 addr, discard_hwcaps, read_hwcaps, pp_hwcaps;
+	int i, ret;
+
+	if (param_header->major != SFDP_JESD216_MAJOR ||
+	    param_header->length < SFDP_4BAIT_DWORD_MAX)
+		return -EINVAL;
+
+	addr = SFDP_PARAM_HEADER_PTP(param_header);
+	ret = spi_nor_read_sfdp(nor, addr, sizeof(dwords), dwords);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < SFDP_4BAIT_DWORD_MAX; i++)
+		dwords[i] = le32_to_cpu(dwords[i]);
+
+	/*
+	 * Compute the subset of (Fast) Read and Page Program commands for
+	 * which the 4-byte version is supported.
+	 */
+	discard_hwcaps = 0;
+	read_hwcaps = 0;
+	for (i = 0; i < ARRAY_SIZE(reads); i++) {
+		discard_hwcaps |= reads[i].hwcaps;
+		if ((params->hwcaps.mask & reads[i].hwcaps) &&
+		    (dwords[0] & reads[i].supported_bit))
+			read_hwcaps |= reads[i].hwcaps;
+	}
+
+	pp_hwcaps = 0;
+	for (i = 0; i < ARRAY_SIZE(programs); i++) {
+		discard_hwcaps |= programs[i].hwcaps;
+		if ((params->hwcaps.mask & programs[i].hwcaps) &&
+		    (dwords[0] & programs[i].supported_bit))
+			pp_hwcaps |= programs[i].hwcaps;
+	}
+
+	/*
+	 * We need at least one 4-byte op code per read, program and erase
+	 * operation; the .read(), .write() and .erase() hooks share the
+	 * nor->addr_width value. The erase op code must have been set from
+	 * the BFPT already to be converted here. 8D-8D-8D commands always
+	 * take a 4-byte address and are kept as they are.
+	 */
+	if (!read_hwcaps || !pp_hwcaps || !(dwords[0] & erase_mask) ||
+	    !nor->mtd.erasesize)
+		return 0;
+
+	/*
+	 * Discard all operations from the 4-byte instruction set which are
+	 * not supported by this memory.
+	 */
+	params->hwcaps.mask &= ~discard_hwcaps;
+	params->hwcaps.mask |= (read_hwcaps | pp_hwcaps);
+
+	/* Use the 4-byte address instruction set. */
+	for (i = 0; i < SNOR_CMD_READ_MAX; i++) {
+		struct spi_nor_read_command *read = &params->reads[i];
+
+		read->opcode = spi_nor_convert_3to4_read(read->opcode);
+	}
+
+	for (i = 0; i < SNOR_CMD_PP_MAX; i++) {
+		struct spi_nor_pp_command *pp = &params->page_programs[i];
+
+		pp->opcode = spi_nor_convert_3to4_program(pp->opcode);
+	}
+
+	nor->erase_opcode = spi_nor_convert_3to4_erase(nor->erase_opcode);
+	nor->addr_width = 4;
+	nor->flags |= SNOR_F_4B_OPCODES;
+
+	return 0;
+}
+#endif /* !CONFIG_SPI_FLASH_BAR */
+
+/* xSPI Profile 1.0 table (from JESD216D.01) */
+#define PROFILE1_DWORD1_RD_FAST_CMD		GENMASK(15, 8)
+#define PROFILE1_DWORD1_RDSR_DUMMY		BIT(28)
+#define PROFILE1_DWORD1_RDSR_ADDR_BYTES		BIT(29)
+#define PROFILE1_DWORD4_DUMMY_200MHZ		GENMASK(11, 7)
+#define PROFILE1_DWORD5_DUMMY_166MHZ		GENMASK(31, 27)
+#define PROFILE1_DWORD5_DUMMY_133MHZ		GENMASK(21, 17)
+#define PROFILE1_DWORD5_DUMMY_100MHZ		GENMASK(11, 7)
+#define PROFILE1_DUMMY_DEFAULT			20
+#define PROFILE1_DWORD_MAX			5
+
+/**
+ * spi_nor_parse_profile1() - parse the xSPI Profile 1.0 table
+ * @nor:		pointer to a 'struct spi_nor'
+ * @param_header:	pointer to the 'struct sfdp_parameter_header' describing
+ *			the Profile 1.0 Table length and version.
+ * @params:		pointer to the 'struct spi_nor_flash_parameter' to be
+ *			filled.
+ *
+ * The table gives the 8D-8D-8D Fast Read op code, the dummy cycles it needs
+ * at each supported frequency, and how registers are read in that mode.
+ *
+ * Return: 0 on success, -errno otherwise.
+ */
+static int spi_nor_parse_profile1(struct spi_nor *nor,
+				  const struct sfdp_parameter_header *param_header,
+				  struct spi_nor_flash_parameter *params)
+{
+	u32 dwords[PROFILE1_DWORD_MAX];
+	u8 opcode, dummy;
+	u32 addr;
+	int i, ret;
+
+	if (param_header->length < PROFILE1_DWORD_MAX)
+		return -EINVAL;
+
+	addr = SFDP_PARAM_HEADER_PTP(param_header);
+	ret = spi_nor_read_sfdp(nor, addr, sizeof(dwords), dwords);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < PROFILE1_DWORD_MAX; i++)
+		dwords[i] = le32_to_cpu(dwords[i]);
+
+	/* Get 8D-8D-8D fast read opcode and dummy cycles. */
+	opcode = (dwords[0] & PROFILE1_DWORD1_RD_FAST_CMD) >> 8;
+
+	/* Set the Read Status Register dummy cycles and dummy address bytes. */
+	params->rdsr_dummy = dwords[0] & PROFILE1_DWORD1_RDSR_DUMMY ? 8 : 4;
+	params->rdsr_addr_nbytes =
+		dwords[0] & PROFILE1_DWORD1_RDSR_ADDR_BYTES ? 4 : 0;
+
+	/*
+	 * We don't know what speed the controller is running at. Find the
+	 * dummy cycles for the fastest frequency the flash can run at to be
+	 * sure we are never short of dummy cycles. A value of 0 means the
+	 * frequency is not supported.
+	 */
+	dummy = (dwords[3] & PROFILE1_DWORD4_DUMMY_200MHZ) >> 7;
+	if (!dummy)
+		dummy = (dwords[4] & PROFILE1_DWORD5_DUMMY_166MHZ) >> 27;
+	if (!dummy)
+		dummy = (dwords[4] & PROFILE1_DWORD5_DUMMY_133MHZ) >> 17;
+	if (!dummy)
+		dummy = (dwords[4] & PROFILE1_DWORD5_DUMMY_100MHZ) >> 7;
+	if (!dummy)
+		dummy = PROFILE1_DUMMY_DEFAULT;
+
+	/* Round up to an even value to avoid tripping controllers up. */
+	dummy = round_up(dummy, 2);
+
+	/* Update the fast read settings. */
+	params->hwcaps.mask |= SNOR_HWCAPS_READ_8_8_8_DTR;
+	spi_nor_set_read_settings(&params->reads[SNOR_CMD_READ_8_8_8_DTR],
+				  0, dummy, opcode, SNOR_PROTO_8_8_8_DTR);
+
+	/*
+	 * Page Program is always available in 8D-8D-8D mode and, as addresses
+	 * are 4 bytes long there, uses the 4-byte op code.
+	 */
+	params->hwcaps.mask |= SNOR_HWCAPS_PP_8_8_8_DTR;
+	spi_nor_set_pp_settings(&params->page_programs[SNOR_CMD_PP_8_8_8_DTR],
+				SPINOR_OP_PP_4B, SNOR_PROTO_8_8_8_DTR);
+
 	return 0;
 }
 
@@ -2120,6 +2488,16 @@ static int spi_nor_parse_sfdp(struct spi_nor *nor,
 			err = spi_nor_parse_microchip_sfdp(nor, param_header);
 			break;
 
+#ifndef CONFIG_SPI_FLASH_BAR
+		case SFDP_4BAIT_ID:
+			err = spi_nor_parse_4bait(nor, param_header, params);
+			break;
+#endif
+
+		case SFDP_PROFILE1_ID:
+			err = spi_nor_parse_profile1(nor, param_header, params);
+			break;
+
 		default:
 			break;
 		}
@@ -2150,6 +2528,86 @@ static int spi_nor_parse_sfdp(struct spi_nor *nor,
 }
 #endif /* SPI_FLASH_SFDP_SUPPORT */
 
+#ifdef CONFIG_SPI_FLASH_STMICRO
+/**
+ * spi_nor_micron_octal_dtr_enable() - switch a Micron flash to or from
+ *				       8D-8D-8D mode.
+ * @nor:		pointer to a 'struct spi_nor'
+ * @enable:		true to enter 8D-8D-8D mode, false to go back to
+ *			1S-1S-1S mode.
+ *
+ * The read dummy cycles are programmed before entering 8D-8D-8D mode, then
+ * the mode is changed through the volatile configuration register and the
+ * ID is read back in the new mode to check the switch worked. On success
+ * nor->reg_proto follows the new mode.
+ *
+ * Return: 0 on success, -errno otherwise.
+ */
+static int spi_nor_micron_octal_dtr_enable(struct spi_nor *nor, bool enable)
+{
+	enum spi_nor_protocol reg_proto = nor->reg_proto;
+	u8 buf[SPI_NOR_MAX_ID_LEN];
+	struct spi_mem_op op;
+	int ret;
+
+	if (enable) {
+		buf[0] = nor->read_dummy;
+		op = (struct spi_mem_op)
+			SPI_MEM_OP(SPI_MEM_OP_CMD(SPINOR_OP_MT_WR_ANY_REG, 1),
+				   SPI_MEM_OP_ADDR(3, SPINOR_REG_MT_CFR1V, 1),
+				   SPI_MEM_OP_NO_DUMMY,
+				   SPI_MEM_OP_DATA_OUT(1, buf, 1));
+
+		write_enable(nor);
+		ret = spi_mem_exec_op(nor->spi, &op);
+		if (ret)
+			return ret;
+
+		ret = spi_nor_wait_till_ready(nor);
+		if (ret)
+			return ret;
+
+		buf[0] = SPINOR_MT_OCT_DTR;
+		op = (struct spi_mem_op)
+			SPI_MEM_OP(SPI_MEM_OP_CMD(SPINOR_OP_MT_WR_ANY_REG, 1),
+				   SPI_MEM_OP_ADDR(3, SPINOR_REG_MT_CFR0V, 1),
+				   SPI_MEM_OP_NO_DUMMY,
+				   SPI_MEM_OP_DATA_OUT(1, buf, 1));
+	} else {
+		/*
+		 * DTR data comes in pairs of bytes: the second one lands in
+		 * CFR1V and restores the default dummy cycles.
+		 */
+		buf[0] = SPINOR_MT_EXSPI;
+		buf[1] = SPINOR_MT_EXSPI;
+		op = (struct spi_mem_op)
+			SPI_MEM_OP(SPI_MEM_OP_CMD(SPINOR_OP_MT_WR_ANY_REG, 1),
+				   SPI_MEM_OP_ADDR(4, SPINOR_REG_MT_CFR0V, 1),
+				   SPI_MEM_OP_NO_DUMMY,
+				   SPI_MEM_OP_DATA_OUT(2, buf, 1));
+		spi_nor_setup_op(nor, &op, SNOR_PROTO_8_8_8_DTR);
+	}
+
+	write_enable(nor);
+	ret = spi_mem_exec_op(nor->spi, &op);
+	if (ret)
+		return ret;
+
+	/* Read the ID back in the new mode */
+	nor->reg_proto = enable ? SNOR_PROTO_8_8_8_DTR : SNOR_PROTO_1_1_1;
+	ret = nor->read_reg(nor, SPINOR_OP_RDID, buf, nor->info->id_len);
+	if (!ret && memcmp(buf, nor->info->id, nor->info->id_len))
+		ret = -EINVAL;
+	if (ret) {
+		dev_dbg(nor->dev, "failed to switch %s 8D-8D-8D mode\n",
+			enable ? "to" : "from");
+		nor->reg_proto = reg_proto;
+	}
+
+	return ret;
+}
+#endif
+
 static int spi_nor_init_params(struct spi_nor *nor,
 			       const struct flash_info *info,
 			       struct spi_nor_flash_parameter *params)
@@ -2195,6 +2653,20 @@ static int spi_nor_init_params(struct spi_nor *nor,
 					  SNOR_PROTO_1_1_8);
 	}
 
+	/*
+	 * Only Micron parts carry the octal DTR flags so far; the xSPI
+	 * Profile 1.0 table overrides these settings when it is present.
+	 */
+	if (info->flags & SPI_NOR_OCTAL_DTR_READ) {
+		params->hwcaps.mask |= SNOR_HWCAPS_READ_8_8_8_DTR;
+		spi_nor_set_read_settings(&params->reads[SNOR_CMD_READ_8_8_8_DTR],
+					  0, 20, SPINOR_OP_MT_DTR_RD,
+					  SNOR_PROTO_8_8_8_DTR);
+		params->cmd_ext_type = SPI_NOR_EXT_REPEAT;
+		params->rdsr_dummy = 8;
+		params->rdsr_addr_nbytes = 0;
+	}
+
 	/* Page Program settings. */
 	params->hwcaps.mask |= SNOR_HWCAPS_PP;
 	spi_nor_set_pp_settings(&params->page_programs[SNOR_CMD_PP],
@@ -2206,6 +2678,13 @@ static int spi_nor_init_params(struct spi_nor *nor,
 					SPINOR_OP_PP_1_1_4, SNOR_PROTO_1_1_4);
 	}
 
+	if (info->flags & SPI_NOR_OCTAL_DTR_PP) {
+		params->hwcaps.mask |= SNOR_HWCAPS_PP_8_8_8_DTR;
+		/* Addresses are always 4 bytes long in 8D-8D-8D mode. */
+		spi_nor_set_pp_settings(&params->page_programs[SNOR_CMD_PP_8_8_8_DTR],
+					SPINOR_OP_PP_4B, SNOR_PROTO_8_8_8_DTR);
+	}
+
 	/* Select the procedure to set the Quad Enable bit. */
 	if (params->hwcaps.mask & (SNOR_HWCAPS_READ_QUAD |
 				   SNOR_HWCAPS_PP_QUAD)) {
@@ -2232,7 +2711,9 @@ static int spi_nor_init_params(struct spi_nor *nor,
 	/* Override the parameters with data read from SFDP tables. */
 	nor->addr_width = 0;
 	nor->mtd.erasesize = 0;
-	if ((info->flags & (SPI_NOR_DUAL_READ | SPI_NOR_QUAD_READ)) &&
+	nor->flags &= ~SNOR_F_4B_OPCODES;
+	if ((info->flags & (SPI_NOR_DUAL_READ | SPI_NOR_QUAD_READ |
+			    SPI_NOR_OCTAL_READ | SPI_NOR_OCTAL_DTR_READ)) &&
 	    !(info->flags & SPI_NOR_SKIP_SFDP)) {
 		struct spi_nor_flash_parameter sfdp_params;
 
@@ -2240,11 +2721,27 @@ static int spi_nor_init_params(struct spi_nor *nor,
 		if (spi_nor_parse_sfdp(nor, &sfdp_params)) {
 			nor->addr_width = 0;
 			nor->mtd.erasesize = 0;
+			nor->flags &= ~SNOR_F_4B_OPCODES;
 		} else {
 			memcpy(params, &sfdp_params, sizeof(*params));
 		}
 	}
 
+	/* Select the procedure to switch to and from 8D-8D-8D mode. */
+	if (params->hwcaps.mask & (SNOR_HWCAPS_READ_8_8_8_DTR |
+				   SNOR_HWCAPS_PP_8_8_8_DTR)) {
+		switch (JEDEC_MFR(info)) {
+#ifdef CONFIG_SPI_FLASH_STMICRO
+		case SNOR_MFR_MICRON:
+			params->octal_dtr_enable =
+				spi_nor_micron_octal_dtr_enable;
+			break;
+#endif
+		default:
+			break;
+		}
+	}
+
 	return 0;
 }
 
@@ -2277,6 +2774,7 @@ static int spi_nor_hwcaps_read2cmd(u32 hwcaps)
 		{ SNOR_HWCAPS_READ_1_8_8,	SNOR_CMD_READ_1_8_8 },
 		{ SNOR_HWCAPS_READ_8_8_8,	SNOR_CMD_READ_8_8_8 },
 		{ SNOR_HWCAPS_READ_1_8_8_DTR,	SNOR_CMD_READ_1_8_8_DTR },
+		{ SNOR_HWCAPS_READ_8_8_8_DTR,	SNOR_CMD_READ_8_8_8_DTR },
 	};
 
 	return spi_nor_hwcaps2cmd(hwcaps, hwcaps_read2cmd,
@@ -2293,6 +2791,7 @@ static int spi_nor_hwcaps_pp2cmd(u32 hwcaps)
 		{ SNOR_HWCAPS_PP_1_1_8,		SNOR_CMD_PP_1_1_8 },
 		{ SNOR_HWCAPS_PP_1_8_8,		SNOR_CMD_PP_1_8_8 },
 		{ SNOR_HWCAPS_PP_8_8_8,		SNOR_CMD_PP_8_8_8 },
+		{ SNOR_HWCAPS_PP_8_8_8_DTR,	SNOR_CMD_PP_8_8_8_DTR },
 	};
 
 	return spi_nor_hwcaps2cmd(hwcaps, hwcaps_pp2cmd,
@@ -2377,6 +2876,83 @@ static int spi_nor_select_erase(struct spi_nor *nor,
 	return 0;
 }
 
+/*
+ * Ask the controller whether it can issue @op, first with a 4-byte address
+ * and, for memories of at most 16MiB, with a 3-byte one. Only the shape of
+ * the op matters here, not the op code.
+ */
+static int spi_nor_spimem_check_op(struct spi_nor *nor,
+				   struct spi_mem_op *op)
+{
+	op->addr.nbytes = 4;
+	if (!spi_mem_supports_op(nor->spi, op)) {
+		if (nor->mtd.size > SZ_16M)
+			return -ENOTSUPP;
+
+		op->addr.nbytes = 3;
+		if (!spi_mem_supports_op(nor->spi, op))
+			return -ENOTSUPP;
+	}
+
+	return 0;
+}
+
+static int spi_nor_spimem_check_readop(struct spi_nor *nor,
+				       const struct spi_nor_read_command *read)
+{
+	struct spi_mem_op op = SPI_MEM_OP(SPI_MEM_OP_CMD(read->opcode, 1),
+					  SPI_MEM_OP_ADDR(3, 0, 1),
+					  SPI_MEM_OP_DUMMY(0, 1),
+					  SPI_MEM_OP_DATA_IN(2, NULL, 1));
+
+	op.dummy.nbytes = (read->num_mode_clocks + read->num_wait_states) *
+			  spi_nor_get_protocol_addr_nbits(read->proto) / 8;
+	spi_nor_setup_op(nor, &op, read->proto);
+
+	return spi_nor_spimem_check_op(nor, &op);
+}
+
+static int spi_nor_spimem_check_pp(struct spi_nor *nor,
+				   const struct spi_nor_pp_command *pp)
+{
+	struct spi_mem_op op = SPI_MEM_OP(SPI_MEM_OP_CMD(pp->opcode, 1),
+					  SPI_MEM_OP_ADDR(3, 0, 1),
+					  SPI_MEM_OP_NO_DUMMY,
+					  SPI_MEM_OP_DATA_OUT(2, NULL, 1));
+
+	spi_nor_setup_op(nor, &op, pp->proto);
+
+	return spi_nor_spimem_check_op(nor, &op);
+}
+
+/*
+ * Drop the (Fast) Read and Page Program commands whose protocol the SPI
+ * controller cannot drive, such as DTR ones on most controllers.
+ */
+static void spi_nor_spimem_adjust_hwcaps(struct spi_nor *nor,
+					 const struct spi_nor_flash_parameter *params,
+					 u32 *hwcaps)
+{
+	unsigned int cap;
+
+	for (cap = 0; cap < sizeof(*hwcaps) * BITS_PER_BYTE; cap++) {
+		int rdidx, ppidx;
+
+		if (!(*hwcaps & BIT(cap)))
+			continue;
+
+		rdidx = spi_nor_hwcaps_read2cmd(BIT(cap));
+		if (rdidx >= 0 &&
+		    spi_nor_spimem_check_readop(nor, &params->reads[rdidx]))
+			*hwcaps &= ~BIT(cap);
+
+		ppidx = spi_nor_hwcaps_pp2cmd(BIT(cap));
+		if (ppidx >= 0 &&
+		    spi_nor_spimem_check_pp(nor, &params->page_programs[ppidx]))
+			*hwcaps &= ~BIT(cap);
+	}
+}
+
 static int spi_nor_setup(struct spi_nor *nor, const struct flash_info *info,
 			 const struct spi_nor_flash_parameter *params,
 			 const struct spi_nor_hwcaps *hwcaps)
@@ -2403,6 +2979,20 @@ static int spi_nor_setup(struct spi_nor *nor, const struct flash_info *info,
 		shared_mask &= ~ignored_mask;
 	}
 
+	nor->cmd_ext_type = params->cmd_ext_type;
+	spi_nor_spimem_adjust_hwcaps(nor, params, &shared_mask);
+
+	/*
+	 * Once in 8D-8D-8D mode every command has to use it, so the memory
+	 * must know how to get there and both reads and page programs must
+	 * be possible in that mode.
+	 */
+	if (!params->octal_dtr_enable ||
+	    !(shared_mask & SNOR_HWCAPS_READ_8_8_8_DTR) ||
+	    !(shared_mask & SNOR_HWCAPS_PP_8_8_8_DTR))
+		shared_mask &= ~(SNOR_HWCAPS_READ_8_8_8_DTR |
+				 SNOR_HWCAPS_PP_8_8_8_DTR);
+
 	/* Select the (Fast) Read command. */
 	err = spi_nor_select_read(nor, params, shared_mask);
 	if (err) {
@@ -2435,6 +3025,15 @@ static int spi_nor_setup(struct spi_nor *nor, const struct flash_info *info,
 	else
 		nor->quad_enable = NULL;
 
+	/* Switch to 8D-8D-8D mode if needed. */
+	if (nor->read_proto == SNOR_PROTO_8_8_8_DTR) {
+		nor->octal_dtr_enable = params->octal_dtr_enable;
+		nor->rdsr_dummy = params->rdsr_dummy;
+		nor->rdsr_addr_nbytes = params->rdsr_addr_nbytes;
+	} else {
+		nor->octal_dtr_enable = NULL;
+	}
+
 	return 0;
 }
 
@@ -2466,7 +3065,8 @@ static int spi_nor_init(struct spi_nor *nor)
 
 	if (nor->addr_width == 4 &&
 	    (JEDEC_MFR(nor->info) != SNOR_MFR_SPANSION) &&
-	    !(nor->info->flags & SPI_NOR_4B_OPCODES)) {
+	    !(nor->info->flags & SPI_NOR_4B_OPCODES) &&
+	    !(nor->flags & SNOR_F_4B_OPCODES)) {
 		/*
 		 * If the RESET# pin isn't hooked up properly, or the system
 		 * otherwise doesn't perform a reset command in the boot
@@ -2479,6 +3079,63 @@ static int spi_nor_init(struct spi_nor *nor)
 		set_4byte(nor, nor->info, 1);
 	}
 
+	if (nor->octal_dtr_enable) {
+		err = nor->octal_dtr_enable(nor, true);
+		if (err) {
+			dev_dbg(nor->dev, "octal DTR mode not supported\n");
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Map the whole flash for reads with the op selected by spi_nor_setup(), so
+ * that controllers with a memory-mapped window or DMA can serve large reads
+ * in one go. Controllers without dirmap support get a descriptor which
+ * issues regular spi-mem ops; if even that fails, spi_nor_read_data() keeps
+ * building the ops itself.
+ */
+static void spi_nor_create_read_dirmap(struct spi_nor *nor)
+{
+	struct spi_mem_dirmap_info info = {
+		.op_tmpl = SPI_MEM_OP(SPI_MEM_OP_CMD(nor->read_opcode, 1),
+				      SPI_MEM_OP_ADDR(nor->addr_width, 0, 1),
+				      SPI_MEM_OP_DUMMY(nor->read_dummy, 1),
+				      SPI_MEM_OP_DATA_IN(0, NULL, 1)),
+		.offset = 0,
+		.length = nor->mtd.size,
+	};
+	struct spi_mem_op *op = &info.op_tmpl;
+
+	/* convert the dummy cycles to the number of bytes */
+	op->dummy.nbytes = (nor->read_dummy *
+			    spi_nor_get_protocol_addr_nbits(nor->read_proto)) / 8;
+	spi_nor_setup_op(nor, op, nor->read_proto);
+
+	nor->dirmap.rdesc = spi_mem_dirmap_create(nor->spi, &info);
+	if (IS_ERR(nor->dirmap.rdesc)) {
+		dev_dbg(nor->dev, "no read dirmap: %ld\n",
+			PTR_ERR(nor->dirmap.rdesc));
+		nor->dirmap.rdesc = NULL;
+	}
+}
+
+int spi_nor_remove(struct spi_nor *nor)
+{
+	if (nor->dirmap.rdesc) {
+		spi_mem_dirmap_destroy(nor->dirmap.rdesc);
+		nor->dirmap.rdesc = NULL;
+	}
+
+	/*
+	 * Hand the flash over in 1S-1S-1S mode: whatever runs next cannot
+	 * know it was switched to 8D-8D-8D.
+	 */
+	if (nor->octal_dtr_enable && nor->reg_proto == SNOR_PROTO_8_8_8_DTR)
+		return nor->octal_dtr_enable(nor, false);
+
 	return 0;
 }
 
@@ -2496,6 +3153,8 @@ int spi_nor_scan(struct spi_nor *nor)
 	int ret;
 
 	/* Reset SPI protocol for all commands. */
+	spi_nor_remove(nor);
+
 	nor->reg_proto = SNOR_PROTO_1_1_1;
 	nor->read_proto = SNOR_PROTO_1_1_1;
 	nor->write_proto = SNOR_PROTO_1_1_1;
@@ -2510,7 +3169,9 @@ int spi_nor_scan(struct spi_nor *nor)
 		if (spi->mode & SPI_TX_OCTAL)
 			hwcaps.mask |= (SNOR_HWCAPS_READ_1_8_8 |
 					SNOR_HWCAPS_PP_1_1_8 |
-					SNOR_HWCAPS_PP_1_8_8);
+					SNOR_HWCAPS_PP_1_8_8 |
+					SNOR_HWCAPS_READ_8_8_8_DTR |
+					SNOR_HWCAPS_PP_8_8_8_DTR);
 	} else if (spi->mode & SPI_RX_QUAD) {
 		hwcaps.mask |= SNOR_HWCAPS_READ_1_1_4;
 
@@ -2607,8 +3268,10 @@ int spi_nor_scan(struct spi_nor *nor)
 		/* enable 4-byte addressing if the device exceeds 16MiB */
 		nor->addr_width = 4;
 		if (JEDEC_MFR(info) == SNOR_MFR_SPANSION ||
-		    info->flags & SPI_NOR_4B_OPCODES)
+		    info->flags & SPI_NOR_4B_OPCODES) {
 			spi_nor_set_4byte_opcodes(nor, info);
+			nor->flags |= SNOR_F_4B_OPCODES;
+		}
 #else
 	/* Configure the BAR - discover bank cmds and read current bank */
 	nor->addr_width = 3;
@@ -2620,6 +3283,10 @@ int spi_nor_scan(struct spi_nor *nor)
 		nor->addr_width = 3;
 	}
 
+	/* Addresses are always 4 bytes long in 8D-8D-8D mode. */
+	if (nor->read_proto == SNOR_PROTO_8_8_8_DTR)
+		nor->addr_width = 4;
+
 	if (nor->addr_width > SPI_NOR_MAX_ADDR_WIDTH) {
 		dev_dbg(nor->dev, "address width is too large: %u\n",
 			nor->addr_width);
@@ -2637,6 +3304,8 @@ int spi_nor_scan(struct spi_nor *nor)
 	nor->erase_size = mtd->erasesize;
 	nor->sector_size = mtd->erasesize;
 
+	spi_nor_create_read_dirmap(nor);
+
 #ifndef CONFIG_SPL_BUILD
 	printf("SF: Detected %s with page size ", nor->name);
 	print_size(nor->page_size, ", erase size ");
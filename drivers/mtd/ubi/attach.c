@@ -832,6 +832,8 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_read_hdrs(ubi, pnum);
+
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1406,6 +1408,11 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	if (!ai)
 		return -ENOMEM;
 
+	/* Not having it only makes scanning slower */
+	ubi->hdrs_pnum = -1;
+	ubi->hdrs_buf = kmalloc(CONFIG_MTD_UBI_SCAN_READ_AHEAD *
+				ubi_io_hdrs_size(ubi), GFP_KERNEL);
+
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	/* On small flash devices we disable fastmap in any case. */
 	if ((int)mtd_div_by_eb(ubi->mtd->size, ubi->mtd) <= UBI_FM_MAX_START) {
@@ -1480,6 +1487,8 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 #endif
 
 	destroy_ai(ai);
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
 	return 0;
 
 out_wl:
@@ -1489,6 +1498,8 @@ out_vtbl:
 	vfree(ubi->vtbl);
 out_ai:
 	destroy_ai(ai);
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
 	return err;
 }
 
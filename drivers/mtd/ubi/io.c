@@ -96,6 +96,7 @@ static int self_check_vid_hdr(const struct ubi_device *ubi, int pnum,
 			      const struct ubi_vid_hdr *vid_hdr);
 static int self_check_write(struct ubi_device *ubi, const void *buf, int pnum,
 			    int offset, int len);
+static void forget_hdrs(struct ubi_device *ubi, int pnum);
 
 /**
  * ubi_io_read - read data from a physical eraseblock.
@@ -276,6 +277,8 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 		return -EIO;
 	}
 
+	forget_hdrs(ubi, pnum);
+
 	addr = (loff_t)pnum * ubi->peb_size + offset;
 	err = mtd_write(ubi->mtd, addr, len, &written, buf);
 	if (err) {
@@ -339,6 +342,8 @@ static int do_sync_erase(struct ubi_device *ubi, int pnum)
 		return -EROFS;
 	}
 
+	forget_hdrs(ubi, pnum);
+
 retry:
 	init_waitqueue_head(&wq);
 	memset(&ei, 0, sizeof(struct erase_info));
@@ -703,6 +708,94 @@ bad:
 	return 1;
 }
 
+/**
+ * ubi_io_hdrs_size - get the size of the headers area of a PEB.
+ * @ubi: UBI device description object
+ *
+ * This is the space taken by the EC and VID headers at the start of each PEB,
+ * which 'ubi_io_read_hdrs()' reads in one go. @ubi->hdrs_buf holds
+ * %CONFIG_MTD_UBI_SCAN_READ_AHEAD of these.
+ */
+int ubi_io_hdrs_size(const struct ubi_device *ubi)
+{
+	return ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+}
+
+/**
+ * ubi_io_read_hdrs - read ahead the headers of a run of physical eraseblocks.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock which is about to be scanned
+ *
+ * While attaching, the EC and VID headers of every PEB are read one after
+ * the other. Unless @pnum is already in @ubi->hdrs_buf, this function fills
+ * it with the headers of %CONFIG_MTD_UBI_SCAN_READ_AHEAD PEBs from @pnum
+ * onwards, skipping bad ones. Both headers of each PEB are read with a
+ * single flash read, which lets the MTD driver fetch the pages back to back
+ * (or just one page if the headers share it), and the reads for the whole
+ * run are issued together before any of the PEBs is scanned. The following
+ * 'ubi_io_read_ec_hdr()' and 'ubi_io_read_vid_hdr()' calls then take the
+ * headers from the buffer.
+ *
+ * A PEB is only taken from the buffer if it was read cleanly; on bit-flips
+ * or errors its headers are read again separately as usual, so that errors
+ * are reported per header.
+ */
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum)
+{
+	int size = ubi_io_hdrs_size(ubi);
+	int i, count;
+
+	if (!ubi->hdrs_buf)
+		return;
+	if (ubi->hdrs_pnum != -1 && pnum >= ubi->hdrs_pnum &&
+	    pnum < ubi->hdrs_pnum + CONFIG_MTD_UBI_SCAN_READ_AHEAD)
+		return;
+
+	ubi->hdrs_pnum = pnum;
+	ubi->hdrs_ok = 0;
+	count = min(CONFIG_MTD_UBI_SCAN_READ_AHEAD, ubi->peb_count - pnum);
+	for (i = 0; i < count; i++) {
+		if (ubi_io_is_bad(ubi, pnum + i))
+			continue;
+		if (!ubi_io_read(ubi, ubi->hdrs_buf + i * size, pnum + i, 0,
+				 size))
+			ubi->hdrs_ok |= 1U << i;
+	}
+}
+
+/* Get the headers of @pnum from @ubi->hdrs_buf, or NULL if not there */
+static void *hdrs_of(const struct ubi_device *ubi, int pnum)
+{
+	int i = pnum - ubi->hdrs_pnum;
+
+	if (!ubi->hdrs_buf || ubi->hdrs_pnum == -1 || i < 0 ||
+	    i >= CONFIG_MTD_UBI_SCAN_READ_AHEAD || !(ubi->hdrs_ok & 1U << i))
+		return NULL;
+
+	return ubi->hdrs_buf + i * ubi_io_hdrs_size(ubi);
+}
+
+/* Drop the read-ahead headers of @pnum, which is about to change */
+static void forget_hdrs(struct ubi_device *ubi, int pnum)
+{
+	if (hdrs_of(ubi, pnum))
+		ubi->hdrs_ok &= ~(1U << (pnum - ubi->hdrs_pnum));
+}
+
+/* Read part of the headers area, using @ubi->hdrs_buf if it holds @pnum */
+static int read_hdr(struct ubi_device *ubi, void *buf, int pnum, int offset,
+		    int len)
+{
+	void *hdrs = hdrs_of(ubi, pnum);
+
+	if (hdrs) {
+		memcpy(buf, hdrs + offset, len);
+		return 0;
+	}
+
+	return ubi_io_read(ubi, buf, pnum, offset, len);
+}
+
 /**
  * ubi_io_read_ec_hdr - read and check an erase counter header.
  * @ubi: UBI device description object
@@ -734,7 +827,7 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 	dbg_io("read EC header from PEB %d", pnum);
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
 
-	read_err = ubi_io_read(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
+	read_err = read_hdr(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
 	if (read_err) {
 		if (read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 			return read_err;
@@ -1009,8 +1102,8 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	ubi_assert(pnum >= 0 &&  pnum < ubi->peb_count);
 
 	p = (char *)vid_hdr - ubi->vid_hdr_shift;
-	read_err = ubi_io_read(ubi, p, pnum, ubi->vid_hdr_aloffset,
-			  ubi->vid_hdr_alsize);
+	read_err = read_hdr(ubi, p, pnum, ubi->vid_hdr_aloffset,
+			    ubi->vid_hdr_alsize);
 	if (read_err && read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 		return read_err;
 
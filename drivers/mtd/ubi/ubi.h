@@ -526,6 +526,11 @@ struct ubi_debug_info {
  *
  * @peb_buf: a buffer of PEB size used for different purposes
  * @buf_mutex: protects @peb_buf
+ * @hdrs_buf: EC and VID headers of the PEBs from @hdrs_pnum onwards, read
+ *            ahead while attaching (see 'ubi_io_read_hdrs()')
+ * @hdrs_pnum: first PEB whose headers are in @hdrs_buf, or %-1
+ * @hdrs_ok: bitmap of the PEBs in @hdrs_buf which were read cleanly, with
+ *           bit 0 for PEB @hdrs_pnum
  * @ckvol_mutex: serializes static volume checking when opening
  *
  * @dbg: debugging information for this UBI device
@@ -625,6 +630,9 @@ struct ubi_device {
 
 	void *peb_buf;
 	struct mutex buf_mutex;
+	void *hdrs_buf;
+	int hdrs_pnum;
+	u32 hdrs_ok;
 	struct mutex ckvol_mutex;
 
 	struct ubi_debug_info dbg;
@@ -890,6 +898,8 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 int ubi_io_sync_erase(struct ubi_device *ubi, int pnum, int torture);
 int ubi_io_is_bad(const struct ubi_device *ubi, int pnum);
 int ubi_io_mark_bad(const struct ubi_device *ubi, int pnum);
+int ubi_io_hdrs_size(const struct ubi_device *ubi);
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum);
 int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 		       struct ubi_ec_hdr *ec_hdr, int verbose);
 int ubi_io_write_ec_hdr(struct ubi_device *ubi, int pnum,
@@ -172,47 +172,29 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 	nvmeq->sq_tail = tail;
 }
 
-static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
-				struct nvme_command *cmd,
-				u32 *result, unsigned timeout)
+/**
+ * nvme_reap_cmd() - consume the next completion of a queue, if there is one
+ *
+ * @nvmeq:	The queue to check
+ * @result:	Returns the command specific result, if not NULL
+ * @return 0 if a command completed successfully, -EBUSY if no completion
+ * is there yet, -EIO if the command failed
+ */
+static int nvme_reap_cmd(struct nvme_queue *nvmeq, u32 *result)
 {
 	u16 head = nvmeq->cq_head;
 	u16 phase = nvmeq->cq_phase;
 	u16 status;
-	ulong start_time;
-	ulong timeout_us = timeout * 100000;
 
-	cmd->common.command_id = nvme_get_cmd_id();
-	nvme_submit_cmd(nvmeq, cmd);
-
-	start_time = timer_get_us();
-
-	for (;;) {
-		status = nvme_read_completion_status(nvmeq, head);
-		if ((status & 0x01) == phase)
-			break;
-		if (timeout_us > 0 && (timer_get_us() - start_time)
-		    >= timeout_us)
-			return -ETIMEDOUT;
-	}
+	status = nvme_read_completion_status(nvmeq, head);
+	if ((status & 0x01) != phase)
+		return -EBUSY;
 
 	status >>= 1;
-	if (status) {
+	if (status)
 		printf("ERROR: status = %x, phase = %d, head = %d\n",
 		       status, phase, head);
-		status = 0;
-		if (++head == nvmeq->q_depth) {
-			head = 0;
-			phase = !phase;
-		}
-		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
-		nvmeq->cq_head = head;
-		nvmeq->cq_phase = phase;
-
-		return -EIO;
-	}
-
-	if (result)
+	else if (result)
 		*result = le32_to_cpu(readl(&(nvmeq->cqes[head].result)));
 
 	if (++head == nvmeq->q_depth) {
@@ -223,7 +205,30 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	nvmeq->cq_head = head;
 	nvmeq->cq_phase = phase;
 
-	return status;
+	return status ? -EIO : 0;
+}
+
+static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
+				struct nvme_command *cmd,
+				u32 *result, unsigned timeout)
+{
+	ulong start_time;
+	ulong timeout_us = timeout * 100000;
+	int ret;
+
+	cmd->common.command_id = nvme_get_cmd_id();
+	nvme_submit_cmd(nvmeq, cmd);
+
+	start_time = timer_get_us();
+
+	for (;;) {
+		ret = nvme_reap_cmd(nvmeq, result);
+		if (ret != -EBUSY)
+			return ret;
+		if (timeout_us > 0 && (timer_get_us() - start_time)
+		    >= timeout_us)
+			return -ETIMEDOUT;
+	}
 }
 
 static int nvme_submit_admin_cmd(struct nvme_dev *dev, struct nvme_command *cmd,
@@ -608,6 +613,7 @@ static int nvme_get_info_from_identify(struct nvme_dev *dev)
 
 	dev->nn = le32_to_cpu(ctrl->nn);
 	dev->vwc = ctrl->vwc;
+	dev->oncs = le16_to_cpu(ctrl->oncs);
 	memcpy(dev->serial, ctrl->sn, sizeof(ctrl->sn));
 	memcpy(dev->model, ctrl->mn, sizeof(ctrl->mn));
 	memcpy(dev->firmware_rev, ctrl->fr, sizeof(ctrl->fr));
@@ -713,6 +719,118 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+static void nvme_setup_rw_cmd(struct nvme_ns *ns, struct nvme_command *c,
+			      bool read)
+{
+	memset(c, '\0', sizeof(*c));
+	c->rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
+	c->rw.nsid = cpu_to_le32(ns->ns_id);
+}
+
+/* Send the next command of the request in dev->io_req */
+static int nvme_io_start(struct nvme_dev *dev)
+{
+	struct blk_req *req = dev->io_req;
+	struct nvme_ns *ns = dev_get_priv(req->dev);
+	void *buffer = req->buffer + (dev->io_done << ns->lba_shift);
+	struct nvme_command c;
+	u64 prp2;
+
+	dev->io_lbas = min_t(u64, dev->io_left,
+			     1 << (dev->max_transfer_shift - ns->lba_shift));
+	if (nvme_setup_prps(dev, &prp2, dev->io_lbas << ns->lba_shift,
+			    (ulong)buffer))
+		return -EIO;
+
+	nvme_setup_rw_cmd(ns, &c, req->op == BLK_REQ_READ);
+	c.rw.slba = cpu_to_le64(dev->io_slba);
+	c.rw.length = cpu_to_le16(dev->io_lbas - 1);
+	c.rw.prp1 = cpu_to_le64((ulong)buffer);
+	c.rw.prp2 = cpu_to_le64(prp2);
+	c.common.command_id = nvme_get_cmd_id();
+	nvme_submit_cmd(dev->queues[NVME_IO_Q], &c);
+	dev->io_start = timer_get_us();
+
+	return 0;
+}
+
+static int nvme_io_poll(struct nvme_dev *dev)
+{
+	struct blk_req *req = dev->io_req;
+	struct nvme_ns *ns;
+	int ret;
+
+	if (!req)
+		return 0;
+
+	ret = nvme_reap_cmd(dev->queues[NVME_IO_Q], NULL);
+	if (ret == -EBUSY) {
+		if (timer_get_us() - dev->io_start < IO_TIMEOUT * 100000)
+			return 1;
+		ret = -ETIMEDOUT;
+	}
+
+	if (!ret) {
+		dev->io_done += dev->io_lbas;
+		dev->io_left -= dev->io_lbas;
+		dev->io_slba += dev->io_lbas;
+		if (dev->io_left) {
+			ret = nvme_io_start(dev);
+			if (!ret)
+				return 1;
+		}
+	}
+
+	ns = dev_get_priv(req->dev);
+	if (req->op == BLK_REQ_READ)
+		invalidate_dcache_range((ulong)req->buffer,
+					(ulong)req->buffer +
+					(req->blkcnt << ns->lba_shift));
+	dev->io_req = NULL;
+	blk_req_complete(req, dev->io_done, ret);
+
+	return 0;
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	return nvme_io_poll(ns->dev);
+}
+
+static int nvme_blk_submit(struct udevice *udev, struct blk_req *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	int ret;
+
+	if (req->op != BLK_REQ_READ && req->op != BLK_REQ_WRITE)
+		return -EOPNOTSUPP;
+
+	/* the I/O queue holds a single command */
+	if (dev->io_req)
+		return -EBUSY;
+
+	flush_dcache_range((ulong)req->buffer,
+			   (ulong)req->buffer + (req->blkcnt << ns->lba_shift));
+
+	dev->io_req = req;
+	dev->io_slba = req->start;
+	dev->io_left = req->blkcnt;
+	dev->io_done = 0;
+	if (!dev->io_left) {
+		nvme_io_poll(dev);
+		return 0;
+	}
+
+	ret = nvme_io_start(dev);
+	if (ret)
+		dev->io_req = NULL;
+
+	return ret;
+}
+
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
@@ -729,18 +847,14 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
 	u64 total_lbas = blkcnt;
 
+	/* finish a submitted request first, it uses the same queue */
+	while (nvme_io_poll(dev))
+		;
+
 	flush_dcache_range((unsigned long)buffer,
 			   (unsigned long)buffer + total_len);
 
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
-	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
+	nvme_setup_rw_cmd(ns, &c, read);
 
 	while (total_lbas) {
 		if (total_lbas < lbas) {
@@ -785,9 +899,54 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 	return nvme_blk_rw(udev, blknr, blkcnt, (void *)buffer, false);
 }
 
+/* Deallocate the range with Dataset Management, one range per command */
+static ulong nvme_blk_discard(struct udevice *udev, lbaint_t blknr,
+			      lbaint_t blkcnt)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	ALLOC_CACHE_ALIGN_BUFFER(struct nvme_dsm_range, range, 1);
+	struct nvme_command c;
+	lbaint_t done = 0;
+	u32 nlb;
+
+	if (!(dev->oncs & NVME_CTRL_ONCS_DSM))
+		return -ENOSYS;
+
+	/* finish a submitted request first, it uses the same queue */
+	while (nvme_io_poll(dev))
+		;
+
+	memset(&c, 0, sizeof(c));
+	c.dsm.opcode = nvme_cmd_dsm;
+	c.dsm.nsid = cpu_to_le32(ns->ns_id);
+	c.dsm.prp1 = cpu_to_le64((ulong)range);
+	c.dsm.nr = 0;
+	c.dsm.attributes = cpu_to_le32(NVME_DSMGMT_AD);
+
+	while (done < blkcnt) {
+		nlb = min_t(lbaint_t, blkcnt - done, U32_MAX);
+		range->cattr = 0;
+		range->nlb = cpu_to_le32(nlb);
+		range->slba = cpu_to_le64(blknr + done);
+		flush_dcache_range((ulong)range,
+				   (ulong)range + ARCH_DMA_MINALIGN);
+
+		if (nvme_submit_sync_cmd(dev->queues[NVME_IO_Q], &c, NULL,
+					 IO_TIMEOUT))
+			break;
+		done += nlb;
+	}
+
+	return done;
+}
+
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+	.discard	= nvme_blk_discard,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
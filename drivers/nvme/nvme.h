@@ -616,9 +616,21 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u8 vwc;
+	u16 oncs;
 	u64 *prp_pool;
 	u32 prp_entry_num;
 	u32 nn;
+
+	/*
+	 * Request from blk_submit() in progress on the I/O queue. It is sent
+	 * as a series of commands of up to 1 << max_transfer_shift bytes.
+	 */
+	struct blk_req *io_req;
+	u64 io_slba;		/* first block of the current command */
+	u64 io_left;		/* blocks not yet completed */
+	u64 io_done;		/* blocks completed */
+	u16 io_lbas;		/* blocks in the current command */
+	ulong io_start;		/* time the current command was sent, in us */
 };
 
 /*
@@ -282,6 +282,51 @@ static int cadence_spi_mem_exec_op(struct spi_slave *spi,
 	return err;
 }
 
+static int cadence_spi_mem_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct udevice *bus = desc->slave->dev->parent;
+	struct cadence_spi_plat *plat = dev_get_plat(bus);
+
+	/* Only reads are served from the direct access window */
+	if (!plat->use_dac_mode ||
+	    desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN ||
+	    desc->info.offset >= plat->ahbsize)
+		return -ENOTSUPP;
+
+	return 0;
+}
+
+static ssize_t cadence_spi_mem_dirmap_read(struct spi_mem_dirmap_desc *desc,
+					   u64 offs, size_t len, void *buf)
+{
+	struct spi_slave *spi = desc->slave;
+	struct udevice *bus = spi->dev->parent;
+	struct cadence_spi_plat *plat = dev_get_plat(bus);
+	struct cadence_spi_priv *priv = dev_get_priv(bus);
+	struct spi_mem_op op = desc->info.op_tmpl;
+	u64 from = desc->info.offset + offs;
+	int err;
+
+	/*
+	 * Serve as much as fits in the window with a single DMA (or
+	 * memcpy) transfer; whatever lies beyond it is read indirectly.
+	 */
+	if (from < plat->ahbsize)
+		len = min_t(u64, len, plat->ahbsize - from);
+
+	cadence_qspi_apb_chipselect(priv->regbase, spi_chip_select(spi->dev),
+				    plat->is_decoded_cs);
+
+	op.addr.val = from;
+	op.data.nbytes = len;
+	op.data.buf.in = buf;
+	err = cadence_qspi_apb_read_setup(plat, &op);
+	if (!err)
+		err = cadence_qspi_apb_read_execute(plat, &op);
+
+	return err ? err : len;
+}
+
 static int cadence_spi_of_to_plat(struct udevice *bus)
 {
 	struct cadence_spi_plat *plat = dev_get_plat(bus);
@@ -330,6 +375,8 @@ static int cadence_spi_of_to_plat(struct udevice *bus)
 
 static const struct spi_controller_mem_ops cadence_spi_mem_ops = {
 	.exec_op = cadence_spi_mem_exec_op,
+	.dirmap_create = cadence_spi_mem_dirmap_create,
+	.dirmap_read = cadence_spi_mem_dirmap_read,
 };
 
 static const struct dm_spi_ops cadence_spi_ops = {
@@ -703,6 +703,57 @@ static int fsl_qspi_adjust_op_size(struct spi_slave *slave,
 	return 0;
 }
 
+static int fsl_qspi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct fsl_qspi *q = dev_get_priv(desc->slave->dev->parent);
+
+	/*
+	 * Reads can only be issued as AHB accesses when the AHB window maps
+	 * the whole memory of each chip select.
+	 */
+	if (!IS_ENABLED(CONFIG_FSL_QSPI_AHB_FULL_MAP) ||
+	    desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN ||
+	    desc->info.offset + desc->info.length > fsl_qspi_memsize_per_cs(q))
+		return -ENOTSUPP;
+
+	if (!fsl_qspi_supports_op(desc->slave, &desc->info.op_tmpl))
+		return -ENOTSUPP;
+
+	return 0;
+}
+
+static ssize_t fsl_qspi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				    u64 offs, size_t len, void *buf)
+{
+	struct fsl_qspi *q = dev_get_priv(desc->slave->dev->parent);
+	struct spi_mem_op op = desc->info.op_tmpl;
+	void __iomem *base = q->iobase;
+
+	/* wait for the controller being ready */
+	fsl_qspi_readl_poll_tout(q, base + QUADSPI_SR, (QUADSPI_SR_IP_ACC_MASK |
+				 QUADSPI_SR_AHB_ACC_MASK), 10, 1000);
+
+	fsl_qspi_select_mem(q, desc->slave);
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.nbytes = len;
+	op.data.buf.in = buf;
+
+	/*
+	 * Load the read sequence into the AHB LUT once and copy the whole
+	 * range from the memory map; the controller refills its AHB buffer
+	 * as the copy walks through it, instead of one IP-triggered op per
+	 * ahb_buf_size chunk.
+	 */
+	fsl_qspi_prepare_lut(q, &op);
+	fsl_qspi_read_ahb(q, &op);
+
+	/* Invalidate the data in the AHB buffer. */
+	fsl_qspi_invalidate(q);
+
+	return len;
+}
+
 static int fsl_qspi_default_setup(struct fsl_qspi *q)
 {
 	void __iomem *base = q->iobase;
@@ -784,6 +835,8 @@ static const struct spi_controller_mem_ops fsl_qspi_mem_ops = {
 	.adjust_op_size = fsl_qspi_adjust_op_size,
 	.supports_op = fsl_qspi_supports_op,
 	.exec_op = fsl_qspi_exec_op,
+	.dirmap_create = fsl_qspi_dirmap_create,
+	.dirmap_read = fsl_qspi_dirmap_read,
 };
 
 static int fsl_qspi_probe(struct udevice *bus)
@@ -196,6 +196,10 @@ static int mtk_snor_adjust_op_size(struct spi_slave *slave,
 static bool mtk_snor_supports_op(struct spi_slave *slave,
 				 const struct spi_mem_op *op)
 {
+	/* DTR transfers and two-byte opcodes are not supported */
+	if (op->cmd.dtr || op->cmd.nbytes != 1)
+		return false;
+
 	/* This controller only supports 1-1-1 write mode */
 	if (op->data.dir == SPI_MEM_DATA_OUT &&
 	    (op->cmd.buswidth != 1 || op->data.buswidth != 1))
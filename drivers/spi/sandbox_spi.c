@@ -15,6 +15,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <os.h>
 
@@ -157,12 +158,34 @@ static int sandbox_spi_get_mmap(struct udevice *dev, ulong *map_basep,
 	return 0;
 }
 
+#ifdef CONFIG_SPI_MEM
+/*
+ * The emulated flashes follow the DTR commands from the byte stream, so
+ * accept them as long as they are well formed.
+ */
+static bool sandbox_spi_supports_op(struct spi_slave *slave,
+				    const struct spi_mem_op *op)
+{
+	if (op->cmd.dtr || op->addr.dtr || op->dummy.dtr || op->data.dtr)
+		return spi_mem_dtr_supports_op(slave, op);
+
+	return spi_mem_default_supports_op(slave, op);
+}
+
+static const struct spi_controller_mem_ops sandbox_spi_mem_ops = {
+	.supports_op	= sandbox_spi_supports_op,
+};
+#endif
+
 static const struct dm_spi_ops sandbox_spi_ops = {
 	.xfer		= sandbox_spi_xfer,
 	.set_speed	= sandbox_spi_set_speed,
 	.set_mode	= sandbox_spi_set_mode,
 	.cs_info	= sandbox_cs_info,
 	.get_mmap	= sandbox_spi_get_mmap,
+#ifdef CONFIG_SPI_MEM
+	.mem_ops	= &sandbox_spi_mem_ops,
+#endif
 };
 
 static const struct udevice_id sandbox_spi_ids[] = {
@@ -10,17 +10,28 @@
 #include <os.h>
 #include <scsi.h>
 #include <usb.h>
+#include <linux/usb/uas.h>
 
 /*
  * This driver emulates a flash stick using the UFI command specification and
  * the BBB (bulk/bulk/bulk) protocol. It supports only a single logical unit
  * number (LUN 0).
+ *
+ * With the "sandbox,uas" property the interface also has an alternate setting
+ * speaking USB Attached SCSI without streams, as USB 2.0 UAS devices do. Queued
+ * commands are served newest first, so that the host has to match status and
+ * data phases to its commands by tag.
  */
 
 enum {
 	SANDBOX_FLASH_EP_OUT		= 1,	/* endpoints */
 	SANDBOX_FLASH_EP_IN		= 2,
+	SANDBOX_FLASH_EP_CMD		= 3,	/* UAS endpoints */
+	SANDBOX_FLASH_EP_STATUS		= 4,
+	SANDBOX_FLASH_EP_DATA_IN	= 5,
+	SANDBOX_FLASH_EP_DATA_OUT	= 6,
 	SANDBOX_FLASH_BLOCK_LEN		= 512,
+	SANDBOX_FLASH_UAS_QUEUE		= 16,	/* commands the device accepts */
 };
 
 enum cmd_phase {
@@ -37,6 +48,17 @@ enum {
 	STRINGID_COUNT,
 };
 
+/**
+ * struct sandbox_flash_uas_cmd - a UAS command waiting to be served
+ *
+ * @tag:	Tag from the command IU
+ * @cdb:	SCSI command
+ */
+struct sandbox_flash_uas_cmd {
+	u16 tag;
+	u8 cdb[16];
+};
+
 /**
  * struct sandbox_flash_priv - private state for this driver
  *
@@ -44,18 +66,26 @@ enum {
  * @alloc_len:	Allocation length from the last incoming command
  * @transfer_len: Transfer length from CBW header
  * @read_len:	Number of blocks of data left in the current read command
+ * @write_len:	Number of blocks of data left in the current write command
  * @tag:	Tag value from last command
  * @fd:		File descriptor of backing file
  * @file_size:	Size of file in bytes
  * @status_buff:	Data buffer for outgoing status
  * @buff_used:	Number of bytes ready to transfer back to host
  * @buff:	Data buffer for outgoing data
+ * @altsetting:	Interface alternate setting selected by the host
+ * @uas_queue:	UAS commands received and not yet started
+ * @uas_queued:	Number of entries in @uas_queue
+ * @uas_max_queued: Largest number of UAS commands outstanding at once
+ * @uas_busy:	true if a UAS command is in its data or status phase
+ * @uas_status:	SCSI status to report for that command
  */
 struct sandbox_flash_priv {
 	bool error;
 	int alloc_len;
 	int transfer_len;
 	int read_len;
+	int write_len;
 	enum cmd_phase phase;
 	u32 tag;
 	int fd;
@@ -63,6 +93,12 @@ struct sandbox_flash_priv {
 	struct umass_bbb_csw status;
 	int buff_used;
 	u8 buff[512];
+	int altsetting;
+	struct sandbox_flash_uas_cmd uas_queue[SANDBOX_FLASH_UAS_QUEUE];
+	int uas_queued;
+	int uas_max_queued;
+	bool uas_busy;
+	u8 uas_status;
 };
 
 struct sandbox_flash_plat {
@@ -168,6 +204,115 @@ static void *flash_desc_list[] = {
 	NULL,
 };
 
+/* The UAS variant needs its own config, which holds the total length */
+static struct usb_config_descriptor flash_uas_config0 = {
+	.bLength		= sizeof(flash_uas_config0),
+	.bDescriptorType	= USB_DT_CONFIG,
+
+	/* wTotalLength is set up by usb-emul-uclass */
+	.bNumInterfaces		= 1,
+	.bConfigurationValue	= 0,
+	.iConfiguration		= 0,
+	.bmAttributes		= 1 << 7,
+	.bMaxPower		= 50,
+};
+
+static struct usb_interface_descriptor flash_interface0_uas = {
+	.bLength		= sizeof(flash_interface0_uas),
+	.bDescriptorType	= USB_DT_INTERFACE,
+
+	.bInterfaceNumber	= 0,
+	.bAlternateSetting	= 1,
+	.bNumEndpoints		= 4,
+	.bInterfaceClass	= USB_CLASS_MASS_STORAGE,
+	.bInterfaceSubClass	= US_SC_SCSI,
+	.bInterfaceProtocol	= US_PR_UAS,
+	.iInterface		= 0,
+};
+
+static struct usb_endpoint_descriptor flash_endpoint_cmd = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_CMD,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_pipe_cmd = {
+	.bLength		= sizeof(flash_pipe_cmd),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= CMD_PIPE_ID,
+};
+
+static struct usb_endpoint_descriptor flash_endpoint_status = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_STATUS | USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_pipe_status = {
+	.bLength		= sizeof(flash_pipe_status),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= STATUS_PIPE_ID,
+};
+
+static struct usb_endpoint_descriptor flash_endpoint_data_in = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_DATA_IN |
+				  USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_pipe_data_in = {
+	.bLength		= sizeof(flash_pipe_data_in),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= DATA_IN_PIPE_ID,
+};
+
+static struct usb_endpoint_descriptor flash_endpoint_data_out = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_DATA_OUT,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_pipe_data_out = {
+	.bLength		= sizeof(flash_pipe_data_out),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= DATA_OUT_PIPE_ID,
+};
+
+static void *flash_uas_desc_list[] = {
+	&flash_device_desc,
+	&flash_uas_config0,
+	&flash_interface0,
+	&flash_endpoint0_out,
+	&flash_endpoint1_in,
+	&flash_interface0_uas,
+	&flash_endpoint_cmd,
+	&flash_pipe_cmd,
+	&flash_endpoint_status,
+	&flash_pipe_status,
+	&flash_endpoint_data_in,
+	&flash_pipe_data_in,
+	&flash_endpoint_data_out,
+	&flash_pipe_data_out,
+	NULL,
+};
+
 static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 				 unsigned long pipe, void *buff, int len,
 				 struct devrequest *setup)
@@ -186,6 +331,21 @@ static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 			debug("request=%x\n", setup->request);
 			break;
 		}
+	} else if (pipe == usb_sndctrlpipe(udev, 0)) {
+		switch (setup->request) {
+		case USB_REQ_SET_INTERFACE:
+			priv->altsetting = setup->value;
+			priv->uas_queued = 0;
+			priv->uas_busy = false;
+			priv->phase = PHASE_START;
+			return 0;
+		case USB_REQ_CLEAR_FEATURE:
+			priv->error = false;
+			return 0;
+		default:
+			debug("request=%x\n", setup->request);
+			break;
+		}
 	}
 	debug("pipe=%lx\n", pipe);
 
@@ -238,6 +398,19 @@ static void handle_read(struct sandbox_flash_priv *priv, ulong lba,
 	}
 }
 
+static void handle_write(struct sandbox_flash_priv *priv, ulong lba,
+			 ulong transfer_len)
+{
+	debug("%s: lba=%lx, transfer_len=%lx\n", __func__, lba, transfer_len);
+	if (priv->fd != -1) {
+		os_lseek(priv->fd, lba * SANDBOX_FLASH_BLOCK_LEN, OS_SEEK_SET);
+		priv->write_len = transfer_len;
+		setup_response(priv, NULL, 0);
+	} else {
+		setup_fail_response(priv);
+	}
+}
+
 static int handle_ufi_command(struct sandbox_flash_plat *plat,
 			      struct sandbox_flash_priv *priv, const void *buff,
 			      int len)
@@ -285,6 +458,13 @@ static int handle_ufi_command(struct sandbox_flash_plat *plat,
 			    be16_to_cpu(req->transfer_len));
 		break;
 	}
+	case SCSI_WRITE10: {
+		struct scsi_read10_req *req = (void *)buff;
+
+		handle_write(priv, be32_to_cpu(req->lba),
+			     be16_to_cpu(req->transfer_len));
+		break;
+	}
 	default:
 		debug("Command not supported: %x\n", req->cmd[0]);
 		return -EPROTONOSUPPORT;
@@ -294,6 +474,131 @@ static int handle_ufi_command(struct sandbox_flash_plat *plat,
 	return 0;
 }
 
+static int sandbox_flash_data_in(struct sandbox_flash_priv *priv, void *buff,
+				 int len)
+{
+	debug("data in, len=%x, alloc_len=%x, priv->read_len=%x\n",
+	      len, priv->alloc_len, priv->read_len);
+	if (priv->read_len) {
+		ulong bytes_read;
+
+		bytes_read = os_read(priv->fd, buff, len);
+		if (bytes_read != len)
+			return -EIO;
+		priv->read_len -= len / SANDBOX_FLASH_BLOCK_LEN;
+		if (!priv->read_len)
+			priv->phase = PHASE_STATUS;
+	} else {
+		if (priv->alloc_len && len > priv->alloc_len)
+			len = priv->alloc_len;
+		memcpy(buff, priv->buff, len);
+		priv->phase = PHASE_STATUS;
+	}
+
+	return len;
+}
+
+static int sandbox_flash_data_out(struct sandbox_flash_priv *priv,
+				  const void *buff, int len)
+{
+	debug("data out, len=%x, priv->write_len=%x\n", len, priv->write_len);
+	if (len > priv->write_len * SANDBOX_FLASH_BLOCK_LEN)
+		return -EIO;
+	if (os_write(priv->fd, buff, len) != len)
+		return -EIO;
+	priv->write_len -= len / SANDBOX_FLASH_BLOCK_LEN;
+	if (!priv->write_len)
+		priv->phase = PHASE_STATUS;
+
+	return len;
+}
+
+/* Queue a UAS command IU until the host asks for its status */
+static int sandbox_flash_uas_cmd(struct sandbox_flash_priv *priv,
+				 const void *buff, int len)
+{
+	const struct command_iu *iu = buff;
+	struct sandbox_flash_uas_cmd *cmd;
+
+	if (priv->altsetting != 1 || len < sizeof(*iu) ||
+	    iu->iu_id != IU_ID_COMMAND || iu->lun[1] ||
+	    priv->uas_queued == SANDBOX_FLASH_UAS_QUEUE)
+		return -EIO;
+
+	cmd = &priv->uas_queue[priv->uas_queued++];
+	cmd->tag = be16_to_cpu(iu->tag);
+	memcpy(cmd->cdb, iu->cdb, sizeof(cmd->cdb));
+	priv->uas_max_queued = max(priv->uas_max_queued,
+				   priv->uas_queued + priv->uas_busy);
+
+	return len;
+}
+
+/*
+ * Answer a read of the UAS status pipe: start the newest queued command and
+ * announce its data phase with a READ READY or WRITE READY IU, or once there
+ * is no data left to move, complete it with a sense IU.
+ */
+static int sandbox_flash_uas_status(struct sandbox_flash_plat *plat,
+				    struct sandbox_flash_priv *priv,
+				    void *buff, int len)
+{
+	struct sense_iu *siu = buff;
+	struct sandbox_flash_uas_cmd *cmd;
+	struct iu *iu = buff;
+	int ret, sense_len = 0;
+
+	if (!priv->uas_busy) {
+		if (!priv->uas_queued)
+			return -EIO;
+		cmd = &priv->uas_queue[--priv->uas_queued];
+		priv->tag = cmd->tag;
+		priv->uas_busy = true;
+		priv->alloc_len = 0;
+		priv->read_len = 0;
+		priv->write_len = 0;
+		priv->transfer_len = 0;
+		ret = handle_ufi_command(plat, priv, cmd->cdb,
+					 sizeof(cmd->cdb));
+		if (ret || priv->status.bCSWStatus != CSWSTATUS_GOOD) {
+			priv->uas_status = S_CHECK_COND;
+		} else {
+			priv->uas_status = S_GOOD;
+			if (priv->read_len || priv->write_len ||
+			    priv->buff_used) {
+				if (len < sizeof(*iu))
+					return -EIO;
+				memset(iu, '\0', sizeof(*iu));
+				iu->iu_id = priv->write_len ?
+					IU_ID_WRITE_READY : IU_ID_READ_READY;
+				iu->tag = cpu_to_be16(priv->tag);
+				priv->phase = PHASE_DATA;
+				return sizeof(*iu);
+			}
+		}
+		priv->phase = PHASE_STATUS;
+	}
+
+	if (priv->phase != PHASE_STATUS || len < sizeof(*siu))
+		return -EIO;
+	memset(siu, '\0', sizeof(*siu));
+	siu->iu_id = IU_ID_STATUS;
+	siu->tag = cpu_to_be16(priv->tag);
+	siu->status = priv->uas_status;
+	if (priv->uas_status == S_CHECK_COND) {
+		/* fixed format sense data: ILLEGAL REQUEST */
+		sense_len = 18;
+		siu->sense[0] = 0x70;
+		siu->sense[2] = SENSE_ILLEGAL_REQUEST;
+		siu->sense[7] = sense_len - 8;
+		siu->len = cpu_to_be16(sense_len);
+	}
+	priv->uas_busy = false;
+	priv->phase = PHASE_START;
+
+	return offsetof(struct sense_iu, sense) + sense_len;
+}
+
 static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 			      unsigned long pipe, void *buff, int len)
 {
@@ -310,6 +615,7 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 		case PHASE_START:
 			priv->alloc_len = 0;
 			priv->read_len = 0;
+			priv->write_len = 0;
 			if (priv->error || len != UMASS_BBB_CBW_SIZE ||
 			    cbw->dCBWSignature != CBWSIGNATURE)
 				goto err;
@@ -323,32 +629,15 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 			return handle_ufi_command(plat, priv, cbw->CBWCDB,
 						  cbw->bCDBLength);
 		case PHASE_DATA:
-			debug("data out\n");
-			break;
+			return sandbox_flash_data_out(priv, buff, len);
 		default:
 			break;
 		}
+		break;
 	case SANDBOX_FLASH_EP_IN:
 		switch (priv->phase) {
 		case PHASE_DATA:
-			debug("data in, len=%x, alloc_len=%x, priv->read_len=%x\n",
-			      len, priv->alloc_len, priv->read_len);
-			if (priv->read_len) {
-				ulong bytes_read;
-
-				bytes_read = os_read(priv->fd, buff, len);
-				if (bytes_read != len)
-					return -EIO;
-				priv->read_len -= len / SANDBOX_FLASH_BLOCK_LEN;
-				if (!priv->read_len)
-					priv->phase = PHASE_STATUS;
-			} else {
-				if (priv->alloc_len && len > priv->alloc_len)
-					len = priv->alloc_len;
-				memcpy(buff, priv->buff, len);
-				priv->phase = PHASE_STATUS;
-			}
-			return len;
+			return sandbox_flash_data_in(priv, buff, len);
 		case PHASE_STATUS:
 			debug("status in, len=%x\n", len);
 			if (len > sizeof(priv->status))
@@ -359,6 +648,19 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 		default:
 			break;
 		}
+		break;
+	case SANDBOX_FLASH_EP_CMD:
+		return sandbox_flash_uas_cmd(priv, buff, len);
+	case SANDBOX_FLASH_EP_STATUS:
+		return sandbox_flash_uas_status(plat, priv, buff, len);
+	case SANDBOX_FLASH_EP_DATA_IN:
+		if (priv->uas_busy && priv->phase == PHASE_DATA)
+			return sandbox_flash_data_in(priv, buff, len);
+		break;
+	case SANDBOX_FLASH_EP_DATA_OUT:
+		if (priv->uas_busy && priv->phase == PHASE_DATA)
+			return sandbox_flash_data_out(priv, buff, len);
+		break;
 	}
 err:
 	priv->error = true;
@@ -366,6 +668,13 @@ err:
 	return 0;
 }
 
+int sandbox_usb_flash_max_queued(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return priv->uas_max_queued;
+}
+
 static int sandbox_flash_of_to_plat(struct udevice *dev)
 {
 	struct sandbox_flash_plat *plat = dev_get_plat(dev);
@@ -388,7 +697,9 @@ static int sandbox_flash_bind(struct udevice *dev)
 	fs[2].id = STRINGID_SERIAL;
 	fs[2].s = dev->name;
 
-	return usb_emul_setup_device(dev, plat->flash_strings, flash_desc_list);
+	return usb_emul_setup_device(dev, plat->flash_strings,
+				     dev_read_bool(dev, "sandbox,uas") ?
+				     flash_uas_desc_list : flash_desc_list);
 }
 
 static int sandbox_flash_probe(struct udevice *dev)
@@ -396,7 +707,9 @@ static int sandbox_flash_probe(struct udevice *dev)
 	struct sandbox_flash_plat *plat = dev_get_plat(dev);
 	struct sandbox_flash_priv *priv = dev_get_priv(dev);
 
-	priv->fd = os_open(plat->pathname, OS_O_RDONLY);
+	priv->fd = os_open(plat->pathname, OS_O_RDWR);
+	if (priv->fd == -1)
+		priv->fd = os_open(plat->pathname, OS_O_RDONLY);
 	if (priv->fd != -1)
 		return os_get_filesize(plat->pathname, &priv->file_size);
 
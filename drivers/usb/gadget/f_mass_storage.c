@@ -692,11 +692,11 @@ static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = &common->luns[common->lun];
 	u32			lba;
-	struct fsg_buffhd	*bh;
+	struct fsg_buffhd	*bh, *last;
 	int			rc;
 	u32			amount_left;
 	loff_t			file_offset;
-	unsigned int		amount;
+	unsigned int		amount, nbufs;
 	unsigned int		partial_page;
 	ssize_t			nread;
 
@@ -728,28 +728,36 @@ static int do_read(struct fsg_common *common)
 
 	for (;;) {
 
+		/* Wait for the next buffer to become available */
+		bh = common->next_buffhd_to_fill;
+		while (bh->state != BUF_STATE_EMPTY) {
+			rc = sleep_thread(common);
+			if (rc)
+				return rc;
+		}
+
+		/* Take in the empty buffers that follow it in memory, so
+		 * that the block device sees one large read */
+		nbufs = 1;
+		for (last = bh; nbufs * FSG_BUFLEN < amount_left &&
+		     last->next == last + 1 &&
+		     last->next->state == BUF_STATE_EMPTY; last = last->next)
+			nbufs++;
+
 		/* Figure out how much we need to read:
 		 * Try to read the remaining amount.
-		 * But don't read more than the buffer size.
+		 * But don't read more than the buffers can hold.
 		 * And don't try to read past the end of the file.
 		 * Finally, if we're not at a page boundary, don't read past
 		 *	the next page.
 		 * If this means reading 0 then we were asked to read past
 		 *	the end of file. */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, nbufs * FSG_BUFLEN);
 		partial_page = file_offset & (PAGE_CACHE_SIZE - 1);
 		if (partial_page > 0)
 			amount = min(amount, (unsigned int) PAGE_CACHE_SIZE -
 					partial_page);
 
-		/* Wait for the next buffer to become available */
-		bh = common->next_buffhd_to_fill;
-		while (bh->state != BUF_STATE_EMPTY) {
-			rc = sleep_thread(common);
-			if (rc)
-				return rc;
-		}
-
 		/* If we were asked to read past the end of file,
 		 * end with an empty buffer. */
 		if (amount == 0) {
@@ -787,6 +795,20 @@ static int do_read(struct fsg_common *common)
 		file_offset  += nread;
 		amount_left  -= nread;
 		common->residue -= nread;
+
+		/* Send all but the last of the filled buffers right away */
+		while (nread > FSG_BUFLEN) {
+			bh->inreq->length = FSG_BUFLEN;
+			bh->inreq->zero = 0;
+			bh->state = BUF_STATE_FULL;
+			START_TRANSFER_OR(common, bulk_in, bh->inreq,
+					  &bh->inreq_busy, &bh->state)
+				return -EIO;
+			bh = bh->next;
+			common->next_buffhd_to_fill = bh;
+			nread -= FSG_BUFLEN;
+			amount -= FSG_BUFLEN;
+		}
 		bh->inreq->length = nread;
 		bh->state = BUF_STATE_FULL;
 
@@ -819,7 +841,7 @@ static int do_write(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = &common->luns[common->lun];
 	u32			lba;
-	struct fsg_buffhd	*bh;
+	struct fsg_buffhd	*bh, *last;
 	int			get_some_more;
 	u32			amount_left_to_req, amount_left_to_write;
 	loff_t			usb_offset, file_offset;
@@ -935,6 +957,24 @@ static int do_write(struct fsg_common *common)
 
 			amount = bh->outreq->actual;
 
+			/*
+			 * Merge the buffers that have already arrived behind
+			 * this one into the same write, as long as they
+			 * follow it in memory and every buffer but the last
+			 * is completely full, so that the data is contiguous.
+			 */
+			last = bh;
+			while (last->outreq->actual == FSG_BUFLEN &&
+			       last->next == last + 1 &&
+			       last->next->state == BUF_STATE_FULL &&
+			       !last->next->outreq->status &&
+			       amount < amount_left_to_write) {
+				last = last->next;
+				last->state = BUF_STATE_EMPTY;
+				amount += last->outreq->actual;
+			}
+			common->next_buffhd_to_drain = last->next;
+
 			/* Perform the write */
 			rc = ums[common->lun].write_sector(&ums[common->lun],
 					       file_offset / SECTOR_SIZE,
@@ -972,7 +1012,7 @@ static int do_write(struct fsg_common *common)
 			}
 
 			/* Did the host decide to stop early? */
-			if (bh->outreq->actual != bh->outreq->length) {
+			if (last->outreq->actual != last->outreq->length) {
 				common->short_packet_received = 1;
 				break;
 			}
@@ -2497,22 +2537,30 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 	}
 	common->lun = 0;
 
-	/* Data buffers cyclic list */
+	/*
+	 * Data buffers cyclic list. The buffers come from one allocation and
+	 * follow each other in memory, so do_write() can hand consecutive
+	 * full buffers to the block device as a single write. That needs
+	 * every buffer to hold whole sectors.
+	 */
+	BUILD_BUG_ON(FSG_BUFLEN % SECTOR_SIZE);
 	bh = common->buffhds;
+	bh->buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+			   FSG_NUM_BUFFERS * FSG_BUFLEN);
+	if (unlikely(!bh->buf)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
 
 	i = FSG_NUM_BUFFERS;
 	goto buffhds_first_it;
 	do {
 		bh->next = bh + 1;
 		++bh;
+		bh->buf = (bh - 1)->buf + FSG_BUFLEN;
 buffhds_first_it:
 		bh->inreq_busy = 0;
 		bh->outreq_busy = 0;
-		bh->buf = memalign(CONFIG_SYS_CACHELINE_SIZE, FSG_BUFLEN);
-		if (unlikely(!bh->buf)) {
-			rc = -ENOMEM;
-			goto error_release;
-		}
 	} while (--i);
 	bh->next = common->buffhds;
 
@@ -2574,13 +2622,8 @@ static void fsg_common_release(struct kref *ref)
 		kfree(common->luns);
 	}
 
-	{
-		struct fsg_buffhd *bh = common->buffhds;
-		unsigned i = FSG_NUM_BUFFERS;
-		do {
-			kfree(bh->buf);
-		} while (++bh, --i);
-	}
+	/* All data buffers share the allocation made for the first one */
+	kfree(common->buffhds[0].buf);
 
 	if (common->free_storage_on_release)
 		kfree(common);
@@ -0,0 +1,394 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sandbox USB device controller
+ *
+ * There is no bus here. Instead a test installs a host function, which is
+ * called each time the gadget polls for interrupts. It plays the part of
+ * the USB host by sending control requests and moving data to and from the
+ * requests queued on the endpoints.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <g_dnl.h>
+#include <malloc.h>
+#include <asm/test.h>
+#include <linux/list.h>
+#include <linux/usb/ch9.h>
+#include <linux/usb/gadget.h>
+
+enum {
+	SANDBOX_UDC_NUM_EPS	= 5,	/* ep0 plus two bulk in and two out */
+	SANDBOX_UDC_MAXPACKET	= 512,
+};
+
+struct sandbox_udc_req {
+	struct usb_request req;
+	struct list_head queue;
+};
+
+struct sandbox_udc_ep {
+	struct usb_ep ep;
+	struct list_head queue;
+	char name[16];
+	bool halted;
+};
+
+/**
+ * struct sandbox_udc - sandbox USB device controller
+ *
+ * @gadget:	Gadget presented to the gadget layer
+ * @driver:	Gadget driver bound to the controller, or NULL
+ * @ep:		Endpoints, where ep[n] has endpoint number n
+ * @host:	Function emulating the host, or NULL
+ * @host_priv:	Private data for @host
+ * @connected:	true while the emulated cable is plugged in
+ * @setup_in:	true if the current control request has an IN data stage
+ * @setup_buf:	Host buffer for the data stage of the control request
+ * @setup_len:	Length of the data stage requested by the host
+ * @setup_actual: Number of bytes moved in the data stage
+ */
+struct sandbox_udc {
+	struct usb_gadget gadget;
+	struct usb_gadget_driver *driver;
+	struct sandbox_udc_ep ep[SANDBOX_UDC_NUM_EPS];
+	sandbox_udc_host_t host;
+	void *host_priv;
+	bool connected;
+	bool setup_in;
+	void *setup_buf;
+	int setup_len;
+	int setup_actual;
+};
+
+/* The controller in use, for g_dnl_board_usb_cable_connected() */
+static struct sandbox_udc *sandbox_udc;
+
+#define to_sandbox_req(r)	container_of((r), struct sandbox_udc_req, req)
+#define to_sandbox_ep(e)	container_of((e), struct sandbox_udc_ep, ep)
+
+static struct usb_endpoint_descriptor sandbox_udc_ep0_desc = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+	.bEndpointAddress	= 0,
+	.bmAttributes		= USB_ENDPOINT_XFER_CONTROL,
+	.wMaxPacketSize		= cpu_to_le16(64),
+};
+
+int g_dnl_board_usb_cable_connected(void)
+{
+	return sandbox_udc && sandbox_udc->connected;
+}
+
+/* Take the oldest request off an endpoint and give it back to the gadget */
+static void sandbox_udc_done(struct sandbox_udc_ep *ep,
+			     struct sandbox_udc_req *sreq, int status)
+{
+	list_del_init(&sreq->queue);
+	sreq->req.status = status;
+	if (sreq->req.complete)
+		sreq->req.complete(&ep->ep, &sreq->req);
+}
+
+static void sandbox_udc_nuke(struct sandbox_udc_ep *ep, int status)
+{
+	struct sandbox_udc_req *sreq;
+
+	while (!list_empty(&ep->queue)) {
+		sreq = list_first_entry(&ep->queue, struct sandbox_udc_req,
+					queue);
+		sandbox_udc_done(ep, sreq, status);
+	}
+}
+
+/* Run the data and status stages of the current control request */
+static void sandbox_udc_ep0_run(struct sandbox_udc *udc)
+{
+	struct sandbox_udc_ep *ep = &udc->ep[0];
+	struct sandbox_udc_req *sreq;
+	int len;
+
+	while (!list_empty(&ep->queue)) {
+		sreq = list_first_entry(&ep->queue, struct sandbox_udc_req,
+					queue);
+		len = min((int)sreq->req.length,
+			  udc->setup_len - udc->setup_actual);
+		if (len > 0 && udc->setup_in)
+			memcpy(udc->setup_buf + udc->setup_actual,
+			       sreq->req.buf, len);
+		else if (len > 0)
+			memcpy(sreq->req.buf,
+			       udc->setup_buf + udc->setup_actual, len);
+		len = max(len, 0);
+		udc->setup_actual += len;
+		sreq->req.actual = len;
+		sandbox_udc_done(ep, sreq, 0);
+	}
+}
+
+static int sandbox_udc_ep_enable(struct usb_ep *_ep,
+				 const struct usb_endpoint_descriptor *desc)
+{
+	struct sandbox_udc_ep *ep = to_sandbox_ep(_ep);
+
+	_ep->desc = desc;
+	_ep->maxpacket = usb_endpoint_maxp(desc) & 0x7ff;
+	ep->halted = false;
+
+	return 0;
+}
+
+static int sandbox_udc_ep_disable(struct usb_ep *_ep)
+{
+	struct sandbox_udc_ep *ep = to_sandbox_ep(_ep);
+
+	sandbox_udc_nuke(ep, -ESHUTDOWN);
+	_ep->desc = NULL;
+
+	return 0;
+}
+
+static struct usb_request *sandbox_udc_alloc_request(struct usb_ep *_ep,
+						     gfp_t gfp_flags)
+{
+	struct sandbox_udc_req *sreq;
+
+	sreq = calloc(1, sizeof(*sreq));
+	if (!sreq)
+		return NULL;
+	INIT_LIST_HEAD(&sreq->queue);
+
+	return &sreq->req;
+}
+
+static void sandbox_udc_free_request(struct usb_ep *_ep,
+				     struct usb_request *req)
+{
+	free(to_sandbox_req(req));
+}
+
+static int sandbox_udc_ep_queue(struct usb_ep *_ep, struct usb_request *req,
+				gfp_t gfp_flags)
+{
+	struct sandbox_udc_ep *ep = to_sandbox_ep(_ep);
+	struct sandbox_udc_req *sreq = to_sandbox_req(req);
+
+	if (!list_empty(&sreq->queue))
+		return -EBUSY;
+	req->actual = 0;
+	req->status = -EINPROGRESS;
+	list_add_tail(&sreq->queue, &ep->queue);
+
+	return 0;
+}
+
+static int sandbox_udc_ep_dequeue(struct usb_ep *_ep, struct usb_request *req)
+{
+	struct sandbox_udc_ep *ep = to_sandbox_ep(_ep);
+	struct sandbox_udc_req *sreq = to_sandbox_req(req);
+
+	if (list_empty(&sreq->queue))
+		return -EINVAL;
+	sandbox_udc_done(ep, sreq, -ECONNRESET);
+
+	return 0;
+}
+
+static int sandbox_udc_ep_set_halt(struct usb_ep *_ep, int value)
+{
+	struct sandbox_udc_ep *ep = to_sandbox_ep(_ep);
+
+	ep->halted = value;
+
+	return 0;
+}
+
+static const struct usb_ep_ops sandbox_udc_ep_ops = {
+	.enable		= sandbox_udc_ep_enable,
+	.disable	= sandbox_udc_ep_disable,
+	.alloc_request	= sandbox_udc_alloc_request,
+	.free_request	= sandbox_udc_free_request,
+	.queue		= sandbox_udc_ep_queue,
+	.dequeue	= sandbox_udc_ep_dequeue,
+	.set_halt	= sandbox_udc_ep_set_halt,
+};
+
+static int sandbox_udc_get_frame(struct usb_gadget *gadget)
+{
+	return 0;
+}
+
+static int sandbox_udc_start(struct usb_gadget *gadget,
+			     struct usb_gadget_driver *driver)
+{
+	struct sandbox_udc *udc = container_of(gadget, struct sandbox_udc,
+					       gadget);
+
+	udc->driver = driver;
+
+	return 0;
+}
+
+static int sandbox_udc_stop(struct usb_gadget *gadget)
+{
+	struct sandbox_udc *udc = container_of(gadget, struct sandbox_udc,
+					       gadget);
+	int i;
+
+	for (i = 0; i < SANDBOX_UDC_NUM_EPS; i++)
+		sandbox_udc_nuke(&udc->ep[i], -ESHUTDOWN);
+	udc->driver = NULL;
+
+	return 0;
+}
+
+static const struct usb_gadget_ops sandbox_udc_ops = {
+	.get_frame	= sandbox_udc_get_frame,
+	.udc_start	= sandbox_udc_start,
+	.udc_stop	= sandbox_udc_stop,
+};
+
+void sandbox_udc_set_host(struct udevice *dev, sandbox_udc_host_t host,
+			  void *priv)
+{
+	struct sandbox_udc *udc = dev_get_priv(dev);
+
+	udc->host = host;
+	udc->host_priv = priv;
+	udc->connected = !!host;
+}
+
+int sandbox_udc_control(struct udevice *dev,
+			const struct usb_ctrlrequest *ctrl, void *buf)
+{
+	struct sandbox_udc *udc = dev_get_priv(dev);
+	int ret;
+
+	if (!udc->driver)
+		return -ENODEV;
+	udc->setup_in = ctrl->bRequestType & USB_DIR_IN;
+	udc->setup_buf = buf;
+	udc->setup_len = le16_to_cpu(ctrl->wLength);
+	udc->setup_actual = 0;
+	ret = udc->driver->setup(&udc->gadget, ctrl);
+	if (ret < 0) {
+		sandbox_udc_nuke(&udc->ep[0], -EPIPE);
+		return -EPIPE;
+	}
+	sandbox_udc_ep0_run(udc);
+	udc->setup_buf = NULL;
+	udc->setup_len = 0;
+
+	return udc->setup_actual;
+}
+
+int sandbox_udc_bulk(struct udevice *dev, int ep_addr, void *buf, int len)
+{
+	struct sandbox_udc *udc = dev_get_priv(dev);
+	struct sandbox_udc_req *sreq;
+	struct sandbox_udc_ep *ep;
+	int num = ep_addr & USB_ENDPOINT_NUMBER_MASK;
+
+	if (!num || num >= SANDBOX_UDC_NUM_EPS)
+		return -EINVAL;
+	ep = &udc->ep[num];
+	if (!ep->ep.desc || ep->ep.desc->bEndpointAddress != ep_addr)
+		return -ENOENT;
+	if (ep->halted)
+		return -EPIPE;
+	if (list_empty(&ep->queue))
+		return -EAGAIN;
+
+	sreq = list_first_entry(&ep->queue, struct sandbox_udc_req, queue);
+	len = min(len, (int)sreq->req.length);
+	if (ep_addr & USB_DIR_IN)
+		memcpy(buf, sreq->req.buf, len);
+	else
+		memcpy(sreq->req.buf, buf, len);
+	sreq->req.actual = len;
+	sandbox_udc_done(ep, sreq, 0);
+
+	return len;
+}
+
+void sandbox_udc_disconnect(struct udevice *dev)
+{
+	struct sandbox_udc *udc = dev_get_priv(dev);
+
+	udc->connected = false;
+	if (udc->driver && udc->driver->disconnect)
+		udc->driver->disconnect(&udc->gadget);
+}
+
+int dm_usb_gadget_handle_interrupts(struct udevice *dev)
+{
+	struct sandbox_udc *udc = dev_get_priv(dev);
+
+	/* A control request may have been answered after setup() returned */
+	sandbox_udc_ep0_run(udc);
+	if (udc->host && udc->connected && udc->driver)
+		udc->host(dev, udc->host_priv);
+
+	return 0;
+}
+
+static int sandbox_udc_probe(struct udevice *dev)
+{
+	struct sandbox_udc *udc = dev_get_priv(dev);
+	int i;
+
+	udc->gadget.ops = &sandbox_udc_ops;
+	udc->gadget.ep0 = &udc->ep[0].ep;
+	udc->gadget.speed = USB_SPEED_HIGH;
+	udc->gadget.max_speed = USB_SPEED_HIGH;
+	udc->gadget.is_dualspeed = 1;
+	udc->gadget.name = "sandbox-udc";
+
+	INIT_LIST_HEAD(&udc->gadget.ep_list);
+	for (i = 0; i < SANDBOX_UDC_NUM_EPS; i++) {
+		struct sandbox_udc_ep *ep = &udc->ep[i];
+
+		INIT_LIST_HEAD(&ep->queue);
+		ep->ep.ops = &sandbox_udc_ep_ops;
+		ep->ep.name = ep->name;
+		ep->ep.maxpacket = SANDBOX_UDC_MAXPACKET;
+		if (!i) {
+			strcpy(ep->name, "ep0");
+			ep->ep.maxpacket = 64;
+			ep->ep.desc = &sandbox_udc_ep0_desc;
+			continue;
+		}
+		/* odd endpoints are IN, even ones OUT */
+		snprintf(ep->name, sizeof(ep->name), "ep%d%s-bulk", i,
+			 i & 1 ? "in" : "out");
+		list_add_tail(&ep->ep.ep_list, &udc->gadget.ep_list);
+	}
+	sandbox_udc = udc;
+
+	return usb_add_gadget_udc((struct device *)dev, &udc->gadget);
+}
+
+static int sandbox_udc_remove(struct udevice *dev)
+{
+	struct sandbox_udc *udc = dev_get_priv(dev);
+
+	usb_del_gadget_udc(&udc->gadget);
+	if (sandbox_udc == udc)
+		sandbox_udc = NULL;
+
+	return 0;
+}
+
+static const struct udevice_id sandbox_udc_ids[] = {
+	{ .compatible = "sandbox,usb-udc" },
+	{ }
+};
+
+U_BOOT_DRIVER(sandbox_udc) = {
+	.name		= "sandbox_udc",
+	.id		= UCLASS_USB_GADGET_GENERIC,
+	.of_match	= sandbox_udc_ids,
+	.probe		= sandbox_udc_probe,
+	.remove		= sandbox_udc_remove,
+	.priv_auto	= sizeof(struct sandbox_udc),
+};
@@ -15,6 +15,7 @@
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
+#include <linux/delay.h>
 
 extern bool usb_started; /* flag for the started/stopped USB status */
 static bool asynch_allowed;
@@ -171,6 +172,82 @@ int usb_get_max_xfer_size(struct usb_device *udev, size_t *size)
 	return ops->get_max_xfer_size(bus, size);
 }
 
+int usb_alloc_streams(struct usb_device *udev, unsigned long *pipes,
+		      int num_pipes, unsigned int num_streams)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->alloc_streams || !ops->bulk_stream)
+		return -ENOSYS;
+
+	return ops->alloc_streams(bus, udev, pipes, num_pipes, num_streams);
+}
+
+int usb_bulk_msg_stream(struct usb_device *udev, unsigned int pipe,
+			unsigned int stream_id, void *data, int len,
+			int *actual_length, int timeout)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (len < 0)
+		return -EINVAL;
+	if (!ops->bulk_stream)
+		return -ENOSYS;
+	udev->status = USB_ST_NOT_PROC; /* not yet processed */
+	if (ops->bulk_stream(bus, udev, pipe, stream_id, data, len) < 0)
+		return -EIO;
+	while (timeout--) {
+		if (!((volatile unsigned long)udev->status & USB_ST_NOT_PROC))
+			break;
+		mdelay(1);
+	}
+	*actual_length = udev->act_len;
+
+	return udev->status ? -EIO : 0;
+}
+
+int usb_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+	int ret;
+
+	req->done = false;
+	req->actual_length = 0;
+	req->status = USB_ST_NOT_PROC;
+	if (ops->bulk_submit && ops->bulk_reap)
+		return ops->bulk_submit(bus, udev, req);
+
+	/* The controller cannot queue transfers, so do it now */
+	if (req->stream_id)
+		ret = usb_bulk_msg_stream(udev, req->pipe, req->stream_id,
+					  req->buffer, req->length,
+					  &req->actual_length,
+					  USB_CNTL_TIMEOUT * 5);
+	else
+		ret = usb_bulk_msg(udev, req->pipe, req->buffer, req->length,
+				   &req->actual_length, USB_CNTL_TIMEOUT * 5);
+	if (ret == -EINVAL || ret == -ENOSYS)
+		return ret;
+	req->status = ret ? udev->status | USB_ST_NOT_PROC : 0;
+	req->done = true;
+
+	return 0;
+}
+
+int usb_bulk_reap(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!req->done && ops->bulk_submit && ops->bulk_reap)
+		return ops->bulk_reap(bus, udev, req);
+
+	return req->status ? -EIO : 0;
+}
+
 int usb_stop(void)
 {
 	struct udevice *bus;
@@ -128,6 +128,29 @@ static void xhci_free_container_ctx(struct xhci_container_ctx *ctx)
 	free(ctx);
 }
 
+/**
+ * frees the stream context array and the stream rings of an endpoint
+ *
+ * @param ep	endpoint which may have been given streams
+ * @return none
+ */
+void xhci_free_stream_info(struct xhci_virt_ep *ep)
+{
+	unsigned int i;
+
+	if (!ep->stream_rings)
+		return;
+
+	/* Stream ID 0 is reserved and has no ring */
+	for (i = 1; i < ep->num_stream_ctxs; i++)
+		xhci_ring_free(ep->stream_rings[i]);
+	free(ep->stream_rings);
+	free(ep->stream_ctx);
+	ep->stream_rings = NULL;
+	ep->stream_ctx = NULL;
+	ep->num_stream_ctxs = 0;
+}
+
 /**
  * frees the virtual devices for "xhci_ctrl" pointer passed
  *
@@ -151,9 +174,11 @@ static void xhci_free_virt_devices(struct xhci_ctrl *ctrl)
 
 		ctrl->dcbaa->dev_context_ptrs[slot_id] = 0;
 
-		for (i = 0; i < 31; ++i)
+		for (i = 0; i < 31; ++i) {
 			if (virt_dev->eps[i].ring)
 				xhci_ring_free(virt_dev->eps[i].ring);
+			xhci_free_stream_info(&virt_dev->eps[i]);
+		}
 
 		if (virt_dev->in_ctx)
 			xhci_free_container_ctx(virt_dev->in_ctx);
@@ -264,6 +289,10 @@ static void xhci_initialize_ring_info(struct xhci_ring *ring)
 	 * check ownership, so CCS = 1.
 	 */
 	ring->cycle_state = 1;
+
+	ring->td_first = 0;
+	ring->num_tds = 0;
+	ring->num_trbs_queued = 0;
 }
 
 /**
@@ -313,6 +342,7 @@ struct xhci_ring *xhci_ring_alloc(struct xhci_ctrl *ctrl, unsigned int num_segs,
 	ring = malloc(sizeof(struct xhci_ring));
 	BUG_ON(!ring);
 
+	ring->num_segs = num_segs;
 	if (num_segs == 0)
 		return ring;
 
@@ -499,6 +529,43 @@ int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id)
 	return 0;
 }
 
+/**
+ * Allocate a linear primary stream context array for an endpoint, with one
+ * transfer ring for each stream ID. Stream ID 0 is reserved. The caller
+ * points the endpoint context at the array with a Configure Endpoint command.
+ *
+ * @param ctrl		Host controller data structure
+ * @param ep		endpoint to set up
+ * @param num_stream_ctxs	size of the array, a power of two
+ * @return none
+ */
+void xhci_alloc_stream_info(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			    unsigned int num_stream_ctxs)
+{
+	struct xhci_ring *ring;
+	unsigned int i;
+	u64 val_64;
+
+	xhci_free_stream_info(ep);
+
+	ep->stream_ctx = xhci_malloc(num_stream_ctxs *
+				     sizeof(struct xhci_stream_ctx));
+	ep->stream_rings = calloc(num_stream_ctxs, sizeof(struct xhci_ring *));
+	BUG_ON(!ep->stream_rings);
+	ep->num_stream_ctxs = num_stream_ctxs;
+
+	for (i = 1; i < num_stream_ctxs; i++) {
+		ring = xhci_ring_alloc(ctrl, 1, true);
+		ep->stream_rings[i] = ring;
+		val_64 = xhci_virt_to_bus(ctrl, ring->enqueue);
+		ep->stream_ctx[i].stream_ring = cpu_to_le64(val_64 |
+				SCT_FOR_CTX(SCT_PRI_TR) | ring->cycle_state);
+	}
+
+	xhci_flush_cache((uintptr_t)ep->stream_ctx,
+			 num_stream_ctxs * sizeof(struct xhci_stream_ctx));
+}
+
 /**
  * Allocates the necessary data structures
  * for XHCI host controller
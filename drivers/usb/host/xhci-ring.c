@@ -268,11 +268,12 @@ static int prepare_ring(struct xhci_ctrl *ctrl, struct xhci_ring *ep_ring,
  * @param ptr		Pointer address to write in the first two fields (opt.)
  * @param slot_id	Slot ID to encode in the flags field (opt.)
  * @param ep_index	Endpoint index to encode in the flags field (opt.)
+ * @param stream_id	Stream ID for 'set TR dequeue pointer' (opt.)
  * @param cmd		Command type to enqueue
  * @return none
  */
-void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
-			u32 ep_index, trb_type cmd)
+static void queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
+			  u32 ep_index, unsigned int stream_id, trb_type cmd)
 {
 	u32 fields[4];
 	u64 val_64 = 0;
@@ -294,6 +295,8 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
 	 */
 	if (cmd >= TRB_RESET_EP && cmd <= TRB_SET_DEQ)
 		fields[3] |= EP_ID_FOR_TRB(ep_index);
+	if (cmd == TRB_SET_DEQ)
+		fields[2] = STREAM_ID_FOR_TRB(stream_id);
 
 	queue_trb(ctrl, ctrl->cmd_ring, false, fields);
 
@@ -301,6 +304,22 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
 	xhci_writel(&ctrl->dba->doorbell[0], DB_VALUE_HOST);
 }
 
+/**
+ * Queue a command TRB which does not refer to a stream
+ *
+ * @param ctrl		Host controller data structure
+ * @param ptr		Pointer address to write in the first two fields (opt.)
+ * @param slot_id	Slot ID to encode in the flags field (opt.)
+ * @param ep_index	Endpoint index to encode in the flags field (opt.)
+ * @param cmd		Command type to enqueue
+ * @return none
+ */
+void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
+			u32 ep_index, trb_type cmd)
+{
+	queue_command(ctrl, ptr, slot_id, ep_index, 0, cmd);
+}
+
 /*
  * For xHCI 1.0 host controllers, TD size is the number of max packet sized
  * packets remaining in the TD (*not* including this TRB).
@@ -359,12 +378,13 @@ static u32 xhci_td_remainder(struct xhci_ctrl *ctrl, int transferred,
  *
  * @param udev		pointer to the USB device structure
  * @param ep_index	index of the endpoint
+ * @param stream_id	stream the TD was queued on, 0 if none
  * @param start_cycle	cycle flag of the first TRB
  * @param start_trb	pionter to the first TRB
  * @return none
  */
 static void giveback_first_trb(struct usb_device *udev, int ep_index,
-				int start_cycle,
+				unsigned int stream_id, int start_cycle,
 				struct xhci_generic_trb *start_trb)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
@@ -382,7 +402,7 @@ static void giveback_first_trb(struct usb_device *udev, int ep_index,
 
 	/* Ringing EP doorbell here */
 	xhci_writel(&ctrl->dba->doorbell[udev->slot_id],
-				DB_VALUE(ep_index, 0));
+				DB_VALUE(ep_index, stream_id));
 
 	return;
 }
@@ -481,29 +501,210 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
 	BUG();
 }
 
+static void record_transfer_result(union xhci_trb *event, int length,
+				   int *act_len, unsigned long *status)
+{
+	*act_len = min(length, length -
+		(int)EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len)));
+
+	switch (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len))) {
+	case COMP_SUCCESS:
+		BUG_ON(*act_len != length);
+		/* fallthrough */
+	case COMP_SHORT_TX:
+		*status = 0;
+		break;
+	case COMP_STALL:
+		*status = USB_ST_STALLED;
+		break;
+	case COMP_DB_ERR:
+	case COMP_TRB_ERR:
+		*status = USB_ST_BUF_ERR;
+		break;
+	case COMP_BABBLE:
+		*status = USB_ST_BABBLE_DET;
+		break;
+	default:
+		*status = 0x80;  /* USB_ST_TOO_LAZY_TO_MAKE_A_NEW_MACRO */
+	}
+}
+
+/**
+ * Checks whether a TRB, given by its bus address, is part of a TD
+ *
+ * @param ctrl	Host controller data structure
+ * @param td	TD to look in
+ * @param addr	bus address of the TRB
+ * @return true if the TRB belongs to the TD
+ */
+static bool td_has_trb(struct xhci_ctrl *ctrl, struct xhci_td *td, u64 addr)
+{
+	struct xhci_segment *seg = td->start_seg;
+	union xhci_trb *trb = td->first_trb;
+
+	for (;;) {
+		if (xhci_virt_to_bus(ctrl, trb) == addr)
+			return true;
+		if (trb == td->last_trb)
+			return false;
+		if (TRB_TYPE_LINK_LE32((++trb)->link.control)) {
+			seg = seg->next;
+			trb = seg->trbs;
+		}
+	}
+}
+
+/**
+ * Finds the bulk TD which a transfer event reports on. The controller works
+ * through the TDs of a ring in order, so only the oldest TD of each ring of
+ * the endpoint can be the one.
+ *
+ * @param ctrl	Host controller data structure
+ * @param event	Transfer event TRB
+ * @param ringp	returns the ring holding the TD
+ * @return the TD, or NULL if the event is not for a bulk TD
+ */
+static struct xhci_td *find_td(struct xhci_ctrl *ctrl, union xhci_trb *event,
+			       struct xhci_ring **ringp)
+{
+	u32 field = le32_to_cpu(event->trans_event.flags);
+	u64 addr = le64_to_cpu(event->trans_event.buffer);
+	struct xhci_virt_device *virt_dev;
+	struct xhci_virt_ep *ep;
+	struct xhci_ring *ring;
+	struct xhci_td *td;
+	unsigned int i;
+
+	virt_dev = ctrl->devs[TRB_TO_SLOT_ID(field)];
+	if (!virt_dev)
+		return NULL;
+	ep = &virt_dev->eps[TRB_TO_EP_INDEX(field)];
+
+	for (i = 0; i < max(ep->num_stream_ctxs, 1U); i++) {
+		ring = ep->num_stream_ctxs ? ep->stream_rings[i] : ep->ring;
+		if (!ring || !ring->num_tds)
+			continue;
+		td = &ring->tds[ring->td_first];
+		if (td_has_trb(ctrl, td, addr)) {
+			*ringp = ring;
+			return td;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Accounts a transfer event to the bulk TD it belongs to, completing the
+ * TD's request when the event is for its last TRB. Acknowledges the event.
+ *
+ * @param ctrl	Host controller data structure
+ * @param event	Transfer event TRB
+ * @return none
+ */
+static void handle_bulk_event(struct xhci_ctrl *ctrl, union xhci_trb *event)
+{
+	u64 addr = le64_to_cpu(event->trans_event.buffer);
+	struct usb_bulk_req *req;
+	struct xhci_ring *ring;
+	struct xhci_td *td;
+	u32 field;
+
+	td = find_td(ctrl, event, &ring);
+	if (!td) {
+		printf("Unexpected XHCI transfer event, skipping... "
+		       "(%08x %08x %08x %08x)\n",
+		       le32_to_cpu(event->generic.field[0]),
+		       le32_to_cpu(event->generic.field[1]),
+		       le32_to_cpu(event->generic.field[2]),
+		       le32_to_cpu(event->generic.field[3]));
+		xhci_acknowledge_event(ctrl);
+		return;
+	}
+
+	/* A short packet part-way through: the TD goes on to its last TRB */
+	if (addr != xhci_virt_to_bus(ctrl, td->last_trb)) {
+		field = le32_to_cpu(event->trans_event.transfer_len);
+		td->length -= (int)EVENT_TRB_LEN(field);
+		xhci_acknowledge_event(ctrl);
+		return;
+	}
+
+	req = td->req;
+	record_transfer_result(event, td->length, &req->actual_length,
+			       &req->status);
+	xhci_acknowledge_event(ctrl);
+	xhci_inval_cache((uintptr_t)req->buffer, req->length);
+
+	ring->td_first = (ring->td_first + 1) % XHCI_MAX_TDS;
+	ring->num_tds--;
+	ring->num_trbs_queued -= td->num_trbs;
+	req->done = true;
+}
+
+/**
+ * Waits for the next transfer event for an endpoint. Events for bulk TDs
+ * on other endpoints which turn up first are handled on the way.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param ep_index	index of the endpoint
+ * @return pointer to event trb, NULL on timeout
+ */
+static union xhci_trb *wait_for_ep_event(struct usb_device *udev,
+					 int ep_index)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	union xhci_trb *event;
+	u32 field;
+
+	for (;;) {
+		event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
+		if (!event)
+			return NULL;
+		field = le32_to_cpu(event->trans_event.flags);
+		if (TRB_TO_SLOT_ID(field) == udev->slot_id &&
+		    TRB_TO_EP_INDEX(field) == ep_index)
+			return event;
+		handle_bulk_event(ctrl, event);
+	}
+}
+
 /*
  * Stops transfer processing for an endpoint and throws away all unprocessed
  * TRBs by setting the xHC's dequeue pointer to our enqueue pointer. The next
  * xhci_bulk_tx/xhci_ctrl_tx on this enpoint will add new transfers there and
  * ring the doorbell, causing this endpoint to start working again.
+ * For an endpoint with streams only the ring of @stream_id is reset.
+ * Bulk TDs thrown away are completed with a timeout.
  * (Careful: This will BUG() when there was no transfer in progress. Shouldn't
  * happen in practice for current uses and is too complicated to fix right now.)
  */
-static void abort_td(struct usb_device *udev, int ep_index)
+static void abort_td(struct usb_device *udev, int ep_index,
+		     unsigned int stream_id)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
-	struct xhci_ring *ring =  ctrl->devs[udev->slot_id]->eps[ep_index].ring;
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct xhci_ring *ring = ep->ring;
 	union xhci_trb *event;
-	u32 field;
+	struct xhci_td *td;
+	uintptr_t deq;
+	unsigned int i;
+	u32 comp;
 
 	xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index, TRB_STOP_RING);
 
-	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
-	field = le32_to_cpu(event->trans_event.flags);
-	BUG_ON(TRB_TO_SLOT_ID(field) != udev->slot_id);
-	BUG_ON(TRB_TO_EP_INDEX(field) != ep_index);
-	BUG_ON(GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len
-		!= COMP_STOP)));
+	/* TDs which finished before the endpoint stopped complete normally */
+	if (stream_id)
+		ring = ep->stream_rings[stream_id];
+	do {
+		event = wait_for_ep_event(udev, ep_index);
+		BUG_ON(!event);
+		comp = le32_to_cpu(event->trans_event.transfer_len);
+		comp = GET_COMP_CODE(comp);
+		if (comp == COMP_STOP || comp == COMP_STOP_INVAL)
+			break;
+		handle_bulk_event(ctrl, event);
+	} while (1);
 	xhci_acknowledge_event(ctrl);
 
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
@@ -512,56 +713,50 @@ static void abort_td(struct usb_device *udev, int ep_index)
 		event->event_cmd.status)) != COMP_SUCCESS);
 	xhci_acknowledge_event(ctrl);
 
-	xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
-		ring->cycle_state), udev->slot_id, ep_index, TRB_SET_DEQ);
+	deq = (uintptr_t)ring->enqueue | ring->cycle_state;
+	if (stream_id)
+		deq |= SCT_FOR_CTX(SCT_PRI_TR);
+	queue_command(ctrl, (void *)deq, udev->slot_id, ep_index, stream_id,
+		      TRB_SET_DEQ);
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
 	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
 		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
 		event->event_cmd.status)) != COMP_SUCCESS);
 	xhci_acknowledge_event(ctrl);
-}
 
-static void record_transfer_result(struct usb_device *udev,
-				   union xhci_trb *event, int length)
-{
-	udev->act_len = min(length, length -
-		(int)EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len)));
+	for (; ring->num_tds; ring->num_tds--) {
+		td = &ring->tds[ring->td_first];
+		td->req->status = USB_ST_NAK_REC; /* closest thing to a timeout */
+		td->req->actual_length = 0;
+		td->req->done = true;
+		ring->td_first = (ring->td_first + 1) % XHCI_MAX_TDS;
+	}
+	ring->num_trbs_queued = 0;
 
-	switch (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len))) {
-	case COMP_SUCCESS:
-		BUG_ON(udev->act_len != length);
-		/* fallthrough */
-	case COMP_SHORT_TX:
-		udev->status = 0;
-		break;
-	case COMP_STALL:
-		udev->status = USB_ST_STALLED;
-		break;
-	case COMP_DB_ERR:
-	case COMP_TRB_ERR:
-		udev->status = USB_ST_BUF_ERR;
-		break;
-	case COMP_BABBLE:
-		udev->status = USB_ST_BABBLE_DET;
-		break;
-	default:
-		udev->status = 0x80;  /* USB_ST_TOO_LAZY_TO_MAKE_A_NEW_MACRO */
+	/* The other streams were stopped too, so get them going again */
+	for (i = 1; i < ep->num_stream_ctxs; i++) {
+		if (i != stream_id && ep->stream_rings[i]->num_tds)
+			xhci_writel(&ctrl->dba->doorbell[udev->slot_id],
+				    DB_VALUE(ep_index, i));
 	}
 }
 
 /**** Bulk and Control transfer methods ****/
 /**
- * Queues up the BULK Request
+ * Queues up a BULK Request as a TD on the transfer ring of its endpoint (or
+ * stream) and lets the controller start on it, without waiting. Several TDs
+ * may be queued on a ring; they complete in order.
  *
  * @param udev		pointer to the USB device structure
- * @param pipe		contains the DIR_IN or OUT , devnum
- * @param length	length of the buffer
- * @param buffer	buffer to be read/written based on the request
- * @return returns 0 if successful else -1 on failure
+ * @param req		request to queue, to be passed to xhci_bulk_reap()
+ * @return 0 if queued, -EBUSY if the ring is full, other -ve on error
  */
-int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-			int length, void *buffer)
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req)
 {
+	unsigned long pipe = req->pipe;
+	unsigned int stream_id = req->stream_id;
+	int length = req->length;
+	void *buffer = req->buffer;
 	int num_trbs = 0;
 	struct xhci_generic_trb *start_trb;
 	bool first_trb = false;
@@ -574,7 +769,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	struct xhci_virt_device *virt_dev;
 	struct xhci_ep_ctx *ep_ctx;
 	struct xhci_ring *ring;		/* EP transfer ring */
-	union xhci_trb *event;
+	struct xhci_td *td;
 
 	int running_total, trb_buff_len;
 	bool more_trbs_coming = true;
@@ -583,13 +778,10 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	int ret;
 	u32 trb_fields[4];
 	u64 val_64 = xhci_virt_to_bus(ctrl, buffer);
-	void *last_transfer_trb_addr;
-	int available_length;
 
 	debug("dev=%p, pipe=%lx, buffer=%p, length=%d\n",
 		udev, pipe, buffer, length);
 
-	available_length = length;
 	ep_index = usb_pipe_ep_index(pipe);
 	virt_dev = ctrl->devs[slot_id];
 
@@ -598,7 +790,16 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 
 	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
 
-	ring = virt_dev->eps[ep_index].ring;
+	/* Once an endpoint has streams, every TD must name one */
+	if (stream_id) {
+		if (stream_id >= virt_dev->eps[ep_index].num_stream_ctxs)
+			return -EINVAL;
+		ring = virt_dev->eps[ep_index].stream_rings[stream_id];
+	} else {
+		if (virt_dev->eps[ep_index].ep_state & EP_HAS_STREAMS)
+			return -EINVAL;
+		ring = virt_dev->eps[ep_index].ring;
+	}
 	/*
 	 * How much data is (potentially) left before the 64KB boundary?
 	 * XHCI Spec puts restriction( TABLE 49 and 6.4.1 section of XHCI Spec)
@@ -624,10 +825,14 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	}
 
 	/*
-	 * XXX: Calling routine prepare_ring() called in place of
-	 * prepare_trasfer() as there in 'Linux' since we are not
-	 * maintaining multiple TDs/transfer at the same time.
+	 * TRBs of TDs still in flight must not be overwritten. Each segment
+	 * loses a TRB to its link TRB.
 	 */
+	if (ring->num_tds == XHCI_MAX_TDS ||
+	    ring->num_trbs_queued + num_trbs >
+	    ring->num_segs * (TRBS_PER_SEGMENT - 1))
+		return ring->num_tds ? -EBUSY : -EINVAL;
+
 	ret = prepare_ring(ctrl, ring,
 			   le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK);
 	if (ret < 0)
@@ -641,6 +846,13 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	start_trb = &ring->enqueue->generic;
 	start_cycle = ring->cycle_state;
 
+	td = &ring->tds[(ring->td_first + ring->num_tds) % XHCI_MAX_TDS];
+	td->req = req;
+	td->start_seg = ring->enq_seg;
+	td->first_trb = ring->enqueue;
+	td->num_trbs = num_trbs;
+	td->length = length;
+
 	running_total = 0;
 	maxpacketsize = usb_maxpacket(udev, pipe);
 
@@ -703,7 +915,9 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_fields[2] = length_field;
 		trb_fields[3] = field | TRB_TYPE(TRB_NORMAL);
 
-		last_transfer_trb_addr = queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
+		td->last_trb = (union xhci_trb *)queue_trb(ctrl, ring,
+							   (num_trbs > 1),
+							   trb_fields);
 
 		--num_trbs;
 
@@ -714,33 +928,87 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_buff_len = min((length - running_total), TRB_MAX_BUFF_SIZE);
 	} while (running_total < length);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	req->done = false;
+	req->actual_length = 0;
+	req->status = USB_ST_NOT_PROC;
+	ring->num_tds++;
+	ring->num_trbs_queued += td->num_trbs;
 
-again:
-	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
-	if (!event) {
-		debug("XHCI bulk transfer timed out, aborting...\n");
-		abort_td(udev, ep_index);
-		udev->status = USB_ST_NAK_REC;  /* closest thing to a timeout */
-		udev->act_len = 0;
-		return -ETIMEDOUT;
-	}
+	giveback_first_trb(udev, ep_index, stream_id, start_cycle, start_trb);
 
-	if ((uintptr_t)(le64_to_cpu(event->trans_event.buffer)) !=
-	    (uintptr_t)xhci_virt_to_bus(ctrl, last_transfer_trb_addr)) {
-		available_length -=
-			(int)EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len));
-		xhci_acknowledge_event(ctrl);
-		goto again;
+	return 0;
+}
+
+/**
+ * Waits for a BULK Request queued by xhci_bulk_submit() to complete. Other
+ * bulk TDs which complete in the meantime are finished off as well. If the
+ * request times out, all TDs queued behind it on its ring are given up too.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param req		request to wait for
+ * @return 0 if it completed successfully, -EIO on a transfer error,
+ *	-ETIMEDOUT on timeout
+ */
+int xhci_bulk_reap(struct usb_device *udev, struct usb_bulk_req *req)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	union xhci_trb *event;
+
+	while (!req->done) {
+		event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
+		if (!event) {
+			debug("XHCI bulk transfer timed out, aborting...\n");
+			abort_td(udev, usb_pipe_ep_index(req->pipe),
+				 req->stream_id);
+			return -ETIMEDOUT;
+		}
+		handle_bulk_event(ctrl, event);
 	}
 
-	field = le32_to_cpu(event->trans_event.flags);
-	BUG_ON(TRB_TO_SLOT_ID(field) != slot_id);
-	BUG_ON(TRB_TO_EP_INDEX(field) != ep_index);
+	return req->status ? -EIO : 0;
+}
 
-	record_transfer_result(udev, event, available_length);
-	xhci_acknowledge_event(ctrl);
-	xhci_inval_cache((uintptr_t)buffer, length);
+/**
+ * Queues up the BULK Request and waits for it to complete
+ *
+ * @param udev		pointer to the USB device structure
+ * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param stream_id	stream to queue the TD on, 0 for the endpoint ring
+ * @param length	length of the buffer
+ * @param buffer	buffer to be read/written based on the request
+ * @return returns 0 if successful else -1 on failure
+ */
+int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
+		 unsigned int stream_id, int length, void *buffer)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct usb_bulk_req req = {
+		.pipe		= pipe,
+		.stream_id	= stream_id,
+		.buffer		= buffer,
+		.length		= length,
+	};
+	union xhci_trb *event;
+	int ret;
+
+	/* Make room if the ring is full of TDs queued by others */
+	while ((ret = xhci_bulk_submit(udev, &req)) == -EBUSY) {
+		event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
+		if (!event)
+			break;
+		handle_bulk_event(ctrl, event);
+	}
+	if (ret)
+		return ret;
+
+	ret = xhci_bulk_reap(udev, &req);
+	if (ret == -ETIMEDOUT) {
+		udev->status = USB_ST_NAK_REC;  /* closest thing to a timeout */
+		udev->act_len = 0;
+		return ret;
+	}
+	udev->status = req.status;
+	udev->act_len = req.actual_length;
 
 	return (udev->status != USB_ST_NOT_PROC) ? 0 : -1;
 }
@@ -919,9 +1187,9 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 	queue_trb(ctrl, ep_ring, false, trb_fields);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	giveback_first_trb(udev, ep_index, 0, start_cycle, start_trb);
 
-	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
+	event = wait_for_ep_event(udev, ep_index);
 	if (!event)
 		goto abort;
 	field = le32_to_cpu(event->trans_event.flags);
@@ -929,7 +1197,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 	BUG_ON(TRB_TO_SLOT_ID(field) != slot_id);
 	BUG_ON(TRB_TO_EP_INDEX(field) != ep_index);
 
-	record_transfer_result(udev, event, length);
+	record_transfer_result(event, length, &udev->act_len, &udev->status);
 	xhci_acknowledge_event(ctrl);
 
 	/* Invalidate buffer to make it available to usb-core */
@@ -939,7 +1207,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 	if (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len))
 			== COMP_SHORT_TX) {
 		/* Short data stage, clear up additional status stage event */
-		event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
+		event = wait_for_ep_event(udev, ep_index);
 		if (!event)
 			goto abort;
 		BUG_ON(TRB_TO_SLOT_ID(field) != slot_id);
@@ -951,7 +1219,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 abort:
 	debug("XHCI control transfer timed out, aborting...\n");
-	abort_td(udev, ep_index);
+	abort_td(udev, ep_index, 0);
 	udev->status = USB_ST_NAK_REC;
 	udev->act_len = 0;
 	return -ETIMEDOUT;
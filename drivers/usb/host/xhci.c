@@ -36,6 +36,7 @@
 #include <linux/delay.h>
 #include <linux/errno.h>
 #include <linux/iopoll.h>
+#include <linux/log2.h>
 
 #ifndef CONFIG_USB_MAX_CONTROLLER_COUNT
 #define CONFIG_USB_MAX_CONTROLLER_COUNT 1
@@ -603,8 +604,10 @@ static int xhci_set_configuration(struct usb_device *udev)
 		ep_index = xhci_get_ep_index(endpt_desc);
 		ep_ctx[ep_index] = xhci_get_ep_ctx(ctrl, in_ctx, ep_index);
 
-		/* Allocate the ep rings */
-		virt_dev->eps[ep_index].ring = xhci_ring_alloc(ctrl, 1, true);
+		/* Allocate the ep rings, long enough to queue bulk TDs */
+		virt_dev->eps[ep_index].ring =
+			xhci_ring_alloc(ctrl, usb_endpoint_xfer_bulk(endpt_desc) ?
+					XHCI_BULK_RING_SEGS : 1, true);
 		if (!virt_dev->eps[ep_index].ring)
 			return -ENOMEM;
 
@@ -1164,7 +1167,7 @@ static int _xhci_submit_int_msg(struct usb_device *udev, unsigned long pipe,
 	 * (at most) one TD. A TD (comprised of sg list entries) can
 	 * take several service intervals to transmit.
 	 */
-	return xhci_bulk_tx(udev, pipe, length, buffer);
+	return xhci_bulk_tx(udev, pipe, 0, length, buffer);
 }
 
 /**
@@ -1184,7 +1187,7 @@ static int _xhci_submit_bulk_msg(struct usb_device *udev, unsigned long pipe,
 		return -EINVAL;
 	}
 
-	return xhci_bulk_tx(udev, pipe, length, buffer);
+	return xhci_bulk_tx(udev, pipe, 0, length, buffer);
 }
 
 /**
@@ -1427,6 +1430,24 @@ static int xhci_submit_bulk_msg(struct udevice *dev, struct usb_device *udev,
 	return _xhci_submit_bulk_msg(udev, pipe, buffer, length);
 }
 
+static int xhci_submit_bulk_req(struct udevice *dev, struct usb_device *udev,
+				struct usb_bulk_req *req)
+{
+	debug("%s: dev='%s', udev=%p\n", __func__, dev->name, udev);
+	if (usb_pipetype(req->pipe) != PIPE_BULK) {
+		printf("non-bulk pipe (type=%lu)", usb_pipetype(req->pipe));
+		return -EINVAL;
+	}
+
+	return xhci_bulk_submit(udev, req);
+}
+
+static int xhci_reap_bulk_req(struct udevice *dev, struct usb_device *udev,
+			      struct usb_bulk_req *req)
+{
+	return xhci_bulk_reap(udev, req);
+}
+
 static int xhci_submit_int_msg(struct udevice *dev, struct usb_device *udev,
 			       unsigned long pipe, void *buffer, int length,
 			       int interval, bool nonblock)
@@ -1508,6 +1529,126 @@ static int xhci_update_hub_device(struct udevice *dev, struct usb_device *udev)
 	return xhci_configure_endpoints(udev, false);
 }
 
+/*
+ * Find the SuperSpeed companion descriptor of the endpoint behind @pipe.
+ * Endpoints of all alternate settings end up in one list, so when several
+ * settings use the endpoint pick the one which offers the most streams.
+ */
+static struct usb_ss_ep_comp_descriptor *
+xhci_find_ss_ep_comp(struct usb_device *udev, unsigned long pipe)
+{
+	struct usb_ss_ep_comp_descriptor *comp = NULL;
+	struct usb_interface *ifdesc;
+	u8 addr;
+	int i, j;
+
+	addr = usb_pipeendpoint(pipe) | (usb_pipein(pipe) ? USB_DIR_IN : 0);
+	for (i = 0; i < udev->config.no_of_if; i++) {
+		ifdesc = &udev->config.if_desc[i];
+		for (j = 0; j < ifdesc->no_of_ep; j++) {
+			if (ifdesc->ep_desc[j].bEndpointAddress != addr)
+				continue;
+			if (usb_ss_max_streams(&ifdesc->ss_ep_comp_desc[j]) >=
+			    usb_ss_max_streams(comp))
+				comp = &ifdesc->ss_ep_comp_desc[j];
+		}
+	}
+
+	return comp;
+}
+
+static int xhci_alloc_streams(struct udevice *dev, struct usb_device *udev,
+			      unsigned long *pipes, int num_pipes,
+			      unsigned int num_streams)
+{
+	struct xhci_ctrl *ctrl = dev_get_priv(dev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_container_ctx *in_ctx = virt_dev->in_ctx;
+	struct xhci_container_ctx *out_ctx = virt_dev->out_ctx;
+	struct xhci_input_control_ctx *ctrl_ctx;
+	struct xhci_ep_ctx *ep_ctx;
+	unsigned int num_stream_ctxs, max_streams;
+	u32 ep_flags = 0;
+	int i, ep_index, ret;
+	u64 val_64;
+
+	debug("%s: dev='%s', udev=%p, streams=%u\n", __func__, dev->name,
+	      udev, num_streams);
+
+	max_streams = HCC_MAX_PSA(xhci_readl(&ctrl->hccr->cr_hccparams));
+	if (udev->speed < USB_SPEED_SUPER || max_streams < 4)
+		return -ENOSYS;
+
+	/* Stream ID 0 is reserved */
+	num_streams = min(num_streams + 1, max_streams);
+	for (i = 0; i < num_pipes; i++) {
+		max_streams = usb_ss_max_streams(xhci_find_ss_ep_comp(udev,
+								      pipes[i]));
+		if (usb_pipetype(pipes[i]) != PIPE_BULK || !max_streams)
+			return -EINVAL;
+		num_streams = min(num_streams, max_streams);
+	}
+	if (num_streams < 2)
+		return -EINVAL;
+	/* The smallest primary stream array has four entries */
+	num_stream_ctxs = max(roundup_pow_of_two(num_streams), 4UL);
+
+	xhci_inval_cache((uintptr_t)out_ctx->bytes, out_ctx->size);
+	xhci_slot_copy(ctrl, in_ctx, out_ctx);
+
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		xhci_alloc_stream_info(ctrl, &virt_dev->eps[ep_index],
+				       num_stream_ctxs);
+
+		xhci_endpoint_copy(ctrl, in_ctx, out_ctx, ep_index);
+		ep_ctx = xhci_get_ep_ctx(ctrl, in_ctx, ep_index);
+		ep_ctx->ep_info &= cpu_to_le32(~(EP_MAXPSTREAMS_MASK |
+						 EP_STATE_MASK));
+		ep_ctx->ep_info |= cpu_to_le32(EP_HAS_LSA |
+				EP_MAXPSTREAMS(fls(num_stream_ctxs) - 2));
+		/* DCS must be zero when pointing at a stream context array */
+		val_64 = xhci_virt_to_bus(ctrl,
+					  virt_dev->eps[ep_index].stream_ctx);
+		ep_ctx->deq = cpu_to_le64(val_64);
+		ep_flags |= 1 << (ep_index + 1);
+	}
+
+	/* Drop and re-add the endpoints so the new dequeue pointers apply */
+	ctrl_ctx = xhci_get_input_control_ctx(in_ctx);
+	ctrl_ctx->add_flags = cpu_to_le32(ep_flags | SLOT_FLAG);
+	ctrl_ctx->drop_flags = cpu_to_le32(ep_flags);
+
+	ret = xhci_configure_endpoints(udev, false);
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		if (ret)
+			xhci_free_stream_info(&virt_dev->eps[ep_index]);
+		else
+			virt_dev->eps[ep_index].ep_state |= EP_HAS_STREAMS;
+	}
+	if (ret)
+		return ret;
+
+	return num_streams - 1;
+}
+
+static int xhci_submit_bulk_stream_msg(struct udevice *dev,
+				       struct usb_device *udev,
+				       unsigned long pipe,
+				       unsigned int stream_id, void *buffer,
+				       int length)
+{
+	debug("%s: dev='%s', udev=%p, stream=%u\n", __func__, dev->name, udev,
+	      stream_id);
+	if (usb_pipetype(pipe) != PIPE_BULK) {
+		printf("non-bulk pipe (type=%lu)", usb_pipetype(pipe));
+		return -EINVAL;
+	}
+
+	return xhci_bulk_tx(udev, pipe, stream_id, length, buffer);
+}
+
 static int xhci_get_max_xfer_size(struct udevice *dev, size_t *size)
 {
 	/*
@@ -1516,6 +1657,8 @@ static int xhci_get_max_xfer_size(struct udevice *dev, size_t *size)
 	 * a TRB ring. Each TRB can transfer up to 64K bytes, however data
 	 * buffers referenced by transfer TRBs shall not span 64KB boundaries.
 	 * Hence the maximum number of TRBs we can use in one transfer is 62.
+	 * Bulk rings have more segments, so that several transfers of this
+	 * size can be queued.
 	 */
 	*size = (TRBS_PER_SEGMENT - 2) * TRB_MAX_BUFF_SIZE;
 
@@ -1580,6 +1723,10 @@ struct dm_usb_ops xhci_usb_ops = {
 	.alloc_device = xhci_alloc_device,
 	.update_hub_device = xhci_update_hub_device,
 	.get_max_xfer_size  = xhci_get_max_xfer_size,
+	.alloc_streams = xhci_alloc_streams,
+	.bulk_stream = xhci_submit_bulk_stream_msg,
+	.bulk_submit = xhci_submit_bulk_req,
+	.bulk_reap = xhci_reap_bulk_req,
 };
 
 #endif
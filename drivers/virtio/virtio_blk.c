@@ -13,12 +13,112 @@
 #include <virtio_ring.h>
 #include "virtio_blk.h"
 
+static const u32 feature[] = {
+	VIRTIO_BLK_F_DISCARD,
+};
+
+static const u32 feature_legacy[] = {
+	VIRTIO_BLK_F_DISCARD,
+};
+
+/* Number of requests from blk_submit() that can be in flight */
+#define VIRTIO_BLK_MAX_REQS	16
+
+/* The header and status of a request, kept until the device is done */
+struct virtio_blk_slot {
+	/* first, as virtqueue_get_buf() returns the address of the header */
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	struct blk_req *req;
+};
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	struct virtio_blk_slot slots[VIRTIO_BLK_MAX_REQS];
+	int num_slots;
+	int in_flight;
+	/* largest discard segment in sectors, 0 if discard is unsupported */
+	u32 max_discard;
 };
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+static int virtio_blk_poll(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_slot *slot;
+	struct blk_req *req;
+	void *hdr;
+
+	for (;;) {
+		hdr = virtqueue_get_buf(priv->vq, NULL);
+		if (!hdr)
+			break;
+		slot = container_of(hdr, struct virtio_blk_slot, out_hdr);
+		req = slot->req;
+		slot->req = NULL;
+		priv->in_flight--;
+		if (slot->status == VIRTIO_BLK_S_OK)
+			blk_req_complete(req, req->blkcnt, 0);
+		else
+			blk_req_complete(req, 0, -EIO);
+	}
+
+	return priv->in_flight;
+}
+
+static int virtio_blk_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_slot *slot = NULL;
+	unsigned int num_out = 0, num_in = 0;
+	struct virtio_sg *sgs[3];
+	struct virtio_sg hdr_sg, data_sg, status_sg;
+	u32 type;
+	int i, ret;
+
+	/* erasing is not part of the virtio block protocol */
+	if (req->op != BLK_REQ_READ && req->op != BLK_REQ_WRITE)
+		return -EOPNOTSUPP;
+
+	for (i = 0; i < priv->num_slots; i++) {
+		if (!priv->slots[i].req) {
+			slot = &priv->slots[i];
+			break;
+		}
+	}
+	if (!slot)
+		return -EBUSY;
+
+	type = req->op == BLK_REQ_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+	slot->out_hdr.type = cpu_to_virtio32(dev, type);
+	slot->out_hdr.ioprio = cpu_to_virtio32(dev, 0);
+	slot->out_hdr.sector = cpu_to_virtio64(dev, req->start);
+	hdr_sg.addr = &slot->out_hdr;
+	hdr_sg.length = sizeof(slot->out_hdr);
+	data_sg.addr = req->buffer;
+	data_sg.length = req->blkcnt * 512;
+	status_sg.addr = &slot->status;
+	status_sg.length = sizeof(slot->status);
+
+	sgs[num_out++] = &hdr_sg;
+	if (type & VIRTIO_BLK_T_OUT)
+		sgs[num_out++] = &data_sg;
+	else
+		sgs[num_out + num_in++] = &data_sg;
+	sgs[num_out + num_in++] = &status_sg;
+
+	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
+	if (ret)
+		return ret == -ENOSPC ? -EBUSY : ret;
+
+	slot->req = req;
+	priv->in_flight++;
+	virtqueue_kick(priv->vq);
+
+	return 0;
+}
+
+static int virtio_blk_xfer(struct udevice *dev, u64 sector, void *buffer,
+			   size_t len, u32 type)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	unsigned int num_out = 0, num_in = 0;
@@ -31,9 +131,13 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 		.sector = cpu_to_virtio64(dev, sector),
 	};
 	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
+	struct virtio_sg data_sg = { buffer, len };
 	struct virtio_sg status_sg = { &status, sizeof(status) };
 
+	/* let submitted requests finish, they share the queue with us */
+	while (priv->in_flight)
+		virtio_blk_poll(dev);
+
 	sgs[num_out++] = &hdr_sg;
 
 	if (type & VIRTIO_BLK_T_OUT)
@@ -52,7 +156,17 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 	while (!virtqueue_get_buf(priv->vq, NULL))
 		;
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+	return status == VIRTIO_BLK_S_OK ? 0 : -EIO;
+}
+
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	int ret;
+
+	ret = virtio_blk_xfer(dev, sector, buffer, blkcnt * 512, type);
+
+	return ret ? ret : blkcnt;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
@@ -69,6 +183,32 @@ static ulong virtio_blk_write(struct udevice *dev, lbaint_t start,
 				 VIRTIO_BLK_T_OUT);
 }
 
+static ulong virtio_blk_discard(struct udevice *dev, lbaint_t start,
+				lbaint_t blkcnt)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_discard_write_zeroes range;
+	lbaint_t done = 0;
+	u32 count;
+
+	if (!priv->max_discard)
+		return -ENOSYS;
+
+	while (done < blkcnt) {
+		count = min_t(lbaint_t, blkcnt - done, priv->max_discard);
+		range.sector = cpu_to_le64(start + done);
+		range.num_sectors = cpu_to_le32(count);
+		range.flags = 0;
+		/* the range is device-readable, like the data of a write */
+		if (virtio_blk_xfer(dev, 0, &range, sizeof(range),
+				    VIRTIO_BLK_T_DISCARD))
+			break;
+		done += count;
+	}
+
+	return done;
+}
+
 static int virtio_blk_bind(struct udevice *dev)
 {
 	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(dev->parent);
@@ -98,7 +238,8 @@ static int virtio_blk_bind(struct udevice *dev)
 	desc->bdev = dev;
 
 	/* Indicate what driver features we support */
-	virtio_driver_features_init(uc_priv, NULL, 0, NULL, 0);
+	virtio_driver_features_init(uc_priv, feature, ARRAY_SIZE(feature),
+				    feature_legacy, ARRAY_SIZE(feature_legacy));
 
 	return 0;
 }
@@ -113,18 +254,31 @@ static int virtio_blk_probe(struct udevice *dev)
 	ret = virtio_find_vqs(dev, 1, &priv->vq);
 	if (ret)
 		return ret;
+	/* each request takes three descriptors */
+	priv->num_slots = min_t(int, VIRTIO_BLK_MAX_REQS,
+				virtqueue_get_vring_size(priv->vq) / 3);
 
 	desc->blksz = 512;
 	desc->log2blksz = 9;
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
 	desc->lba = cap;
 
+	if (virtio_has_feature(dev, VIRTIO_BLK_F_DISCARD)) {
+		virtio_cread(dev, struct virtio_blk_config,
+			     max_discard_sectors, &priv->max_discard);
+		if (!priv->max_discard)
+			priv->max_discard = U32_MAX;
+	}
+
 	return 0;
 }
 
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
+	.discard	= virtio_blk_discard,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
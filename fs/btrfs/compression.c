@@ -143,7 +143,7 @@ static u32 decompress_zstd(const u8 *cbuf, u32 clen, u8 *dbuf, u32 dlen)
 	size_t wsize;
 	u32 res = -1;
 
-	wsize = ZSTD_DStreamWorkspaceBound(ZSTD_BTRFS_MAX_INPUT);
+	wsize = ZSTD_estimateDStreamSize(ZSTD_BTRFS_MAX_INPUT);
 	workspace = malloc(wsize);
 	if (!workspace) {
 		debug("%s: cannot allocate workspace of size %zu\n", __func__,
@@ -151,9 +151,9 @@ static u32 decompress_zstd(const u8 *cbuf, u32 clen, u8 *dbuf, u32 dlen)
 		return -1;
 	}
 
-	dstream = ZSTD_initDStream(ZSTD_BTRFS_MAX_INPUT, workspace, wsize);
+	dstream = ZSTD_initStaticDStream(workspace, wsize);
 	if (!dstream) {
-		printf("%s: ZSTD_initDStream failed\n", __func__);
+		printf("%s: ZSTD_initStaticDStream failed\n", __func__);
 		goto err_free;
 	}
 
@@ -175,7 +175,7 @@ static u32 decompress_zstd(const u8 *cbuf, u32 clen, u8 *dbuf, u32 dlen)
 			goto err_free;
 		}
 
-		if (in_buf.pos >= clen || !ret)
+		if (in_buf.pos >= clen || out_buf.pos >= dlen || !ret)
 			break;
 	}
 
@@ -6,6 +6,7 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/sizes.h>
 #include <malloc.h>
 #include <memalign.h>
 #include "btrfs.h"
@@ -402,6 +403,44 @@ out:
 	return ret;
 }
 
+/*
+ * Read @len bytes at logical address @logical into @dest.
+ *
+ * A logical range can be split across stripes, so keep mapping until the whole
+ * range is read, falling back to the other mirrors when one copy fails.
+ *
+ * Return 0 for success.
+ * Return <0 for error.
+ */
+static int btrfs_read_data_range(struct btrfs_fs_info *fs_info, u64 logical,
+				 u64 len, char *dest)
+{
+	u64 read = 0;
+	int num_copies;
+	int ret;
+	int i;
+
+	while (len) {
+		num_copies = btrfs_num_copies(fs_info, logical, len);
+		ret = -EIO;
+		for (i = 1; i <= num_copies; i++) {
+			/* __btrfs_devread() can only handle int sized reads */
+			read = min_t(u64, len, SZ_1G);
+			ret = read_extent_data(fs_info, dest, logical, &read, i);
+			if (ret == 0 && read)
+				break;
+			ret = -EIO;
+		}
+		if (ret < 0)
+			return ret;
+
+		logical += read;
+		dest += read;
+		len -= read;
+	}
+	return 0;
+}
+
 /*
  * Read out regular extent.
  *
@@ -420,14 +459,10 @@ int btrfs_read_extent_reg(struct btrfs_path *path,
 	struct btrfs_key key;
 	u64 extent_num_bytes;
 	u64 disk_bytenr;
-	u64 read;
 	char *cbuf = NULL;
 	char *dbuf = NULL;
 	u32 csize;
 	u32 dsize;
-	bool finished = false;
-	int num_copies;
-	int i;
 	int slot = path->slots[0];
 	int ret;
 
@@ -451,25 +486,15 @@ int btrfs_read_extent_reg(struct btrfs_path *path,
 		logical = btrfs_file_extent_disk_bytenr(leaf, fi) +
 			  btrfs_file_extent_offset(leaf, fi) +
 			  offset - key.offset;
-		read = len;
-
-		num_copies = btrfs_num_copies(fs_info, logical, len);
-		for (i = 1; i <= num_copies; i++) {
-			ret = read_extent_data(fs_info, dest, logical, &read, i);
-			if (ret < 0 || read != len)
-				continue;
-			finished = true;
-			break;
-		}
-		if (!finished)
-			return -EIO;
+		ret = btrfs_read_data_range(fs_info, logical, len, dest);
+		if (ret < 0)
+			return ret;
 		return len;
 	}
 
 	csize = btrfs_file_extent_disk_num_bytes(leaf, fi);
 	dsize = btrfs_file_extent_ram_bytes(leaf, fi);
 	disk_bytenr = btrfs_file_extent_disk_bytenr(leaf, fi);
-	num_copies = btrfs_num_copies(fs_info, disk_bytenr, csize);
 
 	cbuf = malloc_cache_aligned(csize);
 	dbuf = malloc_cache_aligned(dsize);
@@ -478,19 +503,9 @@ int btrfs_read_extent_reg(struct btrfs_path *path,
 		goto out;
 	}
 	/* For compressed extent, we must read the whole on-disk extent */
-	for (i = 1; i <= num_copies; i++) {
-		read = csize;
-		ret = read_extent_data(fs_info, cbuf, disk_bytenr,
-				       &read, i);
-		if (ret < 0 || read != csize)
-			continue;
-		finished = true;
-		break;
-	}
-	if (!finished) {
-		ret = -EIO;
+	ret = btrfs_read_data_range(fs_info, disk_bytenr, csize, cbuf);
+	if (ret < 0)
 		goto out;
-	}
 
 	ret = btrfs_decompress(btrfs_file_extent_compression(leaf, fi), cbuf,
 			       csize, dbuf, dsize);
@@ -499,7 +514,8 @@ int btrfs_read_extent_reg(struct btrfs_path *path,
 		goto out;
 	}
 	/* Then copy the needed part */
-	memcpy(dest, dbuf + btrfs_file_extent_offset(leaf, fi), len);
+	memcpy(dest, dbuf + btrfs_file_extent_offset(leaf, fi) +
+	       offset - key.offset, len);
 	ret = len;
 out:
 	free(cbuf);
@@ -646,6 +662,202 @@ static int read_and_truncate_page(struct btrfs_path *path,
 	return len;
 }
 
+/*
+ * Extents of a file read are not read one by one, but queued in a batch.
+ *
+ * Uncompressed extents which are adjacent both on disk and in @dest are merged
+ * into a single read straight into the destination. Compressed extents which
+ * are adjacent on disk are read with one device access into a shared buffer,
+ * then each one is decompressed directly into the destination when it is
+ * wanted as a whole, or through a bounce buffer otherwise.
+ */
+#define BTRFS_READ_BATCH_EXTENTS	16
+#define BTRFS_READ_BATCH_BYTES		SZ_1M
+
+struct btrfs_read_batch_item {
+	char *dest;
+	u32 cofs;	/* offset of the compressed data in the batch buffer */
+	u32 csize;
+	u32 dsize;
+	u32 skip;	/* offset of the wanted data in the decompressed extent */
+	u32 len;
+	u8 compression;
+};
+
+struct btrfs_read_batch {
+	struct btrfs_fs_info *fs_info;
+
+	/* Pending uncompressed read */
+	u64 logical;
+	u64 len;
+	char *dest;
+
+	/* Pending compressed extents, starting at @clogical on disk */
+	u64 clogical;
+	u32 clen;
+	int nr;
+	struct btrfs_read_batch_item items[BTRFS_READ_BATCH_EXTENTS];
+
+	char *cbuf;
+	u32 cbuf_size;
+	char *dbuf;
+	u32 dbuf_size;
+};
+
+static int btrfs_read_batch_grow(char **buf, u32 *size, u32 wanted)
+{
+	if (wanted <= *size)
+		return 0;
+
+	free(*buf);
+	*buf = malloc_cache_aligned(wanted);
+	if (!*buf) {
+		*size = 0;
+		return -ENOMEM;
+	}
+	*size = wanted;
+	return 0;
+}
+
+static int btrfs_read_batch_flush_plain(struct btrfs_read_batch *batch)
+{
+	int ret;
+
+	if (!batch->len)
+		return 0;
+
+	ret = btrfs_read_data_range(batch->fs_info, batch->logical, batch->len,
+				    batch->dest);
+	batch->len = 0;
+	return ret;
+}
+
+static int btrfs_read_batch_flush_compressed(struct btrfs_read_batch *batch)
+{
+	struct btrfs_read_batch_item *item;
+	char *cdata;
+	u32 dlen;
+	int ret;
+	int i;
+
+	if (!batch->nr)
+		return 0;
+
+	ret = btrfs_read_batch_grow(&batch->cbuf, &batch->cbuf_size,
+				    batch->clen);
+	if (ret < 0)
+		goto out;
+	ret = btrfs_read_data_range(batch->fs_info, batch->clogical,
+				    batch->clen, batch->cbuf);
+	if (ret < 0)
+		goto out;
+
+	for (i = 0; i < batch->nr; i++) {
+		item = &batch->items[i];
+		cdata = batch->cbuf + item->cofs;
+
+		if (!item->skip && item->len == item->dsize) {
+			dlen = btrfs_decompress(item->compression, cdata,
+						item->csize, item->dest,
+						item->dsize);
+		} else {
+			ret = btrfs_read_batch_grow(&batch->dbuf,
+						    &batch->dbuf_size,
+						    item->dsize);
+			if (ret < 0)
+				goto out;
+			dlen = btrfs_decompress(item->compression, cdata,
+						item->csize, batch->dbuf,
+						item->dsize);
+			if (dlen == item->dsize)
+				memcpy(item->dest, batch->dbuf + item->skip,
+				       item->len);
+		}
+		if (dlen != item->dsize) {
+			ret = -EIO;
+			goto out;
+		}
+	}
+out:
+	batch->nr = 0;
+	return ret;
+}
+
+static int btrfs_read_batch_flush(struct btrfs_read_batch *batch)
+{
+	int ret;
+
+	ret = btrfs_read_batch_flush_plain(batch);
+	if (ret < 0)
+		return ret;
+	return btrfs_read_batch_flush_compressed(batch);
+}
+
+/*
+ * Queue @len bytes at @offset inside the regular extent @fi to be read
+ * into @dest, flushing the batch first if the extent can't be merged.
+ */
+static int btrfs_read_batch_add(struct btrfs_read_batch *batch,
+				struct extent_buffer *leaf,
+				struct btrfs_file_extent_item *fi,
+				u64 offset, u64 len, char *dest)
+{
+	struct btrfs_read_batch_item *item;
+	u64 disk_bytenr = btrfs_file_extent_disk_bytenr(leaf, fi);
+	u8 compression = btrfs_file_extent_compression(leaf, fi);
+	u32 csize, cofs;
+	u64 logical;
+	int ret;
+
+	if (compression == BTRFS_COMPRESS_NONE) {
+		logical = disk_bytenr + btrfs_file_extent_offset(leaf, fi) +
+			  offset;
+		if (batch->len && batch->logical + batch->len == logical &&
+		    batch->dest + batch->len == dest) {
+			batch->len += len;
+			return 0;
+		}
+
+		ret = btrfs_read_batch_flush_plain(batch);
+		if (ret < 0)
+			return ret;
+		batch->logical = logical;
+		batch->len = len;
+		batch->dest = dest;
+		return 0;
+	}
+
+	csize = btrfs_file_extent_disk_num_bytes(leaf, fi);
+	item = batch->nr ? &batch->items[batch->nr - 1] : NULL;
+	if (item && batch->nr < BTRFS_READ_BATCH_EXTENTS &&
+	    disk_bytenr == batch->clogical + item->cofs) {
+		/* Another part of the last on-disk extent, already queued */
+		cofs = item->cofs;
+	} else if (item && batch->nr < BTRFS_READ_BATCH_EXTENTS &&
+		   disk_bytenr == batch->clogical + batch->clen &&
+		   batch->clen + csize <= BTRFS_READ_BATCH_BYTES) {
+		cofs = batch->clen;
+		batch->clen += csize;
+	} else {
+		ret = btrfs_read_batch_flush_compressed(batch);
+		if (ret < 0)
+			return ret;
+		batch->clogical = disk_bytenr;
+		batch->clen = csize;
+		cofs = 0;
+	}
+
+	item = &batch->items[batch->nr++];
+	item->dest = dest;
+	item->cofs = cofs;
+	item->csize = csize;
+	item->dsize = btrfs_file_extent_ram_bytes(leaf, fi);
+	item->skip = btrfs_file_extent_offset(leaf, fi) + offset;
+	item->len = len;
+	item->compression = compression;
+	return 0;
+}
+
 int btrfs_file_read(struct btrfs_root *root, u64 ino, u64 file_offset, u64 len,
 		    char *dest)
 {
@@ -657,6 +869,7 @@ int btrfs_file_read(struct btrfs_root *root, u64 ino, u64 file_offset, u64 len,
 	u64 aligned_end = round_down(file_offset + len, fs_info->sectorsize);
 	u64 next_offset;
 	u64 cur = aligned_start;
+	struct btrfs_read_batch batch = { .fs_info = fs_info };
 	int ret = 0;
 
 	btrfs_init_path(&path);
@@ -691,47 +904,65 @@ int btrfs_file_read(struct btrfs_root *root, u64 ino, u64 file_offset, u64 len,
 	}
 
 	/* Read the aligned part */
-	while (cur < aligned_end) {
-		u64 extent_num_bytes;
-		u8 type;
-
+	if (cur < aligned_end) {
 		btrfs_release_path(&path);
 		ret = lookup_data_extent(root, &path, ino, cur, &next_offset);
 		if (ret < 0)
 			goto out;
-		if (ret > 0) {
-			/* No next, direct exit */
-			if (!next_offset) {
-				ret = 0;
-				goto out;
-			}
+		/* No next, direct exit */
+		if (ret > 0 && !next_offset) {
+			ret = 0;
+			goto out;
 		}
-		fi = btrfs_item_ptr(path.nodes[0], path.slots[0],
+	}
+
+	/*
+	 * @path now points to the first extent at or after @cur, walk the
+	 * following ones in the leaves instead of searching each from the
+	 * root.
+	 */
+	while (cur < aligned_end) {
+		struct extent_buffer *leaf = path.nodes[0];
+		u64 extent_end;
+		u8 type;
+
+		btrfs_item_key_to_cpu(leaf, &key, path.slots[0]);
+		if (key.objectid != ino || key.type != BTRFS_EXTENT_DATA_KEY ||
+		    key.offset >= aligned_end)
+			break;
+
+		fi = btrfs_item_ptr(leaf, path.slots[0],
 				    struct btrfs_file_extent_item);
-		btrfs_item_key_to_cpu(path.nodes[0], &key, path.slots[0]);
-		type = btrfs_file_extent_type(path.nodes[0], fi);
+		type = btrfs_file_extent_type(leaf, fi);
 		if (type == BTRFS_FILE_EXTENT_INLINE) {
 			ret = btrfs_read_extent_inline(&path, fi, dest);
 			goto out;
 		}
+
 		/* Skip holes, as we have zeroed the dest */
-		if (type == BTRFS_FILE_EXTENT_PREALLOC ||
-		    btrfs_file_extent_disk_bytenr(path.nodes[0], fi) == 0) {
-			cur = key.offset + btrfs_file_extent_num_bytes(
-					path.nodes[0], fi);
-			continue;
+		cur = max(cur, key.offset);
+		extent_end = key.offset + btrfs_file_extent_num_bytes(leaf, fi);
+		if (type != BTRFS_FILE_EXTENT_PREALLOC &&
+		    btrfs_file_extent_disk_bytenr(leaf, fi) != 0 &&
+		    extent_end > cur) {
+			ret = btrfs_read_batch_add(&batch, leaf, fi,
+					cur - key.offset,
+					min(extent_end, aligned_end) - cur,
+					dest + cur - file_offset);
+			if (ret < 0)
+				goto out;
 		}
+		cur = max(cur, extent_end);
 
-		/* Read the remaining part of the extent */
-		extent_num_bytes = btrfs_file_extent_num_bytes(path.nodes[0],
-							       fi);
-		ret = btrfs_read_extent_reg(&path, fi, cur,
-				min(extent_num_bytes, aligned_end - cur),
-				dest + cur - file_offset);
+		ret = btrfs_next_item(root, &path);
 		if (ret < 0)
 			goto out;
-		cur += min(extent_num_bytes, aligned_end - cur);
+		if (ret > 0)
+			break;
 	}
+	ret = btrfs_read_batch_flush(&batch);
+	if (ret < 0)
+		goto out;
 
 	/* Read the tailing unaligned part*/
 	if (file_offset + len != aligned_end) {
@@ -748,6 +979,8 @@ int btrfs_file_read(struct btrfs_root *root, u64 ino, u64 file_offset, u64 len,
 				dest + aligned_end - file_offset);
 	}
 out:
+	free(batch.cbuf);
+	free(batch.dbuf);
 	btrfs_release_path(&path);
 	if (ret < 0)
 		return ret;
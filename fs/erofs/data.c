@@ -0,0 +1,433 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * data.c: EROFS device access, metadata block cache and file data reads
+ */
+
+#include <errno.h>
+#include <fs_internal.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <string.h>
+#include <linux/err.h>
+#include <asm/byteorder.h>
+
+#include "internal.h"
+
+/* fs_devread() takes an int length, so split very large reads */
+#define EROFS_DEV_READ_MAX	(1U << 30)
+
+int erofs_dev_read(void *buf, u64 offset, size_t len)
+{
+	struct blk_desc *desc = erofs_sbi.cur_dev;
+	size_t chunk;
+
+	if (!desc)
+		return -EIO;
+
+	while (len) {
+		chunk = min_t(size_t, len, EROFS_DEV_READ_MAX);
+		if (!fs_devread(desc, &erofs_sbi.cur_part_info,
+				offset >> desc->log2blksz,
+				offset & (desc->blksz - 1), chunk, buf))
+			return -EIO;
+
+		buf += chunk;
+		offset += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+int erofs_cache_init(struct erofs_cache *cache, int count)
+{
+	cache->entries = calloc(count, sizeof(*cache->entries));
+	if (!cache->entries)
+		return -ENOMEM;
+
+	cache->count = count;
+	cache->clock = 0;
+
+	return 0;
+}
+
+void erofs_cache_cleanup(struct erofs_cache *cache)
+{
+	int i;
+
+	if (!cache->entries)
+		return;
+
+	for (i = 0; i < cache->count; i++)
+		free(cache->entries[i].data);
+
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->count = 0;
+}
+
+/*
+ * Returns the content of metadata block 'blkaddr', reading it on a cache miss.
+ * The pointer stays valid until the next call, which may evict the block.
+ */
+void *erofs_read_metablock(u32 blkaddr)
+{
+	struct erofs_cache *cache = &erofs_sbi.meta_cache;
+	struct erofs_cache_entry *entry, *victim = NULL;
+	int i, ret;
+
+	for (i = 0; i < cache->count; i++) {
+		entry = &cache->entries[i];
+		if (entry->valid && entry->blkaddr == blkaddr) {
+			entry->last_use = ++cache->clock;
+			return entry->data;
+		}
+
+		if (!victim || !entry->valid ||
+		    (victim->valid && entry->last_use < victim->last_use))
+			victim = entry;
+	}
+
+	if (!victim)
+		return ERR_PTR(-EINVAL);
+
+	if (!victim->data) {
+		victim->data = malloc_cache_aligned(EROFS_BLKSIZ);
+		if (!victim->data)
+			return ERR_PTR(-ENOMEM);
+	}
+
+	victim->valid = false;
+	ret = erofs_dev_read(victim->data, erofs_pos(blkaddr), EROFS_BLKSIZ);
+	if (ret)
+		return ERR_PTR(ret);
+
+	victim->blkaddr = blkaddr;
+	victim->last_use = ++cache->clock;
+	victim->valid = true;
+
+	return victim->data;
+}
+
+int erofs_read_metadata(void *buf, u64 offset, size_t len)
+{
+	size_t blkoff, copy;
+	void *blk;
+
+	while (len) {
+		blk = erofs_read_metablock(erofs_blknr(offset));
+		if (IS_ERR(blk))
+			return PTR_ERR(blk);
+
+		blkoff = erofs_blkoff(offset);
+		copy = min_t(size_t, len, EROFS_BLKSIZ - blkoff);
+		memcpy(buf, blk + blkoff, copy);
+
+		buf += copy;
+		offset += copy;
+		len -= copy;
+	}
+
+	return 0;
+}
+
+static int erofs_map_blocks_flatmode(struct erofs_inode *vi,
+				     struct erofs_map_blocks *map)
+{
+	bool tailendpacking = (vi->datalayout == EROFS_INODE_FLAT_INLINE);
+	u64 nblocks, lastblk;
+
+	nblocks = DIV_ROUND_UP(vi->size, EROFS_BLKSIZ);
+	lastblk = nblocks - tailendpacking;
+
+	/* there is no hole in flatmode */
+	map->m_flags = EROFS_MAP_MAPPED;
+
+	if (map->m_la < erofs_pos(lastblk)) {
+		map->m_pa = erofs_pos(vi->raw_blkaddr) + map->m_la;
+		map->m_plen = erofs_pos(lastblk) - map->m_la;
+	} else if (tailendpacking) {
+		/* inline tail: inode, [xattrs], last partial block of data */
+		map->m_pa = erofs_iloc(vi->nid) + vi->inode_isize +
+			vi->xattr_isize + erofs_blkoff(map->m_la);
+		map->m_plen = vi->size - map->m_la;
+
+		/* inline data should be located in one meta block */
+		if (erofs_blkoff(map->m_pa) + map->m_plen > EROFS_BLKSIZ) {
+			log_err("EROFS: inline data crosses block boundary @ nid %llu\n",
+				vi->nid);
+			return -EFSCORRUPTED;
+		}
+		map->m_flags |= EROFS_MAP_META;
+	} else {
+		log_err("EROFS: internal error @ nid: %llu (size %llu), m_la 0x%llx\n",
+			vi->nid, vi->size, map->m_la);
+		return -EIO;
+	}
+
+	map->m_llen = map->m_plen;
+
+	return 0;
+}
+
+int erofs_map_blocks(struct erofs_inode *vi, struct erofs_map_blocks *map)
+{
+	struct erofs_inode_chunk_index *idx;
+	unsigned int unit;
+	u64 chunknr, pos;
+	u32 blkaddr;
+	void *blk;
+
+	if (map->m_la >= vi->size) {
+		map->m_llen = map->m_la + 1 - vi->size;
+		map->m_la = vi->size;
+		map->m_flags = 0;
+		return 0;
+	}
+
+	if (vi->datalayout != EROFS_INODE_CHUNK_BASED)
+		return erofs_map_blocks_flatmode(vi, map);
+
+	if (vi->chunkformat & EROFS_CHUNK_FORMAT_INDEXES)
+		unit = sizeof(struct erofs_inode_chunk_index);
+	else
+		unit = EROFS_BLOCK_MAP_ENTRY_SIZE;
+
+	chunknr = map->m_la >> vi->chunkbits;
+	pos = ALIGN(erofs_iloc(vi->nid) + vi->inode_isize + vi->xattr_isize,
+		    unit) + unit * chunknr;
+
+	/* entries are naturally aligned, so one never crosses a block */
+	blk = erofs_read_metablock(erofs_blknr(pos));
+	if (IS_ERR(blk))
+		return PTR_ERR(blk);
+
+	map->m_la = chunknr << vi->chunkbits;
+	map->m_plen = min_t(u64, 1ULL << vi->chunkbits,
+			    round_up(vi->size - map->m_la, EROFS_BLKSIZ));
+	map->m_llen = map->m_plen;
+
+	if (unit == EROFS_BLOCK_MAP_ENTRY_SIZE) {
+		blkaddr = le32_to_cpu(*(__le32 *)(blk + erofs_blkoff(pos)));
+	} else {
+		idx = blk + erofs_blkoff(pos);
+		blkaddr = le32_to_cpu(idx->blkaddr);
+		if (blkaddr != EROFS_NULL_ADDR && le16_to_cpu(idx->device_id)) {
+			log_err("EROFS: chunk on extra device @ nid %llu\n",
+				vi->nid);
+			return -EOPNOTSUPP;
+		}
+	}
+
+	if (blkaddr == EROFS_NULL_ADDR) {
+		map->m_flags = 0;
+	} else {
+		map->m_pa = erofs_pos(blkaddr);
+		map->m_flags = EROFS_MAP_MAPPED;
+	}
+
+	return 0;
+}
+
+static int erofs_read_raw_data(struct erofs_inode *vi, char *buffer,
+			       u64 size, u64 offset, bool cached)
+{
+	struct erofs_map_blocks map = { 0 };
+	u64 ptr = offset, end = offset + size, eend, len;
+	/* physically contiguous extents are merged into a single device read */
+	u64 pend_pa = 0, pend_len = 0;
+	char *pend_buf = NULL, *estart;
+	int ret;
+
+	while (ptr < end) {
+		estart = buffer + (ptr - offset);
+
+		map.m_la = ptr;
+		ret = erofs_map_blocks(vi, &map);
+		if (ret)
+			return ret;
+
+		eend = min(end, map.m_la + map.m_llen);
+		len = eend - ptr;
+
+		if (!(map.m_flags & EROFS_MAP_MAPPED)) {
+			memset(estart, 0, len);
+		} else if (cached || (map.m_flags & EROFS_MAP_META)) {
+			ret = erofs_read_metadata(estart,
+						  map.m_pa + ptr - map.m_la,
+						  len);
+			if (ret)
+				return ret;
+		} else if (pend_len && pend_pa + pend_len ==
+			   map.m_pa + ptr - map.m_la &&
+			   pend_buf + pend_len == estart) {
+			pend_len += len;
+		} else {
+			if (pend_len) {
+				ret = erofs_dev_read(pend_buf, pend_pa,
+						     pend_len);
+				if (ret)
+					return ret;
+			}
+			pend_pa = map.m_pa + ptr - map.m_la;
+			pend_len = len;
+			pend_buf = estart;
+		}
+
+		ptr = eend;
+	}
+
+	if (pend_len)
+		return erofs_dev_read(pend_buf, pend_pa, pend_len);
+
+	return 0;
+}
+
+/*
+ * Read the compressed extent described by 'map' so that its decompressed
+ * bytes [skip, length) end up in 'out'. When the extent is wanted as a whole
+ * and there is room in the caller's buffer, the compressed data is read into
+ * the tail of the output area and decompressed in place; otherwise it goes
+ * through the bounce buffer '*raw'.
+ */
+static int z_erofs_read_extent(struct erofs_inode *vi,
+			       struct erofs_map_blocks *map, char *out,
+			       u64 skip, u64 length, char *buf_start,
+			       char *buf_end, char **raw, u64 *rawsize)
+{
+	struct z_erofs_decompress_req rq = {
+		.out = out,
+		.inputsize = map->m_plen,
+		.decodedskip = skip,
+		.outputsize = length - skip,
+		.alg = vi->z_algorithmtype[0],
+	};
+	char saved[Z_EROFS_LZ4_INPLACE_MARGIN(1 << 16) + ARCH_DMA_MINALIGN];
+	char *in = NULL, *iend;
+	size_t margin = 0;
+	int ret;
+
+	if (map->m_flags & EROFS_MAP_FULL_MAPPED)
+		rq.decodedlength = map->m_llen;
+	else
+		rq.decodedlength = length;
+
+	if (erofs_sb_has_lz4_0padding() && !skip &&
+	    rq.decodedlength == length && map->m_plen <= (1 << 16)) {
+		in = (char *)ALIGN((ulong)out + length +
+				   Z_EROFS_LZ4_INPLACE_MARGIN(map->m_plen) -
+				   map->m_plen, ARCH_DMA_MINALIGN);
+		iend = in + map->m_plen;
+		if (in >= buf_start && iend <= buf_end) {
+			/* the tail may overlap data decoded earlier */
+			margin = iend - (out + length);
+			memcpy(saved, out + length, margin);
+		} else {
+			in = NULL;
+		}
+	}
+
+	if (!in) {
+		if (map->m_plen > *rawsize) {
+			free(*raw);
+			*raw = malloc_cache_aligned(map->m_plen);
+			if (!*raw) {
+				*rawsize = 0;
+				return -ENOMEM;
+			}
+			*rawsize = map->m_plen;
+		}
+		in = *raw;
+	}
+
+	ret = erofs_dev_read(in, map->m_pa, map->m_plen);
+	if (!ret) {
+		rq.in = in;
+		ret = z_erofs_decompress(&rq);
+	}
+
+	if (margin)
+		memcpy(out + length, saved, margin);
+
+	return ret;
+}
+
+/*
+ * Compressed extents are walked backwards from the end of the requested range,
+ * so every lookup but the first ends exactly on an extent boundary and each
+ * pcluster is read and decompressed once.
+ */
+static int z_erofs_read_data(struct erofs_inode *vi, char *buffer,
+			     u64 size, u64 offset)
+{
+	struct erofs_map_blocks map = { 0 };
+	u64 end = offset + size, length, skip, rawsize = 0;
+	char *raw = NULL, *out;
+	int flags = EROFS_GET_BLOCKS_FULL;
+	int ret = 0;
+
+	while (end > offset) {
+		map.m_la = end - 1;
+		ret = z_erofs_map_blocks_iter(vi, &map, flags);
+		if (ret)
+			break;
+		flags = 0;
+
+		/* trim to the needed size if the extent goes past 'end' */
+		length = min(end, map.m_la + map.m_llen) - map.m_la;
+
+		if (map.m_la < offset) {
+			skip = offset - map.m_la;
+			out = buffer;
+		} else {
+			skip = 0;
+			out = buffer + (map.m_la - offset);
+		}
+
+		if (!(map.m_flags & EROFS_MAP_MAPPED)) {
+			memset(out, 0, length - skip);
+		} else if (!(map.m_flags & EROFS_MAP_ZIPPED)) {
+			/* plain lcluster: stored as-is, starting at m_la */
+			ret = erofs_dev_read(out, map.m_pa + skip,
+					     length - skip);
+		} else {
+			ret = z_erofs_read_extent(vi, &map, out, skip, length,
+						  buffer, buffer + size,
+						  &raw, &rawsize);
+		}
+		if (ret)
+			break;
+
+		end = map.m_la + skip;
+	}
+
+	free(raw);
+
+	return ret;
+}
+
+static int __erofs_pread(struct erofs_inode *vi, void *buf, u64 size,
+			 u64 offset, bool cached)
+{
+	if (offset >= vi->size)
+		return 0;
+
+	size = min(size, vi->size - offset);
+
+	if (erofs_inode_is_compressed(vi))
+		return z_erofs_read_data(vi, buf, size, offset);
+
+	return erofs_read_raw_data(vi, buf, size, offset, cached);
+}
+
+int erofs_pread(struct erofs_inode *vi, void *buf, u64 size, u64 offset)
+{
+	return __erofs_pread(vi, buf, size, offset, false);
+}
+
+/* Same as erofs_pread(), but uncompressed data goes through the block cache */
+int erofs_pread_meta(struct erofs_inode *vi, void *buf, u64 size, u64 offset)
+{
+	return __erofs_pread(vi, buf, size, offset, true);
+}
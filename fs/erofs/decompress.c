@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * decompress.c: EROFS pcluster decompression
+ */
+
+#include <errno.h>
+#include <lz4.h>
+#include <malloc.h>
+#include <string.h>
+
+#include "internal.h"
+
+static int z_erofs_decompress_lz4(struct z_erofs_decompress_req *rq)
+{
+	char *src = rq->in, *dest = rq->out, *buff = NULL;
+	unsigned int inputmargin = 0;
+	int ret;
+
+	if (erofs_sb_has_lz4_0padding()) {
+		/* compressed data is right-aligned in the pcluster */
+		while (inputmargin < EROFS_BLKSIZ && !src[inputmargin])
+			inputmargin++;
+
+		if (inputmargin >= rq->inputsize)
+			return -EIO;
+	}
+
+	/* only part of the extent is wanted, decompress it aside first */
+	if (rq->decodedskip || rq->outputsize != rq->decodedlength) {
+		buff = malloc(rq->decodedlength);
+		if (!buff)
+			return -ENOMEM;
+		dest = buff;
+	}
+
+	if (erofs_sb_has_lz4_0padding())
+		ret = LZ4_decompress_safe(src + inputmargin, dest,
+					  rq->inputsize - inputmargin,
+					  rq->decodedlength);
+	else
+		ret = LZ4_decompress_safe_partial(src, dest, rq->inputsize,
+						  rq->decodedlength,
+						  rq->decodedlength);
+
+	if (ret != (int)rq->decodedlength) {
+		ret = -EIO;
+		goto out;
+	}
+
+	if (buff)
+		memcpy(rq->out, buff + rq->decodedskip, rq->outputsize);
+	ret = 0;
+
+out:
+	free(buff);
+
+	return ret;
+}
+
+int z_erofs_decompress(struct z_erofs_decompress_req *rq)
+{
+	if (rq->decodedskip + rq->outputsize > rq->decodedlength)
+		return -EINVAL;
+
+	if (rq->alg == Z_EROFS_COMPRESSION_LZ4)
+		return z_erofs_decompress_lz4(rq);
+
+	return -EOPNOTSUPP;
+}
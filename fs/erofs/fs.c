@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * fs.c: EROFS glue for the generic filesystem layer
+ */
+
+#include <erofs.h>
+#include <errno.h>
+#include <fs.h>
+#include <malloc.h>
+#include <part.h>
+#include <string.h>
+#include <linux/stat.h>
+#include <asm/byteorder.h>
+
+#include "internal.h"
+
+struct erofs_sb_info erofs_sbi;
+
+struct erofs_dir_stream {
+	struct fs_dir_stream fs_dirs;
+	struct fs_dirent dirent;
+
+	struct erofs_inode inode;
+	/* directory block currently being walked */
+	u8 *blk;
+	u64 blkaddr;
+	unsigned int maxsize, nent, idx;
+};
+
+int erofs_probe(struct blk_desc *fs_dev_desc,
+		struct disk_partition *fs_partition)
+{
+	int ret;
+
+	erofs_sbi.cur_dev = fs_dev_desc;
+	erofs_sbi.cur_part_info = *fs_partition;
+
+	ret = erofs_read_superblock();
+	if (ret)
+		goto error;
+
+	ret = erofs_cache_init(&erofs_sbi.meta_cache,
+			       CONFIG_EROFS_METADATA_CACHE_BLOCKS);
+	if (ret)
+		goto error;
+
+	return 0;
+error:
+	erofs_sbi.cur_dev = NULL;
+	return ret;
+}
+
+void erofs_close(void)
+{
+	erofs_cache_cleanup(&erofs_sbi.meta_cache);
+	erofs_sbi.cur_dev = NULL;
+}
+
+int erofs_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct erofs_dir_stream *dirs;
+	int ret;
+
+	dirs = calloc(1, sizeof(*dirs));
+	if (!dirs)
+		return -ENOMEM;
+
+	ret = erofs_ilookup(filename, &dirs->inode);
+	if (!ret && !S_ISDIR(dirs->inode.mode))
+		ret = -ENOTDIR;
+	if (!ret) {
+		dirs->blk = malloc(EROFS_BLKSIZ);
+		if (!dirs->blk)
+			ret = -ENOMEM;
+	}
+
+	if (ret) {
+		printf("** Cannot find directory. **\n");
+		free(dirs);
+		return ret;
+	}
+
+	*dirsp = (struct fs_dir_stream *)dirs;
+
+	return 0;
+}
+
+static int erofs_fill_dirent(struct fs_dirent *dent, u64 nid,
+			     unsigned int file_type)
+{
+	struct erofs_inode vi;
+	int ret;
+
+	dent->size = 0;
+	switch (file_type) {
+	case EROFS_FT_DIR:
+		dent->type = FS_DT_DIR;
+		return 0;
+	case EROFS_FT_SYMLINK:
+		dent->type = FS_DT_LNK;
+		return 0;
+	default:
+		dent->type = FS_DT_REG;
+		break;
+	}
+
+	ret = erofs_read_inode(nid, &vi);
+	if (ret)
+		return ret;
+
+	dent->size = vi.size;
+
+	return 0;
+}
+
+int erofs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
+{
+	struct erofs_dir_stream *dirs = (struct erofs_dir_stream *)fs_dirs;
+	struct erofs_dirent *de = (struct erofs_dirent *)dirs->blk;
+	unsigned int nameoff, nameend, namelen;
+	u64 pos;
+	int ret;
+
+	if (dirs->idx >= dirs->nent) {
+		pos = erofs_pos(dirs->blkaddr);
+		if (pos >= dirs->inode.size)
+			return -ENOENT;
+
+		dirs->maxsize = min_t(u64, EROFS_BLKSIZ,
+				      dirs->inode.size - pos);
+		ret = erofs_pread_meta(&dirs->inode, dirs->blk,
+				       dirs->maxsize, pos);
+		if (ret)
+			return ret;
+
+		nameoff = le16_to_cpu(de[0].nameoff);
+		if (nameoff < sizeof(*de) || nameoff >= dirs->maxsize)
+			return -EFSCORRUPTED;
+
+		dirs->nent = nameoff / sizeof(*de);
+		dirs->idx = 0;
+		dirs->blkaddr++;
+	}
+
+	nameoff = le16_to_cpu(de[dirs->idx].nameoff);
+	if (dirs->idx + 1 < dirs->nent)
+		nameend = le16_to_cpu(de[dirs->idx + 1].nameoff);
+	else
+		nameend = dirs->maxsize;
+	if (nameoff >= nameend || nameend > dirs->maxsize)
+		return -EFSCORRUPTED;
+
+	namelen = strnlen((char *)dirs->blk + nameoff, nameend - nameoff);
+	namelen = min_t(unsigned int, namelen, sizeof(dirs->dirent.name) - 1);
+	memcpy(dirs->dirent.name, dirs->blk + nameoff, namelen);
+	dirs->dirent.name[namelen] = '\0';
+
+	ret = erofs_fill_dirent(&dirs->dirent, le64_to_cpu(de[dirs->idx].nid),
+				de[dirs->idx].file_type);
+	if (ret)
+		return ret;
+
+	dirs->idx++;
+	*dentp = &dirs->dirent;
+
+	return 0;
+}
+
+void erofs_closedir(struct fs_dir_stream *fs_dirs)
+{
+	struct erofs_dir_stream *dirs = (struct erofs_dir_stream *)fs_dirs;
+
+	if (!dirs)
+		return;
+
+	free(dirs->blk);
+	free(dirs);
+}
+
+int erofs_exists(const char *filename)
+{
+	struct erofs_inode vi;
+
+	return !erofs_ilookup(filename, &vi);
+}
+
+int erofs_size(const char *filename, loff_t *size)
+{
+	struct erofs_inode vi;
+	int ret;
+
+	ret = erofs_ilookup(filename, &vi);
+	if (ret) {
+		printf("File not found.\n");
+		*size = 0;
+		return ret;
+	}
+
+	*size = vi.size;
+
+	return 0;
+}
+
+int erofs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	       loff_t *actread)
+{
+	struct erofs_inode vi;
+	int ret;
+
+	*actread = 0;
+
+	ret = erofs_ilookup(filename, &vi);
+	if (ret) {
+		printf("File not found.\n");
+		return ret;
+	}
+
+	if (S_ISDIR(vi.mode))
+		return -EISDIR;
+
+	if (offset >= vi.size)
+		return 0;
+
+	if (!len || len > vi.size - offset)
+		len = vi.size - offset;
+
+	ret = erofs_pread(&vi, buf, len, offset);
+	if (ret) {
+		printf("Error reading %s: %d\n", filename, ret);
+		return ret;
+	}
+
+	*actread = len;
+
+	return 0;
+}
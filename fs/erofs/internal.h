@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * internal.h: in-memory structures shared by the EROFS driver
+ */
+
+#ifndef __EROFS_INTERNAL_H
+#define __EROFS_INTERNAL_H
+
+#include <part.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
+
+#include "erofs_fs.h"
+
+#define EFSCORRUPTED	EUCLEAN		/* Filesystem is corrupted */
+
+/* Bounded LRU cache of raw metadata blocks, indexed by block address */
+struct erofs_cache_entry {
+	u32 blkaddr;
+	u32 last_use;
+	bool valid;
+	void *data;
+};
+
+struct erofs_cache {
+	struct erofs_cache_entry *entries;
+	int count;
+	u32 clock;
+};
+
+struct erofs_sb_info {
+	struct blk_desc *cur_dev;
+	struct disk_partition cur_part_info;
+
+	u8 blkszbits;
+	u32 blocks;
+	u32 meta_blkaddr;
+	u32 xattr_blkaddr;
+	u64 root_nid;
+	u32 feature_compat;
+	u32 feature_incompat;
+
+	struct erofs_cache meta_cache;
+};
+
+/* the single mounted filesystem */
+extern struct erofs_sb_info erofs_sbi;
+
+#define EROFS_BLKSIZ		(1U << erofs_sbi.blkszbits)
+#define erofs_blknr(addr)	((addr) >> erofs_sbi.blkszbits)
+#define erofs_blkoff(addr)	((addr) & (EROFS_BLKSIZ - 1))
+#define erofs_pos(blk)		((u64)(blk) << erofs_sbi.blkszbits)
+
+static inline u64 erofs_iloc(u64 nid)
+{
+	return erofs_pos(erofs_sbi.meta_blkaddr) + (nid << 5);
+}
+
+static inline bool erofs_sb_has_lz4_0padding(void)
+{
+	return erofs_sbi.feature_incompat & EROFS_FEATURE_INCOMPAT_LZ4_0PADDING;
+}
+
+static inline bool erofs_sb_has_big_pcluster(void)
+{
+	return erofs_sbi.feature_incompat & EROFS_FEATURE_INCOMPAT_BIG_PCLUSTER;
+}
+
+struct erofs_inode {
+	u64 nid;
+	u64 size;
+	u16 mode;
+	u8 datalayout;
+	u8 inode_isize;
+	u16 xattr_isize;
+
+	union {
+		u32 raw_blkaddr;
+		struct {
+			u16 chunkformat;
+			u8 chunkbits;
+		};
+		struct {
+			u16 z_advise;
+			u8 z_algorithmtype[2];
+			u8 z_logical_clusterbits;
+		};
+	};
+	bool z_inited;
+};
+
+static inline bool erofs_inode_is_compressed(struct erofs_inode *vi)
+{
+	return erofs_inode_is_data_compressed(vi->datalayout);
+}
+
+/* has a valid physical address */
+#define EROFS_MAP_MAPPED	0x0001
+/* located in the metadata area (e.g. inline tail data) */
+#define EROFS_MAP_META		0x0002
+/* the extent is compressed */
+#define EROFS_MAP_ZIPPED	0x0004
+/* the extent is fully mapped, m_llen is its exact decompressed length */
+#define EROFS_MAP_FULL_MAPPED	0x0008
+
+struct erofs_map_blocks {
+	u64 m_pa, m_la;
+	u64 m_plen, m_llen;
+	unsigned int m_flags;
+};
+
+/* Flags for z_erofs_map_blocks_iter() */
+/* also look ahead to find out the whole decompressed length of the extent */
+#define EROFS_GET_BLOCKS_FULL	0x0001
+
+/* data.c */
+int erofs_dev_read(void *buf, u64 offset, size_t len);
+int erofs_cache_init(struct erofs_cache *cache, int count);
+void erofs_cache_cleanup(struct erofs_cache *cache);
+void *erofs_read_metablock(u32 blkaddr);
+int erofs_read_metadata(void *buf, u64 offset, size_t len);
+int erofs_map_blocks(struct erofs_inode *vi, struct erofs_map_blocks *map);
+int erofs_pread(struct erofs_inode *vi, void *buf, u64 size, u64 offset);
+int erofs_pread_meta(struct erofs_inode *vi, void *buf, u64 size, u64 offset);
+
+/* zmap.c */
+int z_erofs_fill_inode(struct erofs_inode *vi);
+int z_erofs_map_blocks_iter(struct erofs_inode *vi,
+			    struct erofs_map_blocks *map, int flags);
+
+/* decompress.c */
+struct z_erofs_decompress_req {
+	char *in, *out;
+	unsigned int inputsize;
+	/* exact decompressed size of the whole extent */
+	unsigned int decodedlength;
+	/* only bytes [decodedskip, decodedskip + outputsize) go to 'out' */
+	unsigned int decodedskip, outputsize;
+	unsigned int alg;
+};
+
+/* room needed behind the output to decompress LZ4 data in place */
+#define Z_EROFS_LZ4_INPLACE_MARGIN(srcsize)	(((srcsize) >> 8) + 32)
+
+int z_erofs_decompress(struct z_erofs_decompress_req *rq);
+
+/* namei.c */
+int erofs_read_inode(u64 nid, struct erofs_inode *vi);
+int erofs_ilookup(const char *path, struct erofs_inode *vi);
+int erofs_readlink(struct erofs_inode *vi, char **target);
+
+/* super.c */
+int erofs_read_superblock(void);
+
+#endif /* __EROFS_INTERNAL_H */
@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * namei.c: EROFS inode loading and path lookup
+ */
+
+#include <errno.h>
+#include <log.h>
+#include <malloc.h>
+#include <string.h>
+#include <linux/stat.h>
+#include <asm/byteorder.h>
+
+#include "internal.h"
+
+/* maximum number of symlinks followed while resolving a single path */
+#define EROFS_MAX_SYMLINK_DEPTH	8
+
+int erofs_read_inode(u64 nid, struct erofs_inode *vi)
+{
+	struct erofs_inode_extended die;
+	struct erofs_inode_compact *dic = (struct erofs_inode_compact *)&die;
+	unsigned int ifmt;
+	u64 pos = erofs_iloc(nid);
+	int ret;
+
+	ret = erofs_read_metadata(dic, pos, sizeof(*dic));
+	if (ret)
+		return ret;
+
+	ifmt = le16_to_cpu(dic->i_format);
+	if (ifmt & ~EROFS_I_ALL) {
+		log_err("EROFS: unsupported i_format %u of nid %llu\n",
+			ifmt, nid);
+		return -EOPNOTSUPP;
+	}
+
+	memset(vi, 0, sizeof(*vi));
+	vi->nid = nid;
+	vi->datalayout = (ifmt >> EROFS_I_DATALAYOUT_BIT) &
+		((1 << EROFS_I_DATALAYOUT_BITS) - 1);
+	if (vi->datalayout >= EROFS_INODE_DATALAYOUT_MAX) {
+		log_err("EROFS: unsupported datalayout %u of nid %llu\n",
+			vi->datalayout, nid);
+		return -EOPNOTSUPP;
+	}
+
+	switch ((ifmt >> EROFS_I_VERSION_BIT) &
+		((1 << EROFS_I_VERSION_BITS) - 1)) {
+	case EROFS_INODE_LAYOUT_EXTENDED:
+		ret = erofs_read_metadata((void *)&die + sizeof(*dic),
+					  pos + sizeof(*dic),
+					  sizeof(die) - sizeof(*dic));
+		if (ret)
+			return ret;
+
+		vi->inode_isize = sizeof(die);
+		vi->xattr_isize = erofs_xattr_ibody_size(die.i_xattr_icount);
+		vi->mode = le16_to_cpu(die.i_mode);
+		vi->size = le64_to_cpu(die.i_size);
+		vi->raw_blkaddr = le32_to_cpu(die.i_u.raw_blkaddr);
+		break;
+	case EROFS_INODE_LAYOUT_COMPACT:
+		vi->inode_isize = sizeof(*dic);
+		vi->xattr_isize = erofs_xattr_ibody_size(dic->i_xattr_icount);
+		vi->mode = le16_to_cpu(dic->i_mode);
+		vi->size = le32_to_cpu(dic->i_size);
+		vi->raw_blkaddr = le32_to_cpu(dic->i_u.raw_blkaddr);
+		break;
+	}
+
+	if (vi->datalayout == EROFS_INODE_CHUNK_BASED) {
+		vi->chunkformat = vi->raw_blkaddr & 0xffff;
+		if (vi->chunkformat & ~EROFS_CHUNK_FORMAT_ALL) {
+			log_err("EROFS: unsupported chunk format %x of nid %llu\n",
+				vi->chunkformat, nid);
+			return -EOPNOTSUPP;
+		}
+		vi->chunkbits = erofs_sbi.blkszbits +
+			(vi->chunkformat & EROFS_CHUNK_FORMAT_BLKBITS_MASK);
+		if (vi->chunkbits >= 64)
+			return -EFSCORRUPTED;
+	}
+
+	return 0;
+}
+
+static int erofs_dirnamecmp(const char *name, size_t len,
+			    const char *dname, size_t dlen)
+{
+	int ret = memcmp(name, dname, min(len, dlen));
+
+	if (ret)
+		return ret;
+
+	return (len > dlen) - (len < dlen);
+}
+
+/*
+ * Binary search 'name' in a directory block. 'maxsize' is the number of
+ * valid bytes in the block. Returns 0 and the nid on a match, 1 if 'name'
+ * sorts after the last entry of the block, -ENOENT otherwise.
+ */
+static int erofs_find_in_dirblk(const u8 *blk, unsigned int maxsize,
+				const char *name, size_t len, u64 *nid)
+{
+	const struct erofs_dirent *de = (const struct erofs_dirent *)blk;
+	unsigned int nameoff, nameend, ndirents;
+	int head, back, mid, ret;
+
+	nameoff = le16_to_cpu(de[0].nameoff);
+	if (nameoff < sizeof(*de) || nameoff >= maxsize)
+		return -EFSCORRUPTED;
+
+	ndirents = nameoff / sizeof(*de);
+	head = 0;
+	back = ndirents - 1;
+	while (head <= back) {
+		mid = head + (back - head) / 2;
+		nameoff = le16_to_cpu(de[mid].nameoff);
+		if (mid + 1 < ndirents)
+			nameend = le16_to_cpu(de[mid + 1].nameoff);
+		else
+			nameend = maxsize;
+		if (nameoff >= nameend || nameend > maxsize)
+			return -EFSCORRUPTED;
+
+		ret = erofs_dirnamecmp(name, len, (const char *)blk + nameoff,
+				       strnlen((const char *)blk + nameoff,
+					       nameend - nameoff));
+		if (!ret) {
+			*nid = le64_to_cpu(de[mid].nid);
+			return 0;
+		}
+
+		if (ret > 0)
+			head = mid + 1;
+		else
+			back = mid - 1;
+	}
+
+	return head == ndirents ? 1 : -ENOENT;
+}
+
+static int erofs_dir_lookup(struct erofs_inode *dir, const char *name,
+			    size_t len, u64 *nid)
+{
+	u64 nblocks = DIV_ROUND_UP(dir->size, EROFS_BLKSIZ), blk;
+	unsigned int maxsize;
+	u8 *buf;
+	int ret = -ENOENT;
+
+	if (!S_ISDIR(dir->mode))
+		return -ENOTDIR;
+
+	buf = malloc(EROFS_BLKSIZ);
+	if (!buf)
+		return -ENOMEM;
+
+	/* names are sorted across the whole directory */
+	for (blk = 0; blk < nblocks; blk++) {
+		maxsize = min_t(u64, EROFS_BLKSIZ,
+				dir->size - erofs_pos(blk));
+		ret = erofs_pread_meta(dir, buf, maxsize, erofs_pos(blk));
+		if (ret)
+			break;
+
+		ret = erofs_find_in_dirblk(buf, maxsize, name, len, nid);
+		if (ret <= 0)
+			break;
+		ret = -ENOENT;
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+int erofs_readlink(struct erofs_inode *vi, char **target)
+{
+	char *buf;
+	int ret;
+
+	if (!S_ISLNK(vi->mode))
+		return -EINVAL;
+
+	if (vi->size > EROFS_BLKSIZ)
+		return -ENAMETOOLONG;
+
+	buf = malloc(vi->size + 1);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = erofs_pread_meta(vi, buf, vi->size, 0);
+	if (ret) {
+		free(buf);
+		return ret;
+	}
+
+	buf[vi->size] = '\0';
+	*target = buf;
+
+	return 0;
+}
+
+static int erofs_walk_path(struct erofs_inode *dir, const char *path,
+			   struct erofs_inode *vi, int depth)
+{
+	struct erofs_inode cur = *dir, parent;
+	const char *name = path, *next;
+	char *target;
+	size_t len;
+	u64 nid;
+	int ret;
+
+	while (1) {
+		while (*name == '/')
+			name++;
+		if (!*name)
+			break;
+
+		next = strchrnul(name, '/');
+		len = next - name;
+
+		parent = cur;
+		ret = erofs_dir_lookup(&parent, name, len, &nid);
+		if (ret)
+			return ret;
+
+		ret = erofs_read_inode(nid, &cur);
+		if (ret)
+			return ret;
+
+		if (S_ISLNK(cur.mode)) {
+			if (depth >= EROFS_MAX_SYMLINK_DEPTH)
+				return -ELOOP;
+
+			ret = erofs_readlink(&cur, &target);
+			if (ret)
+				return ret;
+
+			if (*target == '/')
+				ret = erofs_read_inode(erofs_sbi.root_nid,
+						       &parent);
+			if (!ret)
+				ret = erofs_walk_path(&parent, target, &cur,
+						      depth + 1);
+			free(target);
+			if (ret)
+				return ret;
+		}
+
+		name = next;
+	}
+
+	*vi = cur;
+
+	return 0;
+}
+
+int erofs_ilookup(const char *path, struct erofs_inode *vi)
+{
+	struct erofs_inode root;
+	int ret;
+
+	ret = erofs_read_inode(erofs_sbi.root_nid, &root);
+	if (ret)
+		return ret;
+
+	return erofs_walk_path(&root, path, vi, 0);
+}
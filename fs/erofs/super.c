@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * super.c: EROFS superblock parsing
+ */
+
+#include <errno.h>
+#include <log.h>
+#include <memalign.h>
+#include <asm/byteorder.h>
+
+#include "internal.h"
+
+int erofs_read_superblock(void)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, data, 1 << EROFS_MIN_BLKSZBITS);
+	struct erofs_super_block *dsb;
+	int ret;
+
+	erofs_check_ondisk_layout_definitions();
+
+	ret = erofs_dev_read(data, EROFS_SUPER_OFFSET, sizeof(*dsb));
+	if (ret)
+		return ret;
+
+	dsb = (struct erofs_super_block *)data;
+	if (le32_to_cpu(dsb->magic) != EROFS_SUPER_MAGIC_V1)
+		return -EINVAL;
+
+	erofs_sbi.feature_compat = le32_to_cpu(dsb->feature_compat);
+	erofs_sbi.feature_incompat = le32_to_cpu(dsb->feature_incompat);
+	if (erofs_sbi.feature_incompat & ~EROFS_ALL_FEATURE_INCOMPAT) {
+		log_err("EROFS: unsupported incompatible features %x\n",
+			erofs_sbi.feature_incompat &
+			~EROFS_ALL_FEATURE_INCOMPAT);
+		return -EOPNOTSUPP;
+	}
+
+	erofs_sbi.blkszbits = dsb->blkszbits;
+	if (erofs_sbi.blkszbits < EROFS_MIN_BLKSZBITS ||
+	    erofs_sbi.blkszbits > EROFS_MAX_BLKSZBITS) {
+		log_err("EROFS: unsupported block size %u\n",
+			1U << erofs_sbi.blkszbits);
+		return -EOPNOTSUPP;
+	}
+
+	if (le16_to_cpu(dsb->extra_devices)) {
+		log_err("EROFS: multiple devices are not supported\n");
+		return -EOPNOTSUPP;
+	}
+
+	erofs_sbi.blocks = le32_to_cpu(dsb->blocks);
+	erofs_sbi.meta_blkaddr = le32_to_cpu(dsb->meta_blkaddr);
+	erofs_sbi.xattr_blkaddr = le32_to_cpu(dsb->xattr_blkaddr);
+	erofs_sbi.root_nid = le16_to_cpu(dsb->root_nid);
+
+	return 0;
+}
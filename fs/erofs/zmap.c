@@ -0,0 +1,545 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * zmap.c: logical to physical mapping of EROFS compressed files
+ *
+ * Derived from the Linux kernel's fs/erofs/zmap.c.
+ */
+
+#include <errno.h>
+#include <log.h>
+#include <linux/err.h>
+#include <asm/byteorder.h>
+#include <asm/unaligned.h>
+
+#include "internal.h"
+
+int z_erofs_fill_inode(struct erofs_inode *vi)
+{
+	struct z_erofs_map_header h;
+	u64 pos;
+	int ret;
+
+	if (vi->z_inited)
+		return 0;
+
+	pos = round_up(erofs_iloc(vi->nid) + vi->inode_isize + vi->xattr_isize,
+		       8);
+	ret = erofs_read_metadata(&h, pos, sizeof(h));
+	if (ret)
+		return ret;
+
+	vi->z_advise = le16_to_cpu(h.h_advise);
+	vi->z_algorithmtype[0] = h.h_algorithmtype & 15;
+	vi->z_algorithmtype[1] = h.h_algorithmtype >> 4;
+
+	if (vi->z_algorithmtype[0] != Z_EROFS_COMPRESSION_LZ4) {
+		log_err("EROFS: unsupported compression algorithm %u @ nid %llu\n",
+			vi->z_algorithmtype[0], vi->nid);
+		return -EOPNOTSUPP;
+	}
+
+	if (vi->z_advise & (Z_EROFS_ADVISE_INLINE_PCLUSTER |
+			    Z_EROFS_ADVISE_INTERLACED_PCLUSTER |
+			    Z_EROFS_ADVISE_FRAGMENT_PCLUSTER)) {
+		log_err("EROFS: unsupported compression advise %x @ nid %llu\n",
+			vi->z_advise, vi->nid);
+		return -EOPNOTSUPP;
+	}
+
+	vi->z_logical_clusterbits = erofs_sbi.blkszbits + (h.h_clusterbits & 7);
+
+	if (vi->datalayout == EROFS_INODE_FLAT_COMPRESSION &&
+	    !(vi->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_1) ^
+	    !(vi->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_2)) {
+		log_err("EROFS: big pcluster head1/2 of compact indexes should be consistent @ nid %llu\n",
+			vi->nid);
+		return -EFSCORRUPTED;
+	}
+
+	vi->z_inited = true;
+
+	return 0;
+}
+
+struct z_erofs_maprecorder {
+	struct erofs_inode *inode;
+	struct erofs_map_blocks *map;
+
+	unsigned long lcn;
+	/* compression extent information gathered */
+	u8  type;
+	u16 clusterofs;
+	u16 delta[2];
+	u32 pblk, compressedlcs;
+};
+
+static int legacy_load_cluster_from_disk(struct z_erofs_maprecorder *m,
+					 unsigned long lcn)
+{
+	struct erofs_inode *const vi = m->inode;
+	const u64 ibase = erofs_iloc(vi->nid);
+	const u64 pos = Z_EROFS_VLE_LEGACY_INDEX_ALIGN(ibase + vi->inode_isize +
+						       vi->xattr_isize) +
+		lcn * sizeof(struct z_erofs_vle_decompressed_index);
+	struct z_erofs_vle_decompressed_index *di;
+	unsigned int advise, type;
+	void *blk;
+
+	blk = erofs_read_metablock(erofs_blknr(pos));
+	if (IS_ERR(blk))
+		return PTR_ERR(blk);
+
+	m->lcn = lcn;
+	di = blk + erofs_blkoff(pos);
+
+	advise = le16_to_cpu(di->di_advise);
+	type = (advise >> Z_EROFS_VLE_DI_CLUSTER_TYPE_BIT) &
+		((1 << Z_EROFS_VLE_DI_CLUSTER_TYPE_BITS) - 1);
+	switch (type) {
+	case Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD:
+		m->clusterofs = 1 << vi->z_logical_clusterbits;
+		m->delta[0] = le16_to_cpu(di->di_u.delta[0]);
+		if (m->delta[0] & Z_EROFS_VLE_DI_D0_CBLKCNT) {
+			if (!(vi->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_1))
+				return -EFSCORRUPTED;
+			m->compressedlcs = m->delta[0] &
+				~Z_EROFS_VLE_DI_D0_CBLKCNT;
+			m->delta[0] = 1;
+		}
+		m->delta[1] = le16_to_cpu(di->di_u.delta[1]);
+		break;
+	case Z_EROFS_VLE_CLUSTER_TYPE_PLAIN:
+	case Z_EROFS_VLE_CLUSTER_TYPE_HEAD:
+		m->clusterofs = le16_to_cpu(di->di_clusterofs);
+		m->pblk = le32_to_cpu(di->di_u.blkaddr);
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+	m->type = type;
+
+	return 0;
+}
+
+static unsigned int decode_compactedbits(unsigned int lobits,
+					 unsigned int lomask,
+					 u8 *in, unsigned int pos, u8 *type)
+{
+	const unsigned int v = get_unaligned_le32(in + pos / 8) >> (pos & 7);
+	const unsigned int lo = v & lomask;
+
+	*type = (v >> lobits) & 3;
+	return lo;
+}
+
+static int get_compacted_la_distance(unsigned int lclusterbits,
+				     unsigned int encodebits,
+				     unsigned int vcnt, u8 *in, int i)
+{
+	const unsigned int lomask = (1 << lclusterbits) - 1;
+	unsigned int lo, d1 = 0;
+	u8 type;
+
+	do {
+		lo = decode_compactedbits(lclusterbits, lomask,
+					  in, encodebits * i, &type);
+
+		if (type != Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD)
+			return d1;
+		++d1;
+	} while (++i < vcnt);
+
+	/* vcnt - 1 (Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD) item */
+	if (!(lo & Z_EROFS_VLE_DI_D0_CBLKCNT))
+		d1 += lo - 1;
+	return d1;
+}
+
+static int unpack_compacted_index(struct z_erofs_maprecorder *m,
+				  unsigned int amortizedshift,
+				  u64 pos, bool lookahead)
+{
+	struct erofs_inode *const vi = m->inode;
+	const unsigned int lclusterbits = vi->z_logical_clusterbits;
+	const unsigned int lomask = (1 << lclusterbits) - 1;
+	unsigned int vcnt, base, lo, encodebits, nblk, eofs;
+	bool big_pcluster;
+	u8 *in, type;
+	void *blk;
+	int i;
+
+	if (1 << amortizedshift == 4 && lclusterbits <= 14)
+		vcnt = 2;
+	else if (1 << amortizedshift == 2 && lclusterbits == 12)
+		vcnt = 16;
+	else
+		return -EOPNOTSUPP;
+
+	blk = erofs_read_metablock(erofs_blknr(pos));
+	if (IS_ERR(blk))
+		return PTR_ERR(blk);
+
+	big_pcluster = vi->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_1;
+	encodebits = ((vcnt << amortizedshift) - sizeof(__le32)) * 8 / vcnt;
+	eofs = erofs_blkoff(pos);
+	base = round_down(eofs, vcnt << amortizedshift);
+	in = blk + base;
+
+	i = (eofs - base) >> amortizedshift;
+
+	lo = decode_compactedbits(lclusterbits, lomask,
+				  in, encodebits * i, &type);
+	m->type = type;
+	if (type == Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD) {
+		m->clusterofs = 1 << lclusterbits;
+
+		/* figure out lookahead_distance: delta[1] if needed */
+		if (lookahead)
+			m->delta[1] = get_compacted_la_distance(lclusterbits,
+								encodebits,
+								vcnt, in, i);
+
+		if (lo & Z_EROFS_VLE_DI_D0_CBLKCNT) {
+			if (!big_pcluster)
+				return -EFSCORRUPTED;
+			m->compressedlcs = lo & ~Z_EROFS_VLE_DI_D0_CBLKCNT;
+			m->delta[0] = 1;
+			return 0;
+		} else if (i + 1 != (int)vcnt) {
+			m->delta[0] = lo;
+			return 0;
+		}
+		/*
+		 * since the last lcluster in the pack is special,
+		 * of which lo saves delta[1] rather than delta[0].
+		 * Hence, get delta[0] by the previous lcluster indirectly.
+		 */
+		lo = decode_compactedbits(lclusterbits, lomask,
+					  in, encodebits * (i - 1), &type);
+		if (type != Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD)
+			lo = 0;
+		else if (lo & Z_EROFS_VLE_DI_D0_CBLKCNT)
+			lo = 1;
+		m->delta[0] = lo + 1;
+		return 0;
+	}
+	m->clusterofs = lo;
+	m->delta[0] = 0;
+	/* figout out blkaddr (pblk) for HEAD lclusters */
+	if (!big_pcluster) {
+		nblk = 1;
+		while (i > 0) {
+			--i;
+			lo = decode_compactedbits(lclusterbits, lomask,
+						  in, encodebits * i, &type);
+			if (type == Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD)
+				i -= lo;
+
+			if (i >= 0)
+				++nblk;
+		}
+	} else {
+		nblk = 0;
+		while (i > 0) {
+			--i;
+			lo = decode_compactedbits(lclusterbits, lomask,
+						  in, encodebits * i, &type);
+			if (type == Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD) {
+				if (lo & Z_EROFS_VLE_DI_D0_CBLKCNT) {
+					--i;
+					nblk += lo & ~Z_EROFS_VLE_DI_D0_CBLKCNT;
+					continue;
+				}
+				/* bigpcluster shouldn't have plain d0 == 1 */
+				if (lo <= 1)
+					return -EFSCORRUPTED;
+				i -= lo - 2;
+				continue;
+			}
+			++nblk;
+		}
+	}
+	in += (vcnt << amortizedshift) - sizeof(__le32);
+	m->pblk = get_unaligned_le32(in) + nblk;
+
+	return 0;
+}
+
+static int compacted_load_cluster_from_disk(struct z_erofs_maprecorder *m,
+					    unsigned long lcn, bool lookahead)
+{
+	struct erofs_inode *const vi = m->inode;
+	const unsigned int lclusterbits = vi->z_logical_clusterbits;
+	const u64 ebase = round_up(erofs_iloc(vi->nid) + vi->inode_isize +
+				   vi->xattr_isize, 8) +
+		sizeof(struct z_erofs_map_header);
+	const unsigned long totalidx = DIV_ROUND_UP(vi->size, 1 << lclusterbits);
+	unsigned int compacted_4b_initial, compacted_2b;
+	unsigned int amortizedshift;
+	u64 pos;
+
+	if (lcn >= totalidx)
+		return -EINVAL;
+
+	m->lcn = lcn;
+	/* used to align to 32-byte (compacted_2b) alignment */
+	compacted_4b_initial = (32 - ebase % 32) / 4;
+	if (compacted_4b_initial == 32 / 4)
+		compacted_4b_initial = 0;
+
+	if ((vi->z_advise & Z_EROFS_ADVISE_COMPACTED_2B) &&
+	    compacted_4b_initial < totalidx)
+		compacted_2b = rounddown(totalidx - compacted_4b_initial, 16);
+	else
+		compacted_2b = 0;
+
+	pos = ebase;
+	if (lcn < compacted_4b_initial) {
+		amortizedshift = 2;
+		goto out;
+	}
+	pos += compacted_4b_initial * 4;
+	lcn -= compacted_4b_initial;
+
+	if (lcn < compacted_2b) {
+		amortizedshift = 1;
+		goto out;
+	}
+	pos += compacted_2b * 2;
+	lcn -= compacted_2b;
+	amortizedshift = 2;
+out:
+	pos += lcn * (1 << amortizedshift);
+
+	return unpack_compacted_index(m, amortizedshift, pos, lookahead);
+}
+
+static int z_erofs_load_cluster_from_disk(struct z_erofs_maprecorder *m,
+					  unsigned int lcn, bool lookahead)
+{
+	const unsigned int datamode = m->inode->datalayout;
+
+	if (datamode == EROFS_INODE_FLAT_COMPRESSION_LEGACY)
+		return legacy_load_cluster_from_disk(m, lcn);
+
+	if (datamode == EROFS_INODE_FLAT_COMPRESSION)
+		return compacted_load_cluster_from_disk(m, lcn, lookahead);
+
+	return -EINVAL;
+}
+
+static int z_erofs_extent_lookback(struct z_erofs_maprecorder *m,
+				   unsigned int lookback_distance)
+{
+	struct erofs_inode *const vi = m->inode;
+	struct erofs_map_blocks *const map = m->map;
+	const unsigned int lclusterbits = vi->z_logical_clusterbits;
+	unsigned long lcn = m->lcn;
+	int ret;
+
+	while (1) {
+		if (lcn < lookback_distance) {
+			log_err("EROFS: bogus lookback distance @ nid %llu\n",
+				vi->nid);
+			return -EFSCORRUPTED;
+		}
+
+		/* load extent head logical cluster if needed */
+		lcn -= lookback_distance;
+		ret = z_erofs_load_cluster_from_disk(m, lcn, false);
+		if (ret)
+			return ret;
+
+		switch (m->type) {
+		case Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD:
+			if (!m->delta[0]) {
+				log_err("EROFS: invalid lookback distance 0 @ nid %llu\n",
+					vi->nid);
+				return -EFSCORRUPTED;
+			}
+			lookback_distance = m->delta[0];
+			continue;
+		case Z_EROFS_VLE_CLUSTER_TYPE_PLAIN:
+			map->m_flags &= ~EROFS_MAP_ZIPPED;
+			fallthrough;
+		case Z_EROFS_VLE_CLUSTER_TYPE_HEAD:
+			map->m_la = (lcn << lclusterbits) | m->clusterofs;
+			return 0;
+		default:
+			log_err("EROFS: unknown type %u @ lcn %lu of nid %llu\n",
+				m->type, lcn, vi->nid);
+			return -EOPNOTSUPP;
+		}
+	}
+}
+
+static int z_erofs_get_extent_compressedlen(struct z_erofs_maprecorder *m,
+					    unsigned int initial_lcn)
+{
+	struct erofs_inode *const vi = m->inode;
+	struct erofs_map_blocks *const map = m->map;
+	const unsigned int lclusterbits = vi->z_logical_clusterbits;
+	unsigned long lcn;
+	int ret;
+
+	if (m->type != Z_EROFS_VLE_CLUSTER_TYPE_HEAD ||
+	    !(vi->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_1)) {
+		map->m_plen = 1 << lclusterbits;
+		return 0;
+	}
+
+	lcn = m->lcn + 1;
+	if (m->compressedlcs)
+		goto out;
+
+	ret = z_erofs_load_cluster_from_disk(m, lcn, false);
+	if (ret)
+		return ret;
+
+	switch (m->type) {
+	case Z_EROFS_VLE_CLUSTER_TYPE_PLAIN:
+	case Z_EROFS_VLE_CLUSTER_TYPE_HEAD:
+		/*
+		 * if the 1st NONHEAD lcluster is actually PLAIN or HEAD type
+		 * rather than CBLKCNT, it's a 1 lcluster-sized pcluster.
+		 */
+		m->compressedlcs = 1;
+		break;
+	case Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD:
+		if (m->delta[0] == 1 && m->compressedlcs)
+			break;
+		fallthrough;
+	default:
+		log_err("EROFS: cannot find CBLKCNT @ lcn %lu of nid %llu\n",
+			lcn, vi->nid);
+		return -EFSCORRUPTED;
+	}
+out:
+	map->m_plen = (u64)m->compressedlcs << lclusterbits;
+
+	return 0;
+}
+
+static int z_erofs_get_extent_decompressedlen(struct z_erofs_maprecorder *m)
+{
+	struct erofs_inode *const vi = m->inode;
+	struct erofs_map_blocks *const map = m->map;
+	const unsigned int lclusterbits = vi->z_logical_clusterbits;
+	u64 lcn = m->lcn, headlcn = map->m_la >> lclusterbits;
+	int ret;
+
+	do {
+		/* handle the last EOF pcluster (no next HEAD lcluster) */
+		if ((lcn << lclusterbits) >= vi->size) {
+			map->m_llen = vi->size - map->m_la;
+			return 0;
+		}
+
+		ret = z_erofs_load_cluster_from_disk(m, lcn, true);
+		if (ret)
+			return ret;
+
+		if (m->type == Z_EROFS_VLE_CLUSTER_TYPE_PLAIN ||
+		    m->type == Z_EROFS_VLE_CLUSTER_TYPE_HEAD) {
+			/* go on until the next HEAD lcluster */
+			if (lcn != headlcn)
+				break;
+			m->delta[1] = 1;
+		} else if (m->type != Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD) {
+			log_err("EROFS: unknown type %u @ lcn %llu of nid %llu\n",
+				m->type, lcn, vi->nid);
+			return -EOPNOTSUPP;
+		}
+		lcn += m->delta[1];
+	} while (m->delta[1]);
+
+	map->m_llen = (lcn << lclusterbits) + m->clusterofs - map->m_la;
+
+	return 0;
+}
+
+int z_erofs_map_blocks_iter(struct erofs_inode *vi,
+			    struct erofs_map_blocks *map, int flags)
+{
+	struct z_erofs_maprecorder m = {
+		.inode = vi,
+		.map = map,
+	};
+	unsigned int lclusterbits, endoff;
+	unsigned long initial_lcn;
+	u64 ofs, end;
+	int ret;
+
+	/* when trying to read beyond EOF, leave it unmapped */
+	if (map->m_la >= vi->size) {
+		map->m_llen = map->m_la + 1 - vi->size;
+		map->m_la = vi->size;
+		map->m_flags = 0;
+		return 0;
+	}
+
+	ret = z_erofs_fill_inode(vi);
+	if (ret)
+		return ret;
+
+	lclusterbits = vi->z_logical_clusterbits;
+	ofs = map->m_la;
+	initial_lcn = ofs >> lclusterbits;
+	endoff = ofs & ((1 << lclusterbits) - 1);
+
+	ret = z_erofs_load_cluster_from_disk(&m, initial_lcn, false);
+	if (ret)
+		return ret;
+
+	map->m_flags = EROFS_MAP_ZIPPED;	/* by default, compressed */
+	end = ((u64)m.lcn + 1) << lclusterbits;
+
+	switch (m.type) {
+	case Z_EROFS_VLE_CLUSTER_TYPE_PLAIN:
+	case Z_EROFS_VLE_CLUSTER_TYPE_HEAD:
+		if (endoff >= m.clusterofs) {
+			if (m.type == Z_EROFS_VLE_CLUSTER_TYPE_PLAIN)
+				map->m_flags &= ~EROFS_MAP_ZIPPED;
+			map->m_la = ((u64)m.lcn << lclusterbits) | m.clusterofs;
+			break;
+		}
+		/* m.lcn should be >= 1 if endoff < m.clusterofs */
+		if (!m.lcn) {
+			log_err("EROFS: invalid logical cluster 0 @ nid %llu\n",
+				vi->nid);
+			return -EFSCORRUPTED;
+		}
+		end = ((u64)m.lcn << lclusterbits) | m.clusterofs;
+		map->m_flags |= EROFS_MAP_FULL_MAPPED;
+		m.delta[0] = 1;
+		fallthrough;
+	case Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD:
+		/* get the corresponding first chunk */
+		ret = z_erofs_extent_lookback(&m, m.delta[0]);
+		if (ret)
+			return ret;
+		break;
+	default:
+		log_err("EROFS: unknown type %u @ offset %llu of nid %llu\n",
+			m.type, ofs, vi->nid);
+		return -EOPNOTSUPP;
+	}
+
+	map->m_llen = end - map->m_la;
+	map->m_pa = erofs_pos(m.pblk);
+	map->m_flags |= EROFS_MAP_MAPPED;
+
+	ret = z_erofs_get_extent_compressedlen(&m, initial_lcn);
+	if (ret)
+		return ret;
+
+	if ((flags & EROFS_GET_BLOCKS_FULL) &&
+	    !(map->m_flags & EROFS_MAP_FULL_MAPPED)) {
+		ret = z_erofs_get_extent_decompressedlen(&m);
+		if (ret)
+			return ret;
+		map->m_flags |= EROFS_MAP_FULL_MAPPED;
+	}
+
+	return 0;
+}
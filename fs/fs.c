@@ -26,6 +26,9 @@
 #include <linux/math64.h>
 #include <efi_loader.h>
 #include <squashfs.h>
+#include <erofs.h>
+#include <malloc.h>
+#include <linux/list.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -144,6 +147,12 @@ struct fstype_info {
 	 * filesystem.
 	 */
 	bool null_dev_desc_ok;
+	/*
+	 * The driver holds all its mount state in memory and can be left
+	 * mounted after fs_close() (see CONFIG_FS_MOUNT_CACHE). This must
+	 * only be set if nothing but this file probes and closes it.
+	 */
+	bool cache_mount;
 	int (*probe)(struct blk_desc *fs_dev_desc,
 		     struct disk_partition *fs_partition);
 	int (*ls)(const char *dirname);
@@ -208,6 +217,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_EXT,
 		.name = "ext4",
 		.null_dev_desc_ok = false,
+		.cache_mount = true,
 		.probe = ext4fs_probe,
 		.close = ext4fs_close,
 		.ls = ext4fs_ls,
@@ -270,6 +280,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_BTRFS,
 		.name = "btrfs",
 		.null_dev_desc_ok = false,
+		.cache_mount = true,
 		.probe = btrfs_probe,
 		.close = btrfs_close,
 		.ls = btrfs_ls,
@@ -289,6 +300,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_SQUASHFS,
 		.name = "squashfs",
 		.null_dev_desc_ok = false,
+		.cache_mount = true,
 		.probe = sqfs_probe,
 		.opendir = sqfs_opendir,
 		.readdir = sqfs_readdir,
@@ -304,6 +316,28 @@ static struct fstype_info fstypes[] = {
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
 	},
+#endif
+#if IS_ENABLED(CONFIG_FS_EROFS)
+	{
+		.fstype = FS_TYPE_EROFS,
+		.name = "erofs",
+		.null_dev_desc_ok = false,
+		.cache_mount = true,
+		.probe = erofs_probe,
+		.opendir = erofs_opendir,
+		.readdir = erofs_readdir,
+		.ls = fs_ls_generic,
+		.read = erofs_read,
+		.size = erofs_size,
+		.close = erofs_close,
+		.closedir = erofs_closedir,
+		.exists = erofs_exists,
+		.uuid = fs_uuid_unsupported,
+		.write = fs_write_unsupported,
+		.ln = fs_ln_unsupported,
+		.unlink = fs_unlink_unsupported,
+		.mkdir = fs_mkdir_unsupported,
+	},
 #endif
 	{
 		.fstype = FS_TYPE_ANY,
@@ -364,6 +398,195 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
+/*
+ * The filesystem kept mounted after fs_close(). fstype is FS_TYPE_ANY if
+ * there is none. A write to the device while the filesystem is in use
+ * marks it stale, so that it is closed by the next fs_close().
+ */
+static struct {
+	int fstype;
+	bool stale;
+	struct blk_desc *desc;
+	int hwpart;
+	int part;
+	lbaint_t start;
+	lbaint_t size;
+} fs_mount = {
+	.fstype = FS_TYPE_ANY,
+};
+
+static void fs_mount_release(void)
+{
+	if (fs_mount.fstype == FS_TYPE_ANY)
+		return;
+
+	log_debug("closing cached %s mount\n",
+		  fs_get_info(fs_mount.fstype)->name);
+	fs_get_info(fs_mount.fstype)->close();
+	fs_mount.fstype = FS_TYPE_ANY;
+}
+
+/* Remember the filesystem just probed so that fs_close() keeps it open */
+static void fs_mount_record(struct fstype_info *info, int part)
+{
+	if (!CONFIG_IS_ENABLED(FS_MOUNT_CACHE) || !info->cache_mount)
+		return;
+
+	fs_mount.fstype = info->fstype;
+	fs_mount.stale = false;
+	fs_mount.desc = fs_dev_desc;
+	fs_mount.hwpart = fs_dev_desc->hwpart;
+	fs_mount.part = part;
+	fs_mount.start = fs_partition.start;
+	fs_mount.size = fs_partition.size;
+}
+
+/*
+ * Reuse the cached mount if it matches the device and partition just looked
+ * up, otherwise close it so that the new one can be probed.
+ */
+static bool fs_mount_reuse(int fstype, int part)
+{
+	if (fs_mount.fstype == FS_TYPE_ANY)
+		return false;
+
+	if (!fs_mount.stale && fs_dev_desc && fs_mount.desc == fs_dev_desc &&
+	    fs_mount.hwpart == fs_dev_desc->hwpart && fs_mount.part == part &&
+	    fs_mount.start == fs_partition.start &&
+	    fs_mount.size == fs_partition.size &&
+	    (fstype == FS_TYPE_ANY || fstype == fs_mount.fstype)) {
+		fs_type = fs_mount.fstype;
+		fs_dev_part = part;
+		return true;
+	}
+
+	fs_mount_release();
+
+	return false;
+}
+
+#if CONFIG_IS_ENABLED(FS_FILE_CACHE)
+struct fs_file_cache_entry {
+	struct list_head list;
+	struct blk_desc *desc;
+	int hwpart;
+	int part;
+	char *path;
+	loff_t size;
+	void *data;
+};
+
+/* Most recently used entry first */
+static LIST_HEAD(fs_file_cache);
+static loff_t fs_file_cache_used;
+
+static void fs_file_cache_free(struct fs_file_cache_entry *ent)
+{
+	list_del(&ent->list);
+	fs_file_cache_used -= ent->size;
+	free(ent->path);
+	free(ent->data);
+	free(ent);
+}
+
+static void fs_file_cache_drop(struct blk_desc *desc)
+{
+	struct fs_file_cache_entry *ent, *next;
+
+	list_for_each_entry_safe(ent, next, &fs_file_cache, list) {
+		if (!desc || ent->desc == desc)
+			fs_file_cache_free(ent);
+	}
+}
+
+static struct fs_file_cache_entry *fs_file_cache_find(const char *filename)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct fs_file_cache_entry *ent;
+
+	if (!info->cache_mount || !fs_dev_desc)
+		return NULL;
+
+	list_for_each_entry(ent, &fs_file_cache, list) {
+		if (ent->desc == fs_dev_desc &&
+		    ent->hwpart == fs_dev_desc->hwpart &&
+		    ent->part == fs_dev_part && !strcmp(ent->path, filename)) {
+			list_move(&ent->list, &fs_file_cache);
+			return ent;
+		}
+	}
+
+	return NULL;
+}
+
+static void fs_file_cache_add(const char *filename, const void *buf,
+			      loff_t size)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct fs_file_cache_entry *ent;
+
+	if (!info->cache_mount || !fs_dev_desc ||
+	    size > CONFIG_FS_FILE_CACHE_SIZE || fs_file_cache_find(filename))
+		return;
+
+	while (fs_file_cache_used + size > CONFIG_FS_FILE_CACHE_SIZE)
+		fs_file_cache_free(list_last_entry(&fs_file_cache,
+						   struct fs_file_cache_entry,
+						   list));
+
+	ent = calloc(1, sizeof(*ent));
+	if (!ent)
+		return;
+	ent->path = strdup(filename);
+	ent->data = malloc(size ? size : 1);
+	if (!ent->path || !ent->data) {
+		free(ent->path);
+		free(ent->data);
+		free(ent);
+		return;
+	}
+
+	memcpy(ent->data, buf, size);
+	ent->desc = fs_dev_desc;
+	ent->hwpart = fs_dev_desc->hwpart;
+	ent->part = fs_dev_part;
+	ent->size = size;
+	list_add(&ent->list, &fs_file_cache);
+	fs_file_cache_used += size;
+}
+#else
+struct fs_file_cache_entry {
+	loff_t size;
+	void *data;
+};
+
+static inline void fs_file_cache_drop(struct blk_desc *desc) {}
+
+static inline struct fs_file_cache_entry *fs_file_cache_find(const char *fn)
+{
+	return NULL;
+}
+
+static inline void fs_file_cache_add(const char *filename, const void *buf,
+				     loff_t size) {}
+#endif
+
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+void fs_cache_invalidate(struct blk_desc *desc)
+{
+	fs_file_cache_drop(desc);
+
+	if (fs_mount.fstype == FS_TYPE_ANY || (desc && fs_mount.desc != desc))
+		return;
+
+	/* Don't pull the filesystem from under a running operation */
+	if (fs_type == FS_TYPE_ANY)
+		fs_mount_release();
+	else
+		fs_mount.stale = true;
+}
+#endif
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -390,6 +613,9 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	if (part < 0)
 		return -1;
 
+	if (fs_mount_reuse(fstype, part))
+		return 0;
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
 				fstype != info->fstype)
@@ -401,6 +627,7 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
 			fs_dev_part = part;
+			fs_mount_record(info, part);
 			return 0;
 		}
 	}
@@ -422,10 +649,14 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		return ret;
 	fs_dev_desc = desc;
 
+	if (fs_mount_reuse(FS_TYPE_ANY, part))
+		return 0;
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
 			fs_dev_part = part;
+			fs_mount_record(info, part);
 			return 0;
 		}
 	}
@@ -437,6 +668,14 @@ void fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 
+	if (fs_type != FS_TYPE_ANY && fs_mount.fstype == fs_type) {
+		if (!fs_mount.stale) {
+			fs_type = FS_TYPE_ANY;
+			return;
+		}
+		fs_mount.fstype = FS_TYPE_ANY;
+	}
+
 	info->close();
 
 	fs_type = FS_TYPE_ANY;
@@ -468,20 +707,37 @@ int fs_exists(const char *filename)
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
-	ret = info->exists(filename);
+	if (fs_file_cache_find(filename))
+		ret = 1;
+	else
+		ret = info->exists(filename);
 
 	fs_close();
 
 	return ret;
 }
 
+/* Get the size of a file, from the file cache if possible */
+static int fs_get_size(struct fstype_info *info, const char *filename,
+		       loff_t *size)
+{
+	struct fs_file_cache_entry *ent = fs_file_cache_find(filename);
+
+	if (ent) {
+		*size = ent->size;
+		return 0;
+	}
+
+	return info->size(filename, size);
+}
+
 int fs_size(const char *filename, loff_t *size)
 {
 	int ret;
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
-	ret = info->size(filename, size);
+	ret = fs_get_size(info, filename, size);
 
 	fs_close();
 
@@ -499,7 +755,7 @@ static int fs_read_lmb_check(const char *filename, ulong addr, loff_t offset,
 	loff_t read_len;
 
 	/* get the actual size of the file */
-	ret = info->size(filename, &size);
+	ret = fs_get_size(info, filename, &size);
 	if (ret)
 		return ret;
 	if (offset >= size) {
@@ -527,6 +783,7 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 		    int do_lmb_check, loff_t *actread)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
+	struct fs_file_cache_entry *ent;
 	void *buf;
 	int ret;
 
@@ -543,7 +800,21 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	 * means read the whole file.
 	 */
 	buf = map_sysmem(addr, len);
-	ret = info->read(filename, buf, offset, len, actread);
+	ent = fs_file_cache_find(filename);
+	if (ent) {
+		*actread = 0;
+		if (offset < ent->size) {
+			*actread = ent->size - offset;
+			if (len && len < *actread)
+				*actread = len;
+			memcpy(buf, ent->data + offset, *actread);
+		}
+		ret = 0;
+	} else {
+		ret = info->read(filename, buf, offset, len, actread);
+		if (!ret && !offset && !len)
+			fs_file_cache_add(filename, buf, *actread);
+	}
 	unmap_sysmem(buf);
 
 	/* If we requested a specific number of bytes, check we got it */
@@ -8,12 +8,14 @@
  */
 
 #include <asm/unaligned.h>
+#include <blk.h>
 #include <errno.h>
 #include <fs.h>
 #include <linux/types.h>
 #include <linux/byteorder/little_endian.h>
 #include <linux/byteorder/generic.h>
 #include <memalign.h>
+#include <par_run.h>
 #include <stdlib.h>
 #include <string.h>
 #include <squashfs.h>
@@ -93,107 +95,143 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 }
 
 /*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
+ * Decompresses (or copies, if it is stored uncompressed) the metadata block
+ * payload found at 'src' into a cache entry, and marks the entry valid.
  */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+static int sqfs_fill_metablk(struct squashfs_cache_entry *entry,
+			     unsigned char *src, bool compressed, u32 src_len)
 {
-	u64 start, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
-	struct squashfs_super_block *sblk = ctxt.sblk;
 	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
+	int ret;
 
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
+	if (compressed) {
+		dest_len = SQFS_METADATA_BLOCK_SIZE;
+		ret = sqfs_decompress(&ctxt, entry->data, &dest_len, src,
+				      src_len);
+		if (ret)
+			return -EINVAL;
+	} else {
+		memcpy(entry->data, src, src_len);
+		dest_len = src_len;
+	}
 
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
-		return -EINVAL;
+	entry->data_len = dest_len;
+	entry->disk_len = src_len + SQFS_HEADER_SIZE;
+	entry->valid = true;
+
+	return 0;
+}
+
+/*
+ * Looks up the metadata block stored at the on-disk byte offset 'offset' in the
+ * metadata cache, and reads and decompresses it on a miss. 'end' is the end of
+ * the on-disk area the block belongs to.
+ */
+static int sqfs_get_metablk(u64 offset, u64 end,
+			    struct squashfs_cache_entry **entry)
+{
+	u64 start, n_blks, table_offset;
+	unsigned char *buffer;
+	bool compressed;
+	u32 src_len;
+	int ret;
+
+	*entry = sqfs_cache_get(&ctxt.meta_cache, offset);
+	if (*entry)
+		return 0;
 
-	start = get_unaligned_le64(&sblk->fragment_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  sblk->export_table_start,
+	start = offset / ctxt.cur_dev->blksz;
+	n_blks = sqfs_calc_n_blks(cpu_to_le64(offset), cpu_to_le64(end),
 				  &table_offset);
 
-	/* Allocate a proper sized buffer to store the fragment index table */
-	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
+	buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!buffer)
+		return -ENOMEM;
+
+	if (sqfs_disk_read(start, n_blks, buffer) < 0) {
+		ret = -EINVAL;
 		goto out;
 	}
 
-	if (sqfs_disk_read(start, n_blks, table) < 0) {
+	ret = sqfs_read_metablock(buffer, table_offset, &compressed, &src_len);
+	if (ret || table_offset + SQFS_HEADER_SIZE + src_len >
+	    n_blks * ctxt.cur_dev->blksz) {
 		ret = -EINVAL;
 		goto out;
 	}
 
+	*entry = sqfs_cache_alloc(&ctxt.meta_cache, offset);
+	if (!*entry) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = sqfs_fill_metablk(*entry, buffer + table_offset + SQFS_HEADER_SIZE,
+				compressed, src_len);
+
+out:
+	free(buffer);
+
+	return ret;
+}
+
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	u64 start, n_blks, index_offset, table_offset, start_block;
+	struct squashfs_fragment_block_entry *entries;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct squashfs_cache_entry *entry;
+	unsigned char *table;
+	int block, offset, ret;
+
+	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+		return -EINVAL;
+
 	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
 	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
 
 	/*
-	 * Get the start offset of the metadata block that contains the right
-	 * fragment block entry
+	 * Only read the fragment index table entry holding the start offset of
+	 * the metadata block that contains the right fragment block entry
 	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
-
-	start = start_block / ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
-				  sblk->fragment_table_start, &table_offset);
+	index_offset = get_unaligned_le64(&sblk->fragment_table_start) +
+		block * sizeof(u64);
+	start = index_offset / ctxt.cur_dev->blksz;
+	n_blks = sqfs_calc_n_blks(cpu_to_le64(index_offset),
+				  cpu_to_le64(index_offset + sizeof(u64)),
+				  &table_offset);
 
-	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!table)
+		return -ENOMEM;
 
-	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
-		ret = -EINVAL;
-		goto out;
+	if (sqfs_disk_read(start, n_blks, table) < 0) {
+		free(table);
+		return -EINVAL;
 	}
 
-	/* Every metadata block starts with a 16-bit header */
-	header = get_unaligned_le16(metadata_buffer + table_offset);
-	metadata = metadata_buffer + table_offset + SQFS_HEADER_SIZE;
-
-	if (!metadata || !header) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	start_block = get_unaligned_le64(table + table_offset);
+	free(table);
 
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
-	if (!entries) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	/* The metadata block is usually cached by a previous lookup */
+	ret = sqfs_get_metablk(start_block,
+			       get_unaligned_le64(&sblk->fragment_table_start),
+			       &entry);
+	if (ret)
+		return ret;
 
-	if (SQFS_COMPRESSED_METADATA(header)) {
-		src_len = SQFS_METADATA_SIZE(header);
-		dest_len = SQFS_METADATA_BLOCK_SIZE;
-		ret = sqfs_decompress(&ctxt, entries, &dest_len, metadata,
-				      src_len);
-		if (ret) {
-			ret = -EINVAL;
-			goto out;
-		}
-	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
-	}
+	if ((offset + 1) * sizeof(*e) > entry->data_len)
+		return -EINVAL;
 
+	entries = entry->data;
 	*e = entries[offset];
-	ret = SQFS_COMPRESSED_BLOCK(e->size);
 
-out:
-	free(entries);
-	free(metadata_buffer);
-	free(table);
-
-	return ret;
+	return SQFS_COMPRESSED_BLOCK(e->size);
 }
 
 /*
@@ -684,188 +722,199 @@ static int sqfs_get_metablk_pos(u32 *pos_list, void *table, u32 offset,
 	return ret;
 }
 
-static int sqfs_read_inode_table(unsigned char **inode_table)
+/*
+ * Walks the metadata blocks stored from the on-disk byte offset 'table_start'
+ * using the metadata cache only. The walk ends after 'table_size' bytes or
+ * after a partial block, which is always the last block of a table. If
+ * 'pos_list' is given, it is filled like sqfs_get_metablk_pos() does. Returns
+ * the number of blocks, or -ENOENT if one of them is not cached.
+ */
+static int sqfs_count_cached_metablks(u64 table_start, u64 table_size,
+				      u32 *pos_list)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	u64 start, n_blks, table_offset, table_size;
-	int j, ret = 0, metablks_count;
-	unsigned char *src_table, *itb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
-
-	table_size = get_unaligned_le64(&sblk->directory_table_start) -
-		get_unaligned_le64(&sblk->inode_table_start);
-	start = get_unaligned_le64(&sblk->inode_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->inode_table_start,
-				  sblk->directory_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (itb) to store the inode table */
-	itb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!itb)
-		return -ENOMEM;
-
-	if (sqfs_disk_read(start, n_blks, itb) < 0) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	/* Parse inode table (metadata block) header */
-	ret = sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-	if (ret) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
+	struct squashfs_cache_entry *entry;
+	u32 cur_size = 0;
+	int count = 0;
 
-	/* Calculate size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(itb, table_offset, table_size);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
+	do {
+		entry = sqfs_cache_get(&ctxt.meta_cache, table_start + cur_size);
+		if (!entry)
+			return -ENOENT;
 
-	*inode_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*inode_table) {
-		ret = -ENOMEM;
-		goto free_itb;
-	}
+		cur_size += entry->disk_len;
+		if (pos_list)
+			pos_list[count] = cur_size;
+		count++;
+	} while (cur_size < table_size &&
+		 entry->data_len == SQFS_METADATA_BLOCK_SIZE);
 
-	src_table = itb + table_offset + SQFS_HEADER_SIZE;
+	return count;
+}
 
-	/* Extract compressed Inode table */
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *inode_table +
-					      dest_offset, &dest_len,
-					      src_table, src_len);
-			if (ret) {
-				free(*inode_table);
-				*inode_table = NULL;
-				goto free_itb;
-			}
+static int sqfs_read_raw_table(__le64 start, __le64 end, unsigned char **raw,
+			       u64 *table_offset)
+{
+	u64 start_, n_blks;
 
-			dest_offset += dest_len;
-		} else {
-			memcpy(*inode_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
-		}
+	start_ = le64_to_cpu(start) / ctxt.cur_dev->blksz;
+	n_blks = sqfs_calc_n_blks(start, end, table_offset);
 
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'itb' and to the decompression source, respectively.
-		 */
+	*raw = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!*raw)
+		return -ENOMEM;
 
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
+	if (sqfs_disk_read(start_, n_blks, *raw) < 0) {
+		free(*raw);
+		*raw = NULL;
+		return -EINVAL;
 	}
 
-free_itb:
-	free(itb);
-
-	return ret;
+	return 0;
 }
 
-static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
+/*
+ * Decompresses a metadata table (e.g. the inode or the directory table) stored
+ * between the on-disk byte offsets 'start' and 'end' into '*table'. Blocks
+ * found in the metadata cache are copied from it, so the table is only read
+ * from the device if at least one block is missing. If 'pos_list' is not NULL,
+ * it receives the position of each metadata block. Returns the number of
+ * metadata blocks, or a negative error code.
+ */
+static int sqfs_read_metadata_table(__le64 start, __le64 end,
+				    unsigned char **table, u32 **pos_list)
 {
-	u64 start, n_blks, table_offset, table_size;
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	int j, ret = 0, metablks_count = -1;
-	unsigned char *src_table, *dtb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
+	u64 table_start, table_size, table_offset = 0;
+	struct squashfs_cache_entry *entry;
+	int j, ret, metablks_count;
+	unsigned char *raw = NULL;
+	u32 *pos = NULL, cur_size;
 	bool compressed;
+	u32 src_len;
 
-	*dir_table = NULL;
-	*pos_list = NULL;
-	/* DIRECTORY TABLE */
-	table_size = get_unaligned_le64(&sblk->fragment_table_start) -
-		get_unaligned_le64(&sblk->directory_table_start);
-	start = get_unaligned_le64(&sblk->directory_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->directory_table_start,
-				  sblk->fragment_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (dtb) to store the directory table */
-	dtb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!dtb)
-		return -ENOMEM;
-
-	if (sqfs_disk_read(start, n_blks, dtb) < 0)
-		goto out;
+	*table = NULL;
+	table_start = le64_to_cpu(start);
+	table_size = le64_to_cpu(end) - table_start;
 
-	/* Parse directory table (metadata block) header */
-	ret = sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-	if (ret)
-		goto out;
+	metablks_count = sqfs_count_cached_metablks(table_start, table_size,
+						    NULL);
+	if (metablks_count < 0) {
+		ret = sqfs_read_raw_table(start, end, &raw, &table_offset);
+		if (ret)
+			return ret;
 
-	/* Calculate total size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(dtb, table_offset, table_size);
-	if (metablks_count < 1)
-		goto out;
+		/* Calculate size to store the whole decompressed table */
+		metablks_count = sqfs_count_metablks(raw, table_offset,
+						     table_size);
+		if (metablks_count < 1) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
 
-	*dir_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*dir_table)
+	pos = malloc(metablks_count * sizeof(u32));
+	if (!pos) {
+		ret = -ENOMEM;
 		goto out;
+	}
 
-	*pos_list = malloc(metablks_count * sizeof(u32));
-	if (!*pos_list)
-		goto out;
+	if (raw) {
+		ret = sqfs_get_metablk_pos(pos, raw, table_offset,
+					   metablks_count);
+		if (ret) {
+			ret = -EINVAL;
+			goto out;
+		}
+	} else {
+		/* Nothing was evicted since the blocks were counted */
+		sqfs_count_cached_metablks(table_start, table_size, pos);
+	}
 
-	ret = sqfs_get_metablk_pos(*pos_list, dtb, table_offset,
-				   metablks_count);
-	if (ret) {
-		metablks_count = -1;
+	*table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
+	if (!*table) {
+		ret = -ENOMEM;
 		goto out;
 	}
 
-	src_table = dtb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Directory table */
-	dest_offset = 0;
 	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *dir_table +
-					      (j * SQFS_METADATA_BLOCK_SIZE),
-					      &dest_len, src_table, src_len);
+		cur_size = j ? pos[j - 1] : 0;
+		entry = sqfs_cache_get(&ctxt.meta_cache, table_start + cur_size);
+		if (!entry) {
+			/* The block may have been evicted by a previous one */
+			if (!raw) {
+				ret = sqfs_read_raw_table(start, end, &raw,
+							  &table_offset);
+				if (ret)
+					goto out;
+			}
+
+			ret = sqfs_read_metablock(raw, table_offset + cur_size,
+						  &compressed, &src_len);
 			if (ret) {
-				metablks_count = -1;
+				ret = -EINVAL;
 				goto out;
 			}
 
-			if (dest_len < SQFS_METADATA_BLOCK_SIZE) {
-				dest_offset += dest_len;
-				break;
+			entry = sqfs_cache_alloc(&ctxt.meta_cache,
+						 table_start + cur_size);
+			if (!entry) {
+				ret = -ENOMEM;
+				goto out;
 			}
 
-			dest_offset += dest_len;
-		} else {
-			memcpy(*dir_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
+			ret = sqfs_fill_metablk(entry, raw + table_offset +
+						cur_size + SQFS_HEADER_SIZE,
+						compressed, src_len);
+			if (ret)
+				goto out;
 		}
 
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'dtb' and to the decompression source, respectively.
-		 */
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
+		memcpy(*table + j * SQFS_METADATA_BLOCK_SIZE, entry->data,
+		       entry->data_len);
+
+		/* A partial block ends the table */
+		if (entry->data_len < SQFS_METADATA_BLOCK_SIZE)
+			break;
 	}
 
+	ret = metablks_count;
+
 out:
-	if (metablks_count < 1) {
-		free(*dir_table);
-		free(*pos_list);
-		*dir_table = NULL;
-		*pos_list = NULL;
+	if (ret < 0) {
+		free(*table);
+		*table = NULL;
+		free(pos);
+		pos = NULL;
 	}
-	free(dtb);
 
-	return metablks_count;
+	if (pos_list)
+		*pos_list = pos;
+	else
+		free(pos);
+	free(raw);
+
+	return ret;
+}
+
+static int sqfs_read_inode_table(unsigned char **inode_table)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	int ret;
+
+	ret = sqfs_read_metadata_table(sblk->inode_table_start,
+				       sblk->directory_table_start,
+				       inode_table, NULL);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+
+	/* The directory table is followed by the fragment table */
+	return sqfs_read_metadata_table(sblk->directory_table_start,
+					sblk->fragment_table_start,
+					dir_table, pos_list);
 }
 
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
@@ -1102,7 +1151,22 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 		goto error;
 	}
 
+	ret = sqfs_cache_init(&ctxt.meta_cache,
+			      CONFIG_SQUASHFS_METADATA_CACHE_BLOCKS,
+			      SQFS_METADATA_BLOCK_SIZE);
+	if (ret)
+		goto error_cache;
+
+	ret = sqfs_cache_init(&ctxt.frag_cache,
+			      CONFIG_SQUASHFS_FRAGMENT_CACHE_BLOCKS,
+			      get_unaligned_le32(&sblk->block_size));
+	if (ret)
+		goto error_cache;
+
 	return 0;
+error_cache:
+	sqfs_cache_cleanup(&ctxt.meta_cache);
+	sqfs_decompressor_cleanup(&ctxt);
 error:
 	ctxt.cur_dev = NULL;
 	free(ctxt.sblk);
@@ -1305,16 +1369,279 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 	return datablk_count;
 }
 
+/**
+ * struct sqfs_data_batch - Consecutive data blocks fetched with one read
+ *
+ * @first: Index of the first data block of the batch in the file
+ * @count: Number of data blocks, 0 once there are none left to read
+ * @data_offset: Offset of the first data block in the filesystem
+ * @size: Size of the data blocks in the filesystem, in bytes
+ * @buffer: Device blocks holding the data blocks
+ * @offset: Offset of the first data block in @buffer
+ * @pending: true while the read is in flight
+ * @req: Read request
+ */
+struct sqfs_data_batch {
+	int first;
+	int count;
+	u64 data_offset;
+	u32 size;
+	char *buffer;
+	u32 offset;
+	bool pending;
+#if CONFIG_IS_ENABLED(BLK)
+	struct blk_req req;
+#endif
+};
+
+/**
+ * struct sqfs_data_job - Decompression of the data blocks of a batch
+ *
+ * Each data block is a separate job, so that the blocks of a batch can be
+ * decompressed on several CPUs at once. Block n of a file always starts at
+ * n * block_size in the output.
+ *
+ * @finfo: File being read
+ * @batch: Batch being decompressed
+ * @buf: Destination of the file contents
+ * @len: Number of bytes of the file to read
+ * @block_size: Filesystem block size
+ * @bounce: Buffer of @block_size bytes, for the one block which may not fit
+ *	in @buf
+ * @src_off: Offset of each data block from the first one in the batch
+ * @out_len: Number of bytes written to @buf for each data block
+ */
+struct sqfs_data_job {
+	struct squashfs_file_info *finfo;
+	struct sqfs_data_batch *batch;
+	char *buf;
+	loff_t len;
+	u32 block_size;
+	char *bounce;
+	u32 src_off[SQFS_DATA_BATCH_BLOCKS];
+	u32 out_len[SQFS_DATA_BATCH_BLOCKS];
+};
+
+/*
+ * Set up the batch which follows @prev, or the first one if @prev is NULL,
+ * and start reading it. With driver model the read is queued, so that the
+ * device fetches this batch while the previous one is decompressed.
+ */
+static int sqfs_data_batch_start(struct sqfs_data_batch *batch,
+				 const struct sqfs_data_batch *prev,
+				 struct squashfs_file_info *finfo,
+				 int datablk_count, loff_t len, u32 block_size)
+{
+	u64 start, n_blks;
+	u32 size;
+	int i;
+
+	batch->first = prev ? prev->first + prev->count : 0;
+	batch->data_offset = prev ? prev->data_offset + prev->size :
+			     finfo->start;
+	batch->size = 0;
+
+	/* Sparse blocks take no space, so they never end a batch */
+	for (i = batch->first; i < datablk_count &&
+	     (u64)i * block_size < len &&
+	     i - batch->first < SQFS_DATA_BATCH_BLOCKS; i++) {
+		size = SQFS_BLOCK_SIZE(finfo->blk_sizes[i]);
+		if (i > batch->first &&
+		    batch->size + size > SQFS_DATA_BATCH_SIZE)
+			break;
+		batch->size += size;
+	}
+	batch->count = i - batch->first;
+	if (!batch->size)
+		return 0;
+
+	start = batch->data_offset / ctxt.cur_dev->blksz;
+	batch->offset = batch->data_offset - start * ctxt.cur_dev->blksz;
+	n_blks = DIV_ROUND_UP(batch->size + batch->offset,
+			      ctxt.cur_dev->blksz);
+
+	batch->buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!batch->buffer)
+		return -ENOMEM;
+
+#if CONFIG_IS_ENABLED(BLK)
+	batch->req.complete = NULL;
+	if (blk_dread_async(ctxt.cur_dev, ctxt.cur_part_info.start + start,
+			    n_blks, batch->buffer, &batch->req))
+		return -EIO;
+	batch->pending = true;
+#else
+	if (sqfs_disk_read(start, n_blks, batch->buffer) < 0)
+		return -EIO;
+#endif
+
+	return 0;
+}
+
+/* Wait for the read of a batch to finish */
+static int sqfs_data_batch_wait(struct sqfs_data_batch *batch)
+{
+#if CONFIG_IS_ENABLED(BLK)
+	long ret;
+
+	if (!batch->pending)
+		return 0;
+	batch->pending = false;
+
+	ret = blk_wait(ctxt.cur_dev, &batch->req);
+	if (ret != batch->req.blkcnt)
+		return -EIO;
+#endif
+
+	return 0;
+}
+
+static void sqfs_data_batch_free(struct sqfs_data_batch *batch)
+{
+	/* The device may still be writing to the buffer */
+	sqfs_data_batch_wait(batch);
+	free(batch->buffer);
+	batch->buffer = NULL;
+}
+
+static int sqfs_data_job(void *ctx, int job, int cpu)
+{
+	struct sqfs_data_job *dj = ctx;
+	int blk = dj->batch->first + job;
+	u32 blk_size = dj->finfo->blk_sizes[blk];
+	u32 size = SQFS_BLOCK_SIZE(blk_size);
+	u64 pos = (u64)blk * dj->block_size;
+	u64 space = min((u64)dj->len - pos, (u64)dj->block_size);
+	unsigned long dest_len = dj->block_size;
+	char *src, *dest = dj->buf + pos;
+	int ret;
+
+	src = dj->batch->buffer + dj->batch->offset + dj->src_off[job];
+	if (!blk_size) {
+		/* Don't load any data for sparse blocks */
+		memset(dest, 0, space);
+		dj->out_len[job] = space;
+	} else if (!SQFS_COMPRESSED_BLOCK(blk_size)) {
+		dj->out_len[job] = min((u64)size, space);
+		memcpy(dest, src, dj->out_len[job]);
+	} else {
+		/*
+		 * Decompress straight into the destination when a whole block
+		 * fits, saving a copy.
+		 */
+		if (space < dj->block_size)
+			dest = dj->bounce;
+		ret = sqfs_decompress_block(&ctxt, cpu, dest, &dest_len, src,
+					    size);
+		if (ret)
+			return ret;
+
+		dj->out_len[job] = min((u64)dest_len, space);
+		if (dest == dj->bounce)
+			memcpy(dj->buf + pos, dest, dj->out_len[job]);
+	}
+
+	return 0;
+}
+
+/* Decompress the data blocks of a batch, on several CPUs if available */
+static int sqfs_data_batch_decompress(struct sqfs_data_job *dj)
+{
+	struct sqfs_data_batch *batch = dj->batch;
+	u32 src_off = 0;
+	int i, ret;
+
+	for (i = 0; i < batch->count; i++) {
+		dj->src_off[i] = src_off;
+		src_off += SQFS_BLOCK_SIZE(dj->finfo->blk_sizes[batch->first + i]);
+	}
+
+	if (CONFIG_IS_ENABLED(PAR_RUN))
+		return par_run(sqfs_data_job, dj, batch->count);
+
+	for (i = 0; i < batch->count; i++) {
+		ret = sqfs_data_job(dj, i, 0);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Read the data blocks of a file, i.e. everything but the tail stored in a
+ * fragment block. The blocks are read in batches and the next batch is read
+ * while the current one is decompressed.
+ */
+static int sqfs_read_data_blocks(struct squashfs_file_info *finfo,
+				 int datablk_count, void *buf, loff_t len,
+				 loff_t *actread)
+{
+	struct sqfs_data_batch batch[2] = {};
+	struct sqfs_data_job dj;
+	int cur = 0, ret, i;
+
+	if (!datablk_count)
+		return 0;
+
+	dj.finfo = finfo;
+	dj.buf = buf;
+	dj.len = len;
+	dj.block_size = get_unaligned_le32(&ctxt.sblk->block_size);
+	dj.bounce = malloc(dj.block_size);
+	if (!dj.bounce)
+		return -ENOMEM;
+
+	ret = sqfs_data_batch_start(&batch[cur], NULL, finfo, datablk_count,
+				    len, dj.block_size);
+	while (!ret && batch[cur].count) {
+		ret = sqfs_data_batch_start(&batch[!cur], &batch[cur], finfo,
+					    datablk_count, len, dj.block_size);
+		if (ret)
+			break;
+
+		ret = sqfs_data_batch_wait(&batch[cur]);
+		if (ret) {
+			/*
+			 * Possible causes: too many data blocks or too large
+			 * SquashFS block size. Tip: re-compile the SquashFS
+			 * image with mksquashfs's -b <block_size> option.
+			 */
+			printf("Error: too many data blocks to be read.\n");
+			break;
+		}
+
+		dj.batch = &batch[cur];
+		ret = sqfs_data_batch_decompress(&dj);
+		if (ret) {
+			printf("Error: cannot decompress data blocks.\n");
+			break;
+		}
+		for (i = 0; i < batch[cur].count; i++)
+			*actread += dj.out_len[i];
+
+		sqfs_data_batch_free(&batch[cur]);
+		cur = !cur;
+	}
+
+	sqfs_data_batch_free(&batch[0]);
+	sqfs_data_batch_free(&batch[1]);
+	free(dj.bounce);
+
+	return ret;
+}
+
 int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	      loff_t *actread)
 {
-	char *dir = NULL, *fragment_block, *datablock = NULL, *data_buffer = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
-	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
-	int ret, j, i_number, datablk_count = 0;
+	char *dir = NULL, *fragment = NULL, *file = NULL, *resolved;
+	u64 start, n_blks, table_size, table_offset;
+	int ret, i_number, datablk_count = 0;
+	u32 block_size;
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_fragment_block_entry frag_entry;
 	struct squashfs_file_info finfo = {0};
+	struct squashfs_cache_entry *entry;
 	struct squashfs_symlink_inode *symlink;
 	struct fs_dir_stream *dirsp = NULL;
 	struct squashfs_dir_stream *dirs;
@@ -1428,83 +1755,10 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		len = finfo.size;
 	}
 
-	if (datablk_count) {
-		data_offset = finfo.start;
-		datablock = malloc(get_unaligned_le32(&sblk->block_size));
-		if (!datablock) {
-			ret = -ENOMEM;
-			goto out;
-		}
-	}
-
-	for (j = 0; j < datablk_count; j++) {
-		start = data_offset / ctxt.cur_dev->blksz;
-		table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
-		table_offset = data_offset - (start * ctxt.cur_dev->blksz);
-		n_blks = DIV_ROUND_UP(table_size + table_offset,
-				      ctxt.cur_dev->blksz);
-
-		/* Don't load any data for sparse blocks */
-		if (finfo.blk_sizes[j] == 0) {
-			n_blks = 0;
-			table_offset = 0;
-			data_buffer = NULL;
-			data = NULL;
-		} else {
-			data_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-			if (!data_buffer) {
-				ret = -ENOMEM;
-				goto out;
-			}
-
-			ret = sqfs_disk_read(start, n_blks, data_buffer);
-			if (ret < 0) {
-				/*
-				 * Possible causes: too many data blocks or too large
-				 * SquashFS block size. Tip: re-compile the SquashFS
-				 * image with mksquashfs's -b <block_size> option.
-				 */
-				printf("Error: too many data blocks to be read.\n");
-				goto out;
-			}
-
-			data = data_buffer + table_offset;
-		}
-
-		/* Load the data */
-		if (finfo.blk_sizes[j] == 0) {
-			/* This is a sparse block */
-			sparse_size = get_unaligned_le32(&sblk->block_size);
-			if ((*actread + sparse_size) > len)
-				sparse_size = len - *actread;
-			memset(buf + *actread, 0, sparse_size);
-			*actread += sparse_size;
-		} else if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
-			dest_len = get_unaligned_le32(&sblk->block_size);
-			ret = sqfs_decompress(&ctxt, datablock, &dest_len,
-					      data, table_size);
-			if (ret)
-				goto out;
-
-			if ((*actread + dest_len) > len)
-				dest_len = len - *actread;
-			memcpy(buf + *actread, datablock, dest_len);
-			*actread += dest_len;
-		} else {
-			if ((*actread + table_size) > len)
-				table_size = len - *actread;
-			memcpy(buf + *actread, data, table_size);
-			*actread += table_size;
-		}
-
-		data_offset += table_size;
-		if (data_buffer)
-			free(data_buffer);
-		data_buffer = NULL;
-		if (*actread >= len)
-			break;
-	}
+	block_size = get_unaligned_le32(&sblk->block_size);
+	ret = sqfs_read_data_blocks(&finfo, datablk_count, buf, len, actread);
+	if (ret)
+		goto out;
 
 	/*
 	 * There is no need to continue if the file is not fragmented.
@@ -1514,61 +1768,71 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		goto out;
 	}
 
-	start = frag_entry.start / ctxt.cur_dev->blksz;
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	entry = sqfs_cache_get(&ctxt.frag_cache, frag_entry.start);
+	if (!entry) {
+		start = frag_entry.start / ctxt.cur_dev->blksz;
+		table_size = SQFS_BLOCK_SIZE(frag_entry.size);
+		table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
+		n_blks = DIV_ROUND_UP(table_size + table_offset,
+				      ctxt.cur_dev->blksz);
 
-	if (!fragment) {
-		ret = -ENOMEM;
-		goto out;
-	}
+		/* A fragment block never exceeds the cache entry size */
+		if (table_size > block_size) {
+			ret = -EINVAL;
+			goto out;
+		}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
-		goto out;
+		fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
 
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
+		if (!fragment) {
 			ret = -ENOMEM;
 			goto out;
 		}
 
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
+		ret = sqfs_disk_read(start, n_blks, fragment);
+		if (ret < 0)
 			goto out;
-		}
 
-		for (j = *actread; j < finfo.size; j++) {
-			memcpy(buf + j, &fragment_block[finfo.offset + j], 1);
-			(*actread)++;
+		entry = sqfs_cache_alloc(&ctxt.frag_cache, frag_entry.start);
+		if (!entry) {
+			ret = -ENOMEM;
+			goto out;
 		}
 
-		free(fragment_block);
+		if (SQFS_COMPRESSED_BLOCK(frag_entry.size)) {
+			dest_len = block_size;
+			ret = sqfs_decompress(&ctxt, entry->data, &dest_len,
+					      (void *)fragment + table_offset,
+					      table_size);
+			if (ret)
+				goto out;
+		} else {
+			memcpy(entry->data, fragment + table_offset,
+			       table_size);
+			dest_len = table_size;
+		}
 
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
+		entry->data_len = dest_len;
+		entry->disk_len = table_size;
+		entry->valid = true;
+	}
 
-		for (j = *actread; j < finfo.size; j++) {
-			memcpy(buf + j, &fragment_block[finfo.offset + j], 1);
-			(*actread)++;
+	/* The file's tail starts at 'finfo.offset' in the fragment block */
+	if (*actread < finfo.size) {
+		if (finfo.offset + finfo.size - *actread > entry->data_len) {
+			ret = -EINVAL;
+			goto out;
 		}
+
+		memcpy(buf + *actread, entry->data + finfo.offset,
+		       finfo.size - *actread);
+		*actread = finfo.size;
 	}
 
+	ret = 0;
+
 out:
 	free(fragment);
-	if (datablk_count) {
-		free(data_buffer);
-		free(datablock);
-	}
 	free(file);
 	free(dir);
 	free(finfo.blk_sizes);
@@ -1706,6 +1970,8 @@ free_strings:
 
 void sqfs_close(void)
 {
+	sqfs_cache_cleanup(&ctxt.frag_cache);
+	sqfs_cache_cleanup(&ctxt.meta_cache);
 	sqfs_decompressor_cleanup(&ctxt);
 	free(ctxt.sblk);
 	ctxt.sblk = NULL;
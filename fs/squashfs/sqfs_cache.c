@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * sqfs_cache.c: bounded LRU cache of decompressed SquashFS blocks
+ *
+ * Metadata and fragment blocks are looked up by their on-disk byte offset, so
+ * successive lookups within the same mount do not read and decompress the
+ * same blocks again.
+ */
+
+#include <errno.h>
+#include <linux/kernel.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sqfs_filesystem.h"
+
+int sqfs_cache_init(struct squashfs_cache *cache, int count, size_t block_size)
+{
+	cache->entries = calloc(count, sizeof(*cache->entries));
+	if (!cache->entries)
+		return -ENOMEM;
+
+	cache->count = count;
+	cache->block_size = block_size;
+	cache->clock = 0;
+
+	return 0;
+}
+
+void sqfs_cache_cleanup(struct squashfs_cache *cache)
+{
+	int i;
+
+	if (!cache->entries)
+		return;
+
+	for (i = 0; i < cache->count; i++)
+		free(cache->entries[i].data);
+
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->count = 0;
+}
+
+/*
+ * Returns the valid entry holding the block stored at 'offset' on disk, or NULL
+ * if that block is not cached.
+ */
+struct squashfs_cache_entry *sqfs_cache_get(struct squashfs_cache *cache,
+					    u64 offset)
+{
+	struct squashfs_cache_entry *entry;
+	int i;
+
+	for (i = 0; i < cache->count; i++) {
+		entry = &cache->entries[i];
+		if (entry->valid && entry->offset == offset) {
+			entry->last_use = ++cache->clock;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Evicts the least recently used entry and hands it over for the block stored
+ * at 'offset'. The entry is returned invalid: the caller fills 'data',
+ * 'data_len' and 'disk_len', then sets 'valid'. Returns NULL if the entry
+ * buffer cannot be allocated.
+ */
+struct squashfs_cache_entry *sqfs_cache_alloc(struct squashfs_cache *cache,
+					      u64 offset)
+{
+	struct squashfs_cache_entry *entry, *victim = NULL;
+	int i;
+
+	for (i = 0; i < cache->count; i++) {
+		entry = &cache->entries[i];
+		if (!entry->valid) {
+			victim = entry;
+			break;
+		}
+
+		if (!victim || entry->last_use < victim->last_use)
+			victim = entry;
+	}
+
+	if (!victim)
+		return NULL;
+
+	if (!victim->data) {
+		victim->data = malloc_cache_aligned(cache->block_size);
+		if (!victim->data)
+			return NULL;
+	}
+
+	victim->valid = false;
+	victim->offset = offset;
+	victim->disk_len = 0;
+	victim->data_len = 0;
+	victim->last_use = ++cache->clock;
+
+	return victim;
+}
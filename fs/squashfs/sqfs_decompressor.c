@@ -6,9 +6,11 @@
  */
 
 #include <errno.h>
+#include <par_run.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <linux/kernel.h>
 
 #if IS_ENABLED(CONFIG_LZO)
 #include <linux/lzo.h>
@@ -25,53 +27,100 @@
 #include "sqfs_decompressor.h"
 #include "sqfs_utils.h"
 
+#if IS_ENABLED(CONFIG_ZLIB)
+/* Data blocks are decoded in one go, so inflate() never needs a window */
+static void *sqfs_zlib_noalloc(void *x, unsigned int items, unsigned int size)
+{
+	return NULL;
+}
+
+static int sqfs_zlib_init(struct squashfs_ctxt *ctxt, int cpu)
+{
+	z_stream *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	if (inflateInit(s) != Z_OK) {
+		free(s);
+		return -ENOMEM;
+	}
+	s->zalloc = sqfs_zlib_noalloc;
+	ctxt->zlib_stream[cpu] = s;
+
+	return 0;
+}
+#endif
+
 int sqfs_decompressor_init(struct squashfs_ctxt *ctxt)
 {
 	u16 comp_type = get_unaligned_le16(&ctxt->sblk->compression);
+	int cpu, ncpus = 1;
 
-	switch (comp_type) {
+	if (CONFIG_IS_ENABLED(PAR_RUN))
+		ncpus = min(par_run_cpus(), SQFS_MAX_CPUS);
+	ctxt->ncpus = 0;
+
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		switch (comp_type) {
 #if IS_ENABLED(CONFIG_LZO)
-	case SQFS_COMP_LZO:
-		break;
+		case SQFS_COMP_LZO:
+			break;
 #endif
 #if IS_ENABLED(CONFIG_ZLIB)
-	case SQFS_COMP_ZLIB:
-		break;
+		case SQFS_COMP_ZLIB:
+			if (sqfs_zlib_init(ctxt, cpu))
+				goto err;
+			break;
 #endif
 #if IS_ENABLED(CONFIG_ZSTD)
-	case SQFS_COMP_ZSTD:
-		ctxt->zstd_workspace = malloc(ZSTD_DCtxWorkspaceBound());
-		if (!ctxt->zstd_workspace)
-			return -ENOMEM;
-		break;
+		case SQFS_COMP_ZSTD:
+			ctxt->zstd_workspace[cpu] =
+				malloc(ZSTD_estimateDCtxSize());
+			if (!ctxt->zstd_workspace[cpu])
+				goto err;
+			break;
 #endif
-	default:
-		printf("Error: unknown compression type.\n");
-		return -EINVAL;
+		default:
+			printf("Error: unknown compression type.\n");
+			return -EINVAL;
+		}
+		ctxt->ncpus++;
 	}
 
 	return 0;
+
+err:
+	sqfs_decompressor_cleanup(ctxt);
+
+	return -ENOMEM;
 }
 
 void sqfs_decompressor_cleanup(struct squashfs_ctxt *ctxt)
 {
 	u16 comp_type = get_unaligned_le16(&ctxt->sblk->compression);
+	int cpu;
 
-	switch (comp_type) {
+	for (cpu = 0; cpu < ctxt->ncpus; cpu++) {
+		switch (comp_type) {
 #if IS_ENABLED(CONFIG_LZO)
-	case SQFS_COMP_LZO:
-		break;
+		case SQFS_COMP_LZO:
+			break;
 #endif
 #if IS_ENABLED(CONFIG_ZLIB)
-	case SQFS_COMP_ZLIB:
-		break;
+		case SQFS_COMP_ZLIB:
+			inflateEnd(ctxt->zlib_stream[cpu]);
+			free(ctxt->zlib_stream[cpu]);
+			break;
 #endif
 #if IS_ENABLED(CONFIG_ZSTD)
-	case SQFS_COMP_ZSTD:
-		free(ctxt->zstd_workspace);
-		break;
+		case SQFS_COMP_ZSTD:
+			free(ctxt->zstd_workspace[cpu]);
+			break;
 #endif
+		}
 	}
+	ctxt->ncpus = 0;
 }
 
 #if IS_ENABLED(CONFIG_ZLIB)
@@ -92,21 +141,73 @@ static void zlib_decompression_status(int ret)
 #endif
 
 #if IS_ENABLED(CONFIG_ZSTD)
-static int sqfs_zstd_decompress(struct squashfs_ctxt *ctxt, void *dest,
-				unsigned long dest_len, void *source, u32 src_len)
+static int sqfs_zstd_decompress(struct squashfs_ctxt *ctxt, int cpu,
+				void *dest, unsigned long *dest_len,
+				void *source, u32 src_len)
 {
 	ZSTD_DCtx *ctx;
 	size_t wsize;
-	int ret;
+	size_t ret;
 
-	wsize = ZSTD_DCtxWorkspaceBound();
-	ctx = ZSTD_initDCtx(ctxt->zstd_workspace, wsize);
-	ret = ZSTD_decompressDCtx(ctx, dest, dest_len, source, src_len);
+	wsize = ZSTD_estimateDCtxSize();
+	ctx = ZSTD_initStaticDCtx(ctxt->zstd_workspace[cpu], wsize);
+	ret = ZSTD_decompressDCtx(ctx, dest, *dest_len, source, src_len);
+	if (ZSTD_isError(ret))
+		return ret;
 
-	return ZSTD_isError(ret);
+	*dest_len = ret;
+
+	return 0;
 }
 #endif /* CONFIG_ZSTD */
 
+int sqfs_decompress_block(struct squashfs_ctxt *ctxt, int cpu, void *dest,
+			  unsigned long *dest_len, void *source, u32 src_len)
+{
+	u16 comp_type = get_unaligned_le16(&ctxt->sblk->compression);
+
+	switch (comp_type) {
+#if IS_ENABLED(CONFIG_LZO)
+	case SQFS_COMP_LZO: {
+		size_t lzo_dest_len = *dest_len;
+
+		if (lzo1x_decompress_safe(source, src_len, dest, &lzo_dest_len))
+			return -EINVAL;
+		*dest_len = lzo_dest_len;
+
+		return 0;
+	}
+#endif
+#if IS_ENABLED(CONFIG_ZLIB)
+	case SQFS_COMP_ZLIB: {
+		z_stream *s = ctxt->zlib_stream[cpu];
+
+		if (inflateReset(s) != Z_OK)
+			return -EINVAL;
+		s->next_in = source;
+		s->avail_in = src_len;
+		s->next_out = dest;
+		s->avail_out = *dest_len;
+		if (inflate(s, Z_FINISH) != Z_STREAM_END)
+			return -EINVAL;
+		*dest_len = s->total_out;
+
+		return 0;
+	}
+#endif
+#if IS_ENABLED(CONFIG_ZSTD)
+	case SQFS_COMP_ZSTD:
+		if (sqfs_zstd_decompress(ctxt, cpu, dest, dest_len, source,
+					 src_len))
+			return -EINVAL;
+
+		return 0;
+#endif
+	default:
+		return -EINVAL;
+	}
+}
+
 int sqfs_decompress(struct squashfs_ctxt *ctxt, void *dest,
 		    unsigned long *dest_len, void *source, u32 src_len)
 {
@@ -123,6 +224,8 @@ int sqfs_decompress(struct squashfs_ctxt *ctxt, void *dest,
 			return -EINVAL;
 		}
 
+		*dest_len = lzo_dest_len;
+
 		break;
 	}
 #endif
@@ -138,7 +241,8 @@ int sqfs_decompress(struct squashfs_ctxt *ctxt, void *dest,
 #endif
 #if IS_ENABLED(CONFIG_ZSTD)
 	case SQFS_COMP_ZSTD:
-		ret = sqfs_zstd_decompress(ctxt, dest, *dest_len, source, src_len);
+		ret = sqfs_zstd_decompress(ctxt, 0, dest, dest_len, source,
+					   src_len);
 		if (ret) {
 			printf("ZSTD Error code: %d\n", ZSTD_getErrorCode(ret));
 			return -EINVAL;
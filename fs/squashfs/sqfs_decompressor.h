@@ -55,6 +55,12 @@ union squashfs_compression_opts {
 
 int sqfs_decompress(struct squashfs_ctxt *ctxt, void *dest,
 		    unsigned long *dest_len, void *source, u32 src_len);
+/*
+ * Decompress a data block using the decompressor state of @cpu, without
+ * printing or allocating anything, so that it can run as a par_run() job.
+ */
+int sqfs_decompress_block(struct squashfs_ctxt *ctxt, int cpu, void *dest,
+			  unsigned long *dest_len, void *source, u32 src_len);
 int sqfs_decompressor_init(struct squashfs_ctxt *ctxt);
 void sqfs_decompressor_cleanup(struct squashfs_ctxt *ctxt);
 
@@ -21,6 +21,16 @@
 #define SQFS_METADATA_BLOCK_SIZE 8192
 /* Max. number of fragment entries in a metadata block is 512 */
 #define SQFS_MAX_ENTRIES 512
+/* Max. size of a single device read of consecutive data blocks */
+#define SQFS_DATA_BATCH_SIZE (1024 * 1024)
+/* Max. number of data blocks in such a read */
+#define SQFS_DATA_BATCH_BLOCKS 64
+/* Max. number of CPUs decompressing the data blocks of a batch */
+#if CONFIG_IS_ENABLED(PAR_RUN)
+#define SQFS_MAX_CPUS CONFIG_PAR_RUN_MAX_CPUS
+#else
+#define SQFS_MAX_CPUS 1
+#endif
 /* Metadata blocks start by a 2-byte length header */
 #define SQFS_HEADER_SIZE 2
 #define SQFS_LREG_INODE_MIN_SIZE 56
@@ -73,12 +83,43 @@ struct squashfs_super_block {
 	__le64 export_table_start;
 };
 
+/*
+ * A cache entry holds one decompressed metadata or fragment block, keyed by the
+ * on-disk byte offset of the block. 'disk_len' is the number of bytes the block
+ * takes on disk (including the metadata header, if any), so a table can be
+ * walked from the cache without reading it again.
+ */
+struct squashfs_cache_entry {
+	u64 offset;
+	u32 disk_len;
+	u32 data_len;
+	u32 last_use;
+	bool valid;
+	void *data;
+};
+
+struct squashfs_cache {
+	struct squashfs_cache_entry *entries;
+	int count;
+	size_t block_size;
+	u32 clock;
+};
+
 struct squashfs_ctxt {
 	struct disk_partition cur_part_info;
 	struct blk_desc *cur_dev;
 	struct squashfs_super_block *sblk;
+	/* Decompressed metadata blocks (inode, directory, fragment tables) */
+	struct squashfs_cache meta_cache;
+	/* Decompressed fragment blocks */
+	struct squashfs_cache frag_cache;
+	/* Number of CPUs with their own decompressor state below */
+	int ncpus;
+#if IS_ENABLED(CONFIG_ZLIB)
+	void *zlib_stream[SQFS_MAX_CPUS];
+#endif
 #if IS_ENABLED(CONFIG_ZSTD)
-	void *zstd_workspace;
+	void *zstd_workspace[SQFS_MAX_CPUS];
 #endif
 };
 
@@ -307,4 +348,14 @@ bool sqfs_is_empty_dir(void *dir_i);
 
 bool sqfs_is_dir(u16 type);
 
+int sqfs_cache_init(struct squashfs_cache *cache, int count, size_t block_size);
+
+void sqfs_cache_cleanup(struct squashfs_cache *cache);
+
+struct squashfs_cache_entry *sqfs_cache_get(struct squashfs_cache *cache,
+					    u64 offset);
+
+struct squashfs_cache_entry *sqfs_cache_alloc(struct squashfs_cache *cache,
+					      u64 offset);
+
 #endif /* SQFS_FILESYSTEM_H */
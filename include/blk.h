@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -207,6 +208,47 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+	BLK_REQ_ERASE,
+};
+
+/**
+ * struct blk_req - an asynchronous block device request
+ *
+ * The caller fills in the operation, position and buffer, and optionally a
+ * completion callback, before passing the request to blk_submit(). The
+ * request and its buffer must stay valid until @done is set.
+ *
+ * @op:		Operation to perform
+ * @start:	Start block number
+ * @blkcnt:	Number of blocks
+ * @buffer:	Data buffer, unused for BLK_REQ_ERASE
+ * @complete:	Called once the request has finished, or NULL
+ * @priv:	For use by the caller
+ * @actual:	Number of blocks transferred, valid once @done is set
+ * @status:	0 on success or -ve error, valid once @done is set
+ * @done:	Set when the request has finished
+ * @dev:	Block device the request was submitted to
+ * @list:	For use by the driver while the request is queued
+ */
+struct blk_req {
+	enum blk_req_op op;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	void (*complete)(struct blk_req *req);
+	void *priv;
+
+	lbaint_t actual;
+	int status;
+	bool done;
+
+	struct udevice *dev;
+	struct list_head list;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -247,6 +289,24 @@ struct blk_ops {
 	unsigned long (*erase)(struct udevice *dev, lbaint_t start,
 			       lbaint_t blkcnt);
 
+	/**
+	 * discard() - tell the device that a section is no longer in use
+	 *
+	 * The device may release the blocks (TRIM, UNMAP, deallocate), after
+	 * which their contents are undefined. Unlike erase() this never
+	 * touches blocks outside the section, so a device which can only
+	 * release whole erase groups leaves the unaligned ends alone.
+	 *
+	 * @dev:	Device to discard blocks on
+	 * @start:	Start block number to discard (0=first)
+	 * @blkcnt:	Number of blocks to discard
+	 * @return number of blocks discarded, -ENOSYS if the device cannot
+	 * discard blocks, or other -ve error number (see the IS_ERR_VALUE()
+	 * macro
+	 */
+	unsigned long (*discard)(struct udevice *dev, lbaint_t start,
+				 lbaint_t blkcnt);
+
 	/**
 	 * select_hwpart() - select a particular hardware partition
 	 *
@@ -265,6 +325,30 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start a request without waiting for it to finish
+	 *
+	 * The driver finishes the request with blk_req_complete(), from
+	 * submit() itself or from a later call to poll(). Drivers without
+	 * this method have their requests carried out synchronously by
+	 * blk_submit(). Of the hardware drivers, only virtio-blk and NVMe
+	 * implement it; MMC and SCSI devices, AHCI included, do not.
+	 *
+	 * @dev:	Device to access
+	 * @req:	Request to start
+	 * @return 0 if the request was accepted, -EBUSY if the driver cannot
+	 * take another request until one has finished, other -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * poll() - make progress on submitted requests
+	 *
+	 * @dev:	Device to poll
+	 * @return number of requests still in flight, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -282,6 +366,88 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_ddiscard() - discard a section of a block device
+ *
+ * This is the fast way to throw data away, e.g. when erasing a partition or
+ * skipping the unused parts of a sparse image. Devices without a discard
+ * operation are erased instead. A device may discard fewer blocks than
+ * asked for, e.g. an eMMC which can only erase whole erase groups.
+ *
+ * @block_dev:	Block device to discard blocks on
+ * @start:	Start block number to discard (0=first)
+ * @blkcnt:	Number of blocks to discard
+ * @return number of blocks discarded, or -ve error number
+ */
+unsigned long blk_ddiscard(struct blk_desc *block_dev, lbaint_t start,
+			   lbaint_t blkcnt);
+
+/**
+ * blk_submit() - start an asynchronous block device request
+ *
+ * If the driver cannot queue requests, the request is carried out before
+ * this function returns. Either way, @req->done is set and @req->complete
+ * called once it has finished.
+ *
+ * @block_dev:	Block device to access
+ * @req:	Request to start
+ * @return 0 if the request was started, -ve on error, in which case the
+ * request is not completed
+ */
+int blk_submit(struct blk_desc *block_dev, struct blk_req *req);
+
+/**
+ * blk_poll() - make progress on the requests submitted to a device
+ *
+ * @block_dev:	Block device to poll
+ * @return number of requests still in flight, or -ve on error
+ */
+int blk_poll(struct blk_desc *block_dev);
+
+/**
+ * blk_wait() - wait for a request to finish
+ *
+ * @block_dev:	Block device the request was submitted to
+ * @req:	Request to wait for
+ * @return number of blocks transferred, or -ve error number
+ */
+long blk_wait(struct blk_desc *block_dev, struct blk_req *req);
+
+/**
+ * blk_req_complete() - finish a request, for use by drivers
+ *
+ * @req:	Request that has finished
+ * @actual:	Number of blocks transferred
+ * @status:	0 on success or -ve error
+ */
+void blk_req_complete(struct blk_req *req, lbaint_t actual, int status);
+
+/**
+ * blk_dread_async() - start reading from a block device
+ *
+ * @block_dev:	Block device to read from
+ * @start:	Start block number
+ * @blkcnt:	Number of blocks to read
+ * @buffer:	Destination buffer
+ * @req:	Request to use, with @complete and @priv already set
+ * @return 0 if the read was started, -ve on error
+ */
+int blk_dread_async(struct blk_desc *block_dev, lbaint_t start,
+		    lbaint_t blkcnt, void *buffer, struct blk_req *req);
+
+/**
+ * blk_dwrite_async() - start writing to a block device
+ *
+ * @block_dev:	Block device to write to
+ * @start:	Start block number
+ * @blkcnt:	Number of blocks to write
+ * @buffer:	Source buffer
+ * @req:	Request to use, with @complete and @priv already set
+ * @return 0 if the write was started, -ve on error
+ */
+int blk_dwrite_async(struct blk_desc *block_dev, lbaint_t start,
+		     lbaint_t blkcnt, const void *buffer, struct blk_req *req);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -467,6 +633,13 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
+static inline ulong blk_ddiscard(struct blk_desc *block_dev, lbaint_t start,
+				 lbaint_t blkcnt)
+{
+	/* block_erase() may take out whole erase groups beyond the range */
+	return -ENOSYS;
+}
+
 /**
  * struct blk_driver - Driver for block interface types
  *
@@ -69,7 +69,8 @@
 /* Configure for U-Boot environment */
 #define BZ_NO_STDIO
 
-#ifndef CONFIG_SANDBOX
+/* The compressor is only needed for tests */
+#if !defined(CONFIG_SANDBOX) && !defined(CONFIG_UT_BENCH)
 #define BZ_NO_COMPRESS
 #endif
 /* End of configuration for U-Boot environment */
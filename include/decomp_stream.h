@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Streaming decompression, fed as compressed data arrives
+ */
+
+#ifndef __DECOMP_STREAM_H
+#define __DECOMP_STREAM_H
+
+#include <linux/types.h>
+
+/**
+ * struct decomp_stream - State of a streaming decompression
+ *
+ * The uncompressed data is written sequentially into a single buffer, which
+ * also serves as the history window of the decoder. This means the input can
+ * be consumed in chunks of any size straight from the storage or network
+ * driver, without first collecting the whole compressed image in memory.
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * @dst: Destination buffer
+ * @dst_size: Size of the destination buffer in bytes
+ * @out: Number of bytes written to @dst so far
+ * @done: true once the end of the compressed data has been seen
+ * @priv: Private state of the decoder
+ */
+struct decomp_stream {
+	int comp;
+	void *dst;
+	size_t dst_size;
+	size_t out;
+	bool done;
+	void *priv;
+};
+
+/**
+ * decomp_stream_supported() - Check if a compression type can be streamed
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * @return true if decomp_stream_start() accepts @comp
+ */
+bool decomp_stream_supported(int comp);
+
+/**
+ * decomp_stream_start() - Start a streaming decompression
+ *
+ * @ds: Stream to set up
+ * @comp: Compression type (IH_COMP_...)
+ * @dst: Destination buffer for uncompressed data
+ * @dst_size: Size of the destination buffer in bytes
+ * @return 0 if OK, -EPROTONOSUPPORT if @comp is not supported, -ENOMEM if
+ *	out of memory
+ */
+int decomp_stream_start(struct decomp_stream *ds, int comp, void *dst,
+			size_t dst_size);
+
+/**
+ * decomp_stream_write() - Decompress the next chunk of input
+ *
+ * Any data following the end of the compressed stream is ignored. After an
+ * error the stream must still be closed with decomp_stream_finish().
+ *
+ * @ds: Stream to use
+ * @src: Next chunk of compressed data
+ * @len: Length of the chunk in bytes
+ * @return 0 if OK, -ENOSPC if the destination buffer is too small, -EINVAL
+ *	if the compressed data is corrupt, -ENOMEM if out of memory
+ */
+int decomp_stream_write(struct decomp_stream *ds, const void *src,
+			size_t len);
+
+/**
+ * decomp_stream_finish() - Finish a streaming decompression
+ *
+ * This frees the decoder state. The number of bytes produced is left in
+ * @ds->out.
+ *
+ * @ds: Stream to finish
+ * @return 0 if OK, -EIO if the compressed data ended early
+ */
+int decomp_stream_finish(struct decomp_stream *ds);
+
+#endif
@@ -139,6 +139,15 @@ struct dfu_entity {
 			u64 offset, void *buf, long *len);
 
 	int (*flush_medium)(struct dfu_entity *dfu);
+
+	/*
+	 * Optional: start writing @buf and return without waiting for the
+	 * medium. @buf must not change until wait_medium() returns.
+	 */
+	int (*submit_medium)(struct dfu_entity *dfu,
+			u64 offset, void *buf, long *len);
+
+	int (*wait_medium)(struct dfu_entity *dfu);
 	unsigned int (*poll_timeout)(struct dfu_entity *dfu);
 
 	void (*free_entity)(struct dfu_entity *dfu);
@@ -16,6 +16,7 @@ struct cmd_tbl;
 #define FS_TYPE_UBIFS	4
 #define FS_TYPE_BTRFS	5
 #define FS_TYPE_SQUASHFS 6
+#define FS_TYPE_EROFS	7
 
 struct blk_desc;
 
@@ -74,9 +75,27 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part);
  * Many file functions implicitly call fs_close(), e.g. fs_closedir(),
  * fs_exist(), fs_ln(), fs_ls(), fs_mkdir(), fs_read(), fs_size(), fs_write(),
  * fs_unlink().
+ *
+ * With CONFIG_FS_MOUNT_CACHE the filesystem may stay mounted after this call
+ * so that the next command on the same partition can reuse it.
  */
 void fs_close(void);
 
+/**
+ * fs_cache_invalidate() - Drop cached mounts and file data of a device
+ *
+ * Must be called whenever the contents of a block device may have changed
+ * behind the filesystem layer's back, e.g. on a raw write or when the
+ * device is re-initialised or removed.
+ *
+ * @desc: Block device that changed, or NULL to drop everything
+ */
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+void fs_cache_invalidate(struct blk_desc *desc);
+#else
+static inline void fs_cache_invalidate(struct blk_desc *desc) {}
+#endif
+
 /**
  * fs_get_type() - Get type of current filesystem
  *
@@ -146,6 +146,19 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
 int hash_progressive_lookup_algo(const char *algo_name,
 				 struct hash_algo **algop);
 
+/**
+ * hash_get_algo() - Get a hash_algo struct by its position in the table
+ *
+ * This allows callers to go through all the supported algorithms, starting
+ * from index 0 until -ENOENT is returned.
+ *
+ * @index: Position of the algorithm, from 0
+ * @algop: Pointer to the hash_algo struct if found
+ *
+ * @return 0 if ok, -ENOENT if @index is beyond the last algorithm.
+ */
+int hash_get_algo(int index, struct hash_algo **algop);
+
 /**
  * hash_parse_string() - Parse hash string into a binary array
  *
@@ -24,9 +24,49 @@ struct sparse_storage {
 				 lbaint_t blk,
 				 lbaint_t blkcnt);
 
+	/*
+	 * Optional: erase or discard the blocks of a DONT_CARE chunk before
+	 * they are reserved. Returns the number of blocks discarded.
+	 */
+	lbaint_t	(*discard)(struct sparse_storage *info,
+				   lbaint_t blk,
+				   lbaint_t blkcnt);
+
 	void		(*mssg)(const char *str, char *response);
 };
 
+/**
+ * struct sparse_stream - state of a sparse image being parsed in pieces
+ *
+ * Filled in by sparse_stream_start(); callers should treat it as opaque.
+ */
+struct sparse_stream {
+	struct sparse_storage	*info;
+	int			state;
+	sparse_header_t		header;
+	chunk_header_t		chunk;
+	u32			fill_val;
+	/* header field being gathered, and bytes still to skip */
+	void			*field;
+	unsigned int		field_len;
+	unsigned int		field_pos;
+	u64			skip;
+	/* output position and bytes left in the current RAW chunk */
+	lbaint_t		blk;
+	u64			left;
+	u32			chunk_idx;
+	u32			total_blocks;
+	u64			bytes_written;
+	/* RAW data gathered for the next write, starting at @blk */
+	void			*buf;
+	unsigned int		buf_size;
+	unsigned int		buf_used;
+	/* FILL pattern buffer, holding @fill_buf_val when valid */
+	u32			*fill_buf;
+	u32			fill_buf_val;
+	bool			fill_buf_valid;
+};
+
 static inline int is_sparse_image(void *buf)
 {
 	sparse_header_t *s_header = (sparse_header_t *)buf;
@@ -38,5 +78,44 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * sparse_stream_start() - prepare to write a sparse image in pieces
+ *
+ * @ss: stream state to initialise
+ * @info: storage the image is written to
+ * Return: 0 on success, -ENOMEM if no write buffer could be allocated
+ */
+int sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info);
+
+/**
+ * sparse_stream_write() - feed the next piece of a sparse image
+ *
+ * Pieces may be of any size and need not follow chunk boundaries. Data
+ * after the last chunk is ignored. Adjacent RAW chunks are gathered into
+ * one storage write where they fit into the write buffer.
+ *
+ * @ss: stream state
+ * @data: next bytes of the image
+ * @len: number of bytes at @data
+ * @response: passed to info->mssg() on error
+ * Return: 0 on success, -ve on error, after which the stream is stopped
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response);
+
+/**
+ * sparse_stream_finish() - write out buffered data and check the image
+ *
+ * This also releases the buffers of the stream, and must be called even if
+ * sparse_stream_write() failed.
+ *
+ * @ss: stream state
+ * @part_name: name printed with the number of bytes written
+ * @response: passed to info->mssg() on error
+ * Return: 0 if the complete image was written, -ve on error
+ */
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response);
+
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
@@ -6,19 +6,133 @@
 #ifndef __LZ4_H
 #define __LZ4_H
 
+#include <linux/types.h>
+#include <linux/xxhash.h>
+
 /**
  * ulz4fn() - Decompress LZ4 data
  *
+ * This decodes the whole frame with lz4_stream_decode(), so the same frames
+ * are supported and the same checks are made. The compressed data may be
+ * placed at the end of the output buffer, for in-place decompression.
+ *
  * @src: Source data to decompress
  * @srcn: Length of source data
  * @dst: Destination for uncompressed data
- * @dstn: Returns length of uncompressed data
+ * @dstn: Size of the destination buffer on entry, returns length of
+ *	uncompressed data
  * @return 0 if OK, -EPROTONOSUPPORT if the magic number or version number are
- *	not recognised or independent blocks are used, -EINVAL if the reserved
- *	fields are non-zero, or input is overrun, -EENOBUFS if the destination
- *	buffer is overrun, -EEPROTO if the compressed data causes an error in
- *	the decompression algorithm
+ *	not recognised, -EINVAL if the reserved fields are non-zero, or input
+ *	is overrun, -ENOBUFS if the destination buffer is overrun, -EPROTO if
+ *	the compressed data causes an error in the decompression algorithm,
+ *	-EBADMSG if a checksum does not match
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * LZ4_decompress_safe() - Decompress a raw LZ4 block
+ *
+ * @source: Compressed block, without any frame header
+ * @dest: Destination for uncompressed data
+ * @inputSize: Exact size of the compressed block
+ * @maxOutputSize: Size of the destination buffer
+ * @return number of bytes written to @dest, or a negative value if the block
+ *	is malformed or does not fit in @dest
+ */
+int LZ4_decompress_safe(const char *source, char *dest, int inputSize,
+			int maxOutputSize);
+
+/**
+ * LZ4_decompress_safe_partial() - Decompress the start of a raw LZ4 block
+ *
+ * Decoding stops once at least @targetOutputSize bytes have been produced,
+ * so @inputSize may include trailing padding after the block.
+ *
+ * @source: Compressed block, without any frame header
+ * @dest: Destination for uncompressed data
+ * @inputSize: Size of the compressed data available at @source
+ * @targetOutputSize: Number of bytes needed
+ * @maxOutputSize: Size of the destination buffer
+ * @return number of bytes written to @dest, or a negative value on error
+ */
+int LZ4_decompress_safe_partial(const char *source, char *dest, int inputSize,
+				int targetOutputSize, int maxOutputSize);
+
+/**
+ * struct lz4_stream - State for decoding an LZ4 frame in pieces
+ *
+ * The frame may be fed in chunks of any size. Blocks which arrive whole are
+ * decoded straight from the caller's buffer; only a block split across two
+ * chunks is staged in @buf, which is sized for the largest block the frame
+ * descriptor allows.
+ *
+ * With CONFIG_LZ4_CHECKSUM the header, block and content checksums present
+ * in the frame are checked, the content checksum being updated as each
+ * block is written. With CONFIG_PAR_DECOMP a run of whole independent
+ * blocks within one chunk is decoded on several CPUs at once.
+ *
+ * @dst: Start of the output buffer, used as history by linked blocks
+ * @out: Next byte to write
+ * @end: End of the output buffer
+ * @buf: Staging buffer for a block split across chunks, or NULL
+ * @buf_size: Maximum block size of the frame
+ * @block: Header of the block being read
+ * @need: Number of bytes needed to complete the current state
+ * @have: Number of those bytes already staged
+ * @state: Current position in the frame (internal)
+ * @flags: FLG byte of the frame descriptor
+ * @hdr: Staging area for headers and checksums
+ * @block_csum: Checksum of the compressed data of the last block
+ * @csum: Checksum of the output so far
+ */
+struct lz4_stream {
+	u8 *dst;
+	u8 *out;
+	u8 *end;
+	u8 *buf;
+	u32 buf_size;
+	u32 block;
+	u32 need;
+	u32 have;
+	u8 state;
+	u8 flags;
+	u8 hdr[15];
+	u32 block_csum;
+	struct xxh32_state csum;
+};
+
+/**
+ * lz4_stream_init() - Prepare to decode an LZ4 frame in pieces
+ *
+ * @s: Stream state to set up
+ * @dst: Destination for uncompressed data
+ * @dstn: Size of the destination buffer
+ */
+void lz4_stream_init(struct lz4_stream *s, void *dst, size_t dstn);
+
+/**
+ * lz4_stream_decode() - Decode the next piece of an LZ4 frame
+ *
+ * Data following the end of the frame is ignored. Frames with linked blocks
+ * are supported since the whole output stays in place.
+ *
+ * @s: Stream state
+ * @src: Next chunk of compressed data
+ * @srcn: Length of the chunk
+ * @return 0 if OK, -EPROTONOSUPPORT if the magic number or version number are
+ *	not recognised, -EINVAL if the frame header is invalid, -ENOBUFS if the
+ *	destination buffer is overrun, -EPROTO if a block is corrupt, -EBADMSG
+ *	if a checksum does not match, -ENOMEM if a staging buffer could not be
+ *	allocated
+ */
+int lz4_stream_decode(struct lz4_stream *s, const void *src, size_t srcn);
+
+/**
+ * lz4_stream_end() - Finish decoding an LZ4 frame and free resources
+ *
+ * @s: Stream state
+ * @return 0 if the end of the frame was reached, -EINVAL if it was truncated
+ */
+int lz4_stream_end(struct lz4_stream *s);
+
 #endif
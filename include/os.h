@@ -442,4 +442,25 @@ long os_get_time_offset(void);
  */
 void os_set_time_offset(long offset);
 
+/**
+ * os_get_cpu_count() - get the number of CPUs available to the sandbox
+ *
+ * Return:	number of online host CPUs, at least 1
+ */
+int os_get_cpu_count(void);
+
+/**
+ * os_run_threads() - run a function on several host threads
+ *
+ * This calls @func(@arg, @idx) for each @idx from 0 to @count - 1, with @idx
+ * 0 running on the calling thread and the rest on new threads, and waits
+ * for all of them to return. If a thread cannot be created, its call is
+ * made on the calling thread instead.
+ *
+ * @count:	number of calls to make
+ * @func:	function to call
+ * @arg:	argument passed to @func
+ */
+void os_run_threads(int count, void (*func)(void *arg, int idx), void *arg);
+
 #endif
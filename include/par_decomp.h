@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Parallel decompression of images made of independent frames or blocks
+ */
+
+#ifndef __PAR_DECOMP_H
+#define __PAR_DECOMP_H
+
+#include <linux/types.h>
+
+/**
+ * par_decomp() - Decompress an image on several CPUs at once
+ *
+ * This handles images which consist of several units that can be decoded
+ * on their own and which record their uncompressed size, so that the place
+ * of each unit in the output is known before any decoding is done:
+ *
+ * - zstd: several frames, each with its content size in the frame header
+ * - gzip: several members carrying a BGZF 'BC' extra field with the size
+ *   of the member, which then holds the uncompressed size in its trailer
+ *
+ * The units are spread over the CPUs with par_run(). Anything else is left
+ * to the usual decompressor, as indicated by -EPROTONOSUPPORT. LZ4 is such
+ * a case: its decoder splits frames with independent blocks by itself.
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * @src: Compressed data
+ * @src_len: Size of compressed data in bytes
+ * @dst: Destination buffer for uncompressed data
+ * @dst_size: Size of the destination buffer in bytes
+ * @lenp: Returns the number of uncompressed bytes written to @dst
+ * @return 0 if OK, -EPROTONOSUPPORT if @src cannot be decompressed in
+ *	parallel, -ENOSPC if the destination buffer is too small, -EINVAL if
+ *	the compressed data is corrupt, -ENOMEM if out of memory
+ */
+int par_decomp(int comp, const void *src, size_t src_len, void *dst,
+	       size_t dst_size, size_t *lenp);
+
+#endif
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running independent jobs on several CPUs at once
+ */
+
+#ifndef __PAR_RUN_H
+#define __PAR_RUN_H
+
+/**
+ * typedef par_job_func - Function called for each job
+ *
+ * Jobs run concurrently on different CPUs, so they must not use the heap,
+ * the console or any other shared state of U-Boot. Anything a job needs is
+ * set up by the caller beforehand, typically one set of state per CPU,
+ * indexed by @cpu.
+ *
+ * @ctx: Context passed to par_run()
+ * @job: Job number, from 0
+ * @cpu: CPU the job runs on, from 0 to par_run_cpus() - 1
+ * @return 0 if OK, -ve on error
+ */
+typedef int (*par_job_func)(void *ctx, int job, int cpu);
+
+/**
+ * par_run_cpus() - Get the number of CPUs that par_run() uses
+ *
+ * @return number of CPUs, at least 1
+ */
+int par_run_cpus(void);
+
+/**
+ * par_run() - Run a number of independent jobs, spread over the CPUs
+ *
+ * Job n runs on CPU n % par_run_cpus(), so jobs of similar size keep all
+ * CPUs equally busy. All jobs are run even if some fail.
+ *
+ * @func: Function to call for each job
+ * @ctx: Context to pass to @func
+ * @count: Number of jobs
+ * @return 0 if OK, else the error returned by the lowest-numbered CPU that
+ *	had a failing job
+ */
+int par_run(par_job_func func, void *ctx, int count);
+
+/**
+ * arch_par_run_cpus() - Get the number of CPUs that can run jobs
+ *
+ * This is implemented by architectures that provide arch_par_run(). The
+ * default returns 1.
+ *
+ * @return number of CPUs, including the boot CPU
+ */
+int arch_par_run_cpus(void);
+
+/**
+ * arch_par_run() - Run a worker on several CPUs and wait for them
+ *
+ * This calls @worker(@arg, @cpu) exactly once for each @cpu from 0 to
+ * @ncpus - 1, with @cpu 0 on the calling CPU, and returns when all calls
+ * have returned.
+ *
+ * @ncpus: Number of CPUs to use, 2 or more
+ * @worker: Function to run on each CPU
+ * @arg: Argument to pass to @worker
+ * @return 0 if OK, -ve if nothing was run
+ */
+int arch_par_run(int ncpus, void (*worker)(void *arg, int cpu), void *arg);
+
+#endif
@@ -213,6 +213,30 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 int part_get_info_by_name(struct blk_desc *dev_desc,
 			      const char *name, struct disk_partition *info);
 
+/**
+ * part_get_info_by_uuid() - Search for a partition by its unique UUID
+ *
+ * @dev_desc:	block device descriptor
+ * @uuid:	UUID of the partition, in either case
+ * @info:	returns the disk partition info
+ * @return partition number on match (starting on 1), -ENOENT on no match,
+ * otherwise error
+ */
+int part_get_info_by_uuid(struct blk_desc *dev_desc, const char *uuid,
+			  struct disk_partition *info);
+
+/**
+ * part_get_info_by_type_guid() - Search for the first partition of a type
+ *
+ * @dev_desc:	block device descriptor
+ * @guid:	partition type GUID, in either case
+ * @info:	returns the disk partition info
+ * @return partition number on match (starting on 1), -ENOENT on no match,
+ * otherwise error
+ */
+int part_get_info_by_type_guid(struct blk_desc *dev_desc, const char *guid,
+			       struct disk_partition *info);
+
 /**
  * Get partition info from dev number + part name, or dev number + part number.
  *
@@ -277,6 +301,34 @@ static inline int blk_get_device_part_str(const char *ifname,
 { *dev_desc = NULL; return -1; }
 #endif
 
+#if CONFIG_IS_ENABLED(PARTITION_CACHE)
+/**
+ * part_cache_invalidate() - Drop the cached partition tables of a device
+ *
+ * @dev_desc:	Block device whose tables are dropped, for all its hardware
+ *		partitions, or NULL to drop everything
+ */
+void part_cache_invalidate(struct blk_desc *dev_desc);
+
+/**
+ * part_cache_invalidate_blocks() - Note a write to a block device
+ *
+ * Drops the cached partition table of the current hardware partition of
+ * @dev_desc, unless the blocks lie completely inside one of its partitions.
+ *
+ * @dev_desc:	Block device written to
+ * @start:	First block written
+ * @blkcnt:	Number of blocks written
+ */
+void part_cache_invalidate_blocks(struct blk_desc *dev_desc, lbaint_t start,
+				  lbaint_t blkcnt);
+#else
+static inline void part_cache_invalidate(struct blk_desc *dev_desc) {}
+static inline void part_cache_invalidate_blocks(struct blk_desc *dev_desc,
+						lbaint_t start,
+						lbaint_t blkcnt) {}
+#endif
+
 /*
  * We don't support printing partition information in SPL and only support
  * getting partition information in a few cases.
@@ -9,6 +9,8 @@
 struct host_block_dev {
 #ifndef CONFIG_BLK
 	struct blk_desc blk_dev;
+#else
+	struct list_head queue;	/* requests from blk_submit(), oldest first */
 #endif
 	char *filename;
 	int fd;
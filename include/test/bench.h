@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Benchmarks for decompression, hashing, checksum and memory routines
+ */
+
+#ifndef __TEST_BENCH_H__
+#define __TEST_BENCH_H__
+
+#include <test/test.h>
+
+/* Declare a new benchmark */
+#define BENCH_TEST(_name, _flags)	UNIT_TEST(_name, _flags, bench_test)
+
+/* Largest buffer size used by bench_run_sizes() */
+#define BENCH_MAX_SIZE		(1 << 20)
+
+/**
+ * typedef bench_func - Function timed by a benchmark
+ *
+ * @ctx: Context passed to bench_run()
+ * @size: Number of bytes to process
+ * @return 0 if OK, -ve on error, which stops the benchmark
+ */
+typedef int (*bench_func)(void *ctx, ulong size);
+
+/**
+ * bench_run() - Time a function and report its throughput
+ *
+ * The function is called repeatedly, doubling the number of calls until they
+ * take at least CONFIG_UT_BENCH_TIME_MS. A line is then printed in the form
+ *
+ *   bench: group=<group> name=<name> size=<size> loops=<n> us=<n> mbps=<n>
+ *	cpb=<n.nn>
+ *
+ * (all on one line) giving the throughput in MB/s (10^6 bytes per second)
+ * and in CPU cycles per byte. The latter is '-' if the CPU clock is unknown.
+ *
+ * @group: Group of the benchmark, e.g. "crc"
+ * @name: Name of the routine, e.g. "crc32"
+ * @size: Number of bytes processed by each call
+ * @func: Function to call
+ * @ctx: Context to pass to @func
+ * @return 0 if OK, else the first error from @func
+ */
+int bench_run(const char *group, const char *name, ulong size,
+	      bench_func func, void *ctx);
+
+/**
+ * bench_size() - Get one of the buffer sizes used by bench_run_sizes()
+ *
+ * This allows a benchmark which must prepare its input for each size to use
+ * the same sizes as the others.
+ *
+ * @seq: Sequence number of the size, starting at 0
+ * @return size in bytes, or 0 if @seq is beyond the last size
+ */
+ulong bench_size(int seq);
+
+/**
+ * bench_run_sizes() - Time a function over a range of buffer sizes
+ *
+ * This calls bench_run() for each size given by bench_size(), from 64 bytes
+ * up to BENCH_MAX_SIZE.
+ *
+ * @group: Group of the benchmark
+ * @name: Name of the routine
+ * @func: Function to call
+ * @ctx: Context to pass to @func
+ * @return 0 if OK, else the first error from @func
+ */
+int bench_run_sizes(const char *group, const char *name, bench_func func,
+		    void *ctx);
+
+/**
+ * bench_fill() - Fill a buffer with text-like data
+ *
+ * This writes a pseudo-random sequence of words, which gives the compressors
+ * plenty to do. The same data is produced every time.
+ *
+ * @buf: Buffer to fill
+ * @size: Size of buffer in bytes
+ */
+void bench_fill(void *buf, ulong size);
+
+#endif /* __TEST_BENCH_H__ */
@@ -285,6 +285,31 @@ int usb_string(struct usb_device *dev, int index, char *buf, size_t size);
 int usb_set_interface(struct usb_device *dev, int interface, int alternate);
 int usb_get_port_status(struct usb_device *dev, int port, void *data);
 
+/**
+ * struct usb_bulk_req - a bulk transfer queued without waiting for it
+ *
+ * The caller fills in the first four fields and keeps the request around
+ * until usb_bulk_reap() says that it is done.
+ *
+ * @pipe:	Bulk pipe to transfer on
+ * @stream_id:	Stream to transfer on, 0 unless the endpoint has streams
+ * @buffer:	Data to send, or buffer to receive into. This should be
+ *		DMA-aligned.
+ * @length:	Number of bytes to transfer
+ * @actual_length: Number of bytes transferred, once done
+ * @status:	USB_ST_... flags describing an error, 0 if OK, once done
+ * @done:	true once the transfer has finished
+ */
+struct usb_bulk_req {
+	unsigned long pipe;
+	unsigned int stream_id;
+	void *buffer;
+	int length;
+	int actual_length;
+	unsigned long status;
+	bool done;
+};
+
 /* big endian -> little endian conversion */
 /* some CPUs are already little endian e.g. the ARM920T */
 #define __swap_16(x) \
@@ -802,6 +827,61 @@ struct dm_usb_ops {
 	 * driver to do just that.
 	 */
 	int (*lock_async)(struct udevice *udev, int lock);
+
+	/**
+	 * alloc_streams() - Set up bulk streams on a set of endpoints
+	 *
+	 * SuperSpeed bulk endpoints may carry several independent streams
+	 * of transfers, selected by a stream ID. After this call every
+	 * transfer on the endpoints must go through bulk_stream().
+	 *
+	 * @pipes:	Bulk pipes to set up
+	 * @num_pipes:	Number of pipes
+	 * @num_streams: Number of streams wanted on each pipe
+	 * @return number of streams allocated, with IDs 1 to that number,
+	 *	or -ve on error (-ENOSYS if the device or HCD has no streams)
+	 */
+	int (*alloc_streams)(struct udevice *bus, struct usb_device *udev,
+			     unsigned long *pipes, int num_pipes,
+			     unsigned int num_streams);
+
+	/**
+	 * bulk_stream() - Send a bulk message on a stream
+	 *
+	 * This works like bulk(), but queues the transfer on the ring of
+	 * @stream_id of an endpoint set up with alloc_streams().
+	 */
+	int (*bulk_stream)(struct udevice *bus, struct usb_device *udev,
+			   unsigned long pipe, unsigned int stream_id,
+			   void *buffer, int length);
+
+	/**
+	 * bulk_submit() - Queue a bulk transfer without waiting for it
+	 *
+	 * Transfers queued on the same endpoint (or stream) are carried out
+	 * in order, one after the other, without the host waiting for the
+	 * caller in between.
+	 *
+	 * @req:	Transfer to queue, which must stay valid until
+	 *		bulk_reap() reports it done
+	 * @return 0 if queued, -EBUSY if the endpoint cannot take another
+	 *	transfer until some are reaped, other -ve on error
+	 */
+	int (*bulk_submit)(struct udevice *bus, struct usb_device *udev,
+			   struct usb_bulk_req *req);
+
+	/**
+	 * bulk_reap() - Wait for a queued bulk transfer to finish
+	 *
+	 * Other queued transfers which finish in the meantime are marked
+	 * done as well, so reaping them later does not wait.
+	 *
+	 * @req:	Transfer queued by bulk_submit()
+	 * @return 0 if it finished without error, -EIO if it failed,
+	 *	-ETIMEDOUT if it was given up on
+	 */
+	int (*bulk_reap)(struct udevice *bus, struct usb_device *udev,
+			 struct usb_bulk_req *req);
 };
 
 #define usb_get_ops(dev)	((struct dm_usb_ops *)(dev)->driver->ops)
@@ -1006,6 +1086,68 @@ int usb_update_hub_device(struct usb_device *dev);
  */
 int usb_get_max_xfer_size(struct usb_device *dev, size_t *size);
 
+/**
+ * usb_alloc_streams() - Set up bulk streams on a set of endpoints
+ *
+ * Once this succeeds, transfers on @pipes must use usb_bulk_msg_stream().
+ *
+ * @dev:		USB device
+ * @pipes:		Bulk pipes to set up
+ * @num_pipes:		Number of pipes
+ * @num_streams:	Number of streams wanted on each pipe
+ * @return number of streams allocated (IDs 1 to that number), -ENOSYS if
+ *	the device or the host controller does not support streams, or other
+ *	-ve error
+ */
+int usb_alloc_streams(struct usb_device *dev, unsigned long *pipes,
+		      int num_pipes, unsigned int num_streams);
+
+/**
+ * usb_bulk_msg_stream() - Do a bulk transfer on a stream
+ *
+ * This works like usb_bulk_msg() for an endpoint set up with
+ * usb_alloc_streams().
+ *
+ * @dev:		USB device
+ * @pipe:		Bulk pipe
+ * @stream_id:		Stream to use, 1 to the number of streams allocated
+ * @data:		Data buffer
+ * @len:		Number of bytes to transfer
+ * @actual_length:	Returns the number of bytes transferred
+ * @timeout:		Timeout in milliseconds
+ * @return 0 if OK, -ve on error
+ */
+int usb_bulk_msg_stream(struct usb_device *dev, unsigned int pipe,
+			unsigned int stream_id, void *data, int len,
+			int *actual_length, int timeout);
+
+/**
+ * usb_bulk_submit() - Start a bulk transfer without waiting for it
+ *
+ * Several transfers may be queued on each endpoint, to be carried out in
+ * order, so the host can go on to the next one as soon as one finishes.
+ * Each must be passed to usb_bulk_reap() in the end. Control transfers to
+ * the device must wait until none are left outstanding.
+ *
+ * If the host controller cannot queue transfers, the transfer is done
+ * before this returns and usb_bulk_reap() only reports the result.
+ *
+ * @dev:		USB device
+ * @req:		Transfer to start
+ * @return 0 if OK, -EBUSY if the endpoint has too many transfers queued,
+ *	other -ve on error
+ */
+int usb_bulk_submit(struct usb_device *dev, struct usb_bulk_req *req);
+
+/**
+ * usb_bulk_reap() - Wait for a bulk transfer started by usb_bulk_submit()
+ *
+ * @dev:		USB device
+ * @req:		Transfer to wait for
+ * @return 0 if OK, -EIO if the transfer failed, -ETIMEDOUT if it timed out
+ */
+int usb_bulk_reap(struct usb_device *dev, struct usb_bulk_req *req);
+
 /**
  * usb_emul_setup_device() - Set up a new USB device emulation
  *
@@ -682,6 +682,23 @@ struct xhci_input_control_ctx {
 };
 
 
+/**
+ * struct xhci_stream_ctx
+ * Stream context; see section 6.2.4.1.
+ *
+ * @stream_ring:	64-bit stream ring address, cycle state, and stream type
+ */
+struct xhci_stream_ctx {
+	__le64	stream_ring;
+	/* offset 0x8 - 0xf reserved for HC internal use */
+	__le32	reserved[2];
+};
+
+/* Stream Context Types (section 6.4.1) - bits 3:1 of stream ctx deq ptr */
+#define	SCT_FOR_CTX(p)		(((p) & 0x7) << 1)
+/* Primary stream array type, dequeue pointer is to a transfer ring */
+#define	SCT_PRI_TR		1
+
 /**
  * struct xhci_device_context_array
  * @dev_context_ptr	array of 64-bit DMA addresses for device contexts
@@ -1000,6 +1017,30 @@ struct xhci_segment {
 	struct xhci_segment	*next;
 };
 
+/* Most bulk TDs which can be queued on one transfer ring */
+#define XHCI_MAX_TDS		16
+/* Segments in a bulk endpoint ring, room for several TDs of maximum size */
+#define XHCI_BULK_RING_SEGS	4
+
+/**
+ * struct xhci_td - a bulk TD handed to the controller and not yet completed
+ *
+ * @req:	Request the TD carries out
+ * @start_seg:	Segment holding @first_trb
+ * @first_trb:	First TRB of the TD
+ * @last_trb:	Last TRB, whose event completes the TD
+ * @num_trbs:	Number of TRBs used, free again once the TD completes
+ * @length:	Length still expected, less what short packets left out
+ */
+struct xhci_td {
+	struct usb_bulk_req	*req;
+	struct xhci_segment	*start_seg;
+	union xhci_trb		*first_trb;
+	union xhci_trb		*last_trb;
+	unsigned int		num_trbs;
+	int			length;
+};
+
 struct xhci_ring {
 	struct xhci_segment	*first_seg;
 	union  xhci_trb		*enqueue;
@@ -1013,6 +1054,11 @@ struct xhci_ring {
 	 */
 	volatile u32		cycle_state;
 	unsigned int		num_segs;
+	/* bulk TDs in flight, oldest first, as a circular buffer */
+	struct xhci_td		tds[XHCI_MAX_TDS];
+	unsigned int		td_first;
+	unsigned int		num_tds;
+	unsigned int		num_trbs_queued;
 };
 
 struct xhci_erst_entry {
@@ -1061,6 +1107,10 @@ struct xhci_virt_ep {
 #define EP_HAS_STREAMS		(1 << 4)
 /* Transitioning the endpoint to not using streams, don't enqueue URBs */
 #define EP_GETTING_NO_STREAMS	(1 << 5)
+	/* Primary stream array and one ring per stream ID, if EP_HAS_STREAMS */
+	struct xhci_stream_ctx		*stream_ctx;
+	struct xhci_ring		**stream_rings;
+	unsigned int			num_stream_ctxs;
 };
 
 #define CTX_SIZE(_hcc) (HCC_64BYTE_CONTEXT(_hcc) ? 64 : 32)
@@ -1249,8 +1299,10 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr,
 			u32 slot_id, u32 ep_index, trb_type cmd);
 void xhci_acknowledge_event(struct xhci_ctrl *ctrl);
 union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected);
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_req *req);
+int xhci_bulk_reap(struct usb_device *udev, struct usb_bulk_req *req);
 int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-		 int length, void *buffer);
+		 unsigned int stream_id, int length, void *buffer);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer);
 int xhci_check_maxpacket(struct usb_device *udev);
@@ -1260,6 +1312,9 @@ void xhci_cleanup(struct xhci_ctrl *ctrl);
 struct xhci_ring *xhci_ring_alloc(struct xhci_ctrl *ctrl, unsigned int num_segs,
 				  bool link_trbs);
 int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id);
+void xhci_alloc_stream_info(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			    unsigned int num_stream_ctxs);
+void xhci_free_stream_info(struct xhci_virt_ep *ep);
 int xhci_mem_init(struct xhci_ctrl *ctrl, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor);
 
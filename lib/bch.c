@@ -104,6 +104,16 @@
 #define BCH_ECC_WORDS(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 32)
 #define BCH_ECC_BYTES(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 8)
 
+/*
+ * number of remainder lookup tables: with 8 tables, encoding consumes 64 input
+ * bits per step (slicing-by-8) at the cost of twice the table memory
+ */
+#if defined(CONFIG_BCH_SLICE_BY_8) && !defined(CONFIG_SPL_BUILD)
+#define BCH_MOD8_TABS          8
+#else
+#define BCH_MOD8_TABS          4
+#endif
+
 #ifndef dbg
 #define dbg(_fmt, args...)     do {} while (0)
 #endif
@@ -243,6 +253,14 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
 	const uint32_t * const tab2 = tab1 + 256*(l+1);
 	const uint32_t * const tab3 = tab2 + 256*(l+1);
 	const uint32_t *pdata, *p0, *p1, *p2, *p3;
+#if BCH_MOD8_TABS == 8
+	const uint32_t * const tab4 = tab3 + 256*(l+1);
+	const uint32_t * const tab5 = tab4 + 256*(l+1);
+	const uint32_t * const tab6 = tab5 + 256*(l+1);
+	const uint32_t * const tab7 = tab6 + 256*(l+1);
+	const uint32_t *p4, *p5, *p6, *p7;
+	uint32_t w2;
+#endif
 
 	if (ecc) {
 		/* load ecc parity bytes into internal 32-bit buffer */
@@ -278,6 +296,36 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
 	 * xxxxxxxx  00000000  00000000  00000000  mod g = r3 (precomputed)
 	 * xxxxxxxx  yyyyyyyy  zzzzzzzz  tttttttt  mod g = r0^r1^r2^r3
 	 */
+#if BCH_MOD8_TABS == 8
+	/*
+	 * same as below with 64 bits per step: the first word is reduced with
+	 * tables 4..7, i.e. (x.X^(32+8*b+deg(g))) mod g, the second one with
+	 * tables 0..3; all eight lookups are independent of each other
+	 */
+	while (mlen >= 2) {
+		w  = r[0]^cpu_to_be32(*pdata++);
+		w2 = cpu_to_be32(*pdata++);
+		if (l)
+			w2 ^= r[1];
+		p0 = tab0 + (l+1)*((w2 >>  0) & 0xff);
+		p1 = tab1 + (l+1)*((w2 >>  8) & 0xff);
+		p2 = tab2 + (l+1)*((w2 >> 16) & 0xff);
+		p3 = tab3 + (l+1)*((w2 >> 24) & 0xff);
+		p4 = tab4 + (l+1)*((w >>  0) & 0xff);
+		p5 = tab5 + (l+1)*((w >>  8) & 0xff);
+		p6 = tab6 + (l+1)*((w >> 16) & 0xff);
+		p7 = tab7 + (l+1)*((w >> 24) & 0xff);
+
+		for (i = 0; i+2 <= l; i++)
+			r[i] = r[i+2]^p0[i]^p1[i]^p2[i]^p3[i]^
+				p4[i]^p5[i]^p6[i]^p7[i];
+
+		for (; i <= l; i++)
+			r[i] = p0[i]^p1[i]^p2[i]^p3[i]^p4[i]^p5[i]^p6[i]^p7[i];
+
+		mlen -= 2;
+	}
+#endif
 	while (mlen--) {
 		/* input data is read in big-endian format */
 		w = r[0]^cpu_to_be32(*pdata++);
@@ -387,7 +435,7 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 			      unsigned int *syn)
 {
 	int i, j, s;
-	unsigned int m;
+	unsigned int m, k, k2;
 	uint32_t poly;
 	const int t = GF_T(bch);
 
@@ -399,14 +447,22 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 		ecc[s/32] &= ~((1u << (32-m))-1);
 	memset(syn, 0, 2*t*sizeof(*syn));
 
-	/* compute v(a^j) for j=1 .. 2t-1 */
+	/*
+	 * compute v(a^j) for j=1 .. 2t-1; for a set bit at position k, the
+	 * exponents (j+1)*k are walked incrementally in steps of 2k instead of
+	 * reducing each product modulo n
+	 */
 	do {
 		poly = *ecc++;
 		s -= 32;
 		while (poly) {
 			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
+			k = modulo(bch, i+s);
+			k2 = mod_s(bch, 2*k);
+			for (j = 0; j < 2*t; j += 2) {
+				syn[j] ^= bch->a_pow_tab[k];
+				k = mod_s(bch, k+k2);
+			}
 
 			poly ^= (1 << i);
 		}
@@ -1060,16 +1116,23 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 		if (recv_ecc) {
 			load_ecc8(bch, bch->ecc_buf2, recv_ecc);
 			/* XOR received and calculated ecc */
-			for (i = 0, sum = 0; i < (int)ecc_words; i++) {
+			for (i = 0; i < (int)ecc_words; i++)
 				bch->ecc_buf[i] ^= bch->ecc_buf2[i];
-				sum |= bch->ecc_buf[i];
-			}
-			if (!sum)
-				/* no error found */
-				return 0;
 		}
+		for (i = 0, sum = 0; i < (int)ecc_words; i++)
+			sum |= bch->ecc_buf[i];
+		if (!sum)
+			/* no error found */
+			return 0;
+
 		compute_syndromes(bch, bch->ecc_buf, bch->syn);
 		syn = bch->syn;
+	} else {
+		/* all-zero hw syndromes: no error found */
+		for (i = 0, sum = 0; i < 2*(int)GF_T(bch); i++)
+			sum |= syn[i];
+		if (!sum)
+			return 0;
 	}
 
 	err = compute_error_locator_polynomial(bch, syn);
@@ -1132,7 +1195,8 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 	const int plen = DIV_ROUND_UP(bch->ecc_bits+1, 32);
 	const int ecclen = DIV_ROUND_UP(bch->ecc_bits, 32);
 
-	memset(bch->mod8_tab, 0, 4*256*l*sizeof(*bch->mod8_tab));
+	memset(bch->mod8_tab, 0,
+	       BCH_MOD8_TABS*256*l*sizeof(*bch->mod8_tab));
 
 	for (i = 0; i < 256; i++) {
 		/* p(X)=i is a small polynomial of weight <= 8 */
@@ -1153,6 +1217,29 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 			}
 		}
 	}
+
+#if BCH_MOD8_TABS == 8
+	/*
+	 * (p(X).X^(32+8*b+deg(g))) mod g(X) is the remainder of the 32-bit
+	 * left-justified word (p(X).X^(8*b+deg(g))) mod g(X), shifted by one
+	 * more word: reduce its first word with tables 0..3 and shift the rest
+	 */
+	for (b = 0; b < 4; b++) {
+		for (i = 0; i < 256; i++) {
+			const uint32_t *src = bch->mod8_tab + (b*256+i)*l;
+			const uint32_t *p[4];
+
+			tab = bch->mod8_tab + ((b+4)*256+i)*l;
+			for (d = 0; d < 4; d++)
+				p[d] = bch->mod8_tab +
+					(d*256+((src[0] >> (8*d)) & 0xff))*l;
+
+			for (j = 0; j < l; j++)
+				tab[j] = ((j+1 < l) ? src[j+1] : 0)^
+					p[0][j]^p[1][j]^p[2][j]^p[3][j];
+		}
+	}
+#endif
 }
 
 /*
@@ -1346,7 +1433,8 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	bch->ecc_bytes = DIV_ROUND_UP(m*t, 8);
 	bch->a_pow_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_pow_tab), &err);
 	bch->a_log_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_log_tab), &err);
-	bch->mod8_tab  = bch_alloc(words*1024*sizeof(*bch->mod8_tab), &err);
+	bch->mod8_tab  = bch_alloc(words*BCH_MOD8_TABS*256*
+				   sizeof(*bch->mod8_tab), &err);
 	bch->ecc_buf   = bch_alloc(words*sizeof(*bch->ecc_buf), &err);
 	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
 	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
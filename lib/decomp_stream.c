@@ -0,0 +1,472 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Streaming decompression for gzip, lzma, lz4 and zstd
+ *
+ * Each decoder writes straight into the destination buffer and uses what it
+ * has already written as its history window, so the only memory needed
+ * beyond the decoder tables is a staging buffer for a compressed block that
+ * is split across two input chunks.
+ */
+
+#include <common.h>
+#include <decomp_stream.h>
+#include <image.h>
+#include <log.h>
+#include <lz4.h>
+#include <malloc.h>
+#include <watchdog.h>
+#include <linux/kernel.h>
+#include <linux/zstd.h>
+#include <u-boot/zlib.h>
+#include <asm/unaligned.h>
+
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+
+/**
+ * struct decomp_stream_codec - Operations for one compression type
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * @start: Allocate and set up @ds->priv
+ * @write: Decompress a chunk, setting @ds->done at the end of the stream
+ * @finish: Set @ds->done if the stream ended cleanly, then free @ds->priv
+ */
+struct decomp_stream_codec {
+	int comp;
+	int (*start)(struct decomp_stream *ds);
+	int (*write)(struct decomp_stream *ds, const u8 *src, size_t len);
+	void (*finish)(struct decomp_stream *ds);
+};
+
+static int none_stream_write(struct decomp_stream *ds, const u8 *src,
+			     size_t len)
+{
+	if (len > ds->dst_size - ds->out)
+		return -ENOSPC;
+	memcpy(ds->dst + ds->out, src, len);
+	ds->out += len;
+
+	return 0;
+}
+
+static void none_stream_finish(struct decomp_stream *ds)
+{
+	ds->done = true;
+}
+
+#if CONFIG_IS_ENABLED(GZIP)
+static int gzip_stream_start(struct decomp_stream *ds)
+{
+	z_stream *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->zalloc = gzalloc;
+	s->zfree = gzfree;
+
+	/* 16 + window bits selects the gzip wrapper instead of zlib */
+	if (inflateInit2(s, 16 + MAX_WBITS) != Z_OK) {
+		free(s);
+		return -ENOMEM;
+	}
+	ds->priv = s;
+
+	return 0;
+}
+
+static int gzip_stream_write(struct decomp_stream *ds, const u8 *src,
+			     size_t len)
+{
+	z_stream *s = ds->priv;
+	int ret;
+
+	s->next_in = (u8 *)src;
+	s->avail_in = len;
+	while (s->avail_in) {
+		s->next_out = ds->dst + ds->out;
+		s->avail_out = ds->dst_size - ds->out;
+		ret = inflate(s, Z_SYNC_FLUSH);
+		ds->out = (void *)s->next_out - ds->dst;
+		switch (ret) {
+		case Z_OK:
+			break;
+		case Z_STREAM_END:
+			ds->done = true;
+			return 0;
+		case Z_BUF_ERROR:
+			/* no progress is only possible with the output full */
+			return s->avail_out ? -EINVAL : -ENOSPC;
+		case Z_MEM_ERROR:
+			return -ENOMEM;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void gzip_stream_finish(struct decomp_stream *ds)
+{
+	inflateEnd(ds->priv);
+	free(ds->priv);
+}
+#endif
+
+#if CONFIG_IS_ENABLED(LZMA)
+#define LZMA_HEADER_SIZE	(LZMA_PROPS_SIZE + sizeof(u64))
+
+/**
+ * struct lzma_stream - State for an LZMA stream
+ *
+ * @dec: Decoder, with its dictionary set to the destination buffer
+ * @alloc: Allocator for the probability tables
+ * @hdr: Properties and uncompressed size from the start of the stream
+ * @have: Number of bytes in @hdr
+ * @size: Uncompressed size, or -1 if unknown (end marker expected)
+ * @status: Status from the last call to the decoder
+ */
+struct lzma_stream {
+	CLzmaDec dec;
+	ISzAlloc alloc;
+	u8 hdr[LZMA_HEADER_SIZE];
+	uint have;
+	u64 size;
+	ELzmaStatus status;
+};
+
+static void *lzma_stream_alloc(void *p, size_t size) { return malloc(size); }
+static void lzma_stream_free(void *p, void *address) { free(address); }
+
+static int lzma_stream_start(struct decomp_stream *ds)
+{
+	struct lzma_stream *ls;
+
+	ls = calloc(1, sizeof(*ls));
+	if (!ls)
+		return -ENOMEM;
+	LzmaDec_Construct(&ls->dec);
+	ls->alloc.Alloc = lzma_stream_alloc;
+	ls->alloc.Free = lzma_stream_free;
+	ds->priv = ls;
+
+	return 0;
+}
+
+static int lzma_stream_header(struct decomp_stream *ds,
+			      struct lzma_stream *ls)
+{
+	SRes res;
+
+	ls->size = get_unaligned_le64(ls->hdr + LZMA_PROPS_SIZE);
+	if (ls->size != -1ULL && ls->size > ds->dst_size)
+		return -ENOSPC;
+
+	res = LzmaDec_AllocateProbs(&ls->dec, ls->hdr, LZMA_PROPS_SIZE,
+				    &ls->alloc);
+	if (res)
+		return res == SZ_ERROR_MEM ? -ENOMEM : -EINVAL;
+	ls->dec.dic = ds->dst;
+	ls->dec.dicBufSize = ds->dst_size;
+	LzmaDec_Init(&ls->dec);
+
+	return 0;
+}
+
+static int lzma_stream_write(struct decomp_stream *ds, const u8 *src,
+			     size_t len)
+{
+	struct lzma_stream *ls = ds->priv;
+	SizeT limit, src_len;
+	uint n;
+	SRes res;
+	int ret;
+
+	if (ls->have < LZMA_HEADER_SIZE) {
+		n = min_t(size_t, LZMA_HEADER_SIZE - ls->have, len);
+		memcpy(ls->hdr + ls->have, src, n);
+		ls->have += n;
+		src += n;
+		len -= n;
+		if (ls->have < LZMA_HEADER_SIZE)
+			return 0;
+		ret = lzma_stream_header(ds, ls);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * LZMA_FINISH_END makes the decoder look for the end marker once the
+	 * output is full, rather than stopping with data still pending
+	 */
+	limit = ls->size == -1ULL ? ds->dst_size : ls->size;
+	src_len = len;
+	res = LzmaDec_DecodeToDic(&ls->dec, limit, src, &src_len,
+				  LZMA_FINISH_END, &ls->status);
+	ds->out = ls->dec.dicPos;
+	if (ls->status == LZMA_STATUS_FINISHED_WITH_MARK ||
+	    ls->status == LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK) {
+		ds->done = !res;
+		return 0;
+	}
+	if (res || ls->status == LZMA_STATUS_NOT_FINISHED)
+		return ds->out == ds->dst_size ? -ENOSPC : -EINVAL;
+
+	return 0;
+}
+
+static void lzma_stream_finish(struct decomp_stream *ds)
+{
+	struct lzma_stream *ls = ds->priv;
+
+	LzmaDec_FreeProbs(&ls->dec, &ls->alloc);
+	free(ls);
+}
+#endif
+
+#if CONFIG_IS_ENABLED(LZ4)
+static int lz4_stream_start(struct decomp_stream *ds)
+{
+	struct lz4_stream *s;
+
+	s = malloc(sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	lz4_stream_init(s, ds->dst, ds->dst_size);
+	ds->priv = s;
+
+	return 0;
+}
+
+static int lz4_stream_write(struct decomp_stream *ds, const u8 *src,
+			    size_t len)
+{
+	struct lz4_stream *s = ds->priv;
+	int ret;
+
+	ret = lz4_stream_decode(s, src, len);
+	ds->out = s->out - s->dst;
+	switch (ret) {
+	case 0:
+	case -ENOMEM:
+		return ret;
+	case -ENOBUFS:
+		return -ENOSPC;
+	default:
+		return -EINVAL;
+	}
+}
+
+static void lz4_stream_finish(struct decomp_stream *ds)
+{
+	ds->done = !lz4_stream_end(ds->priv);
+	free(ds->priv);
+}
+#endif
+
+#if CONFIG_IS_ENABLED(ZSTD)
+/**
+ * struct zstd_stream - State for a sequence of zstd frames
+ *
+ * This uses the buffer-less API so that blocks are decoded directly into the
+ * destination, which then provides the window. No window-sized buffer is
+ * needed, unlike with ZSTD_decompressStream().
+ *
+ * @dctx: Decoder context
+ * @buf: Staging buffer for input that is split across chunks, or NULL
+ * @have: Number of bytes in @buf
+ * @skip: Number of bytes left to skip in a skippable frame
+ * @frames: Number of complete frames decoded
+ */
+struct zstd_stream {
+	ZSTD_DCtx *dctx;
+	u8 *buf;
+	size_t have;
+	size_t skip;
+	uint frames;
+};
+
+static int zstd_stream_start(struct decomp_stream *ds)
+{
+	struct zstd_stream *zs;
+
+	zs = calloc(1, sizeof(*zs));
+	if (!zs)
+		return -ENOMEM;
+	zs->dctx = ZSTD_createDCtx();
+	if (!zs->dctx || ZSTD_isError(ZSTD_decompressBegin(zs->dctx))) {
+		ZSTD_freeDCtx(zs->dctx);
+		free(zs);
+		return -ENOMEM;
+	}
+	ds->priv = zs;
+
+	return 0;
+}
+
+static int zstd_stream_write(struct decomp_stream *ds, const u8 *src,
+			     size_t len)
+{
+	struct zstd_stream *zs = ds->priv;
+	const u8 *in;
+	size_t need, n, ret;
+	bool frame_start;
+
+	while (len) {
+		if (zs->skip) {
+			n = min(zs->skip, len);
+			zs->skip -= n;
+			src += n;
+			len -= n;
+			if (!zs->skip)
+				ZSTD_decompressBegin(zs->dctx);
+			continue;
+		}
+
+		need = ZSTD_nextSrcSizeToDecompress(zs->dctx);
+		frame_start = ZSTD_nextInputType(zs->dctx) ==
+			ZSTDnit_frameHeader;
+		if (need > ZSTD_BLOCKSIZE_MAX) {
+			/* only the content of a skippable frame is this big */
+			if (ZSTD_nextInputType(zs->dctx) !=
+			    ZSTDnit_skippableFrame)
+				return -EINVAL;
+			zs->skip = need;
+			continue;
+		}
+
+		if (!zs->have && len >= need) {
+			in = src;
+			src += need;
+			len -= need;
+		} else {
+			if (!zs->buf) {
+				zs->buf = malloc(ZSTD_BLOCKSIZE_MAX);
+				if (!zs->buf)
+					return -ENOMEM;
+			}
+			n = min(need - zs->have, len);
+			memcpy(zs->buf + zs->have, src, n);
+			zs->have += n;
+			src += n;
+			len -= n;
+			if (zs->have < need)
+				break;
+			in = zs->buf;
+			zs->have = 0;
+		}
+
+		ret = ZSTD_decompressContinue(zs->dctx, ds->dst + ds->out,
+					      ds->dst_size - ds->out, in, need);
+		if (ZSTD_isError(ret)) {
+			/* anything after the last frame is not our business */
+			if (zs->frames && frame_start) {
+				ds->done = true;
+				return 0;
+			}
+			if (ZSTD_getErrorCode(ret) == ZSTD_error_dstSize_tooSmall)
+				return -ENOSPC;
+			return -EINVAL;
+		}
+		ds->out += ret;
+
+		if (!ZSTD_nextSrcSizeToDecompress(zs->dctx)) {
+			zs->frames++;
+			ZSTD_decompressBegin(zs->dctx);
+		}
+	}
+
+	return 0;
+}
+
+static void zstd_stream_finish(struct decomp_stream *ds)
+{
+	struct zstd_stream *zs = ds->priv;
+
+	/* a few trailing bytes that cannot be a frame header are fine too */
+	if (zs->frames && !zs->skip &&
+	    ZSTD_nextInputType(zs->dctx) == ZSTDnit_frameHeader)
+		ds->done = true;
+	ZSTD_freeDCtx(zs->dctx);
+	free(zs->buf);
+	free(zs);
+}
+#endif
+
+static const struct decomp_stream_codec decomp_stream_codecs[] = {
+	{ IH_COMP_NONE, NULL, none_stream_write, none_stream_finish },
+#if CONFIG_IS_ENABLED(GZIP)
+	{ IH_COMP_GZIP, gzip_stream_start, gzip_stream_write,
+		gzip_stream_finish },
+#endif
+#if CONFIG_IS_ENABLED(LZMA)
+	{ IH_COMP_LZMA, lzma_stream_start, lzma_stream_write,
+		lzma_stream_finish },
+#endif
+#if CONFIG_IS_ENABLED(LZ4)
+	{ IH_COMP_LZ4, lz4_stream_start, lz4_stream_write, lz4_stream_finish },
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	{ IH_COMP_ZSTD, zstd_stream_start, zstd_stream_write,
+		zstd_stream_finish },
+#endif
+};
+
+static const struct decomp_stream_codec *decomp_stream_codec(int comp)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(decomp_stream_codecs); i++) {
+		if (decomp_stream_codecs[i].comp == comp)
+			return &decomp_stream_codecs[i];
+	}
+
+	return NULL;
+}
+
+bool decomp_stream_supported(int comp)
+{
+	return decomp_stream_codec(comp);
+}
+
+int decomp_stream_start(struct decomp_stream *ds, int comp, void *dst,
+			size_t dst_size)
+{
+	const struct decomp_stream_codec *codec = decomp_stream_codec(comp);
+
+	memset(ds, '\0', sizeof(*ds));
+	if (!codec)
+		return -EPROTONOSUPPORT;
+	ds->comp = comp;
+	ds->dst = dst;
+	ds->dst_size = dst_size;
+	if (!codec->start)
+		return 0;
+
+	return codec->start(ds);
+}
+
+int decomp_stream_write(struct decomp_stream *ds, const void *src,
+			size_t len)
+{
+	int ret;
+
+	if (ds->done || !len)
+		return 0;
+	WATCHDOG_RESET();
+	ret = decomp_stream_codec(ds->comp)->write(ds, src, len);
+	if (ret)
+		log_debug("%s: error %d after %zx bytes\n",
+			  genimg_get_comp_name(ds->comp), ret, ds->out);
+
+	return ret;
+}
+
+int decomp_stream_finish(struct decomp_stream *ds)
+{
+	decomp_stream_codec(ds->comp)->finish(ds);
+	ds->priv = NULL;
+
+	return ds->done ? 0 : -EIO;
+}
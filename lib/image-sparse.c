@@ -49,41 +49,273 @@
 
 static void default_log(const char *ignored, char *response) {}
 
-int write_sparse_image(struct sparse_storage *info,
-		       const char *part_name, void *data, char *response)
+enum sparse_state {
+	SPARSE_FILE_HDR,	/* gathering the file header */
+	SPARSE_CHUNK_HDR,	/* gathering a chunk header */
+	SPARSE_FILL_VAL,	/* gathering the value of a FILL chunk */
+	SPARSE_RAW,		/* passing on the data of a RAW chunk */
+	SPARSE_DONE,
+	SPARSE_ERROR,
+};
+
+static void sparse_gather(struct sparse_stream *ss, enum sparse_state state,
+			  void *field, unsigned int len)
+{
+	ss->state = state;
+	ss->field = field;
+	ss->field_len = len;
+	ss->field_pos = 0;
+}
+
+static void sparse_next_chunk(struct sparse_stream *ss)
+{
+	if (ss->chunk_idx == ss->header.total_chunks) {
+		ss->state = SPARSE_DONE;
+		return;
+	}
+
+	ss->chunk_idx++;
+	sparse_gather(ss, SPARSE_CHUNK_HDR, &ss->chunk, sizeof(ss->chunk));
+}
+
+static int sparse_fail(struct sparse_stream *ss, const char *mssg,
+		       char *response)
+{
+	ss->info->mssg(mssg, response);
+	ss->state = SPARSE_ERROR;
+
+	return -EIO;
+}
+
+/* Block the next byte of output goes to, counting buffered RAW data */
+static lbaint_t sparse_out_blk(struct sparse_stream *ss)
+{
+	return ss->blk + ss->buf_used / ss->info->blksz;
+}
+
+static int sparse_check_size(struct sparse_stream *ss, lbaint_t blkcnt,
+			     char *response)
+{
+	struct sparse_storage *info = ss->info;
+
+	if (sparse_out_blk(ss) + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		return sparse_fail(ss, "Request would exceed partition size!",
+				   response);
+	}
+
+	return 0;
+}
+
+static int sparse_write_blks(struct sparse_stream *ss, lbaint_t blkcnt,
+			     const void *buf, char *response)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
 	lbaint_t blks;
-	uint32_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
+
+	blks = ss->info->write(ss->info, ss->blk, blkcnt, buf);
+	/* blks might be > blkcnt (eg. NAND bad-blocks) */
+	if (blks < blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Write failed, block #", ss->blk, blks);
+		return sparse_fail(ss, "flash write failure", response);
+	}
+	ss->blk += blks;
+
+	return 0;
+}
+
+/* Write out the RAW data gathered so far */
+static int sparse_flush(struct sparse_stream *ss, char *response)
+{
+	int ret;
+
+	if (!ss->buf_used)
+		return 0;
+
+	ret = sparse_write_blks(ss, ss->buf_used / ss->info->blksz, ss->buf,
+				response);
+	ss->buf_used = 0;
+
+	return ret;
+}
+
+static int sparse_raw(struct sparse_stream *ss, const void **data,
+		      size_t *len, char *response)
+{
+	lbaint_t blksz = ss->info->blksz;
+	size_t n = min_t(u64, *len, ss->left);
+	int ret = 0;
+
+	if (!ss->buf_used && n >= ss->buf_size) {
+		/* large enough on its own, write it from where it is */
+		n -= n % blksz;
+		ret = sparse_write_blks(ss, n / blksz, *data, response);
+	} else {
+		/* gather it, together with any RAW chunks that follow */
+		n = min_t(size_t, n, ss->buf_size - ss->buf_used);
+		memcpy(ss->buf + ss->buf_used, *data, n);
+		ss->buf_used += n;
+		if (ss->buf_used == ss->buf_size)
+			ret = sparse_flush(ss, response);
+	}
+	if (ret)
+		return ret;
+
+	*data += n;
+	*len -= n;
+	ss->left -= n;
+	if (!ss->left)
+		sparse_next_chunk(ss);
+
+	return 0;
+}
+
+static int sparse_fill(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
 	int fill_buf_num_blks;
-	int i;
-	int j;
+	lbaint_t blkcnt;
+	int i, j, ret;
 
 	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	blkcnt = (u64)ss->header.blk_sz * ss->chunk.chunk_sz / info->blksz;
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
+	ret = sparse_flush(ss, response);
+	if (!ret)
+		ret = sparse_check_size(ss, blkcnt, response);
+	if (ret)
+		return ret;
 
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+	if (!ss->fill_buf) {
+		ss->fill_buf = (uint32_t *)
+			       memalign(ARCH_DMA_MINALIGN,
+					ROUNDUP(info->blksz * fill_buf_num_blks,
+						ARCH_DMA_MINALIGN));
+		if (!ss->fill_buf)
+			return sparse_fail(ss,
+					   "Malloc failed for: CHUNK_TYPE_FILL",
+					   response);
 	}
 
-	if (!info->mssg)
-		info->mssg = default_log;
+	/* the pattern is only laid out again when the value changes */
+	if (!ss->fill_buf_valid || ss->fill_buf_val != ss->fill_val) {
+		for (i = 0; i < (info->blksz * fill_buf_num_blks /
+				 sizeof(ss->fill_val)); i++)
+			ss->fill_buf[i] = ss->fill_val;
+		ss->fill_buf_val = ss->fill_val;
+		ss->fill_buf_valid = true;
+	}
+
+	for (i = 0; i < blkcnt;) {
+		j = blkcnt - i;
+		if (j > fill_buf_num_blks)
+			j = fill_buf_num_blks;
+		ret = sparse_write_blks(ss, j, ss->fill_buf, response);
+		if (ret)
+			return ret;
+		i += j;
+	}
+	ss->bytes_written += blkcnt * info->blksz;
+	ss->total_blocks += ss->chunk.chunk_sz;
+	sparse_next_chunk(ss);
+
+	return 0;
+}
+
+static int sparse_chunk(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	sparse_header_t *sparse_header = &ss->header;
+	chunk_header_t *chunk_header = &ss->chunk;
+	u64 chunk_data_sz;
+	lbaint_t blkcnt;
+	lbaint_t blks;
+	int ret;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	/* Skip the remaining bytes in a header that is longer than expected */
+	ss->skip = sparse_header->chunk_hdr_sz - sizeof(chunk_header_t);
+
+	chunk_data_sz = (u64)sparse_header->blk_sz * chunk_header->chunk_sz;
+	blkcnt = chunk_data_sz / info->blksz;
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type Raw",
+					   response);
+
+		ret = sparse_check_size(ss, blkcnt, response);
+		if (ret)
+			return ret;
+
+		ss->left = chunk_data_sz;
+		ss->bytes_written += chunk_data_sz;
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->state = SPARSE_RAW;
+		if (!ss->left)
+			sparse_next_chunk(ss);
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type FILL",
+					   response);
+
+		sparse_gather(ss, SPARSE_FILL_VAL, &ss->fill_val,
+			      sizeof(ss->fill_val));
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		ret = sparse_flush(ss, response);
+		if (ret)
+			return ret;
+
+		if (info->discard) {
+			blks = info->discard(info, ss->blk, blkcnt);
+			if (blks < blkcnt)
+				printf("%s: Discard failed, block #" LBAFU
+				       " [" LBAFU "]\n", __func__, ss->blk,
+				       blks);
+		}
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		ss->total_blocks += chunk_header->chunk_sz;
+		sparse_next_chunk(ss);
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz != sparse_header->chunk_hdr_sz)
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type Dont Care",
+					   response);
+
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->skip += chunk_data_sz;
+		sparse_next_chunk(ss);
+		break;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_fail(ss, "Unknown chunk type", response);
+	}
+
+	return 0;
+}
+
+static int sparse_file_header(struct sparse_stream *ss, char *response)
+{
+	sparse_header_t *sparse_header = &ss->header;
+	unsigned int offset;
 
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
@@ -95,170 +327,165 @@ int write_sparse_image(struct sparse_storage *info,
 	debug("total_blks: %d\n", sparse_header->total_blks);
 	debug("total_chunks: %d\n", sparse_header->total_chunks);
 
+	if (!is_sparse_image(sparse_header) ||
+	    sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_fail(ss, "sparse image header invalid", response);
+
 	/*
 	 * Verify that the sparse block size is a multiple of our
 	 * storage backend block size
 	 */
-	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
-	if (offset) {
+	div_u64_rem(sparse_header->blk_sz, ss->info->blksz, &offset);
+	if (offset || !sparse_header->blk_sz) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
-		info->mssg("sparse image block size issue", response);
-		return -1;
+		return sparse_fail(ss, "sparse image block size issue",
+				   response);
 	}
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
+	/* Skip the remaining bytes in a header that is longer than expected */
+	ss->skip = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+	sparse_next_chunk(ss);
+
+	return 0;
+}
+
+int sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info)
+{
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	ss->blk = info->start;
+	sparse_gather(ss, SPARSE_FILE_HDR, &ss->header, sizeof(ss->header));
+
+	if (!info->mssg)
+		info->mssg = default_log;
+
+	ss->buf_size = CONFIG_IMAGE_SPARSE_WRITEBUF_SIZE;
+	ss->buf_size -= ss->buf_size % info->blksz;
+	if (!ss->buf_size)
+		ss->buf_size = info->blksz;
+	ss->buf = memalign(ARCH_DMA_MINALIGN,
+			   ROUNDUP(ss->buf_size, ARCH_DMA_MINALIGN));
+	if (!ss->buf) {
+		ss->state = SPARSE_ERROR;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response)
+{
+	size_t n;
+	int ret = 0;
+
+	while (len && !ret) {
+		if (ss->state == SPARSE_DONE)
+			return 0;
+		if (ss->state == SPARSE_ERROR)
+			return -EIO;
+
+		if (ss->skip) {
+			n = min_t(u64, ss->skip, len);
+			data += n;
+			len -= n;
+			ss->skip -= n;
+			continue;
 		}
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
+		if (ss->state == SPARSE_RAW) {
+			ret = sparse_raw(ss, &data, &len, response);
+			continue;
 		}
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		blkcnt = chunk_data_sz / info->blksz;
-		switch (chunk_header->chunk_type) {
-		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				info->mssg("Bogus chunk size for chunk type Raw",
-					   response);
-				return -1;
-			}
-
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
-
-			blks = info->write(info, blk, blkcnt, data);
-			/* blks might be > blkcnt (eg. NAND bad-blocks) */
-			if (blks < blkcnt) {
-				printf("%s: %s" LBAFU " [" LBAFU "]\n",
-				       __func__, "Write failed, block #",
-				       blk, blks);
-				info->mssg("flash write failure", response);
-				return -1;
-			}
-			blk += blks;
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+		n = min_t(size_t, ss->field_len - ss->field_pos, len);
+		memcpy(ss->field + ss->field_pos, data, n);
+		data += n;
+		len -= n;
+		ss->field_pos += n;
+		if (ss->field_pos < ss->field_len)
+			continue;
 
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				info->mssg("Bogus chunk size for chunk type FILL", response);
-				return -1;
-			}
-
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
-
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
-
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
-
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
-
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_data_sz / sparse_header->blk_sz;
-			free(fill_buf);
+		switch (ss->state) {
+		case SPARSE_FILE_HDR:
+			ret = sparse_file_header(ss, response);
 			break;
-
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
+		case SPARSE_CHUNK_HDR:
+			ret = sparse_chunk(ss, response);
 			break;
-
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz) {
-				info->mssg("Bogus chunk size for chunk type Dont Care",
-					   response);
-				return -1;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
+		case SPARSE_FILL_VAL:
+			ret = sparse_fill(ss, response);
 			break;
-
 		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			info->mssg("Unknown chunk type", response);
-			return -1;
+			break;
 		}
 	}
 
+	return ret;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response)
+{
+	int ret = 0;
+
+	if (ss->state != SPARSE_ERROR)
+		ret = sparse_flush(ss, response);
+
+	free(ss->fill_buf);
+	ss->fill_buf = NULL;
+	free(ss->buf);
+	ss->buf = NULL;
+
+	if (ss->state == SPARSE_ERROR)
+		return ret ? ret : -EIO;
+
 	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	      ss->total_blocks, ss->header.total_blks);
+	printf("........ wrote %llu bytes to '%s'\n",
+	       (unsigned long long)ss->bytes_written, part_name);
 
-	if (total_blocks != sparse_header->total_blks) {
-		info->mssg("sparse image write failure", response);
-		return -1;
-	}
+	if (ss->state != SPARSE_DONE ||
+	    ss->total_blocks != ss->header.total_blks)
+		return sparse_fail(ss, "sparse image write failure", response);
 
 	return 0;
 }
+
+int write_sparse_image(struct sparse_storage *info,
+		       const char *part_name, void *data, char *response)
+{
+	sparse_header_t *sparse_header = data;
+	chunk_header_t *chunk_header;
+	struct sparse_stream ss;
+	size_t size;
+	u32 chunk;
+	int ret;
+
+	/* The image is in memory: find its end from the chunk headers */
+	size = sparse_header->file_hdr_sz;
+	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
+		chunk_header = data + size;
+		if (chunk_header->total_sz < sparse_header->chunk_hdr_sz)
+			break;
+		size += chunk_header->total_sz;
+	}
+
+	ret = sparse_stream_start(&ss, info);
+	if (ret) {
+		info->mssg("Malloc failed for sparse write buffer", response);
+		return ret;
+	}
+
+	ret = sparse_stream_write(&ss, data, size, response);
+	if (!ret)
+		return sparse_stream_finish(&ss, part_name, response);
+
+	sparse_stream_finish(&ss, part_name, response);
+
+	return ret;
+}
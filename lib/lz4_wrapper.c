@@ -7,6 +7,9 @@
 #include <compiler.h>
 #include <image.h>
 #include <lz4.h>
+#include <log.h>
+#include <malloc.h>
+#include <par_run.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <asm/unaligned.h>
@@ -23,99 +26,433 @@ typedef uint64_t U64;
 
 #define FORCE_INLINE static inline __attribute__((always_inline))
 
-/* lz4.c is unaltered (except removing unrelated code) from github.com/Cyan4973/lz4. */
+#ifdef CONFIG_ARM64
+/* Loads both halves before storing, so that a load pair and store pair can be used */
+static void LZ4_copy16(void *dst, const void *src)
+{
+	u64 lo = ((u64 *)src)[0];
+	u64 hi = ((u64 *)src)[1];
+
+	((u64 *)dst)[0] = lo;
+	((u64 *)dst)[1] = hi;
+}
+
+/*
+ * Copy 16 bytes at a time when the source is at least that far behind, so
+ * that an overlapping match never reads bytes it has yet to write. As with
+ * the generic version, nothing is written more than 7 bytes past dstEnd.
+ */
+static void LZ4_wildCopy(void *dstPtr, const void *srcPtr, void *dstEnd)
+{
+	BYTE *d = dstPtr;
+	const BYTE *s = srcPtr;
+	BYTE *e = dstEnd;
+
+	if ((size_t)(d - s) >= 16) {
+		for (; e - d > 8; d += 16, s += 16)
+			LZ4_copy16(d, s);
+	}
+	for (; d < e; d += 8, s += 8)
+		LZ4_copy8(d, s);
+}
+
+#define LZ4_ARCH_WILDCOPY
+#endif
+
+/*
+ * lz4.c is unaltered (except removing unrelated code and allowing LZ4_wildCopy()
+ * to be replaced) from github.com/Cyan4973/lz4.
+ */
 #include "lz4.c"	/* #include for inlining, do not link! */
 
 #define LZ4F_BLOCKUNCOMPRESSED_FLAG 0x80000000U
 
-int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+int LZ4_decompress_safe(const char *source, char *dest, int inputSize,
+			int maxOutputSize)
+{
+	return LZ4_decompress_generic(source, dest, inputSize, maxOutputSize,
+				      endOnInputSize, full, 0, noDict,
+				      (BYTE *)dest, NULL, 0);
+}
+
+int LZ4_decompress_safe_partial(const char *source, char *dest, int inputSize,
+				int targetOutputSize, int maxOutputSize)
+{
+	return LZ4_decompress_generic(source, dest, inputSize, maxOutputSize,
+				      endOnInputSize, partial,
+				      targetOutputSize, noDict,
+				      (BYTE *)dest, NULL, 0);
+}
+
+#define LZ4F_FLG_INDEPENDENT	BIT(5)
+#define LZ4F_FLG_BLOCK_CSUM	BIT(4)
+#define LZ4F_FLG_CONTENT_SIZE	BIT(3)
+#define LZ4F_FLG_CONTENT_CSUM	BIT(2)
+
+enum {
+	LZ4S_HEADER,		/* magic, FLG and BD */
+	LZ4S_DESC,		/* optional content size and header checksum */
+	LZ4S_BLOCK_HDR,
+	LZ4S_BLOCK,
+	LZ4S_BLOCK_CSUM,
+	LZ4S_CONTENT_CSUM,
+	LZ4S_DONE,
+};
+
+static void lz4_stream_next(struct lz4_stream *s, int state, u32 need)
+{
+	s->state = state;
+	s->need = need;
+	s->have = 0;
+}
+
+/* Stage input for the current state, returning true once it is complete */
+static bool lz4_stream_fill(struct lz4_stream *s, u8 *to, const u8 **in,
+			    size_t *len)
+{
+	u32 n = min_t(size_t, s->need - s->have, *len);
+
+	memcpy(to + s->have, *in, n);
+	s->have += n;
+	*in += n;
+	*len -= n;
+
+	return s->have == s->need;
+}
+
+static int lz4_stream_header(struct lz4_stream *s)
+{
+	u8 flags = s->hdr[4];
+	u8 block_desc = s->hdr[5];
+	uint max_size = (block_desc >> 4) & 0x7;
+
+	if (get_unaligned_le32(s->hdr) != LZ4F_MAGIC || flags >> 6 != 1)
+		return -EPROTONOSUPPORT;
+	if ((flags & 0x03) || (block_desc & 0x8f) || max_size < 4)
+		return -EINVAL;
+
+	/* 64KB, 256KB, 1MB or 4MB */
+	s->buf_size = 1 << (8 + 2 * max_size);
+	s->flags = flags;
+	lz4_stream_next(s, LZ4S_DESC,
+			(flags & LZ4F_FLG_CONTENT_SIZE ? sizeof(u64) : 0) + 1);
+
+	return 0;
+}
+
+/* Checksums are only worked out if they are to be checked */
+static bool lz4_csum(const struct lz4_stream *s, u8 flag)
+{
+	return CONFIG_IS_ENABLED(LZ4_CHECKSUM) && (s->flags & flag);
+}
+
+/**
+ * lz4_block() - Decode one block of a frame
+ *
+ * @header: Block header, giving the size and whether it is compressed
+ * @in: Data of the block
+ * @out: Where to write the output
+ * @space: Space available at @out
+ * @prefix: Start of the output which matches may refer back to
+ * @return number of bytes written, -ENOBUFS if an uncompressed block does
+ *	not fit, -EPROTO if a compressed block is corrupt or does not fit
+ */
+static int lz4_block(u32 header, const u8 *in, u8 *out, size_t space,
+		     const BYTE *prefix)
 {
-	const void *end = dst + *dstn;
-	const void *in = src;
-	void *out = dst;
-	int has_block_checksum;
+	u32 size = header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
 	int ret;
-	*dstn = 0;
-
-	{ /* With in-place decompression the header may become invalid later. */
-		u32 magic;
-		u8 flags, version, independent_blocks, has_content_size;
-		u8 block_desc;
-
-		if (srcn < sizeof(u32) + 3*sizeof(u8))
-			return -EINVAL;	/* input overrun */
-
-		magic = get_unaligned_le32(in);
-		in += sizeof(u32);
-		flags = *(u8 *)in;
-		in += sizeof(u8);
-		block_desc = *(u8 *)in;
-		in += sizeof(u8);
-
-		version = (flags >> 6) & 0x3;
-		independent_blocks = (flags >> 5) & 0x1;
-		has_block_checksum = (flags >> 4) & 0x1;
-		has_content_size = (flags >> 3) & 0x1;
-
-		/* We assume there's always only a single, standard frame. */
-		if (magic != LZ4F_MAGIC || version != 1)
-			return -EPROTONOSUPPORT;	/* unknown format */
-		if ((flags & 0x03) || (block_desc & 0x8f))
-			return -EINVAL;	/* reserved bits must be zero */
-		if (!independent_blocks)
-			return -EPROTONOSUPPORT; /* we can't support this yet */
-
-		if (has_content_size) {
-			if (srcn < sizeof(u32) + 3*sizeof(u8) + sizeof(u64))
-				return -EINVAL;	/* input overrun */
-			in += sizeof(u64);
-		}
-		/* Header checksum byte */
-		in += sizeof(u8);
+
+	if (header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
+		if (size > space)
+			return -ENOBUFS;
+		memcpy(out, in, size);
+		return size;
 	}
 
-	while (1) {
-		u32 block_header, block_size;
+	/* constant folding essential, do not touch params! */
+	ret = LZ4_decompress_generic((const char *)in, (char *)out, size,
+				     space, endOnInputSize, full, 0, noDict,
+				     prefix, NULL, 0);
 
-		block_header = get_unaligned_le32(in);
-		in += sizeof(u32);
-		block_size = block_header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+	return ret < 0 ? -EPROTO : ret;
+}
 
-		if (in - src + block_size > srcn) {
-			ret = -EINVAL;		/* input overrun */
-			break;
-		}
+static int lz4_stream_block(struct lz4_stream *s, const u8 *in)
+{
+	int ret;
 
-		if (!block_size) {
-			ret = 0;	/* decompression successful */
+	if (lz4_csum(s, LZ4F_FLG_BLOCK_CSUM))
+		s->block_csum = xxh32(in, s->need, 0);
+
+	/* linked blocks may refer back to anything already written */
+	ret = lz4_block(s->block, in, s->out, s->end - s->out,
+			s->flags & LZ4F_FLG_INDEPENDENT ? s->out : s->dst);
+	if (ret == -EPROTO && s->end - s->out < s->buf_size) {
+		/*
+		 * The decoder does not say why it failed; if a full block
+		 * would not have fitted, blame the buffer size
+		 */
+		ret = -ENOBUFS;
+	}
+	if (ret < 0)
+		return ret;
+	if (lz4_csum(s, LZ4F_FLG_CONTENT_CSUM))
+		xxh32_update(&s->csum, s->out, ret);
+	s->out += ret;
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(PAR_DECOMP)
+/**
+ * struct lz4_par_block - A block decoded by a job of its own
+ *
+ * @src: Block header, followed by the data and any checksum
+ * @len: Returns the number of bytes written
+ */
+struct lz4_par_block {
+	const u8 *src;
+	u32 len;
+};
+
+/**
+ * struct lz4_par - A run of independent blocks decoded on several CPUs
+ *
+ * Block n is written n maximum-sized blocks after the current output
+ * position, so the output only ends up in the right place if each block but
+ * the last fills a whole block. The lz4 tool writes frames like that, but
+ * this can only be checked once all blocks are decoded.
+ *
+ * @s: Stream state, which the jobs only read
+ * @blocks: Blocks to decode
+ */
+struct lz4_par {
+	const struct lz4_stream *s;
+	struct lz4_par_block *blocks;
+};
+
+static int lz4_par_job(void *ctx, int job, int cpu)
+{
+	struct lz4_par *par = ctx;
+	struct lz4_par_block *blk = &par->blocks[job];
+	const struct lz4_stream *s = par->s;
+	u32 header = get_unaligned_le32(blk->src);
+	u32 size = header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+	const u8 *in = blk->src + sizeof(u32);
+	u8 *out = s->out + (size_t)job * s->buf_size;
+	int ret;
+
+	if (lz4_csum(s, LZ4F_FLG_BLOCK_CSUM) &&
+	    xxh32(in, size, 0) != get_unaligned_le32(in + size))
+		return -EBADMSG;
+	ret = lz4_block(header, in, out,
+			min_t(size_t, s->buf_size, s->end - out), out);
+	if (ret < 0)
+		return ret;
+	blk->len = ret;
+
+	return 0;
+}
+
+/**
+ * lz4_par_decode() - Decode the whole blocks at the start of a chunk at once
+ *
+ * Anything unexpected, including corrupt data, makes this give up so that
+ * the blocks are decoded one at a time, which then reports the problem.
+ *
+ * @s: Stream state, about to read a block header
+ * @src: Compressed data, starting with the block header
+ * @srcn: Length of compressed data
+ * @return number of bytes of @src used, 0 if none
+ */
+static size_t lz4_par_decode(struct lz4_stream *s, const u8 *src, size_t srcn)
+{
+	size_t csum_size = s->flags & LZ4F_FLG_BLOCK_CSUM ? sizeof(u32) : 0;
+	struct lz4_par par = { .s = s };
+	size_t pos, step, total;
+	u32 size;
+	int count, i, ret;
+
+	/* in-place decompression relies on the blocks being done in order */
+	if (!(s->flags & LZ4F_FLG_INDEPENDENT) || par_run_cpus() < 2 ||
+	    (src < s->end && src + srcn > s->dst))
+		return 0;
+
+	for (pos = 0, count = 0; pos + sizeof(u32) <= srcn; pos += step) {
+		size = get_unaligned_le32(src + pos) &
+			~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		step = sizeof(u32) + size + csum_size;
+		if (!size || size > s->buf_size || step > srcn - pos)
 			break;
-		}
+		count++;
+	}
+	if (count < 2 || count - 1 > (s->end - s->out) / s->buf_size)
+		return 0;
+
+	par.blocks = malloc(count * sizeof(*par.blocks));
+	if (!par.blocks)
+		return 0;
+	for (i = 0, pos = 0; i < count; i++, pos += step) {
+		size = get_unaligned_le32(src + pos) &
+			~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		step = sizeof(u32) + size + csum_size;
+		par.blocks[i].src = src + pos;
+	}
+
+	ret = par_run(lz4_par_job, &par, count);
+	for (i = 0; !ret && i < count - 1; i++) {
+		if (par.blocks[i].len != s->buf_size)
+			ret = -EPROTONOSUPPORT;
+	}
+	total = (size_t)(count - 1) * s->buf_size + par.blocks[count - 1].len;
+	free(par.blocks);
+	if (ret) {
+		log_debug("Decoding %d blocks one at a time (err=%d)\n", count,
+			  ret);
+		return 0;
+	}
+
+	if (lz4_csum(s, LZ4F_FLG_CONTENT_CSUM))
+		xxh32_update(&s->csum, s->out, total);
+	s->out += total;
 
-		if (block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
-			size_t size = min((ptrdiff_t)block_size, end - out);
-			memcpy(out, in, size);
-			out += size;
-			if (size < block_size) {
-				ret = -ENOBUFS;	/* output overrun */
+	return pos;
+}
+#else
+static size_t lz4_par_decode(struct lz4_stream *s, const u8 *src, size_t srcn)
+{
+	return 0;
+}
+#endif
+
+void lz4_stream_init(struct lz4_stream *s, void *dst, size_t dstn)
+{
+	memset(s, '\0', sizeof(*s));
+	s->dst = dst;
+	s->out = dst;
+	s->end = dst + dstn;
+	if (CONFIG_IS_ENABLED(LZ4_CHECKSUM))
+		xxh32_reset(&s->csum, 0);
+	lz4_stream_next(s, LZ4S_HEADER, 6);
+}
+
+int lz4_stream_decode(struct lz4_stream *s, const void *src, size_t srcn)
+{
+	const u8 *in = src;
+	bool par_tried = false;
+	size_t used;
+	u32 size;
+	int ret;
+
+	while (srcn && s->state != LZ4S_DONE) {
+		switch (s->state) {
+		case LZ4S_HEADER:
+			if (!lz4_stream_fill(s, s->hdr, &in, &srcn))
 				break;
+			ret = lz4_stream_header(s);
+			if (ret)
+				return ret;
+			break;
+		case LZ4S_DESC:
+			if (!lz4_stream_fill(s, s->hdr + 6, &in, &srcn))
+				break;
+			/* second byte of the hash of FLG, BD and content size */
+			if (CONFIG_IS_ENABLED(LZ4_CHECKSUM) &&
+			    s->hdr[5 + s->need] !=
+			    ((xxh32(s->hdr + 4, s->need + 1, 0) >> 8) & 0xff))
+				return -EBADMSG;
+			if ((s->flags & LZ4F_FLG_CONTENT_SIZE) &&
+			    get_unaligned_le64(s->hdr + 6) > s->end - s->out)
+				return -ENOBUFS;
+			lz4_stream_next(s, LZ4S_BLOCK_HDR, sizeof(u32));
+			break;
+		case LZ4S_BLOCK_HDR:
+			/* a failed attempt costs a lot, so only try once */
+			if (!s->have && !par_tried) {
+				par_tried = true;
+				used = lz4_par_decode(s, in, srcn);
+				in += used;
+				srcn -= used;
 			}
-		} else {
-			/* constant folding essential, do not touch params! */
-			ret = LZ4_decompress_generic(in, out, block_size,
-					end - out, endOnInputSize,
-					full, 0, noDict, out, NULL, 0);
-			if (ret < 0) {
-				ret = -EPROTO;	/* decompression error */
+			if (!lz4_stream_fill(s, s->hdr, &in, &srcn))
 				break;
+			s->block = get_unaligned_le32(s->hdr);
+			size = s->block & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+			if (!size) {
+				if (s->flags & LZ4F_FLG_CONTENT_CSUM)
+					lz4_stream_next(s, LZ4S_CONTENT_CSUM,
+							sizeof(u32));
+				else
+					lz4_stream_next(s, LZ4S_DONE, 0);
+				break;
+			}
+			if (size > s->buf_size)
+				return -EINVAL;
+			lz4_stream_next(s, LZ4S_BLOCK, size);
+			break;
+		case LZ4S_BLOCK:
+			if (!s->have && srcn >= s->need) {
+				/* the whole block is here, no need to copy it */
+				ret = lz4_stream_block(s, in);
+				in += s->need;
+				srcn -= s->need;
+			} else {
+				if (!s->buf) {
+					s->buf = malloc(s->buf_size);
+					if (!s->buf)
+						return -ENOMEM;
+				}
+				if (!lz4_stream_fill(s, s->buf, &in, &srcn))
+					break;
+				ret = lz4_stream_block(s, s->buf);
 			}
-			out += ret;
+			if (ret)
+				return ret;
+			if (s->flags & LZ4F_FLG_BLOCK_CSUM)
+				lz4_stream_next(s, LZ4S_BLOCK_CSUM, sizeof(u32));
+			else
+				lz4_stream_next(s, LZ4S_BLOCK_HDR, sizeof(u32));
+			break;
+		case LZ4S_BLOCK_CSUM:
+			if (!lz4_stream_fill(s, s->hdr, &in, &srcn))
+				break;
+			if (lz4_csum(s, LZ4F_FLG_BLOCK_CSUM) &&
+			    get_unaligned_le32(s->hdr) != s->block_csum)
+				return -EBADMSG;
+			lz4_stream_next(s, LZ4S_BLOCK_HDR, sizeof(u32));
+			break;
+		case LZ4S_CONTENT_CSUM:
+			if (!lz4_stream_fill(s, s->hdr, &in, &srcn))
+				break;
+			if (lz4_csum(s, LZ4F_FLG_CONTENT_CSUM) &&
+			    get_unaligned_le32(s->hdr) != xxh32_digest(&s->csum))
+				return -EBADMSG;
+			lz4_stream_next(s, LZ4S_DONE, 0);
+			break;
 		}
-
-		in += block_size;
-		if (has_block_checksum)
-			in += sizeof(u32);
 	}
 
-	*dstn = out - dst;
-	return ret;
+	return 0;
+}
+
+int lz4_stream_end(struct lz4_stream *s)
+{
+	free(s->buf);
+	s->buf = NULL;
+
+	return s->state == LZ4S_DONE ? 0 : -EINVAL;
+}
+
+int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	struct lz4_stream s;
+	int ret, err;
+
+	lz4_stream_init(&s, dst, *dstn);
+	ret = lz4_stream_decode(&s, src, srcn);
+	err = lz4_stream_end(&s);
+	*dstn = s.out - s.dst;
+
+	return ret ? ret : err;
 }
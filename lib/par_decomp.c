@@ -0,0 +1,330 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Parallel decompression of images made of independent frames or blocks
+ *
+ * The image is first split into units, each with a known place in the
+ * output. Decoder state for each CPU is then set up here on the boot CPU,
+ * so that the jobs running on the other CPUs never touch the heap.
+ */
+
+#include <common.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <par_decomp.h>
+#include <par_run.h>
+#include <linux/kernel.h>
+#include <linux/zstd.h>
+#include <u-boot/zlib.h>
+#include <asm/unaligned.h>
+
+/**
+ * struct par_decomp_unit - A part of the image which decodes on its own
+ *
+ * @src: Compressed data of the unit
+ * @src_len: Size of compressed data in bytes
+ * @dst_off: Offset of the uncompressed data in the output
+ * @dst_len: Size of the uncompressed data in bytes
+ */
+struct par_decomp_unit {
+	const u8 *src;
+	size_t src_len;
+	size_t dst_off;
+	size_t dst_len;
+};
+
+/**
+ * struct par_decomp - State of a parallel decompression
+ *
+ * @dst: Destination buffer
+ * @units: Units to decode
+ * @priv: Decoder state for each CPU
+ */
+struct par_decomp {
+	u8 *dst;
+	struct par_decomp_unit *units;
+	void *priv[CONFIG_PAR_RUN_MAX_CPUS];
+};
+
+/**
+ * struct par_decomp_codec - Operations for one compression type
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * @split: Find the units in @src, filling in @units if not NULL. This
+ *	returns the number of units, or -EPROTONOSUPPORT if @src is not in
+ *	a form that can be split or its total uncompressed size overflows.
+ *	The total uncompressed size is returned in @sizep.
+ * @start: Set up @pd->priv[@cpu], returning 0 or -ENOMEM
+ * @decode: Decode one unit using @priv, returning 0 or -EINVAL
+ * @finish: Free @priv
+ */
+struct par_decomp_codec {
+	int comp;
+	int (*split)(const u8 *src, size_t len, struct par_decomp_unit *units,
+		     size_t *sizep);
+	int (*start)(struct par_decomp *pd, int cpu);
+	int (*decode)(void *priv, u8 *dst, const struct par_decomp_unit *unit);
+	void (*finish)(void *priv);
+};
+
+#if CONFIG_IS_ENABLED(GZIP)
+#define GZIP_EXTRA_FIELD	4
+/* Fixed header, XLEN, and the CRC32 and ISIZE trailer */
+#define GZIP_MIN_MEMBER		(12 + 8)
+
+/* Size of the member at @p, from its BGZF 'BC' subfield, or 0 if none */
+static size_t gzip_member_size(const u8 *p, size_t len)
+{
+	size_t xlen, pos, slen;
+
+	if (len < GZIP_MIN_MEMBER || p[0] != 0x1f || p[1] != 0x8b ||
+	    p[2] != Z_DEFLATED || !(p[3] & GZIP_EXTRA_FIELD))
+		return 0;
+	xlen = get_unaligned_le16(p + 10);
+	if (GZIP_MIN_MEMBER + xlen > len)
+		return 0;
+
+	for (pos = 12; pos + 4 <= 12 + xlen; pos += 4 + slen) {
+		slen = get_unaligned_le16(p + pos + 2);
+		if (p[pos] == 'B' && p[pos + 1] == 'C' && slen == 2 &&
+		    pos + 6 <= 12 + xlen)
+			return get_unaligned_le16(p + pos + 4) + 1;
+	}
+
+	return 0;
+}
+
+static int gzip_split(const u8 *src, size_t len,
+		      struct par_decomp_unit *units, size_t *sizep)
+{
+	size_t pos, size, out = 0;
+	int count = 0;
+
+	for (pos = 0; pos < len; pos += size) {
+		struct par_decomp_unit unit;
+
+		size = gzip_member_size(src + pos, len - pos);
+		if (size < GZIP_MIN_MEMBER || size > len - pos)
+			return -EPROTONOSUPPORT;
+		unit.src = src + pos;
+		unit.src_len = size;
+		unit.dst_off = out;
+		unit.dst_len = get_unaligned_le32(src + pos + size - 4);
+		if (out + unit.dst_len < out)
+			return -EPROTONOSUPPORT;
+		out += unit.dst_len;
+
+		/* skip the empty block which marks the end of the file */
+		if (!unit.dst_len)
+			continue;
+		if (units)
+			units[count] = unit;
+		count++;
+	}
+	*sizep = out;
+
+	return count;
+}
+
+/* Jobs must not allocate, so make zlib fail rather than call malloc() */
+static void *gzip_noalloc(void *x, unsigned int items, unsigned int size)
+{
+	return NULL;
+}
+
+static int gzip_start(struct par_decomp *pd, int cpu)
+{
+	z_stream *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->zalloc = gzalloc;
+	s->zfree = gzfree;
+
+	/* 16 + window bits selects the gzip wrapper, which checks the CRC */
+	if (inflateInit2(s, 16 + MAX_WBITS) != Z_OK) {
+		free(s);
+		return -ENOMEM;
+	}
+	s->zalloc = gzip_noalloc;
+	pd->priv[cpu] = s;
+
+	return 0;
+}
+
+static int gzip_decode(void *priv, u8 *dst, const struct par_decomp_unit *unit)
+{
+	z_stream *s = priv;
+	int ret;
+
+	inflateReset(s);
+	s->next_in = (u8 *)unit->src;
+	s->avail_in = unit->src_len;
+	s->next_out = dst + unit->dst_off;
+	s->avail_out = unit->dst_len;
+	ret = inflate(s, Z_FINISH);
+	if (ret != Z_STREAM_END || s->avail_out || s->avail_in)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void gzip_finish(void *priv)
+{
+	z_stream *s = priv;
+
+	inflateEnd(s);
+	free(s);
+}
+#endif
+
+#if CONFIG_IS_ENABLED(ZSTD)
+static int zstd_split(const u8 *src, size_t len,
+		      struct par_decomp_unit *units, size_t *sizep)
+{
+	size_t pos, size, out = 0;
+	int count = 0;
+	u64 content;
+
+	for (pos = 0; pos < len; pos += size) {
+		size = ZSTD_findFrameCompressedSize(src + pos, len - pos);
+		if (ZSTD_isError(size))
+			return -EPROTONOSUPPORT;
+		if (ZSTD_isSkippableFrame(src + pos, len - pos))
+			continue;
+
+		content = ZSTD_getFrameContentSize(src + pos, len - pos);
+		if (content == ZSTD_CONTENTSIZE_UNKNOWN ||
+		    content == ZSTD_CONTENTSIZE_ERROR || content > SIZE_MAX ||
+		    out + (size_t)content < out)
+			return -EPROTONOSUPPORT;
+		if (units) {
+			units[count].src = src + pos;
+			units[count].src_len = size;
+			units[count].dst_off = out;
+			units[count].dst_len = content;
+		}
+		out += content;
+		count++;
+	}
+	*sizep = out;
+
+	return count;
+}
+
+static int zstd_start(struct par_decomp *pd, int cpu)
+{
+	pd->priv[cpu] = ZSTD_createDCtx();
+
+	return pd->priv[cpu] ? 0 : -ENOMEM;
+}
+
+static int zstd_decode(void *priv, u8 *dst, const struct par_decomp_unit *unit)
+{
+	size_t ret;
+
+	ret = ZSTD_decompressDCtx(priv, dst + unit->dst_off, unit->dst_len,
+				  unit->src, unit->src_len);
+	if (ZSTD_isError(ret) || ret != unit->dst_len)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void zstd_finish(void *priv)
+{
+	ZSTD_freeDCtx(priv);
+}
+#endif
+
+static const struct par_decomp_codec par_decomp_codecs[] = {
+#if CONFIG_IS_ENABLED(GZIP)
+	{ IH_COMP_GZIP, gzip_split, gzip_start, gzip_decode, gzip_finish },
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	{ IH_COMP_ZSTD, zstd_split, zstd_start, zstd_decode, zstd_finish },
+#endif
+};
+
+static const struct par_decomp_codec *par_decomp_codec(int comp)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(par_decomp_codecs); i++) {
+		if (par_decomp_codecs[i].comp == comp)
+			return &par_decomp_codecs[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * struct par_decomp_job - Context passed to each job
+ *
+ * @codec: Operations for the compression type
+ * @pd: State of the decompression
+ */
+struct par_decomp_job {
+	const struct par_decomp_codec *codec;
+	struct par_decomp *pd;
+};
+
+static int par_decomp_job(void *ctx, int job, int cpu)
+{
+	struct par_decomp_job *pj = ctx;
+	struct par_decomp *pd = pj->pd;
+
+	return pj->codec->decode(pd->priv[cpu], pd->dst, &pd->units[job]);
+}
+
+int par_decomp(int comp, const void *src, size_t src_len, void *dst,
+	       size_t dst_size, size_t *lenp)
+{
+	const struct par_decomp_codec *codec = par_decomp_codec(comp);
+	struct par_decomp pd = { .dst = dst };
+	struct par_decomp_job pj = { .codec = codec, .pd = &pd };
+	int count, ncpus, cpu, i, ret;
+	size_t size;
+
+	if (!codec || par_run_cpus() < 2)
+		return -EPROTONOSUPPORT;
+	count = codec->split(src, src_len, NULL, &size);
+	if (count < 2)
+		return -EPROTONOSUPPORT;
+	if (size > dst_size)
+		return -ENOSPC;
+
+	pd.units = malloc(count * sizeof(*pd.units));
+	if (!pd.units)
+		return -ENOMEM;
+	codec->split(src, src_len, pd.units, &size);
+
+	/* no job may write outside the buffer, whatever the headers claim */
+	for (i = 0; i < count; i++) {
+		if (pd.units[i].dst_off > dst_size ||
+		    pd.units[i].dst_len > dst_size - pd.units[i].dst_off) {
+			free(pd.units);
+			return -ENOSPC;
+		}
+	}
+
+	ncpus = min(par_run_cpus(), count);
+	for (cpu = 0, ret = 0; cpu < ncpus && !ret; cpu++)
+		ret = codec->start(&pd, cpu);
+	if (!ret) {
+		log_debug("%d units on %d CPUs\n", count, ncpus);
+		ret = par_run(par_decomp_job, &pj, count);
+	}
+
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		if (pd.priv[cpu])
+			codec->finish(pd.priv[cpu]);
+	}
+	free(pd.units);
+	if (ret)
+		return ret;
+	*lenp = size;
+
+	return 0;
+}
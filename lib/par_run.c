@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Running independent jobs on several CPUs at once
+ *
+ * Jobs are given out round-robin rather than through a shared queue, so
+ * the CPUs never need to synchronise with each other until the end.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <par_run.h>
+#include <linux/kernel.h>
+
+/**
+ * struct par_run_state - State shared by the CPUs running jobs
+ *
+ * @func: Function to call for each job
+ * @ctx: Context to pass to @func
+ * @count: Number of jobs
+ * @ncpus: Number of CPUs taking part
+ * @err: First error seen by each CPU
+ */
+struct par_run_state {
+	par_job_func func;
+	void *ctx;
+	int count;
+	int ncpus;
+	int err[CONFIG_PAR_RUN_MAX_CPUS];
+};
+
+static void par_run_worker(void *arg, int cpu)
+{
+	struct par_run_state *st = arg;
+	int job, ret;
+
+	for (job = cpu; job < st->count; job += st->ncpus) {
+		ret = st->func(st->ctx, job, cpu);
+		if (ret && !st->err[cpu])
+			st->err[cpu] = ret;
+	}
+}
+
+__weak int arch_par_run_cpus(void)
+{
+	return 1;
+}
+
+__weak int arch_par_run(int ncpus, void (*worker)(void *arg, int cpu),
+			void *arg)
+{
+	return -ENOTSUPP;
+}
+
+int par_run_cpus(void)
+{
+	return clamp(arch_par_run_cpus(), 1, CONFIG_PAR_RUN_MAX_CPUS);
+}
+
+int par_run(par_job_func func, void *ctx, int count)
+{
+	struct par_run_state st = {
+		.func = func,
+		.ctx = ctx,
+		.count = count,
+	};
+	int cpu, ret;
+
+	st.ncpus = min(par_run_cpus(), count);
+	if (st.ncpus > 1) {
+		ret = arch_par_run(st.ncpus, par_run_worker, &st);
+		if (ret) {
+			log_debug("Cannot start other CPUs (err=%d)\n", ret);
+			st.ncpus = 1;
+		}
+	}
+	if (st.ncpus <= 1) {
+		st.ncpus = 1;
+		par_run_worker(&st, 0);
+	}
+
+	for (cpu = 0; cpu < st.ncpus; cpu++) {
+		if (st.err[cpu])
+			return st.err[cpu];
+	}
+
+	return 0;
+}
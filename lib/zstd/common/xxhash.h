@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Map the XXH64 API used by zstd onto the xxhash implementation in lib/,
+ * instead of carrying a second copy of it. This replaces the upstream file
+ * of the same name.
+ */
+
+#ifndef XXH_ZSTD_SHIM_H
+#define XXH_ZSTD_SHIM_H
+
+#include <linux/xxhash.h>
+
+typedef struct xxh64_state XXH64_state_t;
+
+#define XXH64(input, length, seed)	xxh64((input), (length), (seed))
+#define XXH64_reset(state, seed)	xxh64_reset((state), (seed))
+#define XXH64_update(state, input, length) \
+	xxh64_update((state), (input), (length))
+#define XXH64_digest(state)		xxh64_digest((state))
+
+#endif
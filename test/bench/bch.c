@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for the software BCH encoder/decoder
+ *
+ * These use the common NAND layout of 8 correctable bits in each 512-byte
+ * sector. The word-wide encoder is compared with the byte-at-a-time path,
+ * and decoding is timed for the worst case of t errors in each sector.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/bch.h>
+#include <test/bench.h>
+#include <test/ut.h>
+
+#define BENCH_BCH_M		13
+#define BENCH_BCH_T		8
+#define BENCH_BCH_SECTOR	512
+
+/**
+ * struct bench_bch - State for the BCH benchmarks
+ *
+ * @bch: BCH control structure
+ * @data: One sector of data
+ * @ecc: ECC computed by the last call
+ * @ref: ECC of the sector without errors
+ * @errloc: Error locations found by the last decode
+ */
+struct bench_bch {
+	struct bch_control *bch;
+	u8 *data;
+	u8 ecc[BENCH_BCH_T * BENCH_BCH_M / 8 + 1];
+	u8 ref[BENCH_BCH_T * BENCH_BCH_M / 8 + 1];
+	unsigned int errloc[BENCH_BCH_T];
+};
+
+static int bench_bch_encode_bytewise(void *ctx, ulong size)
+{
+	struct bench_bch *b = ctx;
+	ulong i;
+
+	memset(b->ecc, '\0', b->bch->ecc_bytes);
+	for (i = 0; i < size; i++)
+		encode_bch(b->bch, b->data + i, 1, b->ecc);
+
+	return 0;
+}
+
+static int bench_bch_encode(void *ctx, ulong size)
+{
+	struct bench_bch *b = ctx;
+
+	memset(b->ecc, '\0', b->bch->ecc_bytes);
+	encode_bch(b->bch, b->data, size, b->ecc);
+
+	return 0;
+}
+
+static int bench_bch_decode(void *ctx, ulong size)
+{
+	struct bench_bch *b = ctx;
+
+	return decode_bch(b->bch, b->data, size, b->ref, NULL, NULL,
+			  b->errloc) == BENCH_BCH_T ? 0 : -EINVAL;
+}
+
+static int bench_bch_run(struct unit_test_state *uts, struct bench_bch *b)
+{
+	int i;
+
+	ut_assertnonnull(b->bch);
+	ut_assertnonnull(b->data);
+	bench_fill(b->data, BENCH_BCH_SECTOR);
+
+	ut_assertok(bench_run("bch", "encode-bytewise", BENCH_BCH_SECTOR,
+			      bench_bch_encode_bytewise, b));
+	memcpy(b->ref, b->ecc, b->bch->ecc_bytes);
+	ut_assertok(bench_run("bch", "encode", BENCH_BCH_SECTOR,
+			      bench_bch_encode, b));
+	ut_asserteq_mem(b->ref, b->ecc, b->bch->ecc_bytes);
+
+	/* the decoder leaves the data alone, so the errors stay put */
+	for (i = 0; i < BENCH_BCH_T; i++)
+		b->data[i * 61] ^= 1 << i;
+	ut_assertok(bench_run("bch", "decode", BENCH_BCH_SECTOR,
+			      bench_bch_decode, b));
+
+	return 0;
+}
+
+static int bench_test_bch(struct unit_test_state *uts)
+{
+	struct bench_bch b;
+	int ret;
+
+	/* free the buffers even if an assertion fails */
+	b.bch = init_bch(BENCH_BCH_M, BENCH_BCH_T, 0);
+	b.data = malloc(BENCH_BCH_SECTOR);
+	ret = bench_bch_run(uts, &b);
+	free(b.data);
+	free_bch(b.bch);
+
+	return ret;
+}
+BENCH_TEST(bench_test_bch, 0);
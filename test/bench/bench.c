@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Timing and reporting for benchmarks
+ *
+ * Results are printed one per line as key=value pairs, so that scripts can
+ * pick them out of the console output and compare runs, while the numbers
+ * remain readable by eye.
+ */
+
+#include <common.h>
+#include <cpu.h>
+#include <dm.h>
+#include <env.h>
+#include <time.h>
+#include <watchdog.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+#include <test/bench.h>
+
+static const ulong bench_sizes[] = {
+	64, SZ_1K, SZ_4K, SZ_16K, SZ_64K, SZ_256K, BENCH_MAX_SIZE
+};
+
+/*
+ * Get the CPU clock in MHz, or 0 if unknown. The 'bench_cpu_mhz' environment
+ * variable takes precedence, for boards without a CPU driver.
+ */
+static ulong bench_cpu_mhz(void)
+{
+	struct cpu_info info;
+	struct udevice *dev;
+	ulong mhz;
+
+	mhz = env_get_ulong("bench_cpu_mhz", 10, 0);
+	if (!mhz && CONFIG_IS_ENABLED(CPU) &&
+	    !uclass_first_device_err(UCLASS_CPU, &dev) &&
+	    !cpu_get_info(dev, &info))
+		mhz = info.cpu_freq / 1000000;
+
+	return mhz;
+}
+
+int bench_run(const char *group, const char *name, ulong size,
+	      bench_func func, void *ctx)
+{
+	const ulong min_us = CONFIG_UT_BENCH_TIME_MS * 1000;
+	ulong loops, i, start, us, mhz;
+	u64 bytes, cpb;
+	int ret;
+
+	for (loops = 1;; loops *= 2) {
+		start = timer_get_us();
+		for (i = 0; i < loops; i++) {
+			ret = func(ctx, size);
+			if (ret)
+				return ret;
+		}
+		us = timer_get_us() - start;
+		if (us >= min_us)
+			break;
+		WATCHDOG_RESET();
+	}
+
+	bytes = (u64)size * loops;
+	printf("bench: group=%s name=%s size=%lu loops=%lu us=%lu mbps=%lu ",
+	       group, name, size, loops, us, (ulong)div64_u64(bytes, us));
+
+	mhz = bench_cpu_mhz();
+	if (mhz) {
+		/* hundredths of a cycle */
+		cpb = div64_u64((u64)us * mhz * 100, bytes);
+		printf("cpb=%lu.%02lu\n", (ulong)cpb / 100, (ulong)cpb % 100);
+	} else {
+		printf("cpb=-\n");
+	}
+
+	return 0;
+}
+
+ulong bench_size(int seq)
+{
+	return seq < ARRAY_SIZE(bench_sizes) ? bench_sizes[seq] : 0;
+}
+
+int bench_run_sizes(const char *group, const char *name, bench_func func,
+		    void *ctx)
+{
+	ulong size;
+	int i, ret;
+
+	for (i = 0; (size = bench_size(i)); i++) {
+		ret = bench_run(group, name, size, func, ctx);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+void bench_fill(void *buf, ulong size)
+{
+	static const char *const words[] = {
+		"boot", "kernel", "image", "device", "tree", "loader",
+		"flash", "memory", "driver", "console", "network", "storage",
+		"partition", "firmware", "header", "block",
+	};
+	const char *word;
+	char *out = buf;
+	u32 seed = 1;
+	ulong pos = 0;
+
+	while (pos < size) {
+		seed = seed * 1103515245 + 12345;
+		for (word = words[(seed >> 16) & 15]; *word && pos < size;)
+			out[pos++] = *word++;
+		if (pos < size)
+			out[pos++] = (seed >> 8) & 7 ? ' ' : '\n';
+	}
+}
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for decompression, hashing, checksum and memory routines
+ */
+
+#include <common.h>
+#include <command.h>
+#include <test/bench.h>
+#include <test/suites.h>
+#include <test/ut.h>
+
+int do_ut_bench(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
+{
+	struct unit_test *tests = ll_entry_start(struct unit_test, bench_test);
+	const int n_ents = ll_entry_count(struct unit_test, bench_test);
+
+	return cmd_ut_category("bench", "bench_test_", tests, n_ents, argc,
+			       argv);
+}
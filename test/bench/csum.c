@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for CRCs and other checksums
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <net.h>
+#include <tables_csum.h>
+#include <linux/xxhash.h>
+#include <test/bench.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+#include <u-boot/zlib.h>
+
+/* Castagnoli polynomial, as used by btrfs and iSCSI */
+#define CRC32C_POLY		0x82f63b78
+
+/**
+ * struct bench_csum - State for the checksum benchmarks
+ *
+ * @buf: Data to check, BENCH_MAX_SIZE bytes
+ * @result: Result of the last call, so that it cannot be optimised away
+ * @crc32c_table: Table for crc32c_cal()
+ */
+struct bench_csum {
+	u8 *buf;
+	u64 result;
+	u32 crc32c_table[256];
+};
+
+static int bench_crc8(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = crc8(0, c->buf, size);
+
+	return 0;
+}
+
+static int bench_crc16_ccitt(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = crc16_ccitt(0, c->buf, size);
+
+	return 0;
+}
+
+static int bench_crc32(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = crc32(0, c->buf, size);
+
+	return 0;
+}
+
+static int bench_crc32c(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = crc32c_cal(~0U, (const char *)c->buf, size,
+			       c->crc32c_table);
+
+	return 0;
+}
+
+static int bench_test_crc(struct unit_test_state *uts)
+{
+	struct bench_csum c;
+
+	c.buf = malloc(BENCH_MAX_SIZE);
+	ut_assertnonnull(c.buf);
+	bench_fill(c.buf, BENCH_MAX_SIZE);
+
+	ut_assertok(bench_run_sizes("crc", "crc8", bench_crc8, &c));
+	ut_assertok(bench_run_sizes("crc", "crc16-ccitt", bench_crc16_ccitt,
+				    &c));
+	ut_assertok(bench_run_sizes("crc", "crc32", bench_crc32, &c));
+	if (IS_ENABLED(CONFIG_CRC32C)) {
+		crc32c_init(c.crc32c_table, CRC32C_POLY);
+		ut_assertok(bench_run_sizes("crc", "crc32c", bench_crc32c,
+					    &c));
+	}
+	free(c.buf);
+
+	return 0;
+}
+BENCH_TEST(bench_test_crc, 0);
+
+static int bench_ip_checksum(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = compute_ip_checksum(c->buf, size);
+
+	return 0;
+}
+
+static int bench_table_checksum(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = table_compute_checksum(c->buf, size);
+
+	return 0;
+}
+
+static int bench_adler32(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = adler32(1, c->buf, size);
+
+	return 0;
+}
+
+static int bench_xxh32(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = xxh32(c->buf, size, 0);
+
+	return 0;
+}
+
+static int bench_xxh64(void *ctx, ulong size)
+{
+	struct bench_csum *c = ctx;
+
+	c->result = xxh64(c->buf, size, 0);
+
+	return 0;
+}
+
+static int bench_test_csum(struct unit_test_state *uts)
+{
+	struct bench_csum c;
+
+	c.buf = malloc(BENCH_MAX_SIZE);
+	ut_assertnonnull(c.buf);
+	bench_fill(c.buf, BENCH_MAX_SIZE);
+
+	ut_assertok(bench_run_sizes("csum", "ip", bench_ip_checksum, &c));
+	ut_assertok(bench_run_sizes("csum", "table", bench_table_checksum,
+				    &c));
+	if (IS_ENABLED(CONFIG_ZLIB))
+		ut_assertok(bench_run_sizes("csum", "adler32", bench_adler32,
+					    &c));
+	if (IS_ENABLED(CONFIG_XXHASH)) {
+		ut_assertok(bench_run_sizes("csum", "xxh32", bench_xxh32, &c));
+		ut_assertok(bench_run_sizes("csum", "xxh64", bench_xxh64, &c));
+	}
+	free(c.buf);
+
+	return 0;
+}
+BENCH_TEST(bench_test_csum, 0);
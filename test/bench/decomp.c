@@ -0,0 +1,1036 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for the decompressors
+ *
+ * Each decompressor is timed over the same range of sizes as the other
+ * benchmarks, using data from bench_fill(), so that the cost of setting up
+ * can be told apart from the cost of streaming. The input for gzip and bzip2
+ * comes from U-Boot's own compressors. There are none for the other formats,
+ * so this file has simple greedy encoders for them: they find fewer matches
+ * than the real tools, but write the same instructions, which the
+ * decompressor must handle in the same way. Every result is checked.
+ */
+
+#include <common.h>
+#include <gzip.h>
+#include <image.h>
+#include <lz4.h>
+#include <malloc.h>
+#include <bzlib.h>
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#include <lzma/LzmaTools.h>
+#include <asm/unaligned.h>
+#include <linux/lzo.h>
+#include <linux/sizes.h>
+#include <linux/xxhash.h>
+#include <linux/zstd.h>
+#include <test/bench.h>
+#include <test/ut.h>
+
+/*
+ * Room for the compressed data. The encoders do not check for overflow, but
+ * bench_fill() data never comes close to this.
+ */
+#define BENCH_DECOMP_SPACE	(BENCH_MAX_SIZE * 2)
+
+#define BENCH_LZ_HASH_BITS	14
+#define BENCH_LZ_MIN_MATCH	4
+
+/**
+ * struct bench_lz - State for finding matches in the data to be compressed
+ *
+ * @src: Data to compress
+ * @size: Size of data in bytes
+ * @table: For each hash of four bytes, one more than the last position at
+ *	which they were seen, or 0 if none
+ */
+struct bench_lz {
+	const u8 *src;
+	ulong size;
+	u32 table[1 << BENCH_LZ_HASH_BITS];
+};
+
+/**
+ * struct bench_decomp - State for the decompression benchmarks
+ *
+ * @src: Compressed data
+ * @src_size: Size of compressed data in bytes
+ * @dst: Output buffer, BENCH_MAX_SIZE bytes
+ * @priv: Decompressor state, if needed
+ */
+struct bench_decomp {
+	u8 *src;
+	ulong src_size;
+	u8 *dst;
+	void *priv;
+};
+
+/**
+ * struct bench_algo - A compression algorithm to benchmark
+ *
+ * @name: Name of the algorithm
+ * @compress: Function to compress lz->src into @dst, setting *@sizep to the
+ *	number of bytes written. Returns 0 if OK, -ve on error
+ * @decompress: Function to time
+ */
+struct bench_algo {
+	const char *name;
+	int (*compress)(struct bench_lz *lz, u8 *dst, ulong *sizep);
+	bench_func decompress;
+};
+
+static void bench_lz_start(struct bench_lz *lz)
+{
+	memset(lz->table, '\0', sizeof(lz->table));
+}
+
+/**
+ * bench_lz_match() - Look for an earlier copy of the data at a position
+ *
+ * @lz: Match state
+ * @pos: Position to look at, with at least BENCH_LZ_MIN_MATCH bytes after it
+ * @end: Position which the match may not go beyond
+ * @max_off: Furthest back that the copy may be
+ * @offp: Returns the distance back to the copy
+ * @return length of the match, or 0 if none was found
+ */
+static ulong bench_lz_match(struct bench_lz *lz, ulong pos, ulong end,
+			    ulong max_off, ulong *offp)
+{
+	const u8 *src = lz->src;
+	ulong cand, len;
+	u32 *entry;
+
+	entry = &lz->table[(get_unaligned_le32(src + pos) * 2654435761U) >>
+			   (32 - BENCH_LZ_HASH_BITS)];
+	cand = *entry;
+	*entry = pos + 1;
+	if (!cand-- || pos - cand > max_off)
+		return 0;
+	for (len = 0; pos + len < end && src[cand + len] == src[pos + len];)
+		len++;
+	if (len < BENCH_LZ_MIN_MATCH)
+		return 0;
+	*offp = pos - cand;
+
+	return len;
+}
+
+#if defined(CONFIG_GZIP) && defined(CONFIG_GZIP_COMPRESSED)
+static int bench_gzip(struct bench_lz *lz, u8 *dst, ulong *sizep)
+{
+	*sizep = BENCH_DECOMP_SPACE;
+
+	return gzip(dst, sizep, (uchar *)lz->src, lz->size);
+}
+
+static int bench_gunzip(void *ctx, ulong size)
+{
+	struct bench_decomp *d = ctx;
+	ulong len = d->src_size;
+
+	return gunzip(d->dst, size, d->src, &len) || len != size ?
+		-EINVAL : 0;
+}
+#endif
+
+#ifdef CONFIG_BZIP2
+static int bench_bzip2(struct bench_lz *lz, u8 *dst, ulong *sizep)
+{
+	uint len = BENCH_DECOMP_SPACE;
+
+	if (BZ2_bzBuffToBuffCompress((char *)dst, &len, (char *)lz->src,
+				     lz->size, 9, 0, 0) != BZ_OK)
+		return -EINVAL;
+	*sizep = len;
+
+	return 0;
+}
+
+static int bench_bunzip2(void *ctx, ulong size)
+{
+	struct bench_decomp *d = ctx;
+	uint len = size;
+
+	return BZ2_bzBuffToBuffDecompress((char *)d->dst, &len,
+					  (char *)d->src, d->src_size, 0,
+					  0) != BZ_OK ||
+		len != size ? -EINVAL : 0;
+}
+#endif
+
+#ifdef CONFIG_LZMA
+/* Literal context bits and position bits; there are no literal pos bits */
+#define BENCH_LZMA_LC		3
+#define BENCH_LZMA_PB		2
+#define BENCH_LZMA_MAX_MATCH	273
+
+/**
+ * struct bench_lzma - State for writing an LZMA stream
+ *
+ * The probabilities follow the LZMA specification, except that there are
+ * none for repeated matches, which this encoder does not use.
+ */
+struct bench_lzma {
+	u8 *out;
+	u64 low;
+	u32 range;
+	u8 cache;
+	ulong cache_size;
+	struct {
+		u16 is_match[12][1 << BENCH_LZMA_PB];
+		u16 is_rep[12];
+		u16 choice;
+		u16 choice2;
+		u16 len_low[1 << BENCH_LZMA_PB][8];
+		u16 len_mid[1 << BENCH_LZMA_PB][8];
+		u16 len_high[256];
+		u16 slot[4][64];
+		u16 spec[114];
+		u16 align[16];
+		u16 lit[0x300 << BENCH_LZMA_LC];
+	} probs;
+};
+
+static void bench_lzma_shift(struct bench_lzma *e)
+{
+	u8 byte, carry;
+
+	if ((u32)e->low < 0xff000000 || e->low >> 32) {
+		carry = e->low >> 32;
+		for (byte = e->cache; e->cache_size--; byte = 0xff)
+			*e->out++ = byte + carry;
+		e->cache_size = 0;
+		e->cache = (u32)e->low >> 24;
+	}
+	e->cache_size++;
+	e->low = (u32)e->low << 8;
+}
+
+static void bench_lzma_bit(struct bench_lzma *e, u16 *prob, int bit)
+{
+	u32 bound = (e->range >> 11) * *prob;
+
+	if (bit) {
+		e->low += bound;
+		e->range -= bound;
+		*prob -= *prob >> 5;
+	} else {
+		e->range = bound;
+		*prob += (2048 - *prob) >> 5;
+	}
+	if (e->range < 1 << 24) {
+		e->range <<= 8;
+		bench_lzma_shift(e);
+	}
+}
+
+static void bench_lzma_direct(struct bench_lzma *e, u32 val, int bits)
+{
+	while (bits--) {
+		e->range >>= 1;
+		if (val >> bits & 1)
+			e->low += e->range;
+		if (e->range < 1 << 24) {
+			e->range <<= 8;
+			bench_lzma_shift(e);
+		}
+	}
+}
+
+/* Write @val as a bit tree, most significant bit first */
+static void bench_lzma_tree(struct bench_lzma *e, u16 *probs, int bits,
+			    u32 val)
+{
+	u32 m = 1;
+
+	while (bits--) {
+		bench_lzma_bit(e, &probs[m], val >> bits & 1);
+		m = m << 1 | (val >> bits & 1);
+	}
+}
+
+/* Write @val as a bit tree, least significant bit first */
+static void bench_lzma_rtree(struct bench_lzma *e, u16 *probs, int bits,
+			     u32 val)
+{
+	u32 m = 1;
+
+	for (; bits--; val >>= 1) {
+		bench_lzma_bit(e, &probs[m], val & 1);
+		m = m << 1 | (val & 1);
+	}
+}
+
+static void bench_lzma_literal(struct bench_lzma *e, u16 *probs, u32 sym,
+			       u32 match, bool matched)
+{
+	u32 offs = 0x100;
+
+	for (sym |= 0x100; sym < 0x10000; sym <<= 1) {
+		if (matched) {
+			match <<= 1;
+			bench_lzma_bit(e, &probs[offs + (match & offs) +
+					       (sym >> 8)], sym >> 7 & 1);
+			offs &= ~(match ^ sym << 1);
+		} else {
+			bench_lzma_bit(e, &probs[sym >> 8], sym >> 7 & 1);
+		}
+	}
+}
+
+static void bench_lzma_match(struct bench_lzma *e, int pos_state, ulong len,
+			     ulong dist)
+{
+	u32 slot, bits, base;
+
+	len -= 2;
+	if (len < 8) {
+		bench_lzma_bit(e, &e->probs.choice, 0);
+		bench_lzma_tree(e, e->probs.len_low[pos_state], 3, len);
+	} else if (len < 16) {
+		bench_lzma_bit(e, &e->probs.choice, 1);
+		bench_lzma_bit(e, &e->probs.choice2, 0);
+		bench_lzma_tree(e, e->probs.len_mid[pos_state], 3, len - 8);
+	} else {
+		bench_lzma_bit(e, &e->probs.choice, 1);
+		bench_lzma_bit(e, &e->probs.choice2, 1);
+		bench_lzma_tree(e, e->probs.len_high, 8, len - 16);
+	}
+
+	dist--;
+	bits = fls(dist) - 1;
+	slot = dist < 4 ? dist : bits << 1 | (dist >> (bits - 1) & 1);
+	bench_lzma_tree(e, e->probs.slot[min(len, 3UL)], 6, slot);
+	if (slot < 4)
+		return;
+	bits = (slot >> 1) - 1;
+	base = (2 | (slot & 1)) << bits;
+	if (slot < 14) {
+		bench_lzma_rtree(e, e->probs.spec + base - slot - 1, bits,
+				 dist - base);
+	} else {
+		bench_lzma_direct(e, (dist - base) >> 4, bits - 4);
+		bench_lzma_rtree(e, e->probs.align, 4, dist - base);
+	}
+}
+
+/* Write an LZMA stream with the uncompressed size in its header */
+static int bench_lzma(struct bench_lz *lz, u8 *dst, ulong *sizep)
+{
+	static const u8 lit_next[] = { 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 4, 5 };
+	const u8 *src = lz->src;
+	struct bench_lzma *e;
+	ulong pos, len, off, rep0 = 0;
+	int state = 0, ps, i;
+	u16 *probs;
+
+	e = malloc(sizeof(*e));
+	if (!e)
+		return -ENOMEM;
+	probs = (u16 *)&e->probs;
+	for (i = 0; i < sizeof(e->probs) / sizeof(u16); i++)
+		probs[i] = 1 << 10;
+	e->out = dst + LZMA_PROPS_SIZE + sizeof(u64);
+	e->low = 0;
+	e->range = 0xffffffff;
+	e->cache = 0;
+	e->cache_size = 1;
+
+	/* properties, dictionary size and uncompressed size */
+	dst[0] = BENCH_LZMA_PB * 5 * 9 + BENCH_LZMA_LC;
+	put_unaligned_le32(BENCH_MAX_SIZE, dst + 1);
+	put_unaligned_le64(lz->size, dst + LZMA_PROPS_SIZE);
+
+	bench_lz_start(lz);
+	for (pos = 0; pos < lz->size;) {
+		ps = pos & ((1 << BENCH_LZMA_PB) - 1);
+		len = 0;
+		if (pos + BENCH_LZ_MIN_MATCH <= lz->size)
+			len = bench_lz_match(lz, pos,
+					     min(lz->size,
+						 pos + BENCH_LZMA_MAX_MATCH),
+					     BENCH_MAX_SIZE, &off);
+		bench_lzma_bit(e, &e->probs.is_match[state][ps], !!len);
+		if (len) {
+			bench_lzma_bit(e, &e->probs.is_rep[state], 0);
+			bench_lzma_match(e, ps, len, off);
+			rep0 = off;
+			state = state < 7 ? 7 : 10;
+			pos += len;
+		} else {
+			i = pos ? src[pos - 1] >> (8 - BENCH_LZMA_LC) : 0;
+			bench_lzma_literal(e, &e->probs.lit[0x300 * i], src[pos],
+					   state < 7 ? 0 : src[pos - rep0],
+					   state >= 7);
+			state = lit_next[state];
+			pos++;
+		}
+	}
+	for (i = 0; i < 5; i++)
+		bench_lzma_shift(e);
+	*sizep = e->out - dst;
+	free(e);
+
+	return 0;
+}
+
+static int bench_unlzma(void *ctx, ulong size)
+{
+	struct bench_decomp *d = ctx;
+	SizeT len = size;
+
+	return lzmaBuffToBuffDecompress(d->dst, &len, d->src,
+					d->src_size) != SZ_OK ||
+		len != size ? -EINVAL : 0;
+}
+#endif
+
+#ifdef CONFIG_LZO
+#define BENCH_LZO_M2_MAX_LEN	8
+#define BENCH_LZO_M2_MAX_OFF	0x800
+#define BENCH_LZO_M3_MAX_LEN	33
+#define BENCH_LZO_M3_MAX_OFF	0x4000
+#define BENCH_LZO_M4_MAX_LEN	9
+#define BENCH_LZO_M4_MAX_OFF	0xbfff
+
+static u8 *bench_lzo_count(u8 *p, ulong count)
+{
+	for (; count > 255; count -= 255)
+		*p++ = 0;
+	*p++ = count;
+
+	return p;
+}
+
+/* Write @count literals, which are the first in the stream if p == @start */
+static u8 *bench_lzo_lits(u8 *p, const u8 *start, const u8 *lit, ulong count)
+{
+	if (!count)
+		return p;
+	if (p == start && count <= 238) {
+		*p++ = 17 + count;
+	} else if (count <= 3) {
+		/* these go in the bottom bits of the previous match */
+		p[-2] |= count;
+	} else if (count <= 18) {
+		*p++ = count - 3;
+	} else {
+		*p++ = 0;
+		p = bench_lzo_count(p, count - 18);
+	}
+	memcpy(p, lit, count);
+
+	return p + count;
+}
+
+static u8 *bench_lzo_match(u8 *p, ulong len, ulong off)
+{
+	if (len <= BENCH_LZO_M2_MAX_LEN && off <= BENCH_LZO_M2_MAX_OFF) {
+		off--;
+		*p++ = (len - 1) << 5 | (off & 7) << 2;
+		*p++ = off >> 3;
+		return p;
+	}
+	if (off <= BENCH_LZO_M3_MAX_OFF) {
+		off--;
+		if (len <= BENCH_LZO_M3_MAX_LEN) {
+			*p++ = 32 | (len - 2);
+		} else {
+			*p++ = 32;
+			p = bench_lzo_count(p, len - BENCH_LZO_M3_MAX_LEN);
+		}
+	} else {
+		off -= 0x4000;
+		if (len <= BENCH_LZO_M4_MAX_LEN) {
+			*p++ = 16 | (off >> 11 & 8) | (len - 2);
+		} else {
+			*p++ = 16 | (off >> 11 & 8);
+			p = bench_lzo_count(p, len - BENCH_LZO_M4_MAX_LEN);
+		}
+	}
+	*p++ = off << 2;
+	*p++ = off >> 6;
+
+	return p;
+}
+
+/* Write an LZO1X stream, without the lzop header */
+static int bench_lzo(struct bench_lz *lz, u8 *dst, ulong *sizep)
+{
+	ulong pos, lit, len, off;
+	u8 *p = dst;
+
+	bench_lz_start(lz);
+	for (pos = lit = 0; pos + BENCH_LZ_MIN_MATCH <= lz->size;) {
+		len = bench_lz_match(lz, pos, lz->size, BENCH_LZO_M4_MAX_OFF,
+				     &off);
+		if (!len) {
+			pos++;
+			continue;
+		}
+		p = bench_lzo_lits(p, dst, lz->src + lit, pos - lit);
+		p = bench_lzo_match(p, len, off);
+		pos += len;
+		lit = pos;
+	}
+	p = bench_lzo_lits(p, dst, lz->src + lit, lz->size - lit);
+
+	/* end-of-stream marker */
+	*p++ = 16 | 1;
+	*p++ = 0;
+	*p++ = 0;
+	*sizep = p - dst;
+
+	return 0;
+}
+
+static int bench_unlzo(void *ctx, ulong size)
+{
+	struct bench_decomp *d = ctx;
+	size_t len = size;
+
+	return lzo1x_decompress_safe(d->src, d->src_size, d->dst, &len) !=
+		LZO_E_OK || len != size ? -EINVAL : 0;
+}
+#endif
+
+#ifdef CONFIG_LZ4
+#define BENCH_LZ4_BLOCK		SZ_64K
+#define BENCH_LZ4_MAX_OFF	0xffff
+/* A match must start this far from the end of a block... */
+#define BENCH_LZ4_MFLIMIT	12
+/* ...and end this far from it */
+#define BENCH_LZ4_LASTLITERALS	5
+
+static u8 *bench_lz4_len(u8 *p, ulong len)
+{
+	if (len >= 15) {
+		for (len -= 15; len >= 255; len -= 255)
+			*p++ = 255;
+		*p++ = len;
+	}
+
+	return p;
+}
+
+/* Write a sequence, which is the last in the block if @len is 0 */
+static u8 *bench_lz4_seq(u8 *p, const u8 *lit, ulong count, ulong len,
+			 ulong off)
+{
+	ulong mlen = len ? len - BENCH_LZ_MIN_MATCH : 0;
+
+	*p++ = min(count, 15UL) << 4 | min(mlen, 15UL);
+	p = bench_lz4_len(p, count);
+	memcpy(p, lit, count);
+	p += count;
+	if (len) {
+		put_unaligned_le16(off, p);
+		p = bench_lz4_len(p + 2, mlen);
+	}
+
+	return p;
+}
+
+static u8 *bench_lz4_block(struct bench_lz *lz, ulong start, ulong end,
+			   u8 *p)
+{
+	ulong pos, lit, len, off;
+
+	for (pos = lit = start; pos + BENCH_LZ4_MFLIMIT <= end;) {
+		len = bench_lz_match(lz, pos, end - BENCH_LZ4_LASTLITERALS,
+				     BENCH_LZ4_MAX_OFF, &off);
+		if (!len) {
+			pos++;
+			continue;
+		}
+		p = bench_lz4_seq(p, lz->src + lit, pos - lit, len, off);
+		pos += len;
+		lit = pos;
+	}
+
+	return bench_lz4_seq(p, lz->src + lit, end - lit, 0, 0);
+}
+
+/* Write an LZ4 frame of linked 64KB blocks, without checksums */
+static int bench_lz4(struct bench_lz *lz, u8 *dst, ulong *sizep)
+{
+	ulong start, end, len;
+	u8 *p = dst;
+
+	put_unaligned_le32(LZ4F_MAGIC, p);
+	p[4] = 1 << 6;		/* version */
+	p[5] = 4 << 4;		/* 64KB blocks */
+	p[6] = xxh32(p + 4, 2, 0) >> 8;
+	p += 7;
+
+	bench_lz_start(lz);
+	for (start = 0; start < lz->size; start = end) {
+		end = min(lz->size, start + BENCH_LZ4_BLOCK);
+		len = bench_lz4_block(lz, start, end, p + 4) - (p + 4);
+		if (len >= end - start) {
+			len = end - start;
+			memcpy(p + 4, lz->src + start, len);
+			put_unaligned_le32(len | 0x80000000, p);
+		} else {
+			put_unaligned_le32(len, p);
+		}
+		p += 4 + len;
+	}
+	put_unaligned_le32(0, p);
+	*sizep = p + 4 - dst;
+
+	return 0;
+}
+
+static int bench_unlz4(void *ctx, ulong size)
+{
+	struct bench_decomp *d = ctx;
+	size_t len = size;
+
+	return ulz4fn(d->src, d->src_size, d->dst, &len) || len != size ?
+		-EINVAL : 0;
+}
+#endif
+
+#ifdef CONFIG_ZSTD
+#define BENCH_ZSTD_MAGIC	0xfd2fb528
+#define BENCH_ZSTD_BLOCK	SZ_128K
+#define BENCH_ZSTD_MAX_SEQS	(BENCH_ZSTD_BLOCK / BENCH_LZ_MIN_MATCH)
+
+/* Extra bits for each literal-length and match-length code */
+static const u8 bench_zstd_ll_bits[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+	13, 14, 15, 16
+};
+
+static const u8 bench_zstd_ml_bits[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16
+};
+
+/* The predefined distributions, used so that no tables need be written */
+static const s16 bench_zstd_ll_norm[] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1
+};
+
+static const s16 bench_zstd_ml_norm[] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1
+};
+
+static const s16 bench_zstd_of_norm[] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1
+};
+
+/**
+ * struct bench_fse - FSE encoding table for one predefined distribution
+ *
+ * @log: Log2 of the number of states
+ * @state: Next state, indexed as in the reference encoder
+ * @delta_bits: Per symbol, used to work out the number of bits to write
+ * @delta_state: Per symbol, the offset into @state
+ */
+struct bench_fse {
+	int log;
+	u16 state[64];
+	u32 delta_bits[ARRAY_SIZE(bench_zstd_ml_norm)];
+	int delta_state[ARRAY_SIZE(bench_zstd_ml_norm)];
+};
+
+/**
+ * struct bench_zstd - State for writing a zstd frame
+ *
+ * @ll: FSE table for literal lengths
+ * @ml: FSE table for match lengths
+ * @of: FSE table for offsets
+ * @seq_ll: Literal length of each sequence in the block
+ * @seq_ml: Match length of each sequence in the block
+ * @seq_of: Offset of each sequence in the block
+ */
+struct bench_zstd {
+	struct bench_fse ll, ml, of;
+	u32 seq_ll[BENCH_ZSTD_MAX_SEQS];
+	u32 seq_ml[BENCH_ZSTD_MAX_SEQS];
+	u32 seq_of[BENCH_ZSTD_MAX_SEQS];
+};
+
+/* A little-endian bit stream, read backwards by the decoder */
+struct bench_bits {
+	u8 *p;
+	u64 acc;
+	int count;
+};
+
+static void bench_bits_add(struct bench_bits *b, u32 val, int bits)
+{
+	b->acc |= (u64)(val & ((1ULL << bits) - 1)) << b->count;
+	for (b->count += bits; b->count >= 8; b->count -= 8) {
+		*b->p++ = b->acc;
+		b->acc >>= 8;
+	}
+}
+
+/* Build the encoding table in the same way as FSE_buildCTable() */
+static void bench_fse_build(struct bench_fse *ct, const s16 *norm, int count,
+			    int log)
+{
+	int size = 1 << log, step = (size >> 1) + (size >> 3) + 3;
+	int high = size - 1, pos = 0, total = 0, bits, s, i;
+	int cumul[ARRAY_SIZE(bench_zstd_ml_norm) + 1];
+	u8 symbol[64];
+
+	ct->log = log;
+	cumul[0] = 0;
+	for (s = 0; s < count; s++) {
+		if (norm[s] == -1) {
+			cumul[s + 1] = cumul[s] + 1;
+			symbol[high--] = s;
+		} else {
+			cumul[s + 1] = cumul[s] + norm[s];
+		}
+	}
+	for (s = 0; s < count; s++) {
+		for (i = 0; i < norm[s]; i++) {
+			symbol[pos] = s;
+			do {
+				pos = (pos + step) & (size - 1);
+			} while (pos > high);
+		}
+	}
+	for (i = 0; i < size; i++)
+		ct->state[cumul[symbol[i]]++] = size + i;
+	for (s = 0; s < count; s++) {
+		if (norm[s] == -1 || norm[s] == 1) {
+			ct->delta_bits[s] = (log << 16) - size;
+			ct->delta_state[s] = total - 1;
+			total++;
+		} else {
+			bits = log - (fls(norm[s] - 1) - 1);
+			ct->delta_bits[s] = (bits << 16) - (norm[s] << bits);
+			ct->delta_state[s] = total - norm[s];
+			total += norm[s];
+		}
+	}
+}
+
+static void bench_fse_start(const struct bench_fse *ct, u32 *state, int s)
+{
+	int bits = (ct->delta_bits[s] + (1 << 15)) >> 16;
+	u32 val = (bits << 16) - ct->delta_bits[s];
+
+	*state = ct->state[(val >> bits) + ct->delta_state[s]];
+}
+
+static void bench_fse_encode(struct bench_bits *b, const struct bench_fse *ct,
+			     u32 *state, int s)
+{
+	int bits = (*state + ct->delta_bits[s]) >> 16;
+
+	bench_bits_add(b, *state, bits);
+	*state = ct->state[(*state >> bits) + ct->delta_state[s]];
+}
+
+/* Find the code for @val, given the extra bits for each code */
+static int bench_zstd_code(const u8 *bits, int count, u32 base, u32 val,
+			   u32 *extra)
+{
+	int code;
+
+	for (code = 0; code < count - 1 && val >= base + (1 << bits[code]);
+	     code++)
+		base += 1 << bits[code];
+	*extra = val - base;
+
+	return code;
+}
+
+/* Write the sequences of a block, last first, as the decoder reads back */
+static u8 *bench_zstd_seqs(struct bench_zstd *z, int nseqs, u8 *p)
+{
+	struct bench_bits b = { .p = p };
+	u32 ll_state, ml_state, of_state;
+	u32 ll_extra, ml_extra, of_extra;
+	int ll, ml, of, n;
+
+	for (n = nseqs - 1; n >= 0; n--) {
+		ll = bench_zstd_code(bench_zstd_ll_bits,
+				     ARRAY_SIZE(bench_zstd_ll_bits), 0,
+				     z->seq_ll[n], &ll_extra);
+		ml = bench_zstd_code(bench_zstd_ml_bits,
+				     ARRAY_SIZE(bench_zstd_ml_bits), 3,
+				     z->seq_ml[n], &ml_extra);
+		/* offsets of 1-3 are repeat codes, so 3 is added to real ones */
+		of = fls(z->seq_of[n] + 3) - 1;
+		of_extra = z->seq_of[n] + 3 - (1 << of);
+		if (n == nseqs - 1) {
+			bench_fse_start(&z->ml, &ml_state, ml);
+			bench_fse_start(&z->of, &of_state, of);
+			bench_fse_start(&z->ll, &ll_state, ll);
+		} else {
+			bench_fse_encode(&b, &z->of, &of_state, of);
+			bench_fse_encode(&b, &z->ml, &ml_state, ml);
+			bench_fse_encode(&b, &z->ll, &ll_state, ll);
+		}
+		bench_bits_add(&b, ll_extra, bench_zstd_ll_bits[ll]);
+		bench_bits_add(&b, ml_extra, bench_zstd_ml_bits[ml]);
+		bench_bits_add(&b, of_extra, of);
+	}
+	bench_bits_add(&b, ml_state, z->ml.log);
+	bench_bits_add(&b, of_state, z->of.log);
+	bench_bits_add(&b, ll_state, z->ll.log);
+
+	/* end mark */
+	bench_bits_add(&b, 1, 1);
+	if (b.count)
+		*b.p++ = b.acc;
+
+	return b.p;
+}
+
+static u8 *bench_zstd_le24(u8 *p, u32 val)
+{
+	put_unaligned_le16(val, p);
+	p[2] = val >> 16;
+
+	return p + 3;
+}
+
+/* Write a compressed block with raw literals, or a raw block if smaller */
+static u8 *bench_zstd_block(struct bench_lz *lz, struct bench_zstd *z,
+			    ulong start, ulong end, bool last, u8 *p)
+{
+	ulong pos, lit, len, off, count;
+	u8 *hdr = p;
+	int n, i;
+
+	n = 0;
+	count = 0;
+	for (pos = lit = start; pos + BENCH_LZ_MIN_MATCH <= end;) {
+		len = bench_lz_match(lz, pos, end, pos, &off);
+		if (!len) {
+			pos++;
+			continue;
+		}
+		z->seq_ll[n] = pos - lit;
+		z->seq_ml[n] = len;
+		z->seq_of[n++] = off;
+		count += pos - lit;
+		pos += len;
+		lit = pos;
+	}
+	count += end - lit;
+
+	/* literals section */
+	p += 3;
+	if (count < 32) {
+		*p++ = count << 3;
+	} else if (count < SZ_4K) {
+		put_unaligned_le16(count << 4 | 1 << 2, p);
+		p += 2;
+	} else {
+		p = bench_zstd_le24(p, count << 4 | 3 << 2);
+	}
+	for (pos = start, i = 0; i < n; pos += z->seq_ll[i] + z->seq_ml[i],
+	     i++) {
+		memcpy(p, lz->src + pos, z->seq_ll[i]);
+		p += z->seq_ll[i];
+	}
+	memcpy(p, lz->src + pos, end - pos);
+	p += end - pos;
+
+	/* sequences section, using the predefined tables */
+	if (n < 128) {
+		*p++ = n;
+	} else if (n < 0x7f00) {
+		*p++ = (n >> 8) + 0x80;
+		*p++ = n;
+	} else {
+		*p++ = 0xff;
+		put_unaligned_le16(n - 0x7f00, p);
+		p += 2;
+	}
+	if (n) {
+		*p++ = 0;
+		p = bench_zstd_seqs(z, n, p);
+	}
+
+	len = p - hdr - 3;
+	if (len < end - start) {
+		bench_zstd_le24(hdr, len << 3 | 2 << 1 | last);
+	} else {
+		len = end - start;
+		bench_zstd_le24(hdr, len << 3 | last);
+		memcpy(hdr + 3, lz->src + start, len);
+	}
+
+	return hdr + 3 + len;
+}
+
+/* Write a single-segment zstd frame, with the content size and no checksum */
+static int bench_zstd(struct bench_lz *lz, u8 *dst, ulong *sizep)
+{
+	struct bench_zstd *z;
+	ulong start, end;
+	u8 *p = dst;
+
+	z = malloc(sizeof(*z));
+	if (!z)
+		return -ENOMEM;
+	bench_fse_build(&z->ll, bench_zstd_ll_norm,
+			ARRAY_SIZE(bench_zstd_ll_norm), 6);
+	bench_fse_build(&z->ml, bench_zstd_ml_norm,
+			ARRAY_SIZE(bench_zstd_ml_norm), 6);
+	bench_fse_build(&z->of, bench_zstd_of_norm,
+			ARRAY_SIZE(bench_zstd_of_norm), 5);
+
+	put_unaligned_le32(BENCH_ZSTD_MAGIC, p);
+	p[4] = 2 << 6 | 1 << 5;		/* 4-byte content size, single segment */
+	put_unaligned_le32(lz->size, p + 5);
+	p += 9;
+
+	bench_lz_start(lz);
+	for (start = 0; start < lz->size; start = end) {
+		end = min(lz->size, start + BENCH_ZSTD_BLOCK);
+		p = bench_zstd_block(lz, z, start, end, end == lz->size, p);
+	}
+	*sizep = p - dst;
+	free(z);
+
+	return 0;
+}
+
+static int bench_unzstd(void *ctx, ulong size)
+{
+	struct bench_decomp *d = ctx;
+	size_t len;
+
+	len = ZSTD_decompressDCtx(d->priv, d->dst, size, d->src, d->src_size);
+
+	return ZSTD_isError(len) || len != size ? -EINVAL : 0;
+}
+
+/* Input arrives in 512-byte pieces, as it would from a block device */
+static int bench_unzstd_stream(void *ctx, ulong size)
+{
+	struct bench_decomp *d = ctx;
+	ZSTD_outBuffer out = { .dst = d->dst, .size = size };
+	ZSTD_inBuffer in = { .src = d->src };
+	size_t ret;
+
+	ZSTD_DCtx_reset(d->priv, ZSTD_reset_session_only);
+	do {
+		in.size = min(in.size + 512, (size_t)d->src_size);
+		ret = ZSTD_decompressStream(d->priv, &out, &in);
+		if (ZSTD_isError(ret))
+			return -EINVAL;
+	} while (ret && in.pos < d->src_size);
+
+	return ret || out.pos != size ? -EINVAL : 0;
+}
+#endif
+
+static const struct bench_algo bench_algos[] = {
+#if defined(CONFIG_GZIP) && defined(CONFIG_GZIP_COMPRESSED)
+	{ "gzip", bench_gzip, bench_gunzip },
+#endif
+#ifdef CONFIG_BZIP2
+	{ "bzip2", bench_bzip2, bench_bunzip2 },
+#endif
+#ifdef CONFIG_LZMA
+	{ "lzma", bench_lzma, bench_unlzma },
+#endif
+#ifdef CONFIG_LZO
+	{ "lzo", bench_lzo, bench_unlzo },
+#endif
+#ifdef CONFIG_LZ4
+	{ "lz4", bench_lz4, bench_unlz4 },
+#endif
+#ifdef CONFIG_ZSTD
+	{ "zstd", bench_zstd, bench_unzstd },
+	{ "zstd-stream", bench_zstd, bench_unzstd_stream },
+#endif
+};
+
+/**
+ * bench_decomp() - Time a decompressor over each size and check its output
+ *
+ * @uts: Test state
+ * @algo: Algorithm to benchmark
+ * @lz: Match state, with lz->src holding BENCH_MAX_SIZE bytes of input
+ * @d: Decompression state, with space for the compressed data in d->src
+ * @return 0 if OK, -ve on error
+ */
+static int bench_decomp(struct unit_test_state *uts,
+			const struct bench_algo *algo, struct bench_lz *lz,
+			struct bench_decomp *d)
+{
+	ulong size;
+	int i;
+
+	for (i = 0; (size = bench_size(i)); i++) {
+		lz->size = size;
+		ut_assertok(algo->compress(lz, d->src, &d->src_size));
+		memset(d->dst, '\0', size);
+		ut_assertok(bench_run("decomp", algo->name, size,
+				      algo->decompress, d));
+		ut_asserteq_mem(lz->src, d->dst, size);
+	}
+
+	return 0;
+}
+
+static int bench_decomp_all(struct unit_test_state *uts, struct bench_lz *lz,
+			    struct bench_decomp *d)
+{
+	int i;
+
+	ut_assertnonnull(lz);
+	ut_assertnonnull(lz->src);
+	ut_assertnonnull(d->src);
+	ut_assertnonnull(d->dst);
+	bench_fill((u8 *)lz->src, BENCH_MAX_SIZE);
+	if (IS_ENABLED(CONFIG_ZSTD)) {
+		d->priv = ZSTD_createDCtx();
+		ut_assertnonnull(d->priv);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bench_algos); i++)
+		ut_assertok(bench_decomp(uts, &bench_algos[i], lz, d));
+
+	return 0;
+}
+
+static int bench_test_decomp(struct unit_test_state *uts)
+{
+	struct bench_decomp d = { };
+	struct bench_lz *lz;
+	int ret;
+
+	/* free the buffers even if an assertion fails */
+	lz = malloc(sizeof(*lz));
+	if (lz)
+		lz->src = malloc(BENCH_MAX_SIZE);
+	d.src = malloc(BENCH_DECOMP_SPACE);
+	d.dst = malloc(BENCH_MAX_SIZE);
+	ret = bench_decomp_all(uts, lz, &d);
+	if (IS_ENABLED(CONFIG_ZSTD))
+		ZSTD_freeDCtx(d.priv);
+	free(d.dst);
+	free(d.src);
+	if (lz)
+		free((u8 *)lz->src);
+	free(lz);
+
+	return ret;
+}
+BENCH_TEST(bench_test_decomp, 0);
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for the hash algorithms
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <test/bench.h>
+#include <test/ut.h>
+#include <u-boot/md5.h>
+
+/**
+ * struct bench_hash - State for the hash benchmarks
+ *
+ * @algo: Algorithm being timed from the hash table
+ * @buf: Data to hash, BENCH_MAX_SIZE bytes
+ * @digest: Result of the last call
+ */
+struct bench_hash {
+	struct hash_algo *algo;
+	u8 *buf;
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+};
+
+static int bench_hash_algo(void *ctx, ulong size)
+{
+	struct bench_hash *h = ctx;
+
+	h->algo->hash_func_ws(h->buf, size, h->digest, h->algo->chunk_size);
+
+	return 0;
+}
+
+static int bench_md5(void *ctx, ulong size)
+{
+	struct bench_hash *h = ctx;
+
+	md5_wd(h->buf, size, h->digest, CHUNKSZ_MD5);
+
+	return 0;
+}
+
+/* Time each algorithm in the hash table, plus MD5 */
+static int bench_test_hash(struct unit_test_state *uts)
+{
+	struct bench_hash h;
+	int i;
+
+	h.buf = malloc(BENCH_MAX_SIZE);
+	ut_assertnonnull(h.buf);
+	bench_fill(h.buf, BENCH_MAX_SIZE);
+
+	for (i = 0; !hash_get_algo(i, &h.algo); i++)
+		ut_assertok(bench_run_sizes("hash", h.algo->name,
+					    bench_hash_algo, &h));
+	ut_assert(i > 0);
+
+	if (IS_ENABLED(CONFIG_MD5))
+		ut_assertok(bench_run_sizes("hash", "md5", bench_md5, &h));
+	free(h.buf);
+
+	return 0;
+}
+BENCH_TEST(bench_test_hash, 0);
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for memory routines
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <test/bench.h>
+#include <test/ut.h>
+
+/* Distance by which memmove() shifts the buffer, forcing a backwards copy */
+#define BENCH_MOVE_SHIFT	64
+
+/**
+ * struct bench_mem - Buffers for the memory benchmarks
+ *
+ * @src: Source buffer of BENCH_MAX_SIZE bytes
+ * @dst: Destination buffer, BENCH_MOVE_SHIFT bytes larger
+ */
+struct bench_mem {
+	u8 *src;
+	u8 *dst;
+};
+
+static int bench_memcpy(void *ctx, ulong size)
+{
+	struct bench_mem *m = ctx;
+
+	memcpy(m->dst, m->src, size);
+
+	return 0;
+}
+
+static int bench_memmove(void *ctx, ulong size)
+{
+	struct bench_mem *m = ctx;
+
+	memmove(m->dst + BENCH_MOVE_SHIFT, m->dst, size);
+
+	return 0;
+}
+
+static int bench_memset(void *ctx, ulong size)
+{
+	struct bench_mem *m = ctx;
+
+	memset(m->dst, 0x5a, size);
+
+	return 0;
+}
+
+static int bench_memcmp(void *ctx, ulong size)
+{
+	struct bench_mem *m = ctx;
+
+	return memcmp(m->dst, m->src, size) ? -EINVAL : 0;
+}
+
+static int bench_test_mem(struct unit_test_state *uts)
+{
+	struct bench_mem m;
+
+	m.src = malloc(BENCH_MAX_SIZE);
+	m.dst = malloc(BENCH_MAX_SIZE + BENCH_MOVE_SHIFT);
+	ut_assertnonnull(m.src);
+	ut_assertnonnull(m.dst);
+	bench_fill(m.src, BENCH_MAX_SIZE);
+
+	ut_assertok(bench_run_sizes("mem", "memcpy", bench_memcpy, &m));
+	ut_asserteq_mem(m.src, m.dst, BENCH_MAX_SIZE);
+
+	/* the buffers are the same, so every byte is compared */
+	ut_assertok(bench_run_sizes("mem", "memcmp", bench_memcmp, &m));
+	ut_assertok(bench_run_sizes("mem", "memmove", bench_memmove, &m));
+	ut_assertok(bench_run_sizes("mem", "memset", bench_memset, &m));
+
+	free(m.dst);
+	free(m.src);
+
+	return 0;
+}
+BENCH_TEST(bench_test_mem, 0);
@@ -6,13 +6,16 @@
 #include <common.h>
 #include <bootm.h>
 #include <command.h>
+#include <decomp_stream.h>
 #include <gzip.h>
 #include <image.h>
 #include <log.h>
 #include <lz4.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <par_decomp.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 
 #include <u-boot/zlib.h>
 #include <bzlib.h>
@@ -22,6 +25,8 @@
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <linux/xxhash.h>
+#include <linux/zstd.h>
 #include <test/compression.h>
 #include <test/suites.h>
 #include <test/ut.h>
@@ -121,6 +126,23 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/* zstd -19 /tmp/plain.txt -o /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -536,6 +558,589 @@ static int compression_test_bootm_none(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+#ifdef CONFIG_ZSTD
+/* The zstd dictionary test uses plain[] itself as a raw-content dictionary */
+static const char zstd_dict_msg[] =
+	"There are many like me, but this one is yours.\n"
+	"I am a highly compressable bit of text, if I were any shorter.\n";
+
+/* zstd -19 --no-dictID -D /tmp/plain.txt /tmp/msg.txt -o /tmp/msg.zst */
+static const char zstd_dict_compressed[] =
+	"\x28\xb5\x2f\xfd\x24\x6e\xbd\x00\x00\x58\x54\x79\x6f\x75\x72\x73"
+	"\x2c\x20\x69\x2e\x0a\x03\x00\x12\x4b\x8f\x40\x5b\xaa\x74\x69\xd8"
+	"\x04\x89\x1d\x2e";
+static const unsigned long zstd_dict_compressed_size = 36;
+
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	const size_t len = strlen(plain);
+	char buf[TEST_BUFFER_SIZE];
+	ZSTD_DStream *dstream;
+	ZSTD_outBuffer out;
+	ZSTD_inBuffer in;
+	size_t ret;
+	int i;
+
+	/* one-shot, with exactly the right size and one byte short */
+	memset(buf, 'A', sizeof(buf));
+	ret = ZSTD_decompress(buf, len, zstd_compressed, zstd_compressed_size);
+	ut_asserteq(len, ret);
+	ut_asserteq_mem(plain, buf, len);
+	ut_asserteq('A', buf[len]);
+	ret = ZSTD_decompress(buf, len - 1, zstd_compressed,
+			      zstd_compressed_size);
+	ut_assert(ZSTD_isError(ret));
+	ut_asserteq(ZSTD_error_dstSize_tooSmall, ZSTD_getErrorCode(ret));
+
+	/* streaming, one byte of input and up to 7 bytes of output at a time */
+	dstream = ZSTD_createDStream();
+	ut_assertnonnull(dstream);
+	ut_assert(!ZSTD_isError(ZSTD_initDStream(dstream)));
+	memset(buf, 'A', sizeof(buf));
+	in.src = zstd_compressed;
+	in.size = 0;
+	in.pos = 0;
+	out.dst = buf;
+	out.size = 0;
+	out.pos = 0;
+	ret = 1;
+	for (i = 0; ret && i < 2 * TEST_BUFFER_SIZE; i++) {
+		if (in.pos == in.size && in.size < zstd_compressed_size)
+			in.size++;
+		out.size = min(out.pos + 7, len);
+		ret = ZSTD_decompressStream(dstream, &out, &in);
+		ut_assert(!ZSTD_isError(ret));
+	}
+	ut_asserteq(0, ret);
+	ut_asserteq(zstd_compressed_size, in.pos);
+	ut_asserteq(len, out.pos);
+	ut_asserteq_mem(plain, buf, len);
+	ut_asserteq('A', buf[len]);
+	ZSTD_freeDStream(dstream);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+
+static int compression_test_zstd_dict(struct unit_test_state *uts)
+{
+	const size_t len = strlen(zstd_dict_msg);
+	char buf[TEST_BUFFER_SIZE];
+	ZSTD_outBuffer out;
+	ZSTD_inBuffer in;
+	ZSTD_DDict *ddict;
+	ZSTD_DCtx *dctx;
+	size_t ret;
+
+	dctx = ZSTD_createDCtx();
+	ut_assertnonnull(dctx);
+
+	/* the matches reach back into the dictionary */
+	ret = ZSTD_decompressDCtx(dctx, buf, sizeof(buf), zstd_dict_compressed,
+				  zstd_dict_compressed_size);
+	ut_assert(ZSTD_isError(ret));
+
+	ret = ZSTD_decompress_usingDict(dctx, buf, sizeof(buf),
+					zstd_dict_compressed,
+					zstd_dict_compressed_size, plain,
+					strlen(plain));
+	ut_asserteq(len, ret);
+	ut_asserteq_mem(zstd_dict_msg, buf, len);
+
+	/* a digested dictionary, referenced by a stream */
+	ddict = ZSTD_createDDict(plain, strlen(plain));
+	ut_assertnonnull(ddict);
+	ut_assert(!ZSTD_isError(ZSTD_DCtx_refDDict(dctx, ddict)));
+	memset(buf, '\0', sizeof(buf));
+	in.src = zstd_dict_compressed;
+	in.size = zstd_dict_compressed_size;
+	in.pos = 0;
+	out.dst = buf;
+	out.size = sizeof(buf);
+	out.pos = 0;
+	ut_asserteq(0, ZSTD_decompressStream(dctx, &out, &in));
+	ut_asserteq(len, out.pos);
+	ut_asserteq_mem(zstd_dict_msg, buf, len);
+
+	ZSTD_freeDDict(ddict);
+	ZSTD_freeDCtx(dctx);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd_dict, 0);
+#endif
+
+#ifdef CONFIG_DECOMP_STREAM
+/* Data after the end of a compressed stream, which must be ignored */
+static const char stream_trailer[] = "\x12\x34\x56\x78 trailing junk";
+
+/**
+ * run_stream() - Decompress data by feeding it to a stream in chunks
+ *
+ * @comp:	Compression type
+ * @src:	Compressed data
+ * @src_size:	Size of compressed data
+ * @dst:	Destination buffer
+ * @dst_size:	Size of destination buffer
+ * @chunk:	Number of bytes to pass in each call
+ * @out_size:	Returns number of bytes written to @dst
+ * @return 0 if OK, else the first error from the stream
+ */
+static int run_stream(int comp, const char *src, ulong src_size, void *dst,
+		      ulong dst_size, ulong chunk, ulong *out_size)
+{
+	struct decomp_stream ds;
+	ulong pos, len;
+	int ret, err;
+
+	ret = decomp_stream_start(&ds, comp, dst, dst_size);
+	if (ret)
+		return ret;
+	for (pos = 0; !ret && pos < src_size; pos += len) {
+		len = min(chunk, src_size - pos);
+		ret = decomp_stream_write(&ds, src + pos, len);
+	}
+	err = decomp_stream_finish(&ds);
+	*out_size = ds.out;
+
+	return ret ? ret : err;
+}
+
+static int run_stream_test(struct unit_test_state *uts, int comp,
+			   const char *src, ulong src_size)
+{
+	static const ulong chunks[] = { 1, 3, 64, TEST_BUFFER_SIZE };
+	const ulong size = strlen(plain);
+	ulong out_size;
+	char *buf, *in;
+	int i;
+
+	ut_assert(decomp_stream_supported(comp));
+	buf = malloc(TEST_BUFFER_SIZE);
+	ut_assertnonnull(buf);
+	in = malloc(src_size + sizeof(stream_trailer));
+	ut_assertnonnull(in);
+	memcpy(in, src, src_size);
+	memcpy(in + src_size, stream_trailer, sizeof(stream_trailer));
+
+	for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+		/* Exactly the right size output buffer */
+		memset(buf, 'A', TEST_BUFFER_SIZE);
+		ut_assertok(run_stream(comp, in, src_size, buf, size,
+				       chunks[i], &out_size));
+		ut_asserteq(size, out_size);
+		ut_asserteq_mem(plain, buf, size);
+		ut_asserteq('A', buf[size]);
+
+		/* Trailing data is ignored */
+		memset(buf, 'A', TEST_BUFFER_SIZE);
+		ut_assertok(run_stream(comp, in,
+				       src_size + sizeof(stream_trailer), buf,
+				       TEST_BUFFER_SIZE, chunks[i], &out_size));
+		ut_asserteq(size, out_size);
+		ut_asserteq_mem(plain, buf, size);
+
+		/* Output buffer too small, which must not be overrun */
+		memset(buf, 'A', TEST_BUFFER_SIZE);
+		ut_asserteq(-ENOSPC, run_stream(comp, in, src_size, buf,
+						size - 1, chunks[i],
+						&out_size));
+		ut_asserteq('A', buf[size - 1]);
+
+		/* Truncated input */
+		ut_asserteq(-EIO, run_stream(comp, in, src_size - 5, buf,
+					     TEST_BUFFER_SIZE, chunks[i],
+					     &out_size));
+	}
+
+	free(in);
+	free(buf);
+
+	return 0;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	ulong size = TEST_BUFFER_SIZE;
+	char *buf;
+	int ret;
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	ut_assertok(compress_using_gzip(uts, (void *)plain, strlen(plain),
+					buf, size, &size));
+	ret = run_stream_test(uts, IH_COMP_GZIP, buf, size);
+	free(buf);
+
+	return ret;
+}
+COMPRESSION_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_lzma(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZMA, lzma_compressed,
+			       lzma_compressed_size);
+}
+COMPRESSION_TEST(compression_test_stream_lzma, 0);
+
+static int compression_test_stream_lz4(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZ4, lz4_compressed,
+			       lz4_compressed_size);
+}
+COMPRESSION_TEST(compression_test_stream_lz4, 0);
+
+static int compression_test_stream_zstd(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_ZSTD, zstd_compressed,
+			       zstd_compressed_size);
+}
+COMPRESSION_TEST(compression_test_stream_zstd, 0);
+#endif
+
+#ifdef CONFIG_PAR_DECOMP
+/* bgzip -c /tmp/plain.txt, without the end-of-file block */
+static const char bgzf_compressed[] =
+	"\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00"
+	"\xd4\x00\xad\x8f\x3b\x6e\xc4\x30\x0c\x44\x7b\x9d\x62\xba\x6d\x0c"
+	"\xdf\x21\xa5\xfb\x5c\x80\x76\x68\x8b\x88\x7e\x90\xe8\x68\xbd\xa7"
+	"\x5f\xca\xc0\xde\x20\x05\x21\x92\x98\x79\xd4\x2c\xa0\x08\x82\x97"
+	"\xc3\x87\x0b\x5b\x8e\xa5\x72\x6b\xb4\x06\xc6\x2a\x8a\xbc\x43\xf9"
+	"\xa9\xb3\x5b\xfe\x59\xf7\xed\xb9\x32\xc8\x2a\x52\xba\x10\xe4\xd7"
+	"\x3a\x9e\xb0\x9e\x0a\xf5\xd2\x90\x13\xc3\x9e\x28\x89\x8d\xba\x63"
+	"\x41\xbf\x1d\x26\x6e\x3e\x57\xe5\x3a\x99\x70\xac\x7a\x3e\xc3\x4f"
+	"\x7a\x28\x56\x43\x9c\x9b\x47\xe3\xd4\xcc\x9c\xdc\xe7\xbc\xa4\xc3"
+	"\xe0\xb6\x19\x0e\xec\x52\x9b\xa2\x04\xda\x78\xc6\x97\x22\x30\xd9"
+	"\xdc\x45\x3d\xc2\x2b\x4f\xe3\x44\xa7\x6b\x72\xdd\x8b\xc1\xa8\x14"
+	"\xa6\xda\xa0\xd9\xf8\x9e\xfe\x18\x25\xe7\x6a\xd9\x3e\x34\xc3\x8c"
+	"\x58\xf7\xa7\xee\x70\x2e\x8e\xc4\x07\xb7\xd9\xbd\x01\x16\xe9\x08"
+	"\xcd\x5e\x01\x00\x00";
+static const unsigned long bgzf_compressed_size = 213;
+
+/* The empty block which ends a BGZF file */
+static const char bgzf_eof[] =
+	"\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00"
+	"\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+static const unsigned long bgzf_eof_size = 28;
+
+/* A skippable zstd frame with four bytes of content */
+static const char zstd_skippable[] = "\x50\x2a\x4d\x18\x04\x00\x00\x00junk";
+static const unsigned long zstd_skippable_size = 12;
+
+/* Number of copies of the compressed text which make up the test image */
+#define PAR_TEST_UNITS		7
+
+static int run_par_test(struct unit_test_state *uts, int comp,
+			const char *unit, ulong unit_size, const char *tail,
+			ulong tail_size)
+{
+	const ulong len = strlen(plain);
+	const ulong size = PAR_TEST_UNITS * len;
+	const ulong src_size = PAR_TEST_UNITS * unit_size + tail_size;
+	ulong load_end;
+	char *src, *dst;
+	size_t out;
+	int i;
+
+	src = malloc(src_size);
+	dst = malloc(size + 1);
+	ut_assertnonnull(src);
+	ut_assertnonnull(dst);
+	for (i = 0; i < PAR_TEST_UNITS; i++)
+		memcpy(src + i * unit_size, unit, unit_size);
+	memcpy(src + PAR_TEST_UNITS * unit_size, tail, tail_size);
+
+	memset(dst, 'A', size + 1);
+	ut_assertok(par_decomp(comp, src, src_size, dst, size, &out));
+	ut_asserteq(size, out);
+	for (i = 0; i < PAR_TEST_UNITS; i++)
+		ut_asserteq_mem(plain, dst + i * len, len);
+	ut_asserteq('A', dst[size]);
+
+	/* image_decomp() takes the same path */
+	memset(dst, 'A', size + 1);
+	ut_assertok(image_decomp(comp, 0, 1, IH_TYPE_KERNEL, dst, src,
+				 src_size, size, &load_end));
+	ut_asserteq(size, load_end);
+	for (i = 0; i < PAR_TEST_UNITS; i++)
+		ut_asserteq_mem(plain, dst + i * len, len);
+
+	ut_asserteq(-ENOSPC, par_decomp(comp, src, src_size, dst, size - 1,
+					&out));
+
+	/* a single unit is left to the usual decompressor */
+	ut_asserteq(-EPROTONOSUPPORT, par_decomp(comp, src, unit_size, dst,
+						 size, &out));
+
+	/* damage in one unit is noticed */
+	src[3 * unit_size + unit_size / 2] ^= 0x55;
+	ut_asserteq(-EINVAL, par_decomp(comp, src, src_size, dst, size, &out));
+
+	free(dst);
+	free(src);
+
+	return 0;
+}
+
+static int compression_test_par_gzip(struct unit_test_state *uts)
+{
+	return run_par_test(uts, IH_COMP_GZIP, bgzf_compressed,
+			    bgzf_compressed_size, bgzf_eof, bgzf_eof_size);
+}
+COMPRESSION_TEST(compression_test_par_gzip, 0);
+
+/* Two empty zstd frames which each claim 2^63 bytes of content */
+static const char zstd_huge[] =
+	"\x28\xb5\x2f\xfd\xe0\x00\x00\x00\x00\x00\x00\x00\x80\x01\x00\x00"
+	"\x28\xb5\x2f\xfd\xe0\x00\x00\x00\x00\x00\x00\x00\x80\x01\x00\x00";
+static const unsigned long zstd_huge_size = 32;
+
+static int compression_test_par_zstd(struct unit_test_state *uts)
+{
+	char buf[TEST_BUFFER_SIZE];
+	size_t out;
+
+	ut_assertok(run_par_test(uts, IH_COMP_ZSTD, zstd_compressed,
+				 zstd_compressed_size, zstd_skippable,
+				 zstd_skippable_size));
+
+	/* a total size which wraps around is not trusted */
+	ut_asserteq(-EPROTONOSUPPORT, par_decomp(IH_COMP_ZSTD, zstd_huge,
+						 zstd_huge_size, buf,
+						 sizeof(buf), &out));
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_par_zstd, 0);
+#endif
+
+#ifdef CONFIG_LZ4_CHECKSUM
+/* The text repeated to fill a 64KB block, as a raw LZ4 block */
+static const char lz4_block_compressed[] =
+	"\xff\x19\x49\x20\x61\x6d\x20\x61\x20\x68\x69\x67\x68\x6c\x79\x20"
+	"\x63\x6f\x6d\x70\x72\x65\x73\x73\x61\x62\x6c\x65\x20\x62\x69\x74"
+	"\x20\x6f\x66\x20\x74\x65\x78\x74\x2e\x0a\x28\x00\x3d\xf1\x25\x54"
+	"\x68\x65\x72\x65\x20\x61\x72\x65\x20\x6d\x61\x6e\x79\x20\x6c\x69"
+	"\x6b\x65\x20\x6d\x65\x2c\x20\x62\x75\x74\x20\x74\x68\x69\x73\x20"
+	"\x6f\x6e\x65\x20\x69\x73\x20\x6d\x69\x6e\x65\x2e\x0a\x49\x66\x20"
+	"\x49\x20\x77\x32\x00\xd1\x6e\x79\x20\x73\x68\x6f\x72\x74\x65\x72"
+	"\x2c\x20\x74\x45\x00\xf4\x0b\x77\x6f\x75\x6c\x64\x6e\x27\x74\x20"
+	"\x62\x65\x20\x6d\x75\x63\x68\x20\x73\x65\x6e\x73\x65\x20\x69\x6e"
+	"\x0a\x7f\x00\x50\x69\x6e\x67\x20\x6d\x12\x00\x00\x32\x00\xf0\x11"
+	"\x20\x66\x69\x72\x73\x74\x20\x70\x6c\x61\x63\x65\x2e\x20\x41\x74"
+	"\x20\x6c\x65\x61\x73\x74\x20\x77\x69\x74\x68\x20\x6c\x7a\x6f\x2c"
+	"\x63\x00\xf5\x14\x77\x61\x79\x2c\x0a\x77\x68\x69\x63\x68\x20\x61"
+	"\x70\x70\x65\x61\x72\x73\x20\x74\x6f\x20\x62\x65\x68\x61\x76\x65"
+	"\x20\x70\x6f\x6f\x72\x6c\x79\x4e\x00\x30\x61\x63\x65\xd7\x00\x01"
+	"\x95\x00\x01\xdd\x00\x20\x0a\x6d\xf2\x00\x5f\x67\x65\x73\x2e\x0a"
+	"\x5e\x01\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+	"\xff\x89\x50\x20\x61\x6d\x20\x61";
+static const unsigned long lz4_block_compressed_size = 520;
+
+#define LZ4_TEST_BLOCK_SIZE	0x10000
+
+/**
+ * lz4_build_frame() - Put together an LZ4 frame with all checksums present
+ *
+ * @dst:	Buffer for the frame
+ * @blocks:	Type of each block in turn: 'c' for lz4_block_compressed, which
+ *		fills a whole block, or 'u' for an uncompressed copy of the text
+ * @ref:	Returns the content of the frame
+ * @ref_size:	Returns the size of the content
+ * @return size of the frame
+ */
+static ulong lz4_build_frame(u8 *dst, const char *blocks, char *ref,
+			     ulong *ref_size)
+{
+	const ulong len = strlen(plain);
+	ulong out = 0, i;
+	u8 *p = dst;
+	u32 size;
+
+	put_unaligned_le32(LZ4F_MAGIC, p);
+	p[4] = 0x74;	/* version 1, independent blocks, both checksums */
+	p[5] = 0x40;	/* 64KB blocks */
+	p[6] = xxh32(p + 4, 2, 0) >> 8;
+	p += 7;
+
+	for (; *blocks; blocks++) {
+		if (*blocks == 'c') {
+			size = lz4_block_compressed_size;
+			put_unaligned_le32(size, p);
+			memcpy(p + 4, lz4_block_compressed, size);
+			for (i = 0; i < LZ4_TEST_BLOCK_SIZE; i++)
+				ref[out + i] = plain[i % len];
+			out += LZ4_TEST_BLOCK_SIZE;
+		} else {
+			size = len;
+			put_unaligned_le32(size | 0x80000000, p);
+			memcpy(p + 4, plain, len);
+			memcpy(ref + out, plain, len);
+			out += len;
+		}
+		put_unaligned_le32(xxh32(p + 4, size, 0), p + 4 + size);
+		p += 8 + size;
+	}
+
+	put_unaligned_le32(0, p);
+	put_unaligned_le32(xxh32(ref, out, 0), p + 4);
+	*ref_size = out;
+
+	return p + 8 - dst;
+}
+
+/* Decode @src in chunks of @chunk bytes */
+static int lz4_stream_chunks(const u8 *src, ulong src_size, void *dst,
+			     ulong dst_size, ulong chunk)
+{
+	struct lz4_stream s;
+	ulong pos, len;
+	int ret = 0, err;
+
+	lz4_stream_init(&s, dst, dst_size);
+	for (pos = 0; !ret && pos < src_size; pos += len) {
+		len = min(chunk, src_size - pos);
+		ret = lz4_stream_decode(&s, src + pos, len);
+	}
+
+	err = lz4_stream_end(&s);
+
+	return ret ? ret : err;
+}
+
+static int compression_test_lz4_csum(struct unit_test_state *uts)
+{
+	static const ulong chunks[] = { 1, 7, 0x20000 };
+	ulong frame_size, ref_size, csums[3];
+	char *ref, *buf;
+	size_t size;
+	u8 *frame;
+	int i, j;
+
+	frame = malloc(0x1000);
+	ref = malloc(2 * LZ4_TEST_BLOCK_SIZE);
+	buf = malloc(2 * LZ4_TEST_BLOCK_SIZE);
+	ut_assertnonnull(frame);
+	ut_assertnonnull(ref);
+	ut_assertnonnull(buf);
+	frame_size = lz4_build_frame(frame, "cu", ref, &ref_size);
+
+	for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+		memset(buf, '\0', ref_size);
+		ut_assertok(lz4_stream_chunks(frame, frame_size, buf, ref_size,
+					      chunks[i]));
+		ut_asserteq_mem(ref, buf, ref_size);
+	}
+
+	/* header, block and content checksums in turn */
+	csums[0] = 6;
+	csums[1] = 11 + lz4_block_compressed_size;
+	csums[2] = frame_size - 1;
+	for (j = 0; j < ARRAY_SIZE(csums); j++) {
+		frame[csums[j]] ^= 0x10;
+		size = ref_size;
+		ut_asserteq(-EBADMSG, ulz4fn(frame, frame_size, buf, &size));
+		for (i = 0; i < ARRAY_SIZE(chunks); i++)
+			ut_asserteq(-EBADMSG,
+				    lz4_stream_chunks(frame, frame_size, buf,
+						      ref_size, chunks[i]));
+		frame[csums[j]] ^= 0x10;
+	}
+
+	/* the content checksum written by the lz4 tool */
+	memcpy(frame, lz4_compressed, lz4_compressed_size);
+	frame[lz4_compressed_size - 2] ^= 1;
+	size = TEST_BUFFER_SIZE;
+	ut_asserteq(-EBADMSG, ulz4fn(frame, lz4_compressed_size, buf, &size));
+
+	free(buf);
+	free(ref);
+	free(frame);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_lz4_csum, 0);
+
+#ifdef CONFIG_PAR_DECOMP
+static int compression_test_lz4_par(struct unit_test_state *uts)
+{
+	const ulong max_size = 6 * LZ4_TEST_BLOCK_SIZE;
+	ulong frame_size, ref_size, load_end;
+	char *ref, *buf;
+	size_t size;
+	u8 *frame;
+
+	frame = malloc(0x2000);
+	ref = malloc(max_size);
+	buf = malloc(max_size);
+	ut_assertnonnull(frame);
+	ut_assertnonnull(ref);
+	ut_assertnonnull(buf);
+
+	frame_size = lz4_build_frame(frame, "ccccu", ref, &ref_size);
+	memset(buf, 'A', max_size);
+	size = ref_size;
+	ut_assertok(ulz4fn(frame, frame_size, buf, &size));
+	ut_asserteq(ref_size, size);
+	ut_asserteq_mem(ref, buf, ref_size);
+	ut_asserteq('A', buf[ref_size]);
+
+	memset(buf, '\0', max_size);
+	ut_assertok(image_decomp(IH_COMP_LZ4, 0, 1, IH_TYPE_KERNEL, buf,
+				 frame, frame_size, max_size, &load_end));
+	ut_asserteq(ref_size, load_end);
+	ut_asserteq_mem(ref, buf, ref_size);
+
+	size = ref_size - 1;
+	ut_asserteq(-ENOBUFS, ulz4fn(frame, frame_size, buf, &size));
+
+	/* damage in one block is noticed by its checksum */
+	frame[7 + 3 * (8 + lz4_block_compressed_size) + 100] ^= 0x55;
+	size = max_size;
+	ut_asserteq(-EBADMSG, ulz4fn(frame, frame_size, buf, &size));
+
+	/* a short block which is not the last is left to the usual path */
+	frame_size = lz4_build_frame(frame, "ccucc", ref, &ref_size);
+	memset(buf, '\0', max_size);
+	size = max_size;
+	ut_assertok(ulz4fn(frame, frame_size, buf, &size));
+	ut_asserteq(ref_size, size);
+	ut_asserteq_mem(ref, buf, ref_size);
+
+	/* in-place, with the frame at the end of the output buffer */
+	memset(buf, '\0', max_size);
+	memcpy(buf + max_size - frame_size, frame, frame_size);
+	size = max_size;
+	ut_assertok(ulz4fn(buf + max_size - frame_size, frame_size, buf,
+			   &size));
+	ut_asserteq(ref_size, size);
+	ut_asserteq_mem(ref, buf, ref_size);
+
+	free(buf);
+	free(ref);
+	free(frame);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_lz4_par, 0);
+#endif
+#endif
+
 int do_ut_compression(struct cmd_tbl *cmdtp, int flag, int argc,
 		      char *const argv[])
 {
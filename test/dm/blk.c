@@ -5,7 +5,9 @@
 
 #include <common.h>
 #include <dm.h>
+#include <os.h>
 #include <part.h>
+#include <sandboxblockdev.h>
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
@@ -162,3 +164,144 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#define ASYNC_REQS	4
+
+static void blk_async_complete(struct blk_req *req)
+{
+	int *order = req->priv;
+
+	*order = (*order << 4) | (req->start + 1);
+}
+
+/* Test asynchronous requests, queued by the driver or carried out at once */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	const char *fname = "blk_async.img";
+	struct blk_req reqs[ASYNC_REQS], req;
+	u8 buf[ASYNC_REQS][512], rbuf[512];
+	struct blk_desc *desc;
+	struct udevice *dev;
+	int i, fd, order = 0;
+
+	memset(buf, '\0', sizeof(buf));
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(buf), os_write(fd, buf, sizeof(buf)));
+	os_close(fd);
+	ut_assertok(host_dev_bind(0, (char *)fname));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+
+	/* The sandbox host driver queues requests until it is polled */
+	for (i = 0; i < ASYNC_REQS; i++) {
+		memset(buf[i], 0x10 + i, 512);
+		reqs[i].complete = blk_async_complete;
+		reqs[i].priv = &order;
+		ut_assertok(blk_dwrite_async(desc, i, 1, buf[i], &reqs[i]));
+		ut_assert(!reqs[i].done);
+	}
+	ut_asserteq(ASYNC_REQS - 1, blk_poll(desc));
+	ut_assert(reqs[0].done);
+	ut_assert(!reqs[1].done);
+
+	/* Waiting for the last request finishes all of them, in order */
+	ut_asserteq(1, blk_wait(desc, &reqs[ASYNC_REQS - 1]));
+	ut_asserteq(0x1234, order);
+	for (i = 0; i < ASYNC_REQS; i++) {
+		ut_assertok(reqs[i].status);
+		ut_asserteq(1, reqs[i].actual);
+	}
+
+	/* Read back, both asynchronously and synchronously */
+	memset(rbuf, '\0', sizeof(rbuf));
+	req.complete = NULL;
+	ut_assertok(blk_dread_async(desc, 2, 1, rbuf, &req));
+	ut_asserteq(1, blk_wait(desc, &req));
+	ut_asserteq_mem(buf[2], rbuf, 512);
+	ut_asserteq(1, blk_dread(desc, 3, 1, rbuf));
+	ut_asserteq_mem(buf[3], rbuf, 512);
+
+	/* Requests past the end of the device fail */
+	ut_assertok(blk_dread_async(desc, ASYNC_REQS, 1, rbuf, &req));
+	ut_asserteq(-EIO, blk_wait(desc, &req));
+
+	/*
+	 * A read queued before a write to the same block finishes first and
+	 * caches the old data, which the write must drop again
+	 */
+	blkcache_invalidate(IF_TYPE_HOST, 0);
+	ut_assertok(blk_dread_async(desc, 1, 1, rbuf, &req));
+	memset(buf[0], 0x20, 512);
+	reqs[0].complete = NULL;
+	ut_assertok(blk_dwrite_async(desc, 1, 1, buf[0], &reqs[0]));
+	ut_assert(!req.done);
+	ut_asserteq(1, blk_wait(desc, &reqs[0]));
+	ut_assert(req.done);
+	ut_asserteq_mem(buf[1], rbuf, 512);
+	ut_asserteq(1, blk_dread(desc, 1, 1, rbuf));
+	ut_asserteq_mem(buf[0], rbuf, 512);
+
+	/* MMC has no submit() method, so requests finish before returning */
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_from_parent(dev, &dev));
+	desc = dev_get_uclass_plat(dev);
+	ut_assertok(blk_dread_async(desc, 0, 1, buf[0], &req));
+	ut_assert(req.done);
+	ut_asserteq(1, blk_wait(desc, &req));
+	ut_asserteq(1, blk_dread(desc, 0, 1, rbuf));
+	ut_asserteq_mem(rbuf, buf[0], 512);
+
+	ut_assertok(host_dev_bind(0, NULL));
+	os_unlink(fname);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test discarding blocks, which read back as zeroes on sandbox */
+static int dm_test_blk_discard(struct unit_test_state *uts)
+{
+	const char *fname = "blk_discard.img";
+	u8 buf[4][512], rbuf[4][512], zero[512];
+	struct blk_desc *desc;
+	struct udevice *dev;
+	int i, fd;
+
+	memset(zero, '\0', sizeof(zero));
+	for (i = 0; i < 4; i++)
+		memset(buf[i], 0x20 + i, 512);
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(buf), os_write(fd, buf, sizeof(buf)));
+	os_close(fd);
+	ut_assertok(host_dev_bind(0, (char *)fname));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+
+	/* Only the discarded blocks are cleared */
+	ut_asserteq(2, blk_ddiscard(desc, 1, 2));
+	ut_asserteq(4, blk_dread(desc, 0, 4, rbuf));
+	ut_asserteq_mem(buf[0], rbuf[0], 512);
+	ut_asserteq_mem(zero, rbuf[1], 512);
+	ut_asserteq_mem(zero, rbuf[2], 512);
+	ut_asserteq_mem(buf[3], rbuf[3], 512);
+
+	ut_assertok(host_dev_bind(0, NULL));
+	os_unlink(fname);
+
+	/* The sandbox SD card falls back to an erase */
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_from_parent(dev, &dev));
+	desc = dev_get_uclass_plat(dev);
+	ut_asserteq(4, blk_dwrite(desc, 0, 4, buf));
+	ut_asserteq(2, blk_ddiscard(desc, 1, 2));
+	ut_asserteq(4, blk_dread(desc, 0, 4, rbuf));
+	ut_asserteq_mem(buf[0], rbuf[0], 512);
+	ut_asserteq_mem(zero, rbuf[1], 512);
+	ut_asserteq_mem(zero, rbuf[2], 512);
+	ut_asserteq_mem(buf[3], rbuf[3], 512);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_discard, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for DFU downloads to MMC
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dfu.h>
+#include <dm.h>
+#include <env.h>
+#include <mapmem.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define DFU_TEST_START		0x10
+#define DFU_TEST_BUFSIZ		0x1000
+#define DFU_TEST_CHUNK		0x400
+/* several buffers, ending with a partial one */
+#define DFU_TEST_LEN		(4 * DFU_TEST_BUFSIZ + 3 * DFU_TEST_CHUNK)
+
+/* Download to mmc0 and check what landed on the card */
+static int dfu_mmc_async_check(struct unit_test_state *uts)
+{
+	struct dfu_entity *dfu;
+	struct blk_desc *desc;
+	u8 *src, *dst;
+	int i;
+
+	/* probe the card */
+	ut_asserteq(0, blk_get_device_by_str("mmc", "0", &desc));
+	ut_assertok(env_set("dfu_alt_info", "test raw 0x10 0x400"));
+	ut_assertok(env_set("dfu_bufsiz", "0x1000"));
+	ut_assertok(dfu_init_env_entities("mmc", "0"));
+	dfu = dfu_get_entity(0);
+	ut_assertnonnull(dfu);
+	ut_assertnonnull(dfu->submit_medium);
+
+	src = map_sysmem(0x20000, DFU_TEST_LEN);
+	for (i = 0; i < DFU_TEST_LEN; i++)
+		src[i] = i + (i >> 9);
+
+	for (i = 0; i * DFU_TEST_CHUNK < DFU_TEST_LEN; i++) {
+		ut_assertok(dfu_write(dfu, src + i * DFU_TEST_CHUNK,
+				      DFU_TEST_CHUNK, i));
+		/* the first full buffer is being written, fill the other */
+		if (i == DFU_TEST_BUFSIZ / DFU_TEST_CHUNK - 1)
+			ut_assert(dfu->i_buf_start != dfu_get_buf(dfu));
+	}
+	ut_assertok(dfu_flush(dfu, NULL, 0, i));
+
+	dst = map_sysmem(0x20000 + DFU_TEST_LEN, DFU_TEST_LEN + 1024);
+	ut_asserteq((DFU_TEST_LEN + 1024) / 512,
+		    blk_dread(desc, DFU_TEST_START - 1,
+			      (DFU_TEST_LEN + 1024) / 512, dst));
+	for (i = 0; i < 512; i++)
+		ut_asserteq(0, dst[i]);
+	ut_asserteq_mem(src, dst + 512, DFU_TEST_LEN);
+	for (i = 512 + DFU_TEST_LEN; i < DFU_TEST_LEN + 1024; i++)
+		ut_asserteq(0, dst[i]);
+
+	unmap_sysmem(dst);
+	unmap_sysmem(src);
+
+	return 0;
+}
+
+/*
+ * Download to a raw MMC area with a small DFU buffer, so that every full
+ * buffer is submitted while the data for the next one is copied into the
+ * other buffer.
+ */
+static int dm_test_dfu_mmc_async(struct unit_test_state *uts)
+{
+	int ret;
+
+	/* the buffer size is only read when the buffers are allocated */
+	dfu_free_buf();
+	ret = dfu_mmc_async_check(uts);
+	dfu_free_entities();
+	dfu_free_buf();
+	env_set("dfu_bufsiz", NULL);
+	env_set("dfu_alt_info", NULL);
+
+	return ret;
+}
+DM_TEST(dm_test_dfu_mmc_async, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
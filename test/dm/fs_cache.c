@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the filesystem mount and file caches
+ *
+ * The images are created by test/py/tests/test_ut.py and hold a single file
+ * with the pattern written by fs_cache_fill().
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <command.h>
+#include <dm.h>
+#include <env.h>
+#include <ext4fs.h>
+#include <fs.h>
+#include <mapmem.h>
+#include <os.h>
+#include <sandboxblockdev.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define FS_CACHE_EXT4		"fs_cache.ext4.img"
+#define FS_CACHE_SQFS		"fs_cache.sqfs.img"
+#define FS_CACHE_FILE		"/file"
+#define FS_CACHE_FILE_SIZE	0x4000
+
+#define FS_CACHE_LOAD_ADDR	0x100000
+#define FS_CACHE_ORIG_ADDR	(FS_CACHE_LOAD_ADDR + FS_CACHE_FILE_SIZE)
+#define FS_CACHE_NEW_ADDR	(FS_CACHE_ORIG_ADDR + FS_CACHE_FILE_SIZE)
+/* A copy of the image, so that it can be put back after the test */
+#define FS_CACHE_IMAGE_ADDR	0x1000000
+
+/* Write the contents of the file in the images, or their inverse, at @addr */
+static void fs_cache_fill(ulong addr, bool invert)
+{
+	u8 *buf = map_sysmem(addr, FS_CACHE_FILE_SIZE);
+	int i;
+
+	for (i = 0; i < FS_CACHE_FILE_SIZE; i++)
+		buf[i] = (i * 7 + (i >> 12)) ^ (invert ? 0xff : 0);
+	unmap_sysmem(buf);
+}
+
+/* Load the file from host 0 and check that it matches the data at @expect */
+static int fs_cache_load(struct unit_test_state *uts, ulong expect)
+{
+	u8 *buf, *exp;
+	char cmd[64];
+
+	buf = map_sysmem(FS_CACHE_LOAD_ADDR, FS_CACHE_FILE_SIZE);
+	exp = map_sysmem(expect, FS_CACHE_FILE_SIZE);
+	memset(buf, '\0', FS_CACHE_FILE_SIZE);
+	snprintf(cmd, sizeof(cmd), "load host 0 %x %s", FS_CACHE_LOAD_ADDR,
+		 FS_CACHE_FILE);
+	ut_assertok(run_command(cmd, 0));
+	ut_asserteq(FS_CACHE_FILE_SIZE, env_get_hex("filesize", 0));
+	ut_asserteq_mem(exp, buf, FS_CACHE_FILE_SIZE);
+	unmap_sysmem(exp);
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+/*
+ * Load the file from the image bound to host 0 twice, emptying the image in
+ * between. The second load can only succeed if it is served from the cache.
+ */
+static int fs_cache_check_hit(struct unit_test_state *uts, const char *fname,
+			      const void *image, int size)
+{
+	ut_assertok(fs_cache_load(uts, FS_CACHE_ORIG_ADDR));
+
+	ut_assertok(os_write_file(fname, image, 0));
+	blkcache_invalidate(IF_TYPE_HOST, 0);
+	ut_assertok(fs_cache_load(uts, FS_CACHE_ORIG_ADDR));
+
+	ut_assertok(os_write_file(fname, image, size));
+
+	return 0;
+}
+
+/* Copy the image to FS_CACHE_IMAGE_ADDR and return its size */
+static int fs_cache_read_image(struct unit_test_state *uts, const char *fname)
+{
+	loff_t size;
+	int fd;
+
+	ut_assertok(os_get_filesize(fname, &size));
+	fd = os_open(fname, OS_O_RDONLY);
+	ut_assert(fd >= 0);
+	ut_asserteq(size, os_read(fd, map_sysmem(FS_CACHE_IMAGE_ADDR, size),
+				  size));
+	os_close(fd);
+
+	return size;
+}
+
+static int fs_cache_check_ext4(struct unit_test_state *uts, const void *image,
+			       int size)
+{
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char cmd[64];
+	loff_t actual;
+
+	ut_assertok(host_dev_bind(0, (char *)FS_CACHE_EXT4));
+	ut_assertok(fs_cache_check_hit(uts, FS_CACHE_EXT4, image, size));
+	ut_assertnonnull(ext4fs_root);
+
+	/* a write goes through the cached mount and drops the cached file */
+	snprintf(cmd, sizeof(cmd), "save host 0 %x %s %x", FS_CACHE_NEW_ADDR,
+		 FS_CACHE_FILE, FS_CACHE_FILE_SIZE);
+	ut_assertok(run_command(cmd, 0));
+	ut_assertnull(ext4fs_root);
+	ut_assertok(fs_cache_load(uts, FS_CACHE_NEW_ADDR));
+	ut_assertnonnull(ext4fs_root);
+
+	/*
+	 * Rebinding the device with the original image may give a blk_desc at
+	 * the same address, so nothing cached for the old one may be used
+	 */
+	ut_assertok(host_dev_bind(0, NULL));
+	ut_assertnull(ext4fs_root);
+	ut_assertok(os_write_file(FS_CACHE_EXT4, image, size));
+	blkcache_invalidate(IF_TYPE_HOST, 0);
+	ut_assertok(host_dev_bind(0, (char *)FS_CACHE_EXT4));
+	ut_assertok(fs_cache_load(uts, FS_CACHE_ORIG_ADDR));
+
+	/* invalidating during an operation leaves the mount until fs_close() */
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+	ut_assertok(fs_set_blk_dev("host", "0", FS_TYPE_EXT));
+	ut_assertnonnull(ext4fs_root);
+	fs_cache_invalidate(desc);
+	ut_assertnonnull(ext4fs_root);
+	ut_assertok(fs_size(FS_CACHE_FILE, &actual));
+	ut_asserteq(FS_CACHE_FILE_SIZE, actual);
+	ut_assertnull(ext4fs_root);
+
+	ut_assertok(fs_cache_load(uts, FS_CACHE_ORIG_ADDR));
+	ut_assertnonnull(ext4fs_root);
+
+	return 0;
+}
+
+static int fs_cache_check_sqfs(struct unit_test_state *uts, const void *image,
+			       int size)
+{
+	ut_assertok(host_dev_bind(0, (char *)FS_CACHE_SQFS));
+	ut_assertok(fs_cache_check_hit(uts, FS_CACHE_SQFS, image, size));
+
+	return 0;
+}
+
+/* Test the mount and file caches on ext4, including writes and rebinding */
+static int dm_test_fs_cache_ext4(struct unit_test_state *uts)
+{
+	void *image;
+	int size, ret;
+
+	fs_cache_fill(FS_CACHE_ORIG_ADDR, false);
+	fs_cache_fill(FS_CACHE_NEW_ADDR, true);
+	size = fs_cache_read_image(uts, FS_CACHE_EXT4);
+	ut_assert(size > 0);
+	image = map_sysmem(FS_CACHE_IMAGE_ADDR, size);
+
+	/* put the image back even if an assertion fails */
+	ret = fs_cache_check_ext4(uts, image, size);
+	host_dev_bind(0, NULL);
+	os_write_file(FS_CACHE_EXT4, image, size);
+	unmap_sysmem(image);
+
+	return ret;
+}
+DM_TEST(dm_test_fs_cache_ext4, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test that a file loaded from squashfs is served from the cache */
+static int dm_test_fs_cache_sqfs(struct unit_test_state *uts)
+{
+	void *image;
+	int size, ret;
+
+	fs_cache_fill(FS_CACHE_ORIG_ADDR, false);
+	size = fs_cache_read_image(uts, FS_CACHE_SQFS);
+	ut_assert(size > 0);
+	image = map_sysmem(FS_CACHE_IMAGE_ADDR, size);
+
+	/* put the image back even if an assertion fails */
+	ret = fs_cache_check_sqfs(uts, image, size);
+	host_dev_bind(0, NULL);
+	os_write_file(FS_CACHE_SQFS, image, size);
+	unmap_sysmem(image);
+
+	return ret;
+}
+DM_TEST(dm_test_fs_cache_sqfs, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
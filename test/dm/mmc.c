@@ -7,6 +7,8 @@
 #include <dm.h>
 #include <mmc.h>
 #include <part.h>
+#include <time.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -52,3 +54,44 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Start init early and check that it is completed on first access */
+static int dm_test_mmc_start_init(struct unit_test_state *uts)
+{
+	struct udevice *dev, *bdev;
+	struct blk_desc *dev_desc;
+	struct mmc *mmc;
+	char buf[512];
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assertnonnull(mmc);
+
+	/* Go back to the state before the card was first used */
+	ut_assertok(blk_get_from_parent(dev, &bdev));
+	ut_assertok(device_remove(bdev, DM_REMOVE_NORMAL));
+	mmc->has_init = 0;
+
+	ut_assertok(mmc_start_init(mmc));
+
+	/* The card is still powering up, which is waited for later */
+	ut_asserteq(1, mmc->init_in_progress);
+	ut_asserteq(1, mmc->op_cond_pending);
+	ut_asserteq(1, mmc->op_cond_sd);
+	ut_asserteq(0, mmc->has_init);
+
+	/*
+	 * Probing the block device is its first use. Coming long after the
+	 * start must not be taken for a card which never powers up.
+	 */
+	timer_test_add_offset(2000);
+	ut_assertok(device_probe(bdev));
+	ut_asserteq(1, mmc->has_init);
+	ut_asserteq(0, mmc->init_in_progress);
+	ut_asserteq(0, mmc->op_cond_pending);
+	dev_desc = dev_get_uclass_plat(bdev);
+	ut_asserteq(1, blk_dread(dev_desc, 0, 1, buf));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_start_init, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
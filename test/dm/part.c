@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the partition table cache
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <os.h>
+#include <part.h>
+#include <sandboxblockdev.h>
+#include <dm/test.h>
+#include <linux/ctype.h>
+#include <test/ut.h>
+
+/* Size of each disk image, enough for the GPT and two small partitions */
+#define PART_TEST_BLKS	128
+
+static int part_test_make_disk(struct unit_test_state *uts, int devnum,
+			       const char *fname, struct disk_partition *parts,
+			       struct blk_desc **descp)
+{
+	char disk_guid[UUID_STR_LEN + 1];
+	static u8 zero[PART_TEST_BLKS * 512];
+	struct udevice *dev;
+	int fd;
+
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(zero), os_write(fd, zero, sizeof(zero)));
+	os_close(fd);
+	ut_assertok(host_dev_bind(devnum, (char *)fname));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, devnum, &dev));
+	*descp = dev_get_uclass_plat(dev);
+
+	gen_rand_uuid_str(parts[0].uuid, UUID_STR_FORMAT_STD);
+	gen_rand_uuid_str(parts[1].uuid, UUID_STR_FORMAT_STD);
+	gen_rand_uuid_str(disk_guid, UUID_STR_FORMAT_STD);
+	ut_assertok(gpt_restore(*descp, disk_guid, parts, 2));
+
+	return 0;
+}
+
+/* Copy one image over another, behind the back of the block layer */
+static int part_test_copy_disk(struct unit_test_state *uts, const char *from,
+			       const char *to)
+{
+	static u8 buf[PART_TEST_BLKS * 512];
+	int fd;
+
+	fd = os_open(from, OS_O_RDONLY);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(buf), os_read(fd, buf, sizeof(buf)));
+	os_close(fd);
+	fd = os_open(to, OS_O_WRONLY);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(buf), os_write(fd, buf, sizeof(buf)));
+	os_close(fd);
+
+	return 0;
+}
+
+/* Test lookups from the cache and when the cache is dropped */
+static int dm_test_part_cache(struct unit_test_state *uts)
+{
+	const char *fname[2] = { "part_cache0.img", "part_cache1.img" };
+	struct disk_partition parts[2][2] = {
+		{
+			{ .start = 48, .size = 8, .name = "a1" },
+			{ .start = 56, .size = 8, .name = "a2" },
+		}, {
+			{ .start = 48, .size = 8, .name = "b1" },
+			{ .start = 56, .size = 8, .name = "b2" },
+		},
+	};
+	char uuid[UUID_STR_LEN + 1];
+	struct disk_partition info;
+	struct blk_desc *desc[2];
+	u8 buf[512];
+	int i;
+
+	for (i = 0; i < 2; i++)
+		ut_assertok(part_test_make_disk(uts, i, fname[i], parts[i],
+						&desc[i]));
+
+	/* Look up by name, number and UUID, in any case */
+	ut_asserteq(2, part_get_info_by_name(desc[0], "a2", &info));
+	ut_asserteq(56, info.start);
+	ut_asserteq(8, info.size);
+	ut_assertok(part_get_info(desc[0], 1, &info));
+	ut_asserteq_str("a1", (char *)info.name);
+	ut_asserteq(-ENOENT, part_get_info_by_name(desc[0], "b1", &info));
+	ut_asserteq(1, part_get_info_by_uuid(desc[0], parts[0][0].uuid, &info));
+	ut_asserteq_str("a1", (char *)info.name);
+	for (i = 0; i <= UUID_STR_LEN; i++)
+		uuid[i] = toupper(parts[0][1].uuid[i]);
+	ut_asserteq(2, part_get_info_by_uuid(desc[0], uuid, &info));
+	ut_asserteq(-ENOENT, part_get_info_by_uuid(desc[0], parts[1][0].uuid,
+						   &info));
+	ut_asserteq(-ENOENT, part_get_info_by_uuid(desc[0], "", &info));
+
+	/* The table is not read again, so a change behind our back is missed */
+	ut_assertok(part_test_copy_disk(uts, fname[1], fname[0]));
+	ut_asserteq(1, part_get_info_by_name(desc[0], "a1", &info));
+	ut_assertok(part_get_info(desc[0], 2, &info));
+	ut_asserteq_str("a2", (char *)info.name);
+
+	/* Writing inside a partition keeps the cache */
+	memset(buf, 0x55, sizeof(buf));
+	ut_asserteq(1, blk_dwrite(desc[0], 50, 1, buf));
+	ut_asserteq(1, part_get_info_by_name(desc[0], "a1", &info));
+
+	/* Writing the table area drops it */
+	ut_asserteq(1, blk_dread(desc[0], 0, 1, buf));
+	ut_asserteq(1, blk_dwrite(desc[0], 0, 1, buf));
+	ut_asserteq(-ENOENT, part_get_info_by_name(desc[0], "a1", &info));
+	ut_asserteq(1, part_get_info_by_name(desc[0], "b1", &info));
+	ut_asserteq(2, part_get_info_by_uuid(desc[0], parts[1][1].uuid, &info));
+
+	/* So does re-initialising the device */
+	ut_assertok(part_test_make_disk(uts, 1, fname[1], parts[0], &desc[1]));
+	ut_assertok(part_test_copy_disk(uts, fname[1], fname[0]));
+	ut_asserteq(1, part_get_info_by_name(desc[0], "b1", &info));
+	part_init(desc[0]);
+	ut_asserteq(-ENOENT, part_get_info_by_name(desc[0], "b1", &info));
+	ut_asserteq(2, part_get_info_by_name(desc[0], "a2", &info));
+
+	for (i = 0; i < 2; i++) {
+		ut_assertok(host_dev_bind(i, NULL));
+		os_unlink(fname[i]);
+	}
+
+	return 0;
+}
+DM_TEST(dm_test_part_cache, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
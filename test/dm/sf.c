@@ -10,9 +10,11 @@
 #include <mapmem.h>
 #include <os.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <asm/state.h>
 #include <asm/test.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <dm/util.h>
 #include <test/test.h>
@@ -67,6 +69,125 @@ static int dm_test_spi_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_spi_flash, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+/* Test reads through a SPI memory direct mapping */
+static int dm_test_spi_mem_dirmap(struct unit_test_state *uts)
+{
+	struct spi_mem_dirmap_info info = {
+		.op_tmpl = SPI_MEM_OP(SPI_MEM_OP_CMD(0x03, 1),
+				      SPI_MEM_OP_ADDR(3, 0, 1),
+				      SPI_MEM_OP_NO_DUMMY,
+				      SPI_MEM_OP_DATA_IN(0, NULL, 1)),
+		.offset = 0x1000,
+		.length = 0x10000,
+	};
+	struct spi_mem_dirmap_desc *desc;
+	struct spi_flash *flash;
+	struct udevice *dev;
+	int full_size = 0x200000;
+	u8 *src, *dst;
+	ssize_t ret;
+	size_t done;
+
+	src = map_sysmem(0x20000, full_size);
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	flash = dev_get_uclass_priv(dev);
+
+	/* sandbox SPI has no dirmap hooks, so reads fall back to exec_op */
+	ut_assertnonnull(flash->dirmap.rdesc);
+	ut_asserteq(1, flash->dirmap.rdesc->nodirmap);
+
+	desc = spi_mem_dirmap_create(flash->spi, &info);
+	ut_assertok_ptr(desc);
+
+	dst = map_sysmem(0x20000 + full_size, info.length);
+	memset(dst, 0, info.length);
+	for (done = 0; done < info.length; done += ret) {
+		ret = spi_mem_dirmap_read(desc, done, info.length - done,
+					  dst + done);
+		ut_assert(ret > 0);
+	}
+	ut_asserteq_mem(src + info.offset, dst, info.length);
+
+	/* a read mapping cannot be used to write */
+	ut_asserteq(-EINVAL, spi_mem_dirmap_write(desc, 0, 1, dst));
+	spi_mem_dirmap_destroy(desc);
+
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_mem_dirmap, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test the octal DTR and 4-byte address set-up negotiated through SFDP */
+static int dm_test_spi_flash_octal_dtr(struct unit_test_state *uts)
+{
+	struct spi_flash *flash;
+	struct udevice *dev;
+	int full_size = 0x200000;
+	int size = 0x1000;
+	u8 *src, *dst;
+	int i;
+
+	src = map_sysmem(0x20000, full_size);
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+
+	/* 8 lines both ways: everything goes through 8D-8D-8D */
+	ut_assertok(spi_flash_probe_bus_cs(1, 0, 0, 0, &dev));
+	flash = dev_get_uclass_priv(dev);
+	ut_asserteq(SNOR_PROTO_8_8_8_DTR, flash->read_proto);
+	ut_asserteq(SNOR_PROTO_8_8_8_DTR, flash->write_proto);
+	ut_asserteq(SNOR_PROTO_8_8_8_DTR, flash->reg_proto);
+	ut_asserteq(SPINOR_OP_MT_DTR_RD, flash->read_opcode);
+	ut_asserteq(20, flash->read_dummy);
+	ut_asserteq(SPINOR_OP_PP_4B, flash->program_opcode);
+	ut_asserteq(SPINOR_OP_SE_4B, flash->erase_opcode);
+	ut_asserteq(4, flash->addr_width);
+
+	dst = map_sysmem(0x20000 + full_size, size);
+	ut_assertok(spi_flash_read_dm(dev, 0x21, size, dst));
+	ut_asserteq_mem(src + 0x21, dst, size);
+
+	ut_assertok(spi_flash_erase_dm(dev, 0, flash->erase_size));
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	for (i = 0; i < size; i++)
+		ut_asserteq(0xff, dst[i]);
+
+	/* odd offsets and lengths are padded to whole DTR words */
+	for (i = 0; i < size; i++)
+		src[i] = i;
+	ut_assertok(spi_flash_write_dm(dev, 0, 3, src));
+	ut_assertok(spi_flash_write_dm(dev, 3, 1, src + 3));
+	ut_assertok(spi_flash_write_dm(dev, 4, size - 5, src + 4));
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	ut_asserteq_mem(src, dst, size - 1);
+	ut_asserteq(0xff, dst[size - 1]);
+
+	/* the flash is switched back to 1S-1S-1S, so a new probe works */
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(spi_flash_probe_bus_cs(1, 0, 0, 0, &dev));
+	flash = dev_get_uclass_priv(dev);
+	ut_asserteq(SNOR_PROTO_8_8_8_DTR, flash->reg_proto);
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	ut_asserteq_mem(src, dst, size - 1);
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+
+	/* 8 lines for reads only: 1-1-8 with the 4-byte op code */
+	ut_assertok(spi_flash_probe_bus_cs(1, 1, 0, 0, &dev));
+	flash = dev_get_uclass_priv(dev);
+	ut_asserteq(SNOR_PROTO_1_1_8, flash->read_proto);
+	ut_asserteq(SNOR_PROTO_1_1_1, flash->reg_proto);
+	ut_asserteq(SPINOR_OP_READ_1_1_8_4B, flash->read_opcode);
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	ut_asserteq_mem(src, dst, size - 1);
+
+	sandbox_sf_unbind_emul(state_get_current(), 1, 0);
+	sandbox_sf_unbind_emul(state_get_current(), 1, 1);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_octal_dtr, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 /* Functional test that sandbox SPI flash works correctly */
 static int dm_test_spi_flash_func(struct unit_test_state *uts)
 {
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for UBI attach on the sandbox SPI flash
+ */
+
+#include <common.h>
+#include <command.h>
+#include <dm.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <os.h>
+#include <spi_flash.h>
+#include <ubi_uboot.h>
+#include <linux/sizes.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include "../../drivers/mtd/ubi/ubi.h"
+
+#define UBI_TEST_FLASH_SIZE	0x200000
+#define UBI_TEST_VOL_SIZE	0x30000
+
+/* Check the read-ahead of headers used when scanning, on an attached device */
+static int ubi_read_ahead_check(struct unit_test_state *uts,
+				struct ubi_device *ubi, struct udevice *dev)
+{
+	const int ahead = CONFIG_MTD_UBI_SCAN_READ_AHEAD;
+	const int last = ubi->peb_count - 1;
+	struct ubi_ec_hdr ech;
+
+	ut_assertnonnull(ubi->hdrs_buf);
+
+	ubi_io_read_hdrs(ubi, 0);
+	ut_asserteq(0, ubi->hdrs_pnum);
+	ut_asserteq((u32)GENMASK(ahead - 1, 0), ubi->hdrs_ok);
+
+	/* the last PEB of the run comes from the buffer, not the flash */
+	ut_assertok(spi_flash_erase_dm(dev, (ahead - 1) * SZ_64K, SZ_64K));
+	ut_assertok(ubi_io_read_ec_hdr(ubi, ahead - 1, &ech, 0));
+
+	/* PEBs in the buffer are not read again... */
+	ubi_io_read_hdrs(ubi, ahead - 1);
+	ut_asserteq(0, ubi->hdrs_pnum);
+
+	/* ...but erasing or writing through UBI drops them */
+	ut_asserteq(1, ubi_io_sync_erase(ubi, ahead - 1, 0));
+	ut_asserteq((u32)GENMASK(ahead - 2, 0), ubi->hdrs_ok);
+	ut_asserteq(UBI_IO_FF, ubi_io_read_ec_hdr(ubi, ahead - 1, &ech, 0));
+
+	/* the run stops at the end of the device */
+	ubi_io_read_hdrs(ubi, last);
+	ut_asserteq(last, ubi->hdrs_pnum);
+	ut_asserteq(1, ubi->hdrs_ok);
+
+	return 0;
+}
+
+/*
+ * Attach an empty flash, write a volume, then attach it again. The flash is
+ * too small for fastmap, so the second attach scans the EC and VID headers of
+ * every PEB.
+ */
+static int dm_test_ubi_attach(struct unit_test_state *uts)
+{
+	struct ubi_device *ubi;
+	struct udevice *dev;
+	u8 *src, *dst;
+	int i, ret;
+
+	src = map_sysmem(0x20000, UBI_TEST_FLASH_SIZE);
+	memset(src, 0xff, UBI_TEST_FLASH_SIZE);
+	ut_assertok(os_write_file("spi.bin", src, UBI_TEST_FLASH_SIZE));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+
+	ut_assertok(ubi_part("nor0", NULL));
+	ut_assertok(run_command("ubi create test 30000 dynamic", 0));
+	for (i = 0; i < UBI_TEST_VOL_SIZE; i++)
+		src[i] = i * 7 + (i >> 8);
+	ut_assertok(ubi_volume_write("test", src, UBI_TEST_VOL_SIZE));
+
+	ut_assertok(ubi_part("nor0", NULL));
+	ubi = ubi_devices[0];
+	ut_assertnonnull(ubi);
+	ut_asserteq(UBI_TEST_FLASH_SIZE / SZ_64K, ubi->good_peb_count);
+	ut_asserteq(0, ubi->corr_peb_count);
+	/* the headers buffer only lives while attaching */
+	ut_assertnull(ubi->hdrs_buf);
+
+	dst = map_sysmem(0x20000 + UBI_TEST_FLASH_SIZE, UBI_TEST_VOL_SIZE);
+	memset(dst, '\0', UBI_TEST_VOL_SIZE);
+	ut_assertok(ubi_volume_read("test", (char *)dst, UBI_TEST_VOL_SIZE));
+	ut_asserteq_mem(src, dst, UBI_TEST_VOL_SIZE);
+
+	/* an erased PEB in the middle is picked up as a free one */
+	ut_assertok(spi_flash_erase_dm(dev, 8 * SZ_64K, SZ_64K));
+	ut_assertok(ubi_part("nor0", NULL));
+	ut_asserteq(UBI_TEST_FLASH_SIZE / SZ_64K, ubi_devices[0]->good_peb_count);
+	ut_asserteq(0, ubi_devices[0]->corr_peb_count);
+
+	/* this leaves the device in a mess, so comes last */
+	ubi = ubi_devices[0];
+	ubi->hdrs_pnum = -1;
+	ubi->hdrs_buf = malloc(CONFIG_MTD_UBI_SCAN_READ_AHEAD *
+			       ubi_io_hdrs_size(ubi));
+	ret = ubi_read_ahead_check(uts, ubi, dev);
+	free(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
+	ut_assertok(ret);
+
+	ut_assertok(run_command("ubi detach", 0));
+	unmap_sysmem(dst);
+	unmap_sysmem(src);
+
+	return 0;
+}
+DM_TEST(dm_test_ubi_attach, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
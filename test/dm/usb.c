@@ -6,7 +6,10 @@
 #include <common.h>
 #include <console.h>
 #include <dm.h>
+#include <malloc.h>
+#include <os.h>
 #include <part.h>
+#include <scsi.h>
 #include <usb.h>
 #include <asm/io.h>
 #include <asm/state.h>
@@ -101,6 +104,156 @@ static int dm_test_usb_fdt_node(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_fdt_node, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+/* Size of the backing file for the UAS flash stick */
+#define UAS_FLASH_SIZE		(4 << 20)
+
+/* Drive the UAS flash stick using the @buf and @cmp scratch buffers */
+static int usb_uas_check(struct unit_test_state *uts, u8 *buf, u8 *cmp)
+{
+	struct udevice *dev, *blk, *emul;
+	struct usb_device *udev;
+	struct blk_desc *dev_desc;
+	lbaint_t blkcnt;
+	int fd, i;
+
+	ut_assertnonnull(cmp);
+	ut_assertnonnull(buf);
+
+	/* a pattern which differs in every block */
+	for (i = 0; i < UAS_FLASH_SIZE; i++)
+		cmp[i] = i + (i >> 9);
+	fd = os_open("testflash2.bin", OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(UAS_FLASH_SIZE, os_write(fd, cmp, UAS_FLASH_SIZE));
+	os_close(fd);
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 2, &dev));
+	udev = dev_get_parent_priv(dev);
+	ut_asserteq(1, udev->config.if_desc[0].act_altsetting);
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	dev_desc = dev_get_uclass_plat(blk);
+	ut_asserteq(512, dev_desc->blksz);
+	blkcnt = UAS_FLASH_SIZE / dev_desc->blksz;
+	ut_asserteq(blkcnt, dev_desc->lba);
+
+	/* a read large enough to be split into several queued commands */
+	memset(buf, '\0', UAS_FLASH_SIZE);
+	ut_asserteq(blkcnt - 1, blk_dread(dev_desc, 1, blkcnt - 1, buf));
+	ut_asserteq_mem(cmp + 512, buf, UAS_FLASH_SIZE - 512);
+	ut_assertok(uclass_get_device_by_name(UCLASS_USB_EMUL, "flash-stick@2",
+					      &emul));
+	ut_assert(sandbox_usb_flash_max_queued(emul) > 1);
+
+	/* write everything back inverted and check it arrived */
+	for (i = 0; i < UAS_FLASH_SIZE; i++)
+		cmp[i] = ~cmp[i];
+	ut_asserteq(blkcnt, blk_dwrite(dev_desc, 0, blkcnt, cmp));
+	memset(buf, '\0', UAS_FLASH_SIZE);
+	ut_asserteq(3, blk_dread(dev_desc, 5, 3, buf));
+	ut_asserteq_mem(cmp + 5 * 512, buf, 3 * 512);
+	ut_asserteq(blkcnt, blk_dread(dev_desc, 0, blkcnt, buf));
+	ut_asserteq_mem(cmp, buf, UAS_FLASH_SIZE);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+
+/* Test that a flash stick with a UAS alternate setting is driven through it */
+static int dm_test_usb_uas(struct unit_test_state *uts)
+{
+	u8 *buf, *cmp;
+	int ret;
+
+	/* free the buffers even if an assertion fails */
+	cmp = malloc(UAS_FLASH_SIZE);
+	buf = malloc(UAS_FLASH_SIZE);
+	ret = usb_uas_check(uts, buf, cmp);
+	os_unlink("testflash2.bin");
+	free(buf);
+	free(cmp);
+
+	return ret;
+}
+DM_TEST(dm_test_usb_uas, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/*
+ * Test queued bulk transfers on a controller which cannot queue them, so that
+ * usb_bulk_submit() does each transfer at once and usb_bulk_reap() reports it
+ */
+static int dm_test_usb_bulk_submit(struct unit_test_state *uts)
+{
+	struct usb_device *udev, *kbd_udev;
+	struct usb_bulk_req req[3], bad;
+	struct umass_bbb_cbw cbw;
+	struct umass_bbb_csw csw;
+	struct udevice *dev;
+	u8 inquiry[36];
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
+	udev = dev_get_parent_priv(dev);
+
+	/* queue a whole bulk-only INQUIRY: command, data and status */
+	memset(&cbw, '\0', sizeof(cbw));
+	cbw.dCBWSignature = CBWSIGNATURE;
+	cbw.dCBWTag = 0x1234;
+	cbw.dCBWDataTransferLength = sizeof(inquiry);
+	cbw.bCBWFlags = CBWFLAGS_IN;
+	cbw.bCDBLength = 6;
+	cbw.CBWCDB[0] = SCSI_INQUIRY;
+	cbw.CBWCDB[4] = sizeof(inquiry);
+	memset(req, '\0', sizeof(req));
+	req[0].pipe = usb_sndbulkpipe(udev, 1);
+	req[0].buffer = &cbw;
+	req[0].length = UMASS_BBB_CBW_SIZE;
+	req[1].pipe = usb_rcvbulkpipe(udev, 2);
+	req[1].buffer = inquiry;
+	req[1].length = sizeof(inquiry);
+	req[2].pipe = usb_rcvbulkpipe(udev, 2);
+	req[2].buffer = &csw;
+	req[2].length = UMASS_BBB_CSW_SIZE;
+	ut_assertok(usb_bulk_submit(udev, &req[0]));
+	ut_assertok(usb_bulk_submit(udev, &req[1]));
+	ut_assertok(usb_bulk_submit(udev, &req[2]));
+
+	/* reap them newest first */
+	ut_assertok(usb_bulk_reap(udev, &req[2]));
+	ut_assert(req[2].done);
+	ut_asserteq(UMASS_BBB_CSW_SIZE, req[2].actual_length);
+	ut_asserteq(CSWSIGNATURE, csw.dCSWSignature);
+	ut_asserteq(0x1234, csw.dCSWTag);
+	ut_asserteq(CSWSTATUS_GOOD, csw.bCSWStatus);
+	ut_assertok(usb_bulk_reap(udev, &req[1]));
+	ut_asserteq(sizeof(inquiry), req[1].actual_length);
+	ut_asserteq_strn("sandbox", (char *)inquiry + 8);
+	ut_assertok(usb_bulk_reap(udev, &req[0]));
+	ut_assert(req[0].done);
+
+	/* a bad length is refused at once */
+	bad = req[1];
+	bad.length = -1;
+	ut_asserteq(-EINVAL, usb_bulk_submit(udev, &bad));
+
+	/* the keyboard has no bulk endpoints, so the transfer fails */
+	ut_assertok(uclass_get_device(UCLASS_KEYBOARD, 0, &dev));
+	kbd_udev = dev_get_parent_priv(dev);
+	memset(&bad, '\0', sizeof(bad));
+	bad.pipe = usb_rcvbulkpipe(kbd_udev, 1);
+	bad.buffer = inquiry;
+	bad.length = sizeof(inquiry);
+	ut_assertok(usb_bulk_submit(kbd_udev, &bad));
+	ut_asserteq(-EIO, usb_bulk_reap(kbd_udev, &bad));
+	ut_assert(bad.status);
+	ut_asserteq(0, bad.actual_length);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_bulk_submit, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 static int count_usb_devices(void)
 {
 	struct udevice *hub;
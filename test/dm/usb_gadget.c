@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for USB gadget functions, using the sandbox device controller
+ */
+
+#include <common.h>
+#include <command.h>
+#include <dm.h>
+#include <malloc.h>
+#include <os.h>
+#include <sandboxblockdev.h>
+#include <scsi.h>
+#include <usb_defs.h>
+#include <asm/state.h>
+#include <asm/test.h>
+#include <asm/unaligned.h>
+#include <dm/test.h>
+#include <linux/usb/ch9.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Endpoints which the mass storage function picks on the sandbox UDC */
+#define UMS_EP_IN		(USB_DIR_IN | 1)
+#define UMS_EP_OUT		2
+
+#define UMS_FILE_SIZE		(2 << 20)
+#define UMS_START		7
+/* Enough to wrap around the buffer ring, ending with a partial buffer */
+#define UMS_BLOCKS		2051
+#define UMS_LEN			(UMS_BLOCKS * 512)
+
+enum ums_host_step {
+	UMS_SET_CONFIG,
+	UMS_WRITE_CBW,
+	UMS_WRITE_DATA,
+	UMS_WRITE_CSW,
+	UMS_READ_CBW,
+	UMS_READ_DATA,
+	UMS_READ_CSW,
+	UMS_DONE,
+};
+
+/**
+ * struct ums_host - emulated host writing and reading back a range of blocks
+ *
+ * @step:	Next thing to do
+ * @wdata:	Data to write
+ * @rdata:	Buffer for the data read back
+ * @done:	Bytes sent or received in the current data stage
+ * @err:	First error seen, or 0
+ */
+struct ums_host {
+	enum ums_host_step step;
+	u8 *wdata;
+	u8 *rdata;
+	int done;
+	int err;
+};
+
+static void ums_host_cbw(struct umass_bbb_cbw *cbw, u8 opcode, bool in)
+{
+	memset(cbw, '\0', sizeof(*cbw));
+	cbw->dCBWSignature = CBWSIGNATURE;
+	cbw->dCBWTag = opcode;
+	cbw->dCBWDataTransferLength = UMS_LEN;
+	cbw->bCBWFlags = in ? CBWFLAGS_IN : CBWFLAGS_OUT;
+	cbw->bCDBLength = 10;
+	cbw->CBWCDB[0] = opcode;
+	put_unaligned_be32(UMS_START, &cbw->CBWCDB[2]);
+	put_unaligned_be16(UMS_BLOCKS, &cbw->CBWCDB[7]);
+}
+
+/* Move as much data as the gadget has queued requests for */
+static int ums_host_data(struct udevice *dev, struct ums_host *host, int ep,
+			 u8 *buf)
+{
+	int ret;
+
+	do {
+		ret = sandbox_udc_bulk(dev, ep, buf + host->done,
+				       UMS_LEN - host->done);
+		if (ret < 0)
+			return ret;
+		host->done += ret;
+	} while (host->done < UMS_LEN);
+	host->done = 0;
+
+	return 0;
+}
+
+static void ums_host(struct udevice *dev, void *priv)
+{
+	struct ums_host *host = priv;
+	struct usb_ctrlrequest ctrl;
+	struct umass_bbb_cbw cbw;
+	struct umass_bbb_csw csw;
+	int ret;
+
+	switch (host->step) {
+	case UMS_SET_CONFIG:
+		memset(&ctrl, '\0', sizeof(ctrl));
+		ctrl.bRequestType = USB_DIR_OUT | USB_TYPE_STANDARD |
+			USB_RECIP_DEVICE;
+		ctrl.bRequest = USB_REQ_SET_CONFIGURATION;
+		ctrl.wValue = cpu_to_le16(1);
+		ret = sandbox_udc_control(dev, &ctrl, NULL);
+		break;
+	case UMS_WRITE_CBW:
+	case UMS_READ_CBW:
+		ums_host_cbw(&cbw, host->step == UMS_WRITE_CBW ? SCSI_WRITE10 :
+			     SCSI_READ10, host->step == UMS_READ_CBW);
+		ret = sandbox_udc_bulk(dev, UMS_EP_OUT, &cbw,
+				       UMASS_BBB_CBW_SIZE);
+		break;
+	case UMS_WRITE_DATA:
+		ret = ums_host_data(dev, host, UMS_EP_OUT, host->wdata);
+		break;
+	case UMS_READ_DATA:
+		ret = ums_host_data(dev, host, UMS_EP_IN, host->rdata);
+		break;
+	case UMS_WRITE_CSW:
+	case UMS_READ_CSW:
+		ret = sandbox_udc_bulk(dev, UMS_EP_IN, &csw, UMASS_BBB_CSW_SIZE);
+		if (ret >= 0 && (ret != UMASS_BBB_CSW_SIZE ||
+				 csw.dCSWSignature != CSWSIGNATURE ||
+				 csw.bCSWStatus != CSWSTATUS_GOOD ||
+				 csw.dCSWDataResidue))
+			ret = -EIO;
+		break;
+	default:
+		return;
+	}
+
+	/* Wait until the gadget has queued the next request */
+	if (ret == -EAGAIN)
+		return;
+	if (ret < 0) {
+		host->err = ret;
+		host->step = UMS_DONE;
+	} else {
+		host->step++;
+	}
+	if (host->step == UMS_DONE)
+		sandbox_udc_disconnect(dev);
+}
+
+/* Write and read back through the mass storage function with @wdata/@rdata */
+static int usb_ums_check(struct unit_test_state *uts, u8 *wdata, u8 *rdata)
+{
+	const char *fname = "ums.img";
+	struct ums_host host;
+	struct udevice *dev;
+	int fd, i;
+
+	ut_assertnonnull(wdata);
+	ut_assertnonnull(rdata);
+
+	memset(wdata, '\0', UMS_FILE_SIZE);
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(UMS_FILE_SIZE, os_write(fd, wdata, UMS_FILE_SIZE));
+	os_close(fd);
+	ut_assertok(host_dev_bind(0, (char *)fname));
+
+	/* a pattern which differs in every block */
+	for (i = 0; i < UMS_LEN; i++)
+		wdata[i] = i + (i >> 9);
+	memset(&host, '\0', sizeof(host));
+	host.wdata = wdata;
+	host.rdata = rdata;
+	ut_assertok(uclass_first_device_err(UCLASS_USB_GADGET_GENERIC, &dev));
+	sandbox_udc_set_host(dev, ums_host, &host);
+
+	state_set_skip_delays(true);
+	ut_assertok(run_command("ums 0 host 0", 0));
+	ut_assertok(host.err);
+	ut_asserteq(UMS_DONE, host.step);
+	ut_asserteq_mem(wdata, rdata, UMS_LEN);
+
+	/* check what landed in the file, and that nothing else changed */
+	ut_assertok(host_dev_bind(0, NULL));
+	fd = os_open(fname, OS_O_RDONLY);
+	ut_assert(fd >= 0);
+	ut_asserteq(UMS_FILE_SIZE, os_read(fd, rdata, UMS_FILE_SIZE));
+	os_close(fd);
+	for (i = 0; i < UMS_START * 512; i++)
+		ut_asserteq(0, rdata[i]);
+	ut_asserteq_mem(wdata, rdata + UMS_START * 512, UMS_LEN);
+	for (i = (UMS_START + UMS_BLOCKS) * 512; i < UMS_FILE_SIZE; i++)
+		ut_asserteq(0, rdata[i]);
+
+	return 0;
+}
+
+/*
+ * Test writing and reading back through the mass storage function. The
+ * transfers are longer than all the buffers together, so that several full
+ * buffers are merged into each block device access.
+ */
+static int dm_test_usb_ums(struct unit_test_state *uts)
+{
+	u8 *wdata, *rdata;
+	int ret;
+
+	/* free the buffers even if an assertion fails */
+	wdata = malloc(UMS_FILE_SIZE);
+	rdata = malloc(UMS_FILE_SIZE);
+	ret = usb_ums_check(uts, wdata, rdata);
+	os_unlink("ums.img");
+	free(rdata);
+	free(wdata);
+
+	return ret;
+}
+DM_TEST(dm_test_usb_ums, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
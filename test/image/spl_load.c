@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for loading compressed images from a FIT in SPL
+ */
+
+#include <common.h>
+#include <image.h>
+#include <mapmem.h>
+#include <spl.h>
+#include <asm/unaligned.h>
+#include <dm/test.h>
+#include <linux/libfdt.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+/* Large enough to need several reads, and several stored deflate blocks */
+#define SPL_LOAD_DATA_SIZE	(200 << 10)
+#define SPL_LOAD_FIT_SIZE	0x1000
+/* Not a multiple of the block size, so the data starts mid-block */
+#define SPL_LOAD_DATA_OFFSET	3
+#define SPL_LOAD_BL_LEN		512
+
+#define SPL_LOAD_IMAGE_ADDR	0x100000
+#define SPL_LOAD_DEST_ADDR	0x400000
+/* Room for the image plus the devicetree which SPL may append to it */
+#define SPL_LOAD_DEST_SIZE	(4 << 20)
+
+#define GZIP_STORED_MAX		0xffff
+
+static ulong spl_load_test_read(struct spl_load_info *load, ulong sector,
+				ulong count, void *buf)
+{
+	memcpy(buf, load->priv + sector * load->bl_len, count * load->bl_len);
+
+	return count;
+}
+
+/*
+ * Write @src as a gzip stream using stored (uncompressed) deflate blocks and
+ * return its length. This keeps the test independent of a compressor.
+ */
+static int spl_load_test_gzip(u8 *dst, const u8 *src, int size)
+{
+	static const u8 header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+	u8 *p = dst;
+	int len, done;
+
+	memcpy(p, header, sizeof(header));
+	p += sizeof(header);
+	for (done = 0; done < size; done += len) {
+		len = min(size - done, GZIP_STORED_MAX);
+		*p++ = done + len == size;	/* BFINAL, BTYPE 0 */
+		put_unaligned_le16(len, p);
+		put_unaligned_le16(~len, p + 2);
+		memcpy(p + 4, src + done, len);
+		p += 4 + len;
+	}
+	put_unaligned_le32(crc32(0, src, size), p);
+	put_unaligned_le32(size, p + 4);
+	p += 8;
+
+	return p - dst;
+}
+
+/* Write a FIT describing one gzip-compressed firmware image stored after it */
+static int spl_load_test_fit(struct unit_test_state *uts, void *fit,
+			     int data_size)
+{
+	ut_assertok(fdt_create(fit, SPL_LOAD_FIT_SIZE));
+	ut_assertok(fdt_finish_reservemap(fit));
+	ut_assertok(fdt_begin_node(fit, ""));
+	ut_assertok(fdt_property_string(fit, FIT_DESC_PROP, "SPL load test"));
+
+	ut_assertok(fdt_begin_node(fit, "images"));
+	ut_assertok(fdt_begin_node(fit, "firmware-1"));
+	ut_assertok(fdt_property_string(fit, FIT_TYPE_PROP, "firmware"));
+	ut_assertok(fdt_property_string(fit, FIT_COMP_PROP, "gzip"));
+	ut_assertok(fdt_property_u32(fit, FIT_DATA_OFFSET_PROP,
+				     SPL_LOAD_DATA_OFFSET));
+	ut_assertok(fdt_property_u32(fit, FIT_DATA_SIZE_PROP, data_size));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+
+	ut_assertok(fdt_begin_node(fit, "configurations"));
+	ut_assertok(fdt_property_string(fit, FIT_DEFAULT_PROP, "conf-1"));
+	ut_assertok(fdt_begin_node(fit, "conf-1"));
+	ut_assertok(fdt_property_string(fit, FIT_DESC_PROP, "test"));
+	ut_assertok(fdt_property_string(fit, FIT_FIRMWARE_PROP,
+					"firmware-1"));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_finish(fit));
+
+	return 0;
+}
+
+/*
+ * Test loading a gzip-compressed image with external data from a FIT. The
+ * image is decompressed a chunk at a time as it is read, straight to its
+ * load address.
+ */
+static int dm_test_spl_load_fit_gzip(struct unit_test_state *uts)
+{
+	struct spl_image_info image;
+	struct spl_load_info load;
+	u8 *fit, *data, *src, *dst;
+	int i, data_size;
+
+	fit = map_sysmem(SPL_LOAD_IMAGE_ADDR, 0);
+	dst = map_sysmem(SPL_LOAD_DEST_ADDR, SPL_LOAD_DEST_SIZE);
+	src = dst + SPL_LOAD_DEST_SIZE;
+	for (i = 0; i < SPL_LOAD_DATA_SIZE; i++)
+		src[i] = i * 7 + (i >> 12);
+
+	/* write the gzip data first, since its size goes in the FIT */
+	data_size = spl_load_test_gzip(fit + SPL_LOAD_FIT_SIZE, src,
+				       SPL_LOAD_DATA_SIZE);
+	ut_assertok(spl_load_test_fit(uts, fit, data_size));
+
+	/* external data offsets count from the 4-byte boundary after the FIT */
+	data = fit + ALIGN(fdt_totalsize(fit), 4) + SPL_LOAD_DATA_OFFSET;
+	memmove(data, fit + SPL_LOAD_FIT_SIZE, data_size);
+
+	memset(&load, '\0', sizeof(load));
+	load.bl_len = SPL_LOAD_BL_LEN;
+	load.priv = fit;
+	load.read = spl_load_test_read;
+	memset(&image, '\0', sizeof(image));
+	image.load_addr = (ulong)dst;
+	memset(dst, '\0', SPL_LOAD_DATA_SIZE);
+	ut_assertok(spl_load_simple_fit(&image, &load, 0, fit));
+	ut_asserteq(SPL_LOAD_DATA_SIZE, image.size);
+	ut_asserteq((ulong)dst, image.load_addr);
+	ut_asserteq_mem(src, dst, SPL_LOAD_DATA_SIZE);
+
+	/* a bad checksum in the gzip trailer is reported */
+	data[data_size - 8] ^= 1;
+	ut_assert(spl_load_simple_fit(&image, &load, 0, fit) < 0);
+
+	unmap_sysmem(dst);
+	unmap_sysmem(fit);
+
+	return 0;
+}
+DM_TEST(dm_test_spl_load_fit_gzip, 0);
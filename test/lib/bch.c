@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the software BCH encoder/decoder
+ *
+ * The word-wide encoder, which uses slicing-by-8 if CONFIG_BCH_SLICE_BY_8
+ * is enabled, is checked bit for bit against the byte-at-a-time path, then
+ * random error patterns of up to t bits are corrected. Timings are in
+ * test/bench/bch.c
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <rand.h>
+#include <linux/bch.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+struct test_bch_s {
+	int m;
+	int t;
+	int len;
+};
+
+static struct test_bch_s test_bch[] = {
+	{  8,  2,   29 },	/* single ecc word */
+	{ 13,  4,  512 },
+	{ 13,  8,  512 },
+	{ 14, 24, 1024 },
+	{ 15, 40, 1024 },
+};
+
+/* Number of random error patterns tried for each error count */
+#define BCH_TEST_ROUNDS		8
+
+/**
+ * struct test_bch_bufs - Buffers used by the tests
+ *
+ * @data: Data as read back, with errors
+ * @orig: Data as written, @len + 8 bytes so that it can be misaligned
+ * @ecc: ECC as read back, with errors
+ * @orig_ecc: ECC as written
+ * @errloc: Error locations, t entries
+ */
+struct test_bch_bufs {
+	u8 *data;
+	u8 *orig;
+	u8 *ecc;
+	u8 *orig_ecc;
+	unsigned int *errloc;
+};
+
+static void rand_buf(u8 *buf, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = rand() & 0xff;
+}
+
+/* Encode one byte at a time, which only uses the first remainder table */
+static void encode_bytewise(struct bch_control *bch, const u8 *data, int len,
+			    u8 *ecc)
+{
+	int i;
+
+	memset(ecc, 0, bch->ecc_bytes);
+	for (i = 0; i < len; i++)
+		encode_bch(bch, data + i, 1, ecc);
+}
+
+/* Flip bit @loc of the codeword, numbered the way decode_bch() reports it */
+static void flip_bit(u8 *data, int len, u8 *ecc, unsigned int loc)
+{
+	if (loc < 8 * len)
+		data[loc / 8] ^= 1 << (loc % 8);
+	else
+		ecc[loc / 8 - len] ^= 1 << (loc % 8);
+}
+
+static int lib_test_bch_encode(struct unit_test_state *uts,
+			       struct bch_control *bch, int len,
+			       struct test_bch_bufs *b)
+{
+	u8 *buf = b->orig, *ecc = b->ecc, *ref = b->orig_ecc;
+	int offset;
+
+	/* cover the unaligned head and tail of the word-wide loop */
+	for (offset = 0; offset < 8; offset++) {
+		rand_buf(buf + offset, len);
+		encode_bytewise(bch, buf + offset, len, ref);
+
+		memset(ecc, 0, bch->ecc_bytes);
+		encode_bch(bch, buf + offset, len, ecc);
+		ut_asserteq_mem(ref, ecc, bch->ecc_bytes);
+
+		/* incremental computation over two chunks */
+		memset(ecc, 0, bch->ecc_bytes);
+		encode_bch(bch, buf + offset, len / 2 + 1, ecc);
+		encode_bch(bch, buf + offset + len / 2 + 1, len - len / 2 - 1,
+			   ecc);
+		ut_asserteq_mem(ref, ecc, bch->ecc_bytes);
+	}
+
+	return 0;
+}
+
+static int lib_test_bch_decode(struct unit_test_state *uts,
+			       struct bch_control *bch, int len,
+			       struct test_bch_bufs *b)
+{
+	const unsigned int nbits = 8 * len + bch->ecc_bits;
+	unsigned int *errloc = b->errloc, loc, q;
+	u8 *data = b->data, *orig = b->orig;
+	u8 *ecc = b->ecc, *orig_ecc = b->orig_ecc;
+	int nerr, round, i, j, ret;
+
+	for (nerr = 0; nerr <= bch->t; nerr++) {
+		for (round = 0; round < BCH_TEST_ROUNDS; round++) {
+			rand_buf(orig, len);
+			memset(orig_ecc, 0, bch->ecc_bytes);
+			encode_bch(bch, orig, len, orig_ecc);
+			memcpy(data, orig, len);
+			memcpy(ecc, orig_ecc, bch->ecc_bytes);
+
+			/* nerr distinct positions among the codeword bits */
+			for (i = 0; i < nerr; i++) {
+				do {
+					q = rand() % nbits;
+					for (j = 0; j < i; j++)
+						if (errloc[j] == q)
+							break;
+				} while (j < i);
+				errloc[i] = q;
+			}
+			for (i = 0; i < nerr; i++) {
+				q = errloc[i];
+				loc = (q & ~7) | (7 - (q & 7));
+				flip_bit(data, len, ecc, loc);
+			}
+
+			ret = decode_bch(bch, data, len, ecc, NULL, NULL,
+					 errloc);
+			ut_asserteq(nerr, ret);
+			for (i = 0; i < ret; i++)
+				flip_bit(data, len, ecc, errloc[i]);
+			ut_asserteq_mem(orig, data, len);
+			ut_asserteq_mem(orig_ecc, ecc, bch->ecc_bytes);
+		}
+	}
+
+	/* no error: the calc_ecc-only form must exit early as well */
+	memset(ecc, 0, bch->ecc_bytes);
+	ut_asserteq(0, decode_bch(bch, NULL, len, NULL, ecc, NULL, errloc));
+
+	return 0;
+}
+
+static int lib_test_bch_one(struct unit_test_state *uts,
+			    struct bch_control *bch, int len,
+			    struct test_bch_bufs *b)
+{
+	ut_assertnonnull(bch);
+	ut_assertnonnull(b->data);
+	ut_assertnonnull(b->orig);
+	ut_assertnonnull(b->ecc);
+	ut_assertnonnull(b->orig_ecc);
+	ut_assertnonnull(b->errloc);
+
+	ut_assertok(lib_test_bch_encode(uts, bch, len, b));
+	ut_assertok(lib_test_bch_decode(uts, bch, len, b));
+
+	return 0;
+}
+
+static int lib_test_bch(struct unit_test_state *uts)
+{
+	struct test_bch_bufs b;
+	struct bch_control *bch;
+	int i, len, ret;
+
+	srand(0x1234);
+	for (i = 0; i < ARRAY_SIZE(test_bch); i++) {
+		/* free the buffers even if an assertion fails */
+		bch = init_bch(test_bch[i].m, test_bch[i].t, 0);
+		len = test_bch[i].len;
+		b.data = malloc(len);
+		b.orig = malloc(len + 8);
+		b.ecc = bch ? malloc(bch->ecc_bytes) : NULL;
+		b.orig_ecc = bch ? malloc(bch->ecc_bytes) : NULL;
+		b.errloc = calloc(test_bch[i].t, sizeof(*b.errloc));
+		ret = lib_test_bch_one(uts, bch, len, &b);
+		free(b.errloc);
+		free(b.orig_ecc);
+		free(b.ecc);
+		free(b.orig);
+		free(b.data);
+		free_bch(bch);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+LIB_TEST(lib_test_bch, 0);
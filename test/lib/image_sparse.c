@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the Android sparse image writer
+ *
+ * A small image is expanded into a RAM disk, both from memory and fed in
+ * pieces of odd sizes, and the result is compared with the expected data.
+ */
+
+#include <common.h>
+#include <image-sparse.h>
+#include <malloc.h>
+#include <rand.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define DISK_BLKSZ	512
+#define DISK_BLKS	64
+/* sparse blocks are two disk blocks */
+#define SPARSE_BLKSZ	1024
+/* both headers are longer than the structures, as allowed by the format */
+#define FILE_HDR_SZ	(sizeof(sparse_header_t) + 4)
+#define CHUNK_HDR_SZ	(sizeof(chunk_header_t) + 4)
+#define FILL_VAL	0x12345678
+#define PART_START	4
+
+struct ram_disk {
+	u8 data[DISK_BLKS * DISK_BLKSZ];
+	int writes;
+	int discards;
+	lbaint_t discard_blk;
+	lbaint_t discard_cnt;
+};
+
+static lbaint_t ram_disk_write(struct sparse_storage *info, lbaint_t blk,
+			       lbaint_t blkcnt, const void *buffer)
+{
+	struct ram_disk *disk = info->priv;
+
+	memcpy(disk->data + blk * DISK_BLKSZ, buffer, blkcnt * DISK_BLKSZ);
+	disk->writes++;
+
+	return blkcnt;
+}
+
+static lbaint_t ram_disk_reserve(struct sparse_storage *info, lbaint_t blk,
+				 lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static lbaint_t ram_disk_discard(struct sparse_storage *info, lbaint_t blk,
+				 lbaint_t blkcnt)
+{
+	struct ram_disk *disk = info->priv;
+
+	disk->discards++;
+	disk->discard_blk = blk;
+	disk->discard_cnt = blkcnt;
+
+	return blkcnt;
+}
+
+static void *add_chunk(void *p, u16 type, u32 chunk_sz, u32 data_sz)
+{
+	chunk_header_t *chunk = p;
+
+	memset(p, '\0', CHUNK_HDR_SZ);
+	chunk->chunk_type = type;
+	chunk->chunk_sz = chunk_sz;
+	chunk->total_sz = CHUNK_HDR_SZ + data_sz;
+
+	return p + CHUNK_HDR_SZ;
+}
+
+static void *add_raw(void *p, void *expect, u32 chunk_sz)
+{
+	int i;
+
+	p = add_chunk(p, CHUNK_TYPE_RAW, chunk_sz, chunk_sz * SPARSE_BLKSZ);
+	for (i = 0; i < chunk_sz * SPARSE_BLKSZ; i++)
+		((u8 *)p)[i] = rand();
+	memcpy(expect, p, chunk_sz * SPARSE_BLKSZ);
+
+	return p + chunk_sz * SPARSE_BLKSZ;
+}
+
+static void *add_fill(void *p, void *expect, u32 chunk_sz)
+{
+	u32 *out = expect;
+	int i;
+
+	p = add_chunk(p, CHUNK_TYPE_FILL, chunk_sz, sizeof(u32));
+	*(u32 *)p = FILL_VAL;
+	for (i = 0; i < chunk_sz * SPARSE_BLKSZ / sizeof(u32); i++)
+		out[i] = FILL_VAL;
+
+	return p + sizeof(u32);
+}
+
+/*
+ * Build a sparse image of 10 blocks and the disk contents expected after
+ * writing it at PART_START. Returns the size of the image.
+ */
+static size_t build_image(void *image, u8 *expect)
+{
+	sparse_header_t *header = image;
+	u8 *out = expect + PART_START * DISK_BLKSZ;
+	void *p;
+
+	memset(image, '\0', FILE_HDR_SZ);
+	header->magic = SPARSE_HEADER_MAGIC;
+	header->major_version = 1;
+	header->file_hdr_sz = FILE_HDR_SZ;
+	header->chunk_hdr_sz = CHUNK_HDR_SZ;
+	header->blk_sz = SPARSE_BLKSZ;
+	header->total_blks = 10;
+	header->total_chunks = 7;
+
+	p = image + FILE_HDR_SZ;
+	p = add_raw(p, out, 1);
+	p = add_raw(p, out + SPARSE_BLKSZ, 2);
+	p = add_fill(p, out + 3 * SPARSE_BLKSZ, 3);
+	/* the DONT_CARE blocks keep what was on the disk */
+	p = add_chunk(p, CHUNK_TYPE_DONT_CARE, 2, 0);
+	p = add_raw(p, out + 8 * SPARSE_BLKSZ, 1);
+	p = add_chunk(p, CHUNK_TYPE_CRC32, 0, 0);
+	p = add_fill(p, out + 9 * SPARSE_BLKSZ, 1);
+
+	return p - image;
+}
+
+static void init_storage(struct sparse_storage *info, struct ram_disk *disk)
+{
+	memset(disk->data, 0xaa, sizeof(disk->data));
+	disk->writes = 0;
+	disk->discards = 0;
+
+	info->blksz = DISK_BLKSZ;
+	info->start = PART_START;
+	info->size = DISK_BLKS - PART_START;
+	info->priv = disk;
+	info->write = ram_disk_write;
+	info->reserve = ram_disk_reserve;
+	info->discard = NULL;
+	info->mssg = NULL;
+}
+
+static int lib_test_image_sparse(struct unit_test_state *uts)
+{
+	static const int pieces[] = { 1, 7, 13, 512, 4093, 11 };
+	struct sparse_storage info;
+	struct sparse_stream ss;
+	struct ram_disk *disk;
+	u8 *image, *expect;
+	size_t size, pos, n;
+	int i;
+
+	disk = malloc(sizeof(*disk));
+	image = malloc(16 * SPARSE_BLKSZ);
+	expect = malloc(sizeof(disk->data));
+	ut_assertnonnull(disk);
+	ut_assertnonnull(image);
+	ut_assertnonnull(expect);
+
+	srand(0x5a5a);
+	memset(expect, 0xaa, sizeof(disk->data));
+	size = build_image(image, expect);
+
+	/* whole image in memory */
+	init_storage(&info, disk);
+	ut_assertok(write_sparse_image(&info, "test", image, NULL));
+	ut_asserteq_mem(expect, disk->data, sizeof(disk->data));
+	/* the first two RAW chunks are merged, the last goes with the FILL */
+	ut_asserteq(4, disk->writes);
+
+	/* the same image in pieces, with DONT_CARE discarded */
+	init_storage(&info, disk);
+	info.discard = ram_disk_discard;
+	ut_assertok(sparse_stream_start(&ss, &info));
+	for (pos = 0, i = 0; pos < size; pos += n, i++) {
+		n = min_t(size_t, pieces[i % ARRAY_SIZE(pieces)], size - pos);
+		ut_assertok(sparse_stream_write(&ss, image + pos, n, NULL));
+	}
+	ut_assertok(sparse_stream_finish(&ss, "test", NULL));
+	ut_asserteq_mem(expect, disk->data, sizeof(disk->data));
+	ut_asserteq(1, disk->discards);
+	ut_asserteq(PART_START + 12, disk->discard_blk);
+	ut_asserteq(4, disk->discard_cnt);
+
+	/* a truncated image is reported at the end */
+	init_storage(&info, disk);
+	ut_assertok(sparse_stream_start(&ss, &info));
+	ut_assertok(sparse_stream_write(&ss, image, size - 1, NULL));
+	ut_asserteq(-EIO, sparse_stream_finish(&ss, "test", NULL));
+
+	/* and one that does not fit into the partition right away */
+	init_storage(&info, disk);
+	info.size = 8;
+	ut_assertok(sparse_stream_start(&ss, &info));
+	ut_asserteq(-EIO, sparse_stream_write(&ss, image, size, NULL));
+	ut_asserteq(-EIO, sparse_stream_finish(&ss, "test", NULL));
+
+	free(expect);
+	free(image);
+	free(disk);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_image_sparse, 0);
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for running jobs on several CPUs
+ */
+
+#include <common.h>
+#include <par_run.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define PAR_TEST_JOBS	13
+#define PAR_TEST_FAIL	5
+
+struct par_test {
+	int cpu[PAR_TEST_JOBS];
+	int runs[PAR_TEST_JOBS];
+	bool fail;
+};
+
+static int par_test_job(void *ctx, int job, int cpu)
+{
+	struct par_test *pt = ctx;
+
+	/* each job has its own slot, so no locking is needed */
+	pt->cpu[job] = cpu;
+	pt->runs[job]++;
+	if (pt->fail && job == PAR_TEST_FAIL)
+		return -EIO;
+
+	return 0;
+}
+
+static int lib_test_par_run(struct unit_test_state *uts)
+{
+	struct par_test pt;
+	int ncpus, job;
+
+	ncpus = par_run_cpus();
+	ut_assert(ncpus >= 1);
+	ut_assert(ncpus <= CONFIG_PAR_RUN_MAX_CPUS);
+	/* sandbox always runs jobs on at least two threads */
+	if (IS_ENABLED(CONFIG_SANDBOX))
+		ut_assert(ncpus >= 2);
+
+	memset(&pt, '\0', sizeof(pt));
+	ut_assertok(par_run(par_test_job, &pt, PAR_TEST_JOBS));
+	for (job = 0; job < PAR_TEST_JOBS; job++) {
+		ut_asserteq(1, pt.runs[job]);
+		ut_asserteq(job % min(ncpus, PAR_TEST_JOBS), pt.cpu[job]);
+	}
+
+	/* a failure is reported, but the other jobs still run */
+	memset(&pt, '\0', sizeof(pt));
+	pt.fail = true;
+	ut_asserteq(-EIO, par_run(par_test_job, &pt, PAR_TEST_JOBS));
+	for (job = 0; job < PAR_TEST_JOBS; job++)
+		ut_asserteq(1, pt.runs[job]);
+
+	/* fewer jobs than CPUs, and none at all */
+	memset(&pt, '\0', sizeof(pt));
+	ut_assertok(par_run(par_test_job, &pt, 1));
+	ut_asserteq(1, pt.runs[0]);
+	ut_asserteq(0, pt.cpu[0]);
+	ut_asserteq(0, pt.runs[1]);
+	ut_assertok(par_run(par_test_job, &pt, 0));
+	ut_asserteq(1, pt.runs[0]);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_par_run, 0);
@@ -0,0 +1,421 @@
+# SPDX-License-Identifier: GPL-2.0
+
+"""Write a small single-device btrfs image with chosen file extent layouts.
+
+mkfs.btrfs --rootdir lays each file out as it likes and does not compress
+it, so the layouts that the extent reader has to handle are written here
+directly: runs of extents that are contiguous on disk, implicit and explicit
+holes, preallocated extents, zlib/zstd/lzo extents which are referenced in
+part or shared by several file extents, and inline extents.
+
+Only what U-Boot reads is written: a superblock, the chunk, root and fs
+trees and an empty csum tree. There is no extent tree.
+"""
+
+import random
+import struct
+import subprocess
+import zlib
+
+SECTOR = 4096
+NODE = 4096
+GEN = 7
+CHUNK_START = 1 << 20
+IMAGE_SIZE = 16 << 20
+FSID = bytes(range(16))
+DEV_UUID = bytes(range(16, 32))
+CHUNK_TREE_UUID = bytes(range(32, 48))
+
+INODE_ITEM, INODE_REF, DIR_ITEM, DIR_INDEX = 1, 12, 84, 96
+EXTENT_DATA, ROOT_ITEM, DEV_ITEM, CHUNK_ITEM = 108, 132, 216, 228
+FS_TREE, CSUM_TREE, ROOT_TREE, CHUNK_TREE = 5, 7, 1, 3
+INLINE, REG, PREALLOC = 0, 1, 2
+COMP_NONE, COMP_ZLIB, COMP_LZO, COMP_ZSTD = 0, 1, 2, 3
+
+# MIXED_BACKREF, COMPRESS_LZO, COMPRESS_ZSTD and NO_HOLES
+INCOMPAT = 1 | (1 << 3) | (1 << 4) | (1 << 9)
+
+HEADER_SIZE = 101
+ITEM_SIZE = 25
+KEY_PTR_SIZE = 33
+
+def crc32c(crc, data):
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x82f63b78 if crc & 1 else crc >> 1
+    return crc
+
+def csum(data):
+    return struct.pack('<I', crc32c(0xffffffff, data) ^ 0xffffffff)
+
+def name_hash(name):
+    return crc32c(0xfffffffe, name)
+
+def key(objectid, type, offset):
+    return struct.pack('<QBQ', objectid, type, offset)
+
+def lzo_count(out, count):
+    while count > 255:
+        out.append(0)
+        count -= 255
+    out.append(count)
+
+def lzo_literals(out, lit):
+    count = len(lit)
+    if not count:
+        return
+    if not out and count <= 238:
+        out.append(17 + count)
+    elif count <= 3:
+        # these go in the bottom bits of the previous match
+        out[-2] |= count
+    elif count <= 18:
+        out.append(count - 3)
+    else:
+        out.append(0)
+        lzo_count(out, count - 18)
+    out += lit
+
+def lzo_match(out, length, dist):
+    if length <= 8 and dist <= 0x800:
+        dist -= 1
+        out += bytes([(length - 1) << 5 | (dist & 7) << 2, dist >> 3])
+        return
+    if dist <= 0x4000:
+        dist -= 1
+        if length <= 33:
+            out.append(32 | (length - 2))
+        else:
+            out.append(32)
+            lzo_count(out, length - 33)
+    else:
+        dist -= 0x4000
+        if length <= 9:
+            out.append(16 | (dist >> 11 & 8) | (length - 2))
+        else:
+            out.append(16 | (dist >> 11 & 8))
+            lzo_count(out, length - 9)
+    out += bytes([(dist << 2) & 0xff, (dist >> 6) & 0xff])
+
+def lzo1x_compress(data):
+    """Greedy LZO1X compressor, enough for U-Boot's decompressor."""
+    out = bytearray()
+    last = {}
+    pos = lit = 0
+    while pos + 4 <= len(data):
+        prev = last.get(data[pos:pos + 4])
+        last[data[pos:pos + 4]] = pos
+        if prev is None or pos - prev > 0xbfff:
+            pos += 1
+            continue
+        length = 4
+        while (pos + length < len(data) and
+               data[prev + length] == data[pos + length]):
+            length += 1
+        lzo_literals(out, data[lit:pos])
+        lzo_match(out, length, pos - prev)
+        pos += length
+        lit = pos
+    lzo_literals(out, data[lit:])
+    out += b'\x11\x00\x00'
+    return bytes(out)
+
+def compress(comp, data):
+    if comp == COMP_ZLIB:
+        return zlib.compress(data)
+    if comp == COMP_ZSTD:
+        # btrfs limits the zstd window to 128KiB
+        return subprocess.run(['zstd', '-q', '-c', '--zstd=wlog=17'],
+                              input=data, stdout=subprocess.PIPE,
+                              check=True).stdout
+
+    # btrfs compresses each sector as its own LZO segment, and a segment
+    # header never crosses a sector boundary
+    out = bytearray(4)
+    for pos in range(0, len(data), SECTOR):
+        seg = lzo1x_compress(data[pos:pos + SECTOR])
+        out += struct.pack('<I', len(seg)) + seg
+        if SECTOR - len(out) % SECTOR < 4:
+            out += bytes(SECTOR - len(out) % SECTOR)
+    out[:4] = struct.pack('<I', len(out))
+    return bytes(out)
+
+def round_up(val):
+    return (val + SECTOR - 1) // SECTOR * SECTOR
+
+class BtrfsImage:
+    def __init__(self):
+        self.img = bytearray(IMAGE_SIZE)
+        self.next = CHUNK_START
+        self.files = {}
+        self.rnd = random.Random(42)
+        self.words = [bytes(self.rnd.choice(b'abcdefghijklmnop')
+                            for _ in range(self.rnd.randint(2, 8)))
+                      for _ in range(200)]
+
+    def alloc(self, size, data=b''):
+        """Allocate sectors after the last ones and fill them with @data"""
+        at = self.next
+        self.next += round_up(size)
+        assert self.next <= IMAGE_SIZE
+        self.img[at:at + len(data)] = data
+        return at
+
+    def text(self, size):
+        out = bytearray()
+        while len(out) < size:
+            out += self.rnd.choice(self.words) + b' '
+        return bytes(out[:size])
+
+    def random(self, size):
+        return bytes(self.rnd.getrandbits(8) for _ in range(size))
+
+    @staticmethod
+    def extent(type, comp, ram, bytenr=0, disk_num=0, offset=0, num=0,
+               inline=b''):
+        item = struct.pack('<QQBBHB', GEN, ram, comp, 0, 0, type)
+        if type == INLINE:
+            return item + inline
+        return item + struct.pack('<QQQQ', bytenr, disk_num, offset, num)
+
+    def plain(self, data, pos, size):
+        """An uncompressed extent holding data[pos:pos + size]"""
+        at = self.alloc(size, data[pos:pos + size])
+        return (pos, self.extent(REG, COMP_NONE, size, at, size, 0, size))
+
+    def compressed(self, comp, raw):
+        """Write @raw compressed and return its address and size on disk"""
+        data = compress(comp, raw)
+        return self.alloc(len(data), data), round_up(len(data))
+
+    def add_plain(self):
+        # seven extents which are contiguous on disk, then one elsewhere
+        data = self.random(1 << 20)
+        extents = [self.plain(data, i << 17, 1 << 17) for i in range(7)]
+        self.alloc(SECTOR)
+        extents.append(self.plain(data, 7 << 17, 1 << 17))
+        self.files['plain.bin'] = (data, extents)
+
+    def add_holes(self):
+        size = 400000
+        data = bytearray(self.random(size))
+        extents = [self.plain(data, 0, 0x10000)]
+
+        # an implicit hole (NO_HOLES), an explicit one and a preallocated one
+        data[0x10000:0x30000] = bytes(0x20000)
+        extents.append(self.plain(data, 0x30000, 0x10000))
+        data[0x40000:0x50000] = bytes(0x10000)
+        extents.append((0x40000,
+                        self.extent(REG, COMP_NONE, 0x10000, 0, 0, 0,
+                                    0x10000)))
+        data[0x50000:0x60000] = bytes(0x10000)
+        at = self.alloc(0x10000)
+        extents.append((0x50000,
+                        self.extent(PREALLOC, COMP_NONE, 0x10000, at,
+                                    0x10000, 0, 0x10000)))
+
+        tail = round_up(size - 0x60000)
+        at = self.alloc(tail, bytes(data[0x60000:]))
+        extents.append((0x60000,
+                        self.extent(REG, COMP_NONE, tail, at, tail, 0, tail)))
+        self.files['holes.bin'] = (bytes(data), extents)
+
+    def add_compressed(self, name, comp):
+        size = 24 * 0x20000 + 5000
+        data = bytearray(self.text(size))
+        extents = []
+
+        # extents which are contiguous on disk
+        pos = 0
+        for i in range(20):
+            at, disk = self.compressed(comp, bytes(data[pos:pos + 0x20000]))
+            extents.append((pos, self.extent(REG, comp, 0x20000, at, disk, 0,
+                                             0x20000)))
+            pos += 0x20000
+
+        # an extent of which only the middle is referenced
+        raw = self.text(0x20000)
+        at, disk = self.compressed(comp, raw)
+        data[pos:pos + 0x10000] = raw[0x4000:0x14000]
+        extents.append((pos, self.extent(REG, comp, 0x20000, at, disk,
+                                         0x4000, 0x10000)))
+        pos += 0x10000
+
+        # three file extents sharing one, with a plain extent in between
+        raw = self.text(0x20000)
+        at, disk = self.compressed(comp, raw)
+        data[pos:pos + 0x8000] = raw[:0x8000]
+        extents.append((pos, self.extent(REG, comp, 0x20000, at, disk, 0,
+                                         0x8000)))
+        pos += 0x8000
+        extents.append(self.plain(data, pos, 0x8000))
+        pos += 0x8000
+        data[pos:pos + 0x10000] = raw[0x10000:]
+        extents.append((pos, self.extent(REG, comp, 0x20000, at, disk,
+                                         0x10000, 0x10000)))
+        pos += 0x10000
+        data[pos:pos + 0x10000] = raw[:0x10000]
+        extents.append((pos, self.extent(REG, comp, 0x20000, at, disk, 0,
+                                         0x10000)))
+        pos += 0x10000
+
+        # a tail which does not fill its last sector
+        tail = round_up(size - pos)
+        raw = bytes(data[pos:]) + bytes(tail - (size - pos))
+        at, disk = self.compressed(comp, raw)
+        extents.append((pos, self.extent(REG, comp, tail, at, disk, 0, tail)))
+        self.files[name] = (bytes(data), extents)
+
+    def add_mixed(self):
+        # small extents of each kind, over several leaves
+        size = 200 * 0x2000 + 123
+        data = self.text(size)
+        extents = []
+        for i, pos in enumerate(range(0, size, 0x2000)):
+            length = round_up(min(0x2000, size - pos))
+            raw = data[pos:pos + length]
+            raw += bytes(length - len(raw))
+            comp = (COMP_NONE, COMP_ZLIB, COMP_ZSTD, COMP_LZO)[i % 4]
+            if comp == COMP_NONE:
+                at, disk = self.alloc(length, raw), length
+            else:
+                at, disk = self.compressed(comp, raw)
+            extents.append((pos, self.extent(REG, comp, length, at, disk, 0,
+                                             length)))
+        self.files['mixed.bin'] = (data, extents)
+
+    def add_inline(self):
+        data = self.text(1000)
+        self.files['inline.txt'] = (data, [(0, self.extent(
+            INLINE, COMP_NONE, len(data), inline=data))])
+        data = self.text(3000)
+        self.files['inline_z.txt'] = (data, [(0, self.extent(
+            INLINE, COMP_ZLIB, len(data), inline=zlib.compress(data)))])
+
+    def block(self, bytenr, owner, nritems, level, body):
+        blk = (bytes(32) + FSID + struct.pack('<QQ', bytenr, 1 | (1 << 56)) +
+               CHUNK_TREE_UUID +
+               struct.pack('<QQIB', GEN, owner, nritems, level) + body)
+        blk += bytes(NODE - len(blk))
+        self.img[bytenr:bytenr + NODE] = csum(blk[32:]) + bytes(28) + blk[32:]
+
+    def tree(self, owner, items):
+        """Write a tree holding @items, sorted, and return its root and level"""
+        leaves = [[]]
+        used = 0
+        for item in items:
+            if used + ITEM_SIZE + len(item[1]) > NODE - HEADER_SIZE:
+                leaves.append([])
+                used = 0
+            leaves[-1].append(item)
+            used += ITEM_SIZE + len(item[1])
+
+        ptrs = []
+        for leaf in leaves:
+            at = self.alloc(NODE)
+            body = bytearray(NODE - HEADER_SIZE)
+            end = len(body)
+            for i, (k, d) in enumerate(leaf):
+                end -= len(d)
+                body[end:end + len(d)] = d
+                body[i * ITEM_SIZE:(i + 1) * ITEM_SIZE] = (
+                    k + struct.pack('<II', end, len(d)))
+            self.block(at, owner, len(leaf), 0, bytes(body))
+            ptrs.append((leaf[0][0] if leaf else key(0, 0, 0), at))
+
+        level = 0
+        per_node = (NODE - HEADER_SIZE) // KEY_PTR_SIZE
+        while len(ptrs) > 1:
+            level += 1
+            nodes = []
+            for i in range(0, len(ptrs), per_node):
+                at = self.alloc(NODE)
+                body = b''.join(k + struct.pack('<QQ', b, GEN)
+                                for k, b in ptrs[i:i + per_node])
+                self.block(at, owner, len(ptrs[i:i + per_node]), level, body)
+                nodes.append((ptrs[i][0], at))
+            ptrs = nodes
+        return ptrs[0][1], level
+
+    @staticmethod
+    def timespec():
+        return struct.pack('<QI', 1600000000, 0)
+
+    @classmethod
+    def inode_item(cls, size, mode):
+        return (struct.pack('<QQQQQIIIIQQQ', GEN, GEN, size, 0, 0, 1, 0, 0,
+                            mode, 0, 0, 0) + bytes(32) + cls.timespec() * 4)
+
+    @classmethod
+    def root_item(cls, bytenr, level):
+        return (cls.inode_item(3, 0o40755) +
+                struct.pack('<QQQQQQQI', GEN, 256, bytenr, 0, NODE, 0, 0, 1) +
+                bytes(17) + struct.pack('<BBQ', 0, level, GEN) + bytes(48) +
+                struct.pack('<QQQQ', GEN, GEN, 0, 0) + cls.timespec() * 4 +
+                bytes(64))
+
+    def write(self, path):
+        items = [(key(256, INODE_ITEM, 0), self.inode_item(0, 0o40755)),
+                 (key(256, INODE_REF, 256), struct.pack('<QH', 0, 2) + b'..')]
+        for i, (name, (data, extents)) in enumerate(sorted(self.files.items())):
+            ino = 257 + i
+            name = name.encode()
+            items.append((key(ino, INODE_ITEM, 0),
+                          self.inode_item(len(data), 0o100644)))
+            items.append((key(ino, INODE_REF, 256),
+                          struct.pack('<QH', i + 2, len(name)) + name))
+            items += [(key(ino, EXTENT_DATA, pos), item)
+                      for pos, item in extents]
+            dir_item = (key(ino, INODE_ITEM, 0) +
+                        struct.pack('<QHHB', GEN, 0, len(name), 1) + name)
+            items.append((key(256, DIR_ITEM, name_hash(name)), dir_item))
+            items.append((key(256, DIR_INDEX, i + 2), dir_item))
+        items.sort(key=lambda item: struct.unpack('<QBQ', item[0]))
+        fs_root, fs_level = self.tree(FS_TREE, items)
+
+        csum_root, _ = self.tree(CSUM_TREE, [])
+        root, level = self.tree(ROOT_TREE, [
+            (key(FS_TREE, ROOT_ITEM, 0), self.root_item(fs_root, fs_level)),
+            (key(CSUM_TREE, ROOT_ITEM, 0), self.root_item(csum_root, 0))])
+
+        # a single chunk maps the rest of the device one to one
+        chunk = (struct.pack('<QQQQIIIHH', IMAGE_SIZE - CHUNK_START, 2,
+                             0x10000, 7, SECTOR, SECTOR, SECTOR, 1, 0) +
+                 struct.pack('<QQ', 1, CHUNK_START) + DEV_UUID)
+        dev_item = (struct.pack('<QQQIIIQQQIBB', 1, IMAGE_SIZE, self.next,
+                                SECTOR, SECTOR, SECTOR, 0, 0, 0, 0, 0, 0) +
+                    DEV_UUID + FSID)
+        chunk_root, chunk_level = self.tree(CHUNK_TREE, [
+            (key(1, DEV_ITEM, 1), dev_item),
+            (key(256, CHUNK_ITEM, CHUNK_START), chunk)])
+
+        sys_chunks = key(256, CHUNK_ITEM, CHUNK_START) + chunk
+        sb = (bytes(32) + FSID + struct.pack('<QQ', 0x10000, 0) +
+              b'_BHRfS_M' +
+              struct.pack('<QQQQQQQQQ', GEN, root, chunk_root, 0, 0,
+                          IMAGE_SIZE, self.next - CHUNK_START, 6, 1) +
+              struct.pack('<IIIII', SECTOR, NODE, NODE, SECTOR,
+                          len(sys_chunks)) +
+              struct.pack('<QQQQ', GEN, 0, 0, INCOMPAT) +
+              struct.pack('<HBBB', 0, level, chunk_level, 0) + dev_item +
+              bytes(256) + struct.pack('<QQ', 0, 0) + FSID + bytes(224) +
+              sys_chunks)
+        sb += bytes(SECTOR - len(sb))
+        self.img[0x10000:0x10000 + SECTOR] = csum(sb[32:]) + bytes(28) + sb[32:]
+
+        with open(path, 'wb') as fd:
+            fd.write(self.img)
+
+def make_btrfs_image(path):
+    """Write the image to @path and return a dict of file name to contents"""
+    image = BtrfsImage()
+    image.add_plain()
+    image.add_holes()
+    image.add_compressed('zlib.bin', COMP_ZLIB)
+    image.add_compressed('zstd.bin', COMP_ZSTD)
+    image.add_compressed('lzo.bin', COMP_LZO)
+    image.add_mixed()
+    image.add_inline()
+    image.write(path)
+    return {name: data for name, (data, _) in image.files.items()}
@@ -0,0 +1,58 @@
+# SPDX-License-Identifier: GPL-2.0
+
+import os
+import pytest
+import random
+import zlib
+from btrfs_common import make_btrfs_image
+
+def btrfs_reads(size, rnd):
+    """Return the (offset, length) pairs to read from a file of @size bytes
+
+    A length of 0 reads up to the end of the file.
+    """
+    reads = [(0, 0), (4095, 2), (size - 1, 1), (size // 3, 0)]
+
+    # unaligned, crossing any number of extents
+    for _ in range(10):
+        offset = rnd.randrange(size)
+        reads.append((offset, rnd.randrange(1, size - offset + 1)))
+
+    # aligned, so that whole extents are read straight to the destination
+    for _ in range(4):
+        offset = rnd.randrange(max(1, size // 4096)) * 4096
+        reads.append((offset, min(size - offset, rnd.randrange(1, 64) * 4096)))
+
+    # past the end of the file, which ends inside its last extent
+    reads.append((size - 5000, 0x20000))
+    return [(offset, length) for offset, length in reads if offset >= 0]
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('fs_btrfs')
+@pytest.mark.requiredtool('zstd')
+def test_btrfs_load(u_boot_console):
+    """Test reading parts of files laid out in different kinds of extents"""
+    path = os.path.join(u_boot_console.config.build_dir, 'btrfs.img')
+    files = make_btrfs_image(path)
+    rnd = random.Random(7)
+
+    try:
+        u_boot_console.run_command('host bind 0 ' + path)
+        for name, data in sorted(files.items()):
+            for offset, length in btrfs_reads(len(data), rnd):
+                want = data[offset:offset + length] if length else data[offset:]
+                output = u_boot_console.run_command_list([
+                    'load host 0 $kernel_addr_r %s %x %x' % (name, length,
+                                                            offset),
+                    'crc32 $kernel_addr_r $filesize'])
+                assert ('%d bytes read' % len(want)) in output[0], \
+                    '%s at %x' % (name, offset)
+                assert ('==> %08x' % zlib.crc32(want)) in output[1], \
+                    '%s at %x, %x bytes' % (name, offset, length)
+
+        output = u_boot_console.run_command('load host 0 $kernel_addr_r xxx')
+        assert 'Failed to load' in output
+    finally:
+        u_boot_console.run_command('host bind 0')
+        os.remove(path)
@@ -0,0 +1,131 @@
+# SPDX-License-Identifier: GPL-2.0
+
+import os
+import pytest
+import random
+import shutil
+import subprocess
+import zlib
+
+EROFS_SRC_DIR = 'erofs_src_dir'
+EROFS_IMAGE_NAME = 'erofs.img'
+
+# (file name, size): a few sub-block files exercise inline data, the
+# larger ones span many logical clusters
+FILES = [('tiny', 100), ('f4k', 4096), ('f5k', 5096), ('f1m', 1024 * 1024),
+         ('odd', 300001)]
+
+def generate_file(path, size):
+    # mix of compressible text and random data so that LZ4 images
+    # contain both compressed and plain extents
+    words = [b'erofs', b'u-boot', b'sandbox', b'lz4', b'cluster', b'inline']
+    content = bytearray()
+    while len(content) < size:
+        if random.randint(0, 7):
+            content += random.choice(words) + b' '
+        else:
+            content += bytes(random.getrandbits(8) for _ in range(64))
+    with open(path, 'wb') as f:
+        f.write(content[:size])
+    return zlib.crc32(content[:size])
+
+def make_erofs_image(build_dir, opts):
+    root = os.path.join(build_dir, EROFS_SRC_DIR)
+    image_path = os.path.join(build_dir, EROFS_IMAGE_NAME)
+    shutil.rmtree(root, ignore_errors=True)
+    os.makedirs(os.path.join(root, 'subdir'))
+
+    crcs = {}
+    for (name, size) in FILES:
+        crcs[name] = generate_file(os.path.join(root, name), size)
+    crcs['subdir/nested'] = generate_file(os.path.join(root, 'subdir',
+                                                       'nested'), 20000)
+    os.symlink('f1m', os.path.join(root, 'sym'))
+    os.symlink('../tiny', os.path.join(root, 'subdir', 'up'))
+
+    subprocess.run(['mkfs.erofs ' + opts + ' ' + image_path + ' ' + root],
+                   shell=True, check=True)
+
+    return crcs
+
+def clean_erofs_image(build_dir):
+    shutil.rmtree(os.path.join(build_dir, EROFS_SRC_DIR))
+    os.remove(os.path.join(build_dir, EROFS_IMAGE_NAME))
+
+def erofs_ls_at_root(u_boot_console):
+    output = u_boot_console.run_command('erofsls host 0')
+    assert '6 file(s), 3 dir(s)' in output
+    assert '<SYM>   sym' in output
+
+    output = u_boot_console.run_command('erofsls host 0 subdir')
+    assert '2 file(s), 2 dir(s)' in output
+
+    output = u_boot_console.run_command('erofsls host 0 xxx')
+    assert '** Cannot find directory. **' in output
+
+def erofs_load_files(u_boot_console, crcs):
+    for (name, crc) in crcs.items():
+        output = u_boot_console.run_command_list([
+            'erofsload host 0 $kernel_addr_r ' + name,
+            'crc32 $kernel_addr_r $filesize'])
+        assert ('%08x' % crc) in ''.join(output)
+
+    output = u_boot_console.run_command('erofsload host 0 $kernel_addr_r xxx')
+    assert 'File not found.' in output
+
+    # loading through a symlink, relative to the parent directory
+    output = u_boot_console.run_command_list([
+        'erofsload host 0 $kernel_addr_r subdir/up',
+        'crc32 $kernel_addr_r $filesize'])
+    assert ('%08x' % crcs['tiny']) in ''.join(output)
+
+def erofs_load_partial(u_boot_console, build_dir):
+    path = os.path.join(build_dir, EROFS_SRC_DIR, 'odd')
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    for (offset, length) in [(1, 100), (4095, 2), (8192, 4096),
+                             (123457, 65536), (len(data) - 10, 10)]:
+        crc = zlib.crc32(data[offset:offset + length])
+        output = u_boot_console.run_command_list([
+            'erofsload host 0 $kernel_addr_r odd %x %x' % (length, offset),
+            'crc32 $kernel_addr_r %x' % length])
+        assert ('%08x' % crc) in ''.join(output)
+
+def erofs_run_all_tests(u_boot_console, opts):
+    build_dir = u_boot_console.config.build_dir
+    try:
+        crcs = make_erofs_image(build_dir, opts)
+    except:
+        pytest.skip('mkfs.erofs does not support "%s"' % opts)
+
+    try:
+        u_boot_console.run_command('host bind 0 ' +
+                                   os.path.join(build_dir, EROFS_IMAGE_NAME))
+        erofs_ls_at_root(u_boot_console)
+        erofs_load_files(u_boot_console, crcs)
+        erofs_load_partial(u_boot_console, build_dir)
+
+        u_boot_console.run_command('size host 0 sym')
+        output = u_boot_console.run_command('printenv filesize')
+        assert 'filesize=100000' in output
+    finally:
+        clean_erofs_image(build_dir)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_erofs')
+@pytest.mark.buildconfigspec('fs_erofs')
+@pytest.mark.requiredtool('mkfs.erofs')
+def test_erofs_uncompressed(u_boot_console):
+    erofs_run_all_tests(u_boot_console, '')
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_erofs')
+@pytest.mark.buildconfigspec('fs_erofs')
+@pytest.mark.requiredtool('mkfs.erofs')
+@pytest.mark.parametrize('opts', ['-zlz4', '-zlz4hc,12',
+                                  '-zlz4hc -C65536', '-Eforce-inode-compact'])
+def test_erofs_lz4(u_boot_console, opts):
+    erofs_run_all_tests(u_boot_console, opts)
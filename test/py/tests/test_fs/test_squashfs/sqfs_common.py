@@ -60,8 +60,9 @@ class Compression:
         sqfs_img = os.path.join(build_dir, "sqfs-" + self.name)
         os.remove(sqfs_img)
 
-files = ["blks_only", "blks_frag", "frag_only"]
-sizes = [4096, 5100, 100]
+# blks_many spans several batches of data blocks, read one after the other
+files = ["blks_only", "blks_frag", "frag_only", "blks_many"]
+sizes = [4096, 5100, 100, 300000]
 gzip = Compression("gzip", files, sizes)
 zstd = Compression("zstd", files, sizes)
 lzo = Compression("lzo", files, sizes)
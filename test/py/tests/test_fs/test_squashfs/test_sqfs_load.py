@@ -4,6 +4,7 @@
 
 import os
 import pytest
+import zlib
 from sqfs_common import *
 
 @pytest.mark.boardspec('sandbox')
@@ -30,10 +31,16 @@ def test_sqfs_load(u_boot_console):
         output = u_boot_console.run_command(command + "xxx")
         assert "File not found." in output
 
+        src = os.path.join(build_dir, "sqfs_src/")
         for (f, s) in zip(opt.files, opt.sizes):
             try:
                 output = u_boot_console.run_command(command + f)
                 assert str(s) in output
+                with open(src + f, "rb") as fd:
+                    crc = "%08x" % zlib.crc32(fd.read())
+                output = u_boot_console.run_command(
+                    "crc32 $kernel_addr_r $filesize")
+                assert crc in output
             except:
                 assert False
                 opt.cleanup(build_dir)
@@ -3,6 +3,34 @@
 
 import os.path
 import pytest
+import u_boot_utils
+
+def setup_fs_cache_image(cons, fs_type):
+    """Create a filesystem image for the dm fs_cache tests.
+
+    The image holds a single file, /file, with the 16KiB pattern that the
+    tests in test/dm/fs_cache.c expect.
+
+    Args:
+        cons (ConsoleBase): U-Boot console
+        fs_type (str): 'ext4' or 'sqfs'
+    """
+    fn = cons.config.source_dir + '/fs_cache.%s.img' % fs_type
+    if os.path.exists(fn):
+        return
+
+    src = cons.config.persistent_data_dir + '/fs_cache'
+    if not os.path.exists(src):
+        os.mkdir(src)
+    with open(src + '/file', 'wb') as fh:
+        fh.write(bytes((i * 7 + (i >> 12)) & 0xff for i in range(0x4000)))
+
+    if fs_type == 'ext4':
+        # U-Boot does not write to filesystems with metadata checksums
+        u_boot_utils.run_and_log(
+            cons, 'mkfs.ext4 -q -O ^metadata_csum -d %s %s 4M' % (src, fn))
+    else:
+        u_boot_utils.run_and_log(cons, 'mksquashfs %s %s -noappend' % (src, fn))
 
 @pytest.mark.buildconfigspec('ut_dm')
 def test_ut_dm_init(u_boot_console):
@@ -21,6 +49,9 @@ def test_ut_dm_init(u_boot_console):
         with open(fn, 'wb') as fh:
             fh.write(data)
 
+    setup_fs_cache_image(u_boot_console, 'ext4')
+    setup_fs_cache_image(u_boot_console, 'sqfs')
+
 def test_ut(u_boot_console, ut_subtest):
     """Execute a "ut" subtest.
 